@@ -0,0 +1,126 @@
+#include "Arena.hpp"
+#include <algorithm>
+#include <iterator>
+#include <new>
+using namespace std;
+
+namespace ElasticC {
+
+// Stored before every arena object, whether allocated in an arena or on the
+// heap
+struct alignas(max_align_t) ArenaHeader {
+  Arena *owner;            // nullptr if the object was allocated on the heap
+  ArenaHeader *prev;       // previous object allocated in the same arena
+  ArenaObjectBase *object; // set once the object has been constructed
+  bool live;               // false once the object has been deleted
+};
+
+vector<ArenaHeader *> Arena::pendingObjects;
+Arena *Arena::currentArenas[2] = {nullptr, nullptr};
+
+static inline size_t AlignSize(size_t size) {
+  return (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+}
+
+Arena::Arena(size_t _blockSize) : blockSize(_blockSize){};
+
+void *Arena::Allocate(size_t size) {
+  size = AlignSize(size);
+  if ((currentBlock == nullptr) || ((blockUsed + size) > currentBlock->size)) {
+    size_t newSize = max(blockSize, size);
+    Block *newBlock = static_cast<Block *>(
+        ::operator new(AlignSize(sizeof(Block)) + newSize));
+    newBlock->prev = currentBlock;
+    newBlock->size = newSize;
+    currentBlock = newBlock;
+    blockUsed = 0;
+  }
+  void *ptr = reinterpret_cast<char *>(currentBlock) +
+              AlignSize(sizeof(Block)) + blockUsed;
+  blockUsed += size;
+  usage += size;
+  return ptr;
+}
+
+void Arena::Release() {
+  // Destroy objects in reverse order of allocation. The header is read before
+  // the destructor runs, as a destructor may delete other objects
+  for (ArenaHeader *hdr = lastObject; hdr != nullptr; hdr = hdr->prev) {
+    if (hdr->live && (hdr->object != nullptr)) {
+      hdr->live = false;
+      hdr->object->~ArenaObjectBase();
+    }
+  }
+  lastObject = nullptr;
+  while (currentBlock != nullptr) {
+    Block *prev = currentBlock->prev;
+    ::operator delete(currentBlock);
+    currentBlock = prev;
+  }
+  blockUsed = 0;
+  usage = 0;
+}
+
+size_t Arena::GetUsage() const { return usage; }
+
+Arena::~Arena() {
+  for (int i = 0; i < 2; i++)
+    if (currentArenas[i] == this)
+      currentArenas[i] = nullptr;
+  Release();
+}
+
+Arena *Arena::GetCurrent(ArenaKind kind) {
+  return currentArenas[static_cast<int>(kind)];
+}
+
+void Arena::SetCurrent(ArenaKind kind, Arena *arena) {
+  currentArenas[static_cast<int>(kind)] = arena;
+}
+
+void *Arena::AllocateObject(ArenaKind kind, size_t size) {
+  Arena *arena = GetCurrent(kind);
+  size_t total = sizeof(ArenaHeader) + size;
+  void *mem =
+      (arena != nullptr) ? arena->Allocate(total) : ::operator new(total);
+  ArenaHeader *hdr = new (mem) ArenaHeader{arena, nullptr, nullptr, true};
+  if (arena != nullptr) {
+    hdr->prev = arena->lastObject;
+    arena->lastObject = hdr;
+  }
+  pendingObjects.push_back(hdr);
+  return hdr + 1;
+}
+
+void Arena::FreeObject(void *ptr) {
+  if (ptr == nullptr)
+    return;
+  ArenaHeader *hdr = static_cast<ArenaHeader *>(ptr) - 1;
+  // The object is still pending if its constructor, or the evaluation of its
+  // arguments, threw
+  auto pending = find(pendingObjects.rbegin(), pendingObjects.rend(), hdr);
+  if (pending != pendingObjects.rend())
+    pendingObjects.erase(next(pending).base());
+  if (hdr->owner == nullptr)
+    ::operator delete(hdr);
+  else
+    hdr->live = false;
+}
+
+ArenaObjectBase::ArenaObjectBase() {
+  // Objects not created by AllocateObject (e.g. on the stack, or static) are
+  // not tracked. This is usually the most recent allocation, but not always,
+  // as in new Outer(new Inner())
+  auto &pending = Arena::pendingObjects;
+  for (auto it = pending.rbegin(); it != pending.rend(); ++it) {
+    if (static_cast<void *>(*it + 1) == this) {
+      (*it)->object = this;
+      pending.erase(next(it).base());
+      break;
+    }
+  }
+}
+
+ArenaObjectBase::~ArenaObjectBase() {}
+
+} // namespace ElasticC
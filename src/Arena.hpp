@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+namespace ElasticC {
+/*
+Bump pointer arenas, used to allocate the large graphs of small objects built by
+each phase of compilation (parse tree, evaluated expressions and HDL netlist).
+Memory is taken from large blocks and released all at once when the phase's
+arena is released, running the destructors of any objects that have not
+already been deleted.
+*/
+class ArenaObjectBase;
+struct ArenaHeader;
+
+// The different kinds of object that may be allocated in an arena, each of
+// which has its own current arena
+enum class ArenaKind {
+  Graph,   // parse tree and evaluator objects
+  Netlist, // HDL devices
+};
+
+class Arena {
+public:
+  Arena(size_t _blockSize = 1 << 20);
+  // Allocate memory from the arena, aligned to max_align_t
+  void *Allocate(size_t size);
+  // Destroy all objects still alive in the arena and free its memory
+  void Release();
+  // Return the number of bytes currently allocated from the arena
+  size_t GetUsage() const;
+  ~Arena();
+
+  // Get and set the arena that new objects of a given kind are allocated in.
+  // If the current arena is nullptr, objects are allocated on the heap
+  static Arena *GetCurrent(ArenaKind kind);
+  static void SetCurrent(ArenaKind kind, Arena *arena);
+
+  // Allocate and free memory for an arena object, including its header
+  static void *AllocateObject(ArenaKind kind, size_t size);
+  static void FreeObject(void *ptr);
+
+private:
+  friend class ArenaObjectBase;
+  struct Block {
+    Block *prev;
+    size_t size;
+  };
+  size_t blockSize;
+  Block *currentBlock = nullptr;
+  size_t blockUsed = 0;
+  size_t usage = 0;
+  // Most recently allocated object, objects are linked in reverse order
+  ArenaHeader *lastObject = nullptr;
+  // Allocations whose objects have not yet been constructed, most recent last.
+  // There can be several, as the arguments to a constructor may allocate and
+  // construct other objects before it runs
+  static vector<ArenaHeader *> pendingObjects;
+  static Arena *currentArenas[2];
+};
+
+// Common base for arena allocated objects, allowing their destructors to be
+// run when the arena is released
+class ArenaObjectBase {
+public:
+  virtual ~ArenaObjectBase();
+
+protected:
+  ArenaObjectBase();
+};
+
+// Classes deriving from this are allocated in the current arena of a given
+// kind (or on the heap if there is none). Deleting an arena allocated object
+// runs its destructor but its memory is not reused until the arena is released
+template <ArenaKind kind> class ArenaAllocated : public ArenaObjectBase {
+public:
+  static void *operator new(size_t size) {
+    return Arena::AllocateObject(kind, size);
+  };
+  static void operator delete(void *ptr) { Arena::FreeObject(ptr); };
+};
+} // namespace ElasticC
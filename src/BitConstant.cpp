@@ -7,6 +7,8 @@ using namespace std;
 
 namespace ElasticC {
 
+typedef unsigned __int128 uint128_t;
+
 int getNumericValue(char c) {
   c = toupper(c);
   if ((c >= '0') && (c <= '9')) {
@@ -18,19 +20,272 @@ int getNumericValue(char c) {
   }
 }
 
-BitConstant::BitConstant() {}
+static inline int LimbsForWidth(int width) { return (width + 63) / 64; }
+
+/*
+Helper functions for unsigned multi-limb arithmetic on little-endian vectors of
+limbs, used for multiplication and parsing of decimal literals
+*/
+
+// Remove high zero limbs
+static void StripLimbs(vector<uint64_t> &a) {
+  while (!a.empty() && (a.back() == 0))
+    a.pop_back();
+}
+
+// a += b << (64 * offset), discarding any carry out of a
+static void AddLimbsInto(vector<uint64_t> &a, int offset,
+                         const vector<uint64_t> &b) {
+  uint64_t carry = 0;
+  int i;
+  for (i = 0; (i < b.size()) && ((i + offset) < a.size()); i++) {
+    uint128_t s = uint128_t(a[i + offset]) + b[i] + carry;
+    a[i + offset] = uint64_t(s);
+    carry = uint64_t(s >> 64);
+  }
+  for (i += offset; (carry != 0) && (i < a.size()); i++) {
+    a[i]++;
+    carry = (a[i] == 0);
+  }
+}
+
+// a -= b, where a >= b
+static void SubtractLimbsFrom(vector<uint64_t> &a, const vector<uint64_t> &b) {
+  uint64_t borrow = 0;
+  int i;
+  for (i = 0; (i < b.size()) && (i < a.size()); i++) {
+    uint64_t d = a[i] - b[i];
+    uint64_t nb = (a[i] < b[i]) || (d < borrow);
+    a[i] = d - borrow;
+    borrow = nb;
+  }
+  for (; (borrow != 0) && (i < a.size()); i++) {
+    borrow = (a[i] == 0);
+    a[i]--;
+  }
+}
+
+// a * b + add, in place, where b and add are single limbs
+static void MultiplyAddSmall(vector<uint64_t> &a, uint64_t b, uint64_t add) {
+  uint64_t carry = add;
+  for (auto &limb : a) {
+    uint128_t p = uint128_t(limb) * b + carry;
+    limb = uint64_t(p);
+    carry = uint64_t(p >> 64);
+  }
+  if (carry != 0)
+    a.push_back(carry);
+}
+
+// Below this many limbs, schoolbook multiplication is faster than Karatsuba
+static const int KaratsubaThreshold = 32;
+
+static vector<uint64_t> MultiplyLimbs(const uint64_t *a, int na,
+                                      const uint64_t *b, int nb) {
+  vector<uint64_t> r(na + nb, 0);
+  if (na < nb) {
+    swap(a, b);
+    swap(na, nb);
+  }
+  if (nb == 0)
+    return r;
+  if (nb < KaratsubaThreshold) {
+    // Schoolbook multiplication
+    for (int j = 0; j < nb; j++) {
+      uint64_t carry = 0;
+      for (int i = 0; i < na; i++) {
+        uint128_t p = uint128_t(a[i]) * b[j] + r[i + j] + carry;
+        r[i + j] = uint64_t(p);
+        carry = uint64_t(p >> 64);
+      }
+      r[na + j] = carry;
+    }
+  } else if ((2 * nb) <= na) {
+    // Very unbalanced operands: split a into pieces the size of b
+    for (int i = 0; i < na; i += nb) {
+      AddLimbsInto(r, i, MultiplyLimbs(a + i, min(nb, na - i), b, nb));
+    }
+  } else {
+    // Karatsuba: with a = a1*B^m + a0 and b = b1*B^m + b0,
+    // a*b = z2*B^2m + (z1 - z2 - z0)*B^m + z0 where z0 = a0*b0, z2 = a1*b1
+    // and z1 = (a0 + a1)*(b0 + b1)
+    int m = na / 2;
+    vector<uint64_t> z0 = MultiplyLimbs(a, m, b, m);
+    vector<uint64_t> z2 = MultiplyLimbs(a + m, na - m, b + m, nb - m);
+    vector<uint64_t> sa(max(m, na - m) + 1, 0), sb(max(m, nb - m) + 1, 0);
+    AddLimbsInto(sa, 0, vector<uint64_t>(a, a + m));
+    AddLimbsInto(sa, 0, vector<uint64_t>(a + m, a + na));
+    AddLimbsInto(sb, 0, vector<uint64_t>(b, b + m));
+    AddLimbsInto(sb, 0, vector<uint64_t>(b + m, b + nb));
+    vector<uint64_t> z1 = MultiplyLimbs(sa.data(), sa.size(), sb.data(), sb.size());
+    SubtractLimbsFrom(z1, z0);
+    SubtractLimbsFrom(z1, z2);
+    AddLimbsInto(r, 0, z0);
+    AddLimbsInto(r, 2 * m, z2);
+    AddLimbsInto(r, m, z1);
+  }
+  return r;
+}
+
+static vector<uint64_t> MultiplyLimbs(const vector<uint64_t> &a,
+                                      const vector<uint64_t> &b) {
+  vector<uint64_t> r = MultiplyLimbs(a.data(), a.size(), b.data(), b.size());
+  StripLimbs(r);
+  return r;
+}
+
+// Divide u by v, which must be non-zero, giving quotient q and remainder r
+// This is Knuth's algorithm D, using 64-bit limbs
+static void DivideLimbs(vector<uint64_t> u, vector<uint64_t> v,
+                        vector<uint64_t> &q, vector<uint64_t> &r) {
+  StripLimbs(u);
+  StripLimbs(v);
+  int n = v.size();
+  if (n == 0)
+    throw runtime_error("division by zero");
+  if (u.size() < n) {
+    q.clear();
+    r = u;
+    return;
+  }
+  int m = u.size() - n;
+  q.assign(m + 1, 0);
+  if (n == 1) {
+    // Short division by a single limb
+    uint64_t rem = 0;
+    for (int j = m; j >= 0; j--) {
+      uint128_t num = (uint128_t(rem) << 64) | u[j];
+      q[j] = uint64_t(num / v[0]);
+      rem = uint64_t(num % v[0]);
+    }
+    r = {rem};
+    StripLimbs(q);
+    StripLimbs(r);
+    return;
+  }
+  // Normalise so that the top bit of the divisor is set
+  int shift = __builtin_clzll(v.back());
+  u.push_back(0);
+  if (shift != 0) {
+    for (int i = n - 1; i > 0; i--)
+      v[i] = (v[i] << shift) | (v[i - 1] >> (64 - shift));
+    v[0] <<= shift;
+    for (int i = m + n; i > 0; i--)
+      u[i] = (u[i] << shift) | (u[i - 1] >> (64 - shift));
+    u[0] <<= shift;
+  }
+  const uint128_t base = uint128_t(1) << 64;
+  for (int j = m; j >= 0; j--) {
+    // Estimate the quotient limb from the top two limbs, which is at most two
+    // too large after correction
+    uint128_t num = (uint128_t(u[j + n]) << 64) | u[j + n - 1];
+    uint128_t qhat = num / v[n - 1], rhat = num % v[n - 1];
+    while ((qhat >= base) ||
+           ((qhat * v[n - 2]) > ((rhat << 64) | u[j + n - 2]))) {
+      qhat--;
+      rhat += v[n - 1];
+      if (rhat >= base)
+        break;
+    }
+    // Multiply and subtract
+    uint64_t carry = 0, borrow = 0;
+    for (int i = 0; i < n; i++) {
+      uint128_t p = qhat * v[i] + carry;
+      carry = uint64_t(p >> 64);
+      uint64_t sub = uint64_t(p), t = u[i + j] - sub;
+      uint64_t next_borrow = (u[i + j] < sub) || (t < borrow);
+      u[i + j] = t - borrow;
+      borrow = next_borrow;
+    }
+    uint64_t t = u[j + n] - carry;
+    bool negative = (u[j + n] < carry) || (t < borrow);
+    u[j + n] = t - borrow;
+    if (negative) {
+      // Estimate was one too large, add back
+      qhat--;
+      uint64_t c = 0;
+      for (int i = 0; i < n; i++) {
+        uint128_t s = uint128_t(u[i + j]) + v[i] + c;
+        u[i + j] = uint64_t(s);
+        c = uint64_t(s >> 64);
+      }
+      u[j + n] += c;
+    }
+    q[j] = uint64_t(qhat);
+  }
+  // Denormalise the remainder
+  r.assign(n, 0);
+  for (int i = 0; i < n; i++) {
+    r[i] = u[i] >> shift;
+    if ((shift != 0) && ((i + 1) < u.size()))
+      r[i] |= u[i + 1] << (64 - shift);
+  }
+  StripLimbs(q);
+  StripLimbs(r);
+}
+
+static vector<uint64_t> PowerOfTen(int n) {
+  vector<uint64_t> result{1}, base{10};
+  while (n > 0) {
+    if (n & 0x1)
+      result = MultiplyLimbs(result, base);
+    n >>= 1;
+    if (n > 0)
+      base = MultiplyLimbs(base, base);
+  }
+  return result;
+}
+
+// Decimal strings longer than this are split in half and parsed recursively
+static const int DecimalSplitDigits = 1024;
+static const int DigitsPerLimb = 19; // 10^19 < 2^64
+
+// Parse a string of validated decimal digits into limbs
+static vector<uint64_t> ParseDecimalLimbs(const string &str, int start,
+                                          int end) {
+  vector<uint64_t> result;
+  if ((end - start) <= DecimalSplitDigits) {
+    // Consume a limb's worth of digits at a time
+    for (int i = start; i < end; i += DigitsPerLimb) {
+      uint64_t chunk = 0, scale = 1;
+      for (int j = i; j < min(end, i + DigitsPerLimb); j++) {
+        chunk = chunk * 10 + (str[j] - '0');
+        scale *= 10;
+      }
+      MultiplyAddSmall(result, scale, chunk);
+    }
+  } else {
+    int lowDigits = (end - start) / 2;
+    result = MultiplyLimbs(ParseDecimalLimbs(str, start, end - lowDigits),
+                           PowerOfTen(lowDigits));
+    result.push_back(0);
+    AddLimbsInto(result, 0, ParseDecimalLimbs(str, end - lowDigits, end));
+  }
+  StripLimbs(result);
+  return result;
+}
+
+BitConstant::BitConstant() : is_signed(false), nbits(0), inlineLimb(0) {}
 
 BitConstant::BitConstant(const BitConstant &other)
-    : bits(other.bits), is_signed(other.is_signed){};
+    : is_signed(other.is_signed), nbits(other.nbits),
+      inlineLimb(other.inlineLimb), wideLimbs(other.wideLimbs){};
+
+BitConstant &BitConstant::operator=(const BitConstant &other) {
+  is_signed = other.is_signed;
+  nbits = other.nbits;
+  inlineLimb = other.inlineLimb;
+  wideLimbs = other.wideLimbs;
+  return *this;
+}
 
-BitConstant::BitConstant(string constval) {
+BitConstant::BitConstant(string constval) : BitConstant() {
   if (constval.length() > 0) {
     int offset = 0;
+    bool negative = false;
     if (constval[0] == '-') {
-      is_signed = true;
+      negative = true;
       offset++;
-    } else {
-      is_signed = false;
     }
     int base = 10;
     if (constval.size() >= (2 + offset)) {
@@ -48,142 +303,180 @@ BitConstant::BitConstant(string constval) {
       }
     }
 
-    // reverse order as last digit has the lowest value
     for (int i = offset; i < constval.size(); i++) {
       int digitVal = getNumericValue(constval[i]);
-
       if ((digitVal >= base) || (digitVal == -1)) {
         throw runtime_error(string("Unexpected digit ") + constval[i] +
                             " in numeric constant");
       }
-      bits = PerformConstOperation(
-                 vector<BitConstant>{BitConstant(base), *this}, B_MUL)
-                 .bits; // multiply by base to shift existing value
-      bits = PerformConstOperation(
-                 vector<BitConstant>{BitConstant(digitVal), *this},
-                 B_ADD)
-                 .bits; // add value of current digit
     }
-    if (bits.size() == 0) {
-      bits.push_back(false); // force at least one bit
+
+    if (base == 10) {
+      set_magnitude(ParseDecimalLimbs(constval, offset, constval.size()));
+    } else {
+      // Each digit maps directly onto a fixed number of bits
+      int digitBits = (base == 16) ? 4 : ((base == 8) ? 3 : 1);
+      resize(max(int(constval.size() - offset) * digitBits, 1));
+      uint64_t *data = limbs();
+      int pos = 0;
+      // reverse order as last digit has the lowest value
+      for (int i = int(constval.size()) - 1; i >= offset; i--) {
+        uint64_t digitVal = getNumericValue(constval[i]);
+        data[pos / 64] |= digitVal << (pos % 64);
+        if (((pos % 64) + digitBits) > 64)
+          data[pos / 64 + 1] |= digitVal >> (64 - (pos % 64));
+        pos += digitBits;
+      }
     }
+    trim();
     // negate, 2's complement
-    if (is_signed) {
-      bits.push_back(false);
-      bits = PerformConstOperation(vector<BitConstant>{BitConstant(0), *this},
-                                   B_SUB)
-                 .bits;
+    if (negative) {
+      *this = SubtractBits(BitConstant(0), *this);
+      is_signed = true;
     };
-
   } else {
-    is_signed = false;
-    bits.push_back(false);
+    resize(1);
   }
 
   trim();
 }
 
-BitConstant::BitConstant(int intval) {
-  bool neg = false;
-  if (intval < 0) {
-    neg = true;
-    intval = -intval;
-  }
-  while (intval > 0) {
-    bits.push_back(~~(intval & 0x1));
-    intval >>= 1;
-  }
+BitConstant::BitConstant(int intval) : BitConstant() {
+  is_signed = (intval < 0);
+  resize(64);
+  set_limb(0, uint64_t(int64_t(intval)));
+  trim();
+}
 
-  if (neg) {
-    // negate, 2's complement
-    bits.push_back(false);
-    bits =
-        PerformConstOperation(vector<BitConstant>{BitConstant(0), *this}, B_SUB)
-            .bits;
-    is_signed = true;
-  } else {
-    is_signed = false;
+BitConstant::BitConstant(int intval, int width) : BitConstant() {
+  is_signed = (intval < 0);
+  resize(width);
+  for (int i = 0; i < limb_count(); i++) {
+    if (i == 0)
+      set_limb(i, uint64_t(int64_t(intval)));
+    else
+      set_limb(i, is_signed ? ~uint64_t(0) : 0);
   }
+}
 
-  if (bits.size() == 0)
-    bits.push_back(false);
+BitConstant::BitConstant(unsigned long long intval) : BitConstant() {
+  resize(64);
+  set_limb(0, intval);
   trim();
 }
 
-BitConstant::BitConstant(int intval, int width) {
-  bool neg = false;
-  if (intval < 0) {
-    neg = true;
-    intval = -intval;
-  }
-  while (intval > 0) {
-    bits.push_back(~~(intval & 0x1));
-    intval >>= 1;
-  }
+uint64_t *BitConstant::limbs() {
+  return (nbits > 64) ? wideLimbs.data() : &inlineLimb;
+}
 
-  if (neg) {
-    // negate, 2's complement
-    bits.push_back(false);
-    bits =
-        PerformConstOperation(vector<BitConstant>{BitConstant(0), *this}, B_SUB)
-            .bits;
-    is_signed = true;
-  } else {
-    is_signed = false;
-  }
+const uint64_t *BitConstant::limbs() const {
+  return (nbits > 64) ? wideLimbs.data() : &inlineLimb;
+}
 
-  if (bits.size() == 0)
-    bits.push_back(false);
+int BitConstant::width() const { return nbits; }
 
-  while (bits.size() > width) {
-    bits.pop_back();
-  }
+int BitConstant::limb_count() const { return LimbsForWidth(nbits); }
+
+bool BitConstant::is_negative() const {
+  return is_signed && (nbits > 0) &&
+         ((limbs()[(nbits - 1) / 64] >> ((nbits - 1) % 64)) & 0x1);
+}
 
-  while (bits.size() < width) {
-    if (is_signed) {
-      bits.push_back(bits.back());
+bool BitConstant::is_zero() const {
+  const uint64_t *data = limbs();
+  return all_of(data, data + limb_count(), [](uint64_t l) { return l == 0; });
+}
+
+bool BitConstant::get_bit(int i) const {
+  if (i >= nbits)
+    return is_negative();
+  return (limbs()[i / 64] >> (i % 64)) & 0x1;
+}
+
+void BitConstant::set_bit(int i, bool value) {
+  uint64_t mask = uint64_t(1) << (i % 64);
+  if (value)
+    limbs()[i / 64] |= mask;
+  else
+    limbs()[i / 64] &= ~mask;
+}
+
+uint64_t BitConstant::get_limb(int i) const {
+  bool negative = is_negative();
+  int count = limb_count();
+  if (i >= count)
+    return negative ? ~uint64_t(0) : 0;
+  uint64_t value = limbs()[i];
+  if (negative && (i == (count - 1)) && ((nbits % 64) != 0))
+    value |= ~uint64_t(0) << (nbits % 64);
+  return value;
+}
+
+void BitConstant::set_limb(int i, uint64_t value) {
+  if ((i == (limb_count() - 1)) && ((nbits % 64) != 0))
+    value &= ~(~uint64_t(0) << (nbits % 64));
+  limbs()[i] = value;
+}
+
+void BitConstant::resize(int newWidth) {
+  int oldCount = limb_count(), newCount = LimbsForWidth(newWidth);
+  if (newCount > 1) {
+    if (oldCount <= 1) {
+      wideLimbs.assign(newCount, 0);
+      wideLimbs[0] = inlineLimb;
+      inlineLimb = 0;
     } else {
-      bits.push_back(false);
+      wideLimbs.resize(newCount, 0);
     }
+  } else if (oldCount > 1) {
+    inlineLimb = wideLimbs[0];
+    wideLimbs.clear();
   }
+  nbits = newWidth;
+  if (newCount == 0)
+    inlineLimb = 0;
+  else
+    set_limb(newCount - 1, limbs()[newCount - 1]);
 }
 
-BitConstant::BitConstant(unsigned long long intval) {
+// Set to an unsigned value given as limbs
+void BitConstant::set_magnitude(const vector<uint64_t> &mag) {
   is_signed = false;
-  while (intval > 0) {
-    bits.push_back(~~(intval & 0x1));
-    intval >>= 1;
-  }
-  if (bits.size() == 0)
-    bits.push_back(false);
-  trim();
+  resize(max(int(mag.size()) * 64, 1));
+  copy(mag.begin(), mag.end(), limbs());
 }
 
 void BitConstant::trim() {
-  // signed numbers require a bit of care
-  if (is_signed) {
-    // remove all the sign bits
-    if (bits.size() > 0) {
-      bool sign_bit = bits.back();
-      while ((bits.size() > 0) && (bits.back() == sign_bit)) {
-        bits.erase(bits.end() - 1);
-      }
-      // restore exactly one sign bit
-      bits.push_back(sign_bit);
+  if (nbits == 0)
+    return;
+  // Find the highest bit that differs from the sign (or zero for unsigned
+  // numbers)
+  bool negative = is_negative();
+  uint64_t fill = negative ? ~uint64_t(0) : 0;
+  int highest = -1;
+  for (int i = limb_count() - 1; i >= 0; i--) {
+    uint64_t diff = get_limb(i) ^ fill;
+    if (diff != 0) {
+      highest = i * 64 + (63 - __builtin_clzll(diff));
+      break;
     }
+  }
+  if (is_signed) {
+    // keep exactly one sign bit
+    resize(highest + 2);
+    if (negative)
+      set_bit(highest + 1, true);
   } else {
-    // for unsigned numbers, just trim off
     // Ensure length does not fall below 1
-    while ((bits.size() > 1) && (bits.back() == false)) {
-      bits.erase(bits.end() - 1);
-    }
+    resize(max(highest + 1, 1));
   }
 }
 
 string BitConstant::to_string() const {
   string out = "\"";
-  for (int i = bits.size() - 1; i >= 0; i--) {
-    if (bits[i]) {
+  out.reserve(nbits + 2);
+  for (int i = nbits - 1; i >= 0; i--) {
+    if (get_bit(i)) {
       out += "1";
     } else {
       out += "0";
@@ -192,205 +485,190 @@ string BitConstant::to_string() const {
   return out + "\"";
 }
 
-int BitConstant::intval() const {
-  int ival = 0;
-  bool sign = false;
-  int start = bits.size() - 1;
-  if (is_signed) {
-    sign = bits.back();
-    start--;
-  }
-
-  for (int i = start; i >= 0; i--) {
-    ival <<= 1;
-    if (bits[i] != sign) { // the != sign deals with 2's complement inversion
-      ival++;
-    }
-  }
-
-  if (sign) {
-    ival += 1;
-    ival = -ival;
-  }
-
-  return ival;
-}
+int BitConstant::intval() const { return int(int64_t(get_limb(0))); }
 
 BitConstant BitConstant::cast(int newsize, bool newsigned) const {
   BitConstant casted;
   casted.is_signed = newsigned;
-  for (int i = 0; i < newsize; i++) {
-    if (i < bits.size()) {
-      casted.bits.push_back(bits[i]);
-    } else if ((is_signed) && (bits.size() > 0)) {
-      casted.bits.push_back(bits.back()); // sign extend
-    } else {
-      casted.bits.push_back(false);
-    }
+  casted.resize(newsize);
+  for (int i = 0; i < casted.limb_count(); i++) {
+    casted.set_limb(i, get_limb(i)); // sign extends if required
   }
   return casted;
 }
 
-BitConstant InvertBits(BitConstant a) {
+BitConstant InvertBits(const BitConstant &a) {
   // Special case: if a is 0 length then the result is a '1' constant
-  if (a.bits.size() == 0) {
+  if (a.width() == 0) {
     return BitConstant(1);
   } else {
     BitConstant result;
     result.is_signed = a.is_signed;
-    for (int i = 0; i < a.bits.size(); i++) {
-      result.bits.push_back(!a.bits[i]);
+    result.resize(a.width());
+    for (int i = 0; i < result.limb_count(); i++) {
+      result.set_limb(i, ~a.get_limb(i));
     }
     return result;
   }
 }
 
-BitConstant AddBits(BitConstant a, BitConstant b, bool cin) {
+// Width of a constant once converted to a signed result, if required, where an
+// unsigned value needs an extra bit
+static int GetSignedWidth(const BitConstant &a, bool is_signed) {
+  return a.width() + ((is_signed && !a.is_signed) ? 1 : 0);
+}
+
+BitConstant AddBits(const BitConstant &a, const BitConstant &b, bool cin) {
   BitConstant result;
   result.is_signed = a.is_signed || b.is_signed;
-  result.bits.resize(max(a.bits.size(), b.bits.size()) + 1);
-  bool carry = cin;
-  for (int i = 0; i < result.bits.size(); i++) {
-    bool int_a, int_b;
-    if (i < a.bits.size())
-      int_a = a.bits[i];
-    else if (a.is_signed) // sign extend
-      int_a = a.bits.back();
-    else
-      int_a = false;
+  result.resize(max(GetSignedWidth(a, result.is_signed),
+                    GetSignedWidth(b, result.is_signed)) +
+                1);
+  uint64_t carry = cin;
+  for (int i = 0; i < result.limb_count(); i++) {
+    uint128_t sum = uint128_t(a.get_limb(i)) + b.get_limb(i) + carry;
+    result.set_limb(i, uint64_t(sum));
+    carry = uint64_t(sum >> 64);
+  }
+  return result;
+}
 
-    if (i < b.bits.size())
-      int_b = b.bits[i];
-    else if (b.is_signed) // sign extend
-      int_b = b.bits.back();
-    else
-      int_b = false;
-    // full adder
-    result.bits[i] = (int_a != int_b) != carry;
-    carry = (int_a && int_b) || ((int_a != int_b) && carry);
+BitConstant SubtractBits(const BitConstant &a, const BitConstant &b) {
+  BitConstant result;
+  result.is_signed = a.is_signed || b.is_signed;
+  result.resize(max(GetSignedWidth(a, result.is_signed),
+                    GetSignedWidth(b, result.is_signed)) +
+                1);
+  uint64_t borrow = 0;
+  for (int i = 0; i < result.limb_count(); i++) {
+    uint64_t int_a = a.get_limb(i), int_b = b.get_limb(i);
+    uint64_t diff = int_a - int_b;
+    uint64_t next_borrow = (int_a < int_b) || (diff < borrow);
+    result.set_limb(i, diff - borrow);
+    borrow = next_borrow;
   }
   return result;
 }
 
-BitConstant SubtractBits(BitConstant a, BitConstant b) {
-  BitConstant temp_b =
-      b.cast(max(a.bits.size(), b.bits.size()), a.is_signed | b.is_signed);
-  return AddBits(a, InvertBits(temp_b), true);
+// Get the absolute value of a constant as limbs
+static vector<uint64_t> GetMagnitude(const BitConstant &a) {
+  vector<uint64_t> mag(a.limb_count());
+  for (int i = 0; i < mag.size(); i++)
+    mag[i] = a.get_limb(i);
+  if (a.is_negative()) {
+    // negate, 2's complement
+    uint64_t carry = 1;
+    for (auto &limb : mag) {
+      limb = ~limb + carry;
+      carry = carry && (limb == 0);
+    }
+  }
+  return mag;
 }
 
-BitConstant MultiplyBits(BitConstant a, BitConstant b) {
+// Make a constant of a given width and signedness from a magnitude and sign
+static BitConstant FromMagnitude(const vector<uint64_t> &mag, bool negative,
+                                 int width, bool is_signed) {
   BitConstant result;
-  result.is_signed = a.is_signed || b.is_signed;
-  result.bits.resize(a.bits.size() + b.bits.size(), false);
-  BitConstant temp_a = a;
-  for (int i = 0; i < b.bits.size(); i++) {
-    if (b.bits[i]) {
-      result = AddBits(result, temp_a);
+  result.is_signed = is_signed;
+  result.resize(width);
+  uint64_t carry = 1;
+  for (int i = 0; i < result.limb_count(); i++) {
+    uint64_t limb = (i < mag.size()) ? mag[i] : 0;
+    if (negative) {
+      limb = ~limb + carry;
+      carry = carry && (limb == 0);
     }
-    temp_a = AddBits(temp_a, temp_a);
+    result.set_limb(i, limb);
   }
   return result;
 }
 
-BitConstant BitwiseBitOperation(BitConstant a, BitConstant b,
+BitConstant MultiplyBits(const BitConstant &a, const BitConstant &b) {
+  vector<uint64_t> mag_a = GetMagnitude(a), mag_b = GetMagnitude(b);
+  vector<uint64_t> product =
+      MultiplyLimbs(mag_a.data(), mag_a.size(), mag_b.data(), mag_b.size());
+  // The product always fits in the sum of the operand widths
+  return FromMagnitude(product, a.is_negative() != b.is_negative(),
+                       a.width() + b.width(), a.is_signed || b.is_signed);
+}
+
+BitConstant DivideBits(const BitConstant &a, const BitConstant &b) {
+  if (b.is_zero())
+    throw runtime_error("division by zero in constant expression");
+  vector<uint64_t> quot, rem;
+  DivideLimbs(GetMagnitude(a), GetMagnitude(b), quot, rem);
+  // |a / b| <= |a| so one extra bit is always enough for the sign
+  return FromMagnitude(quot, a.is_negative() != b.is_negative(),
+                       a.width() + 1, a.is_signed || b.is_signed);
+}
+
+BitConstant ModuloBits(const BitConstant &a, const BitConstant &b) {
+  if (b.is_zero())
+    throw runtime_error("division by zero in constant expression");
+  vector<uint64_t> quot, rem;
+  DivideLimbs(GetMagnitude(a), GetMagnitude(b), quot, rem);
+  return FromMagnitude(rem, a.is_negative(), b.width() + 1,
+                       a.is_signed || b.is_signed);
+}
+
+BitConstant BitwiseBitOperation(const BitConstant &a, const BitConstant &b,
                                 OperationType oper) {
   BitConstant result;
   result.is_signed = a.is_signed || b.is_signed;
-  result.bits.resize(max(a.bits.size(), b.bits.size()));
-  for (int i = 0; i < result.bits.size(); i++) {
-    bool int_a, int_b;
-    if (i < a.bits.size())
-      int_a = a.bits[i];
-    else if (a.is_signed) // sign extend
-      int_a = a.bits.back();
-    else
-      int_a = false;
-
-    if (i < b.bits.size())
-      int_b = b.bits[i];
-    else if (b.is_signed) // sign extend
-      int_b = b.bits.back();
-    else
-      int_b = false;
-
-    bool bitresult = false;
+  result.resize(max(a.width(), b.width()));
+  for (int i = 0; i < result.limb_count(); i++) {
+    uint64_t int_a = a.get_limb(i), int_b = b.get_limb(i);
+    uint64_t limbresult = 0;
     switch (oper) {
     case B_BWOR:
-      bitresult = int_a || int_b;
+      limbresult = int_a | int_b;
       break;
     case B_BWAND:
-      bitresult = int_a && int_b;
+      limbresult = int_a & int_b;
       break;
     case B_BWXOR:
-      bitresult = (int_a != int_b);
+      limbresult = int_a ^ int_b;
       break;
     default:
       break;
     }
-    result.bits[i] = bitresult;
+    result.set_limb(i, limbresult);
   }
   return result;
 }
 
-BitConstant IsLessThan(BitConstant a, BitConstant b) {
-  if (a.is_signed) {
-    if (b.is_signed) {
-      if ((a.bits.back()) && (!b.bits.back())) // a -ve, b +ve
-        return BitConstant(1);
-      if ((!a.bits.back()) && (b.bits.back())) // a +ve, b -ve
-        return BitConstant(0);
-    } else {
-      if (a.bits.back()) // a -ve, b +ve unsigned
-        return BitConstant(1);
-    }
-  } else if (b.is_signed) {
-    if (b.bits.back()) // a +ve unsigned, b -ve
-      return BitConstant(0);
-  }
-  int comp_size = max(a.bits.size(), b.bits.size());
-  for (int i = comp_size - 1; i >= 0; i--) {
-    bool int_a, int_b;
-    if (i < a.bits.size())
-      int_a = a.bits[i];
-    else if (a.is_signed) // sign extend
-      int_a = a.bits.back();
-    else
-      int_a = false;
-
-    if (i < b.bits.size())
-      int_b = b.bits[i];
-    else if (b.is_signed) // sign extend
-      int_b = b.bits.back();
-    else
-      int_b = false;
-
-    if ((int_a) && (!int_b))
-      return BitConstant(0); // a=1, b=0 : >
-    if ((!int_a) && (int_b))
-      return BitConstant(1); // a=0, b=1 : <
+// Compare two constants by value, returning -1, 0 or 1
+static int CompareBits(const BitConstant &a, const BitConstant &b) {
+  bool neg_a = a.is_negative(), neg_b = b.is_negative();
+  if (neg_a != neg_b)
+    return neg_a ? -1 : 1;
+  // With the same sign, the sign extended limbs compare as unsigned values
+  for (int i = max(a.limb_count(), b.limb_count()) - 1; i >= 0; i--) {
+    uint64_t int_a = a.get_limb(i), int_b = b.get_limb(i);
+    if (int_a < int_b)
+      return -1;
+    if (int_a > int_b)
+      return 1;
+  }
+  return 0;
+}
 
-    // otherwise equal so far, continue
-  };
-  return BitConstant(0); // they're equal
+BitConstant IsLessThan(const BitConstant &a, const BitConstant &b) {
+  return BitConstant(CompareBits(a, b) < 0);
 }
 
 BitConstant LogicalBitOperation(const vector<BitConstant> &operands,
                                 OperationType oper) {
   vector<bool> booleanOperands;
-  for (auto operand : operands) {
-    bool lval = false;
-    for (auto bit : operand.bits) {
-      if (bit) {
-        lval = true;
-      }
-    }
-    booleanOperands.push_back(lval);
+  for (const auto &operand : operands) {
+    booleanOperands.push_back(!operand.is_zero());
   }
   switch (oper) {
   case B_LOR:
     return BitConstant(booleanOperands[0] || booleanOperands[1]);
   case B_LAND:
-    return BitConstant(booleanOperands[0] || booleanOperands[1]);
+    return BitConstant(booleanOperands[0] && booleanOperands[1]);
   case U_LNOT:
     return BitConstant(!booleanOperands[0]);
   default:
@@ -398,50 +676,43 @@ BitConstant LogicalBitOperation(const vector<BitConstant> &operands,
   }
 }
 
-BitConstant LeftShiftBits(BitConstant val, BitConstant amt) {
-  BitConstant result = val;
-  result.bits.insert(result.bits.begin(), amt.intval(), false);
+BitConstant LeftShiftBits(const BitConstant &val, const BitConstant &amt) {
+  int shift = max(amt.intval(), 0);
+  int limbShift = shift / 64, bitShift = shift % 64;
+  BitConstant result;
+  result.is_signed = val.is_signed;
+  result.resize(val.width() + shift);
+  for (int i = limbShift; i < result.limb_count(); i++) {
+    uint64_t limb = val.get_limb(i - limbShift) << bitShift;
+    if ((bitShift != 0) && (i > limbShift))
+      limb |= val.get_limb(i - limbShift - 1) >> (64 - bitShift);
+    result.set_limb(i, limb);
+  }
   return result;
 }
 
-BitConstant RightShiftBits(BitConstant val, BitConstant amt) {
-  BitConstant result = val;
-  if (amt.intval() > val.bits.size()) {
-    result = BitConstant(0);
-  } else if (amt.intval() > 0) {
-    result.bits.erase(result.bits.begin(), result.bits.begin() + amt.intval());
+BitConstant RightShiftBits(const BitConstant &val, const BitConstant &amt) {
+  int shift = max(amt.intval(), 0);
+  if (shift >= val.width()) {
+    // only the sign extension remains
+    return BitConstant(val.is_negative() ? -1 : 0);
+  }
+  int limbShift = shift / 64, bitShift = shift % 64;
+  BitConstant result;
+  result.is_signed = val.is_signed;
+  result.resize(val.width() - shift);
+  for (int i = 0; i < result.limb_count(); i++) {
+    uint64_t limb = val.get_limb(i + limbShift) >> bitShift;
+    if (bitShift != 0)
+      limb |= val.get_limb(i + limbShift + 1) << (64 - bitShift);
+    result.set_limb(i, limb);
   }
   return result;
 }
 
-BitConstant AreBitsEqual(BitConstant a, BitConstant b) {
-  BitConstant result;
-  bool isEqual = true;
-  int msize = max(a.bits.size(), b.bits.size());
-  for (int i = 0; i < msize; i++) {
-    bool int_a, int_b;
-    if (i < a.bits.size())
-      int_a = a.bits[i];
-    else if (a.is_signed) // sign extend
-      int_a = a.bits.back();
-    else
-      int_a = false;
-
-    if (i < b.bits.size())
-      int_b = b.bits[i];
-    else if (b.is_signed) // sign extend
-      int_b = b.bits.back();
-    else
-      int_b = false;
-
-    if (int_a != int_b) {
-      isEqual = false;
-      break;
-    }
-  }
-  return BitConstant(isEqual);
+BitConstant AreBitsEqual(const BitConstant &a, const BitConstant &b) {
+  return BitConstant(CompareBits(a, b) == 0);
 }
-// also need constant compare operations
 
 BitConstant PerformConstOperation(vector<BitConstant> operands,
                                   OperationType oper) {
@@ -456,7 +727,12 @@ BitConstant PerformConstOperation(vector<BitConstant> operands,
   case B_MUL:
     result = MultiplyBits(operands[0], operands[1]);
     break;
-  // no divide/modulo as these are eliminated and converted to multiply
+  case B_DIV:
+    result = DivideBits(operands[0], operands[1]);
+    break;
+  case B_MOD:
+    result = ModuloBits(operands[0], operands[1]);
+    break;
   case B_LS:
     result = LeftShiftBits(operands[0], operands[1]);
     break;
@@ -477,25 +753,19 @@ BitConstant PerformConstOperation(vector<BitConstant> operands,
     result = AreBitsEqual(operands[0], operands[1]);
     break;
   case B_NEQ:
-    result = InvertBits(AreBitsEqual(operands[0], operands[1]));
+    result = BitConstant(CompareBits(operands[0], operands[1]) != 0);
     break;
   case B_LT:
-    result = IsLessThan(operands[0], operands[1]);
+    result = BitConstant(CompareBits(operands[0], operands[1]) < 0);
     break;
   case B_GTE:
-    result = InvertBits(IsLessThan(operands[0], operands[1]));
+    result = BitConstant(CompareBits(operands[0], operands[1]) >= 0);
     break;
   case B_LTE:
-    result = LogicalBitOperation(
-        vector<BitConstant>{IsLessThan(operands[0], operands[1]),
-                            AreBitsEqual(operands[0], operands[1])},
-        B_LOR);
+    result = BitConstant(CompareBits(operands[0], operands[1]) <= 0);
     break;
   case B_GT:
-    result = InvertBits(LogicalBitOperation(
-        vector<BitConstant>{IsLessThan(operands[0], operands[1]),
-                            AreBitsEqual(operands[0], operands[1])},
-        B_LOR));
+    result = BitConstant(CompareBits(operands[0], operands[1]) > 0);
     break;
   default:
     throw runtime_error("cannot determine const result for operator" +
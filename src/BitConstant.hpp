@@ -1,38 +1,73 @@
 #pragma once
 #include "Operations.hpp"
+#include <cstdint>
 #include <string>
 #include <vector>
 using namespace std;
 namespace ElasticC {
 /*
 This is intended to store the value of an arbitrary length constant
+
+Values are stored as 64-bit limbs, least significant limb first. Values of up
+to 64 bits are stored inline, without any heap allocation. Bits in the top limb
+above the width are always kept as zero, regardless of signedness.
 */
 class BitConstant {
 public:
   BitConstant();
   BitConstant(const BitConstant &other);
+  BitConstant &operator=(const BitConstant &other);
   BitConstant(string constval);
   BitConstant(int intval);
   BitConstant(int intval, int width);
   BitConstant(unsigned long long intval);
-  vector<bool> bits; // note bits[0] is LSB
   bool is_signed;
   void trim();        // remove redundant bits
   int intval() const; // get value as integer
   string to_string() const;
   BitConstant cast(int newsize, bool newsigned) const;
+
+  // Bit level access. Bits past the width read as the sign extension
+  int width() const;
+  bool get_bit(int i) const; // note bit 0 is LSB
+  void set_bit(int i, bool value);
+  // Change the width, keeping the low bits and filling new bits with zero
+  void resize(int newWidth);
+  bool is_negative() const;
+  bool is_zero() const;
+
+  // Limb level access, used to implement arithmetic a word at a time. Limbs
+  // past the width read as the sign extension, set_limb discards any bits
+  // above the width
+  int limb_count() const;
+  uint64_t get_limb(int i) const;
+  void set_limb(int i, uint64_t value);
+
+private:
+  int nbits;
+  uint64_t inlineLimb;        // storage for values up to 64 bits wide
+  vector<uint64_t> wideLimbs; // storage for wider values
+  uint64_t *limbs();
+  const uint64_t *limbs() const;
+  void set_magnitude(const vector<uint64_t> &mag);
 };
 
 // These functions implement various specific operations on BitConstants
-BitConstant InvertBits(BitConstant a);
-BitConstant AddBits(BitConstant a, BitConstant b, bool cin = false);
-BitConstant SubtractBits(BitConstant a, BitConstant b);
-BitConstant MultiplyBits(BitConstant a, BitConstant b);
-BitConstant LeftShiftBits(BitConstant val, BitConstant amt);
-BitConstant RightShiftBits(BitConstant val, BitConstant amt);
-BitConstant AreBitsEqual(BitConstant a, BitConstant b);
-BitConstant IsLessThan(BitConstant a, BitConstant b);
-BitConstant BitwiseBitOperation(BitConstant a, BitConstant b,
+BitConstant InvertBits(const BitConstant &a);
+BitConstant AddBits(const BitConstant &a, const BitConstant &b,
+                    bool cin = false);
+BitConstant SubtractBits(const BitConstant &a, const BitConstant &b);
+BitConstant MultiplyBits(const BitConstant &a, const BitConstant &b);
+// Division and modulo follow C semantics: the quotient is truncated towards
+// zero and the remainder takes the sign of the dividend. Both throw on division
+// by zero
+BitConstant DivideBits(const BitConstant &a, const BitConstant &b);
+BitConstant ModuloBits(const BitConstant &a, const BitConstant &b);
+BitConstant LeftShiftBits(const BitConstant &val, const BitConstant &amt);
+BitConstant RightShiftBits(const BitConstant &val, const BitConstant &amt);
+BitConstant AreBitsEqual(const BitConstant &a, const BitConstant &b);
+BitConstant IsLessThan(const BitConstant &a, const BitConstant &b);
+BitConstant BitwiseBitOperation(const BitConstant &a, const BitConstant &b,
                                 OperationType oper);
 BitConstant LogicalBitOperation(const vector<BitConstant> &operands,
                                 OperationType oper);
@@ -1,5 +1,6 @@
 
 #pragma once
+#include "Arena.hpp"
 #include "hdl/HDLPortType.hpp"
 #include <string>
 #include <vector>
@@ -9,7 +10,7 @@ namespace ElasticC {
 /*
 The generic interface for definable data types
 */
-class DataType {
+class DataType : public ArenaAllocated<ArenaKind::Graph> {
 public:
   virtual string GetName() = 0; // return user-friendly name
   virtual int GetWidth() = 0;   // its width in bits
@@ -4,6 +4,7 @@
 
 #include <iostream>
 #include <cstdlib>
+#include <sstream>
 #include <boost/program_options.hpp>
 using namespace std;
 using namespace ElasticC;
@@ -22,8 +23,23 @@ int main(int argc, char const *argv[]) {
       ("help,h", "Display this message")
       ("verbose,v", "Increase output verbosity")
       ("quiet,q", "Decrease output verbosity")
-			("output,o", value<string>(), "Specify output file")
-			("input,i", value<string>(), "Specify input file");
+			("output,o", value<string>(), "Specify output file, written as Verilog if it ends in .v and VHDL otherwise")
+			("input,i", value<string>(), "Specify input file")
+			("device", value<string>(), "Specify target device timing library (e.g. xc7-1, ecp5-6)")
+			("lanes", value<int>()->default_value(1), "Number of samples processed per clock cycle")
+			("ii", value<int>()->default_value(1), "Target initiation interval in clock cycles, sharing multipliers if more than 1")
+			("elastic", "Add valid/ready handshaking, so that the outputs can be stalled")
+			("timing-report", value<string>(), "Write timing report to a JSON file")
+			("critical-paths", value<int>()->default_value(1), "Number of critical paths to report")
+			("simulate", value<string>(), "Simulate the design with binary test vectors from a file, instead of writing VHDL unless an output file is given")
+			("sim-output", value<string>(), "Write simulation results to a file rather than stdout")
+			("sim-inputs", value<string>(), "Comma separated input ports given by each test vector, by default all but the clock")
+			("sim-outputs", value<string>(), "Comma separated output ports written for each test vector, by default all of them")
+			("sim-batch", "Run each test vector as an independent test, many at once, holding it until the outputs are valid")
+			("sim-exhaustive", "Run every combination of input values as independent tests, instead of reading test vectors")
+			("cpp-model", value<string>(), "Write a cycle accurate C++ model of the design to a header file, instead of writing VHDL unless an output file is given")
+			("golden", value<string>(), "Run a golden model of the block, compiled before optimisation, on binary test vectors from a file, instead of writing VHDL unless an output file is given")
+			("sim-check", value<int>(), "Check the simulated design against the golden model with a number of random test vectors, or every combination of input values if there are fewer");
 
 		positional_options_description pdesc;
 		pdesc.add("input", -1);
@@ -84,25 +100,74 @@ int main(int argc, char const *argv[]) {
 		blktop = gs->blocks.at(0);
 	}
 
+	int lanes = vm.at("lanes").as<int>();
+	if(lanes < 1) {
+		PrintMessage(MSG_ERROR, "number of lanes must be at least 1");
+	}
 	try {
-		evb = EvaluateCode(new SingleCycleEvaluator(gs), blktop);
+		Evaluator *eval = (lanes > 1) ? new MultiLaneEvaluator(gs, lanes) : new SingleCycleEvaluator(gs);
+		evb = EvaluateCode(eval, blktop);
 	} catch (eval_error &e) {
 		PrintMessage(MSG_ERROR, "Evaluation Error: " + string(e.what()));
 	}
 
-	OptimiseBlock(&evb);
+	// The golden model is compiled before optimisation, as a reference for the netlist
+	GoldenModel *golden = nullptr;
+	if(vm.count("golden") || vm.count("sim-check"))
+		golden = CompileGoldenModel(blktop, &evb);
+
+	DeviceTiming *timing = LoadDeviceTiming(
+							vm.count("device") ? vm.at("device").as<string>() : "");
+	OptimiseBlock(blktop, &evb, timing);
 
 	// Convert the optimised block to a HDL style netlist
-	SynthContext sc = MakeHDLDesign(blktop, &evb);
+	SynthContext sc = MakeHDLDesign(blktop, &evb, timing, vm.count("elastic"));
+	ReleaseFrontend(sc);
 
 	// Optimise the generated HDL design
 	OptimiseHDLDesign(sc.design, sc);
 
 	// Insert pipeline registers as needed in the HDL netlist
-  PipelineHDLDesign(sc.design, sc);
+  PipelineHDLDesign(sc.design, sc, vm.at("ii").as<int>());
 
 	// Print a final timing and pipeling report
-	PrintTiming(sc.design, sc);
+	PrintTiming(sc.design, sc, vm.at("critical-paths").as<int>(),
+							vm.count("timing-report") ? vm.at("timing-report").as<string>() : "");
+
+	if(vm.count("cpp-model"))
+		GenerateCppModel(sc.design, vm.at("cpp-model").as<string>());
+
+	auto portList = [&](string option) {
+		vector<string> names;
+		if(vm.count(option)) {
+			istringstream list(vm.at(option).as<string>());
+			string name;
+			while(getline(list, name, ','))
+				names.push_back(name);
+		}
+		return names;
+	};
+	string resultFile = vm.count("sim-output") ? vm.at("sim-output").as<string>() : "";
+	if(vm.count("golden"))
+		RunGoldenModel(golden, vm.at("golden").as<string>(), resultFile,
+							portList("sim-inputs"), portList("sim-outputs"));
+	if(vm.count("sim-check"))
+		CheckHDLDesign(sc.design, sc, golden, vm.at("sim-check").as<int>());
+
+	if(vm.count("simulate") || vm.count("sim-exhaustive")) {
+		if(vm.count("sim-exhaustive"))
+			BatchSimulateHDLDesign(sc.design, sc, "", resultFile,
+								portList("sim-inputs"), portList("sim-outputs"));
+		else if(vm.count("sim-batch"))
+			BatchSimulateHDLDesign(sc.design, sc, vm.at("simulate").as<string>(), resultFile,
+								portList("sim-inputs"), portList("sim-outputs"));
+		else
+			SimulateHDLDesign(sc.design, sc, vm.at("simulate").as<string>(), resultFile,
+								portList("sim-inputs"), portList("sim-outputs"));
+	}
+	if(!vm.count("output") && (vm.count("simulate") || vm.count("sim-exhaustive") || vm.count("cpp-model") ||
+			vm.count("golden") || vm.count("sim-check")))
+		return 0;
 
 	string outfile;
 	if(vm.count("output"))
@@ -110,8 +175,11 @@ int main(int argc, char const *argv[]) {
 	else
 		outfile = vm.at("input").as<string>() + ".vhd";
 
-	// Save the HDL design to a VHDL file
-	GenerateVHDL(sc.design, outfile);
+	// Save the HDL design to a Verilog or VHDL file, depending on its extension
+	if((outfile.size() > 2) && (outfile.substr(outfile.size() - 2) == ".v"))
+		GenerateVerilog(sc.design, outfile);
+	else
+		GenerateVHDL(sc.design, outfile);
 
 
 	return 0;
@@ -4,14 +4,36 @@
 #include "EvaluatorState.hpp"
 #include "Operations.hpp"
 #include "Util.hpp"
+#include "hdl/HDLArithmeticDevices.hpp"
 #include "hdl/HDLCoreDevices.hpp"
 #include <algorithm>
 #include <iterator>
 #include <stdexcept>
+#include <tuple>
 using namespace std;
 namespace ElasticC {
+/* Intern tables for the EvalObject factories */
+static map<pair<string, bool>, EvalConstant *> internedConstants;
+static map<tuple<int, bool, EvalObject *>, EvalCast *> internedCasts;
+static map<pair<OperationType, vector<EvalObject *>>, EvalBasicOperation *>
+    internedBasicOperations;
+static map<tuple<SpecialOperationType, vector<EvalObject *>, vector<string>>,
+           EvalSpecialOperation *>
+    internedSpecialOperations;
+
+void ClearInternedEvalObjects() {
+  internedConstants.clear();
+  internedCasts.clear();
+  internedBasicOperations.clear();
+  internedSpecialOperations.clear();
+}
+
 /* EvalObject base */
-EvalObject::EvalObject() { base_id = GetUniqueID(); };
+int EvalObject::currentSourceLine = -1;
+
+EvalObject::EvalObject() : sourceLine(currentSourceLine) {
+  base_id = GetUniqueID();
+};
 
 string EvalObject::GetID() { return "eval_" + to_string(base_id); };
 
@@ -60,6 +82,10 @@ vector<EvalObject *> EvalObject::GetOperands() {
   return vector<EvalObject *>{};
 };
 
+EvalObject *EvalObject::ReplaceOperands(const vector<EvalObject *> &newOperands) {
+  return this;
+}
+
 EvalObject *EvalObject::GetValue(Evaluator *state) { return this; }
 
 bool EvalObject::CanPushInto() { return false; }
@@ -68,14 +94,32 @@ EvalObject *EvalObject::ApplyPushInto(Evaluator *state, EvalObject *value) {
   return EvalNull;
 }
 
-void EvalObject::Synthesise(Evaluator *state, const SynthContext &sc,
+void EvalObject::Synthesise(Evaluator *state, SynthContext &sc,
                             HDLGen::HDLSignal *outputNet) {
   throw eval_error("===" + GetID() + "=== cannot be synthesised to HDL");
 }
 
+HDLGen::HDLSignal *EvalObject::GetSynthesisedNet(Evaluator *state,
+                                                 SynthContext &sc) {
+  auto existing = sc.objectNets.find(this);
+  if (existing != sc.objectNets.end())
+    return existing->second;
+  HDLGen::HDLSignal *net =
+      sc.design->CreateTempSignal(GetDataType(state)->GetHDLType());
+  int oldLine = sc.design->currentSourceLine;
+  if (sourceLine != -1)
+    sc.design->currentSourceLine = sourceLine;
+  Synthesise(state, sc, net);
+  sc.design->currentSourceLine = oldLine;
+  sc.objectNets[this] = net;
+  return net;
+}
+
 /* EvalVariable */
 EvalVariable::EvalVariable(EvaluatorVariable *_var) : EvalObject(), var(_var){};
 
+EvaluatorVariable *EvalVariable::GetVariable() { return var; }
+
 string EvalVariable::GetID() {
   return "eval_var_" + var->name + "_" + to_string(base_id);
 }
@@ -106,6 +150,20 @@ EvalObject *EvalVariable::GetConstantValue(Evaluator *state) {
   }
 };
 
+// Items of arrays not mapped to memory are selected by multiplexers when the
+// index is not constant, which is only supported for arrays of integers
+static void CheckDynamicIndex(EvaluatorVariable *var,
+                              const vector<EvalObject *> &subscript) {
+  vector<EvaluatorVariable *> items = var->GetArrayChildren();
+  if ((subscript.size() != 1) ||
+      any_of(items.begin(), items.end(), [](EvaluatorVariable *item) {
+        return dynamic_cast<ScalarEvaluatorVariable *>(item) == nullptr;
+      }))
+    throw eval_error("non-constant indices are only supported for "
+                     "one-dimensional arrays of integers, unlike ===" +
+                     var->name + "===");
+}
+
 EvalObject *
 EvalVariable::ApplyArraySubscriptRead(Evaluator *state,
                                       vector<EvalObject *> subscript) {
@@ -117,17 +175,15 @@ EvalVariable::ApplyArraySubscriptRead(Evaluator *state,
     if (subscript.size() == var->GetType()->GetDimensions().size()) {
       bool isConst = true;
       int offset = 0;
-      int lastDim = 1;
       for (int i = 0; i < var->GetType()->GetDimensions().size(); i++) {
         if (!subscript[i]->HasConstantValue(state)) {
           isConst = false;
           break;
         }
-        offset *= lastDim;
         int indval = subscript[i]->GetScalarConstValue(state).intval();
-        lastDim = var->GetType()->GetDimensions()[i];
-        if (indval < lastDim) {
-          offset += indval;
+        int dim = var->GetType()->GetDimensions()[i];
+        if (indval < dim) {
+          offset = offset * dim + indval;
         } else {
           throw eval_error(
               "array index out of bounds for variable ===" + var->name + "===");
@@ -136,7 +192,14 @@ EvalVariable::ApplyArraySubscriptRead(Evaluator *state,
       if (isConst) {
         return new EvalVariable(var->GetArrayChildren()[offset]);
       } else {
-        throw eval_error("non-constant array indices are not yet implemented");
+        // Select between the values of all items
+        CheckDynamicIndex(var, subscript);
+        vector<EvalObject *> operands;
+        for (auto item : var->GetArrayChildren())
+          operands.push_back(item->HandleRead(state));
+        operands.push_back(subscript[0]->GetValue(state));
+        return EvalSpecialOperation::Create(SpecialOperationType::ARRAY_SEL,
+                                            operands);
       }
     } else {
       throw eval_error("dimensionality mismatch for variable ===" + var->name +
@@ -149,7 +212,7 @@ void EvalVariable::ApplyArraySubscriptWrite(Evaluator *state,
                                             vector<EvalObject *> subscript,
                                             EvalObject *value) {
   if (var->IsNonTrivialArrayAccess()) {
-    var->HandleSubscriptedRead(state, subscript);
+    var->HandleSubscriptedWrite(state, subscript, value);
   } else {
     // check dimensions - note if multiple are specified this is because a
     // single subscript in the form [x,y] was used
@@ -157,17 +220,15 @@ void EvalVariable::ApplyArraySubscriptWrite(Evaluator *state,
     if (subscript.size() == var->GetType()->GetDimensions().size()) {
       bool isConst = true;
       int offset = 0;
-      int lastDim = 1;
       for (int i = 0; i < var->GetType()->GetDimensions().size(); i++) {
         if (!subscript[i]->HasConstantValue(state)) {
           isConst = false;
           break;
         }
-        offset *= lastDim;
         int indval = subscript[i]->GetScalarConstValue(state).intval();
-        lastDim = var->GetType()->GetDimensions()[i];
-        if (indval < lastDim) {
-          offset += indval;
+        int dim = var->GetType()->GetDimensions()[i];
+        if (indval < dim) {
+          offset = offset * dim + indval;
         } else {
           throw eval_error(
               "array index out of bounds for variable ===" + var->name + "===");
@@ -176,7 +237,14 @@ void EvalVariable::ApplyArraySubscriptWrite(Evaluator *state,
       if (isConst) {
         var->GetArrayChildren()[offset]->HandleWrite(state, value);
       } else {
-        throw eval_error("non-constant array indices are not yet implemented");
+        // Every item is written, keeping its value unless it is the one
+        // indexed
+        CheckDynamicIndex(var, subscript);
+        vector<EvaluatorVariable *> items = var->GetArrayChildren();
+        EvalObject *index = subscript[0]->GetValue(state);
+        for (int i = 0; i < int(items.size()); i++)
+          dynamic_cast<ScalarEvaluatorVariable *>(items[i])
+              ->HandleIndexedWrite(state, value, index, i);
       }
     } else {
       throw eval_error("dimensionality mismatch for variable ===" + var->name +
@@ -195,11 +263,18 @@ void EvalVariable::AssignStructureMember(Evaluator *state, string name,
 void EvalVariable::AssignValue(Evaluator *state, EvalObject *value) {
   var->HandleWrite(state, value);
 }
+bool EvalVariable::CanPushInto() {
+  return dynamic_cast<StreamType *>(var->GetType()) != nullptr;
+}
+EvalObject *EvalVariable::ApplyPushInto(Evaluator *state, EvalObject *value) {
+  var->HandlePush(state, value);
+  return EvalNull;
+}
 EvalObject *EvalVariable::GetValue(Evaluator *state) {
   return var->HandleRead(state);
 }
 
-void EvalVariable::Synthesise(Evaluator *state, const SynthContext &sc,
+void EvalVariable::Synthesise(Evaluator *state, SynthContext &sc,
                               HDLGen::HDLSignal *outputNet) {
   sc.design->AddDevice(
       new HDLGen::BufferHDLDevice(sc.varSignals.at(var), outputNet));
@@ -208,6 +283,14 @@ void EvalVariable::Synthesise(Evaluator *state, const SynthContext &sc,
 /*EvalConstant*/
 EvalConstant::EvalConstant(BitConstant _val) : EvalObject(), val(_val){};
 
+EvalConstant *EvalConstant::Create(const BitConstant &val) {
+  EvalConstant *&interned =
+      internedConstants[make_pair(val.to_string(), val.is_signed)];
+  if (interned == nullptr)
+    interned = new EvalConstant(val);
+  return interned;
+}
+
 string EvalConstant::GetID() { return "const_" + to_string(base_id); };
 
 bool EvalConstant::HasConstantValue(Evaluator *state) { return true; }
@@ -215,12 +298,12 @@ bool EvalConstant::HasConstantValue(Evaluator *state) { return true; }
 EvalObject *EvalConstant::GetConstantValue(Evaluator *state) { return this; };
 
 DataType *EvalConstant::GetDataType(Evaluator *state) {
-  return new IntegerType(val.bits.size(), val.is_signed);
+  return new IntegerType(val.width(), val.is_signed);
 }
 
 BitConstant EvalConstant::GetScalarConstValue(Evaluator *state) { return val; };
 
-void EvalConstant::Synthesise(Evaluator *state, const SynthContext &sc,
+void EvalConstant::Synthesise(Evaluator *state, SynthContext &sc,
                               HDLGen::HDLSignal *outputNet) {
   sc.design->AddDevice(new HDLGen::ConstantHDLDevice(val, outputNet));
 }
@@ -276,7 +359,11 @@ void EvalArray::ApplyArraySubscriptWrite(Evaluator *state,
 
 vector<EvalObject *> EvalArray::GetOperands() { return items; }
 
-void EvalArray::Synthesise(Evaluator *state, const SynthContext &sc,
+EvalObject *EvalArray::ReplaceOperands(const vector<EvalObject *> &newOperands) {
+  return new EvalArray(arrType, newOperands);
+}
+
+void EvalArray::Synthesise(Evaluator *state, SynthContext &sc,
                            HDLGen::HDLSignal *outputNet) {
   // TODO dimensions
   if (arrType->GetDimensions().size() != 1)
@@ -289,11 +376,8 @@ void EvalArray::Synthesise(Evaluator *state, const SynthContext &sc,
   vector<HDLGen::HDLSignal *> operandSigs;
 
   transform(items.begin(), items.end(), back_inserter(operandSigs),
-            [sc, state](EvalObject *op) {
-              HDLGen::HDLSignal *res = sc.design->CreateTempSignal(
-                  op->GetDataType(state)->GetHDLType());
-              op->Synthesise(state, sc, res);
-              return res;
+            [&sc, state](EvalObject *op) {
+              return op->GetSynthesisedNet(state, sc);
             });
 
   for (int i = 0; i < N; i++) {
@@ -351,9 +435,26 @@ vector<EvalObject *> EvalStruct::GetOperands() {
   return operands;
 }
 
+EvalObject *
+EvalStruct::ReplaceOperands(const vector<EvalObject *> &newOperands) {
+  map<string, EvalObject *> newItems;
+  auto op = newOperands.begin();
+  for (auto item : items)
+    newItems[item.first] = *(op++);
+  return new EvalStruct(structType, newItems);
+}
+
 EvalCast::EvalCast(IntegerType *_castTo, EvalObject *_operand)
     : EvalObject(), castTo(_castTo), operand(_operand){};
 
+EvalCast *EvalCast::Create(IntegerType *castTo, EvalObject *operand) {
+  EvalCast *&interned = internedCasts[make_tuple(
+      castTo->width, castTo->is_signed, operand)];
+  if (interned == nullptr)
+    interned = new EvalCast(castTo, operand);
+  return interned;
+}
+
 string EvalCast::GetID() { return "cast_" + to_string(base_id); }
 
 DataType *EvalCast::GetDataType(Evaluator *state) { return castTo; };
@@ -363,7 +464,7 @@ bool EvalCast::HasConstantValue(Evaluator *state) {
 };
 
 EvalObject *EvalCast::GetConstantValue(Evaluator *state) {
-  return new EvalCast(castTo, operand->GetConstantValue(state));
+  return Create(castTo, operand->GetConstantValue(state));
 }
 
 BitConstant EvalCast::GetScalarConstValue(Evaluator *state) {
@@ -373,15 +474,17 @@ BitConstant EvalCast::GetScalarConstValue(Evaluator *state) {
 
 vector<EvalObject *> EvalCast::GetOperands() { return {operand}; }
 
+EvalObject *EvalCast::ReplaceOperands(const vector<EvalObject *> &newOperands) {
+  return Create(castTo, newOperands.at(0));
+}
+
 EvalObject *EvalCast::GetValue(Evaluator *state) {
-  return new EvalCast(castTo, operand->GetValue(state));
+  return Create(castTo, operand->GetValue(state));
 }
 
-void EvalCast::Synthesise(Evaluator *state, const SynthContext &sc,
+void EvalCast::Synthesise(Evaluator *state, SynthContext &sc,
                           HDLGen::HDLSignal *outputNet) {
-  HDLGen::HDLSignal *inputNet =
-      sc.design->CreateTempSignal(operand->GetDataType(state)->GetHDLType());
-  operand->Synthesise(state, sc, inputNet);
+  HDLGen::HDLSignal *inputNet = operand->GetSynthesisedNet(state, sc);
   sc.design->AddDevice(new HDLGen::BufferHDLDevice(inputNet, outputNet));
 }
 
@@ -389,6 +492,16 @@ EvalBasicOperation::EvalBasicOperation(OperationType _type,
                                        vector<EvalObject *> _operands)
     : EvalObject(), type(_type), operands(_operands){};
 
+EvalBasicOperation *
+EvalBasicOperation::Create(OperationType type,
+                           const vector<EvalObject *> &operands) {
+  EvalBasicOperation *&interned =
+      internedBasicOperations[make_pair(type, operands)];
+  if (interned == nullptr)
+    interned = new EvalBasicOperation(type, operands);
+  return interned;
+}
+
 string EvalBasicOperation::GetID() { return "oper_" + to_string(base_id); };
 
 DataType *EvalBasicOperation::GetDataType(Evaluator *state) {
@@ -413,23 +526,32 @@ DataType *EvalBasicOperation::GetDataType(Evaluator *state) {
     transform(intTypes.begin(), intTypes.end(), back_inserter(widths),
               [](IntegerType *i) { return i->width; });
 
-    transform(operands.begin(), operands.end(), back_inserter(cnstVals),
-              [state](EvalObject *o) -> BitConstant * {
-                if (o->HasConstantValue(state)) {
-                  return new BitConstant(o->GetScalarConstValue(state));
-                } else {
-                  return nullptr;
-                }
-              });
+    // Only a constant right hand operand of a division or shift affects the
+    // result width. Finding constant values is expensive for deep expressions,
+    // so other operands are not checked
+    bool needsConst = (type == B_DIV) || (type == B_LS) || (type == B_RS);
+    for (size_t i = 0; i < operands.size(); i++) {
+      EvalObject *o = operands.at(i);
+      if (needsConst && (i == 1) && o->HasConstantValue(state))
+        cnstVals.push_back(new BitConstant(o->GetScalarConstValue(state)));
+      else
+        cnstVals.push_back(nullptr);
+    }
 
-    bool result_signed = any_of(intTypes.begin(), intTypes.end(),
-                                [](IntegerType *t) { return t->is_signed; });
+    vector<bool> signs;
+    transform(intTypes.begin(), intTypes.end(), back_inserter(signs),
+              [](IntegerType *i) { return i->is_signed; });
+    bool result_signed = any_of(signs.begin(), signs.end(),
+                                [](bool s) { return s; });
+    // The result of a shift takes the signedness of the value shifted
+    if ((type == B_LS) || (type == B_RS))
+      result_signed = signs.at(0);
 
     // Special case for comparisons and logical operations
     if (HasBooleanResult(type))
       return new IntegerType(1, false);
     else
-      return new IntegerType(GetResultWidth(widths, type, cnstVals),
+      return new IntegerType(GetResultWidth(widths, type, cnstVals, signs),
                              result_signed);
   }
 };
@@ -449,7 +571,7 @@ EvalObject *EvalBasicOperation::GetConstantValue(Evaluator *state) {
   vector<BitConstant> constOperands;
   transform(operands.begin(), operands.end(), back_inserter(constOperands),
             [state](EvalObject *o) { return o->GetScalarConstValue(state); });
-  return new EvalConstant(PerformConstOperation(constOperands, type));
+  return EvalConstant::Create(PerformConstOperation(constOperands, type));
 };
 
 EvalObject *EvalBasicOperation::ApplyToState(Evaluator *state) {
@@ -493,6 +615,13 @@ EvalObject *EvalBasicOperation::ApplyToState(Evaluator *state) {
 
 vector<EvalObject *> EvalBasicOperation::GetOperands() { return operands; };
 
+EvalObject *
+EvalBasicOperation::ReplaceOperands(const vector<EvalObject *> &newOperands) {
+  return Create(type, newOperands);
+}
+
+OperationType EvalBasicOperation::GetOperationType() { return type; }
+
 EvalObject *EvalBasicOperation::GetValue(Evaluator *state) {
   return GetResult(state, operands, type);
 };
@@ -550,36 +679,53 @@ EvalObject *EvalBasicOperation::GetResult(Evaluator *state,
       case U_POSTDEC:
         return operandValues[0];
       case U_PREINC:
-        return new EvalBasicOperation(
-            B_ADD, vector<EvalObject *>{operandValues[0],
-                                        new EvalConstant(BitConstant(1))});
+        return Create(B_ADD,
+                      vector<EvalObject *>{operandValues[0],
+                                           EvalConstant::Create(BitConstant(1))});
       case U_PREDEC:
-        return new EvalBasicOperation(
-            B_SUB, vector<EvalObject *>{operandValues[0],
-                                        new EvalConstant(BitConstant(1))});
+        return Create(B_SUB,
+                      vector<EvalObject *>{operandValues[0],
+                                           EvalConstant::Create(BitConstant(1))});
       default:
         throw eval_error("unknown assignment type operation");
       };
     } else {
-      return new EvalBasicOperation(type, operands);
+      return Create(type, operandValues);
     }
   }
 }
 
-void EvalBasicOperation::Synthesise(Evaluator *state, const SynthContext &sc,
+void EvalBasicOperation::Synthesise(Evaluator *state, SynthContext &sc,
                                     HDLGen::HDLSignal *outputNet) {
+  if (((type == B_DIV) || (type == B_MOD)) &&
+      operands.at(1)->HasConstantValue(state)) {
+    // Division by a constant is lowered to a multiply by the reciprocal
+    sc.design->AddDevice(new HDLGen::ConstantDividerHDLDevice(
+        type, operands.at(0)->GetSynthesisedNet(state, sc),
+        operands.at(1)->GetScalarConstValue(state), outputNet));
+    return;
+  }
+
   vector<HDLGen::HDLSignal *> operandSigs;
 
   transform(operands.begin(), operands.end(), back_inserter(operandSigs),
-            [sc, state](EvalObject *op) {
-              HDLGen::HDLSignal *res = sc.design->CreateTempSignal(
-                  op->GetDataType(state)->GetHDLType());
-              op->Synthesise(state, sc, res);
-              return res;
+            [&sc, state](EvalObject *op) {
+              return op->GetSynthesisedNet(state, sc);
             });
 
-  sc.design->AddDevice(
-      new HDLGen::OperationHDLDevice(type, operandSigs, outputNet));
+  if ((type == B_DIV) || (type == B_MOD)) {
+    // Variable divisors use a divider, pipelined if the design is clocked
+    if (sc.clock != sc.design->gnd)
+      sc.design->AddDevice(new HDLGen::DividerHDLDevice(
+          type, operandSigs.at(0), operandSigs.at(1), outputNet, sc.clock,
+          sc.clock_enable));
+    else
+      sc.design->AddDevice(new HDLGen::DividerHDLDevice(
+          type, operandSigs.at(0), operandSigs.at(1), outputNet));
+  } else {
+    sc.design->AddDevice(
+        new HDLGen::OperationHDLDevice(type, operandSigs, outputNet));
+  }
 }
 
 EvalSpecialOperation::EvalSpecialOperation(SpecialOperationType _type,
@@ -587,6 +733,22 @@ EvalSpecialOperation::EvalSpecialOperation(SpecialOperationType _type,
                                            vector<BitConstant> _parameters)
     : EvalObject(), type(_type), operands(_operands), parameters(_parameters){};
 
+EvalSpecialOperation *
+EvalSpecialOperation::Create(SpecialOperationType type,
+                             const vector<EvalObject *> &operands,
+                             const vector<BitConstant> &parameters) {
+  vector<string> paramKey;
+  transform(parameters.begin(), parameters.end(), back_inserter(paramKey),
+            [](const BitConstant &p) {
+              return p.to_string() + (p.is_signed ? "s" : "u");
+            });
+  EvalSpecialOperation *&interned =
+      internedSpecialOperations[make_tuple(type, operands, paramKey)];
+  if (interned == nullptr)
+    interned = new EvalSpecialOperation(type, operands, parameters);
+  return interned;
+}
+
 string EvalSpecialOperation::GetID() {
   return "special_op_" + to_string(base_id);
 }
@@ -599,6 +761,27 @@ DataType *EvalSpecialOperation::GetDataType(Evaluator *state) {
     return operands.at(0)->GetDataType(state);
   case SpecialOperationType::ARRAY_WRITE:
     return operands.at(1)->GetDataType(state);
+  case SpecialOperationType::MULTI_ADD: {
+    // Wide enough that the sum can never overflow
+    vector<IntegerType *> intTypes;
+    transform(operands.begin(), operands.end(), back_inserter(intTypes),
+              [state](EvalObject *o) {
+                return dynamic_cast<IntegerType *>(o->GetDataType(state));
+              });
+    if (find(intTypes.begin(), intTypes.end(), nullptr) != intTypes.end())
+      throw eval_error("all operands of a sum must be numeric and scalar");
+    bool is_signed = any_of(intTypes.begin(), intTypes.end(),
+                            [](IntegerType *i) { return i->is_signed; });
+    int width = 0, growth = 0;
+    for (auto i : intTypes)
+      width = max(width, i->width + ((is_signed && !i->is_signed) ? 1 : 0));
+    while ((1U << growth) < operands.size())
+      growth++;
+    if (!parameters.empty())
+      return new IntegerType(min(width + growth, parameters.at(0).intval()),
+                             is_signed);
+    return new IntegerType(width + growth, is_signed);
+  }
   default:
     throw eval_error("unknown special operation");
   }
@@ -622,20 +805,26 @@ EvalObject *EvalSpecialOperation::GetConstantValue(Evaluator *state) {
   switch (type) {
   case SpecialOperationType::T_COND:
     if (constOperands[0].intval() != 0)
-      return new EvalConstant(constOperands[1]);
+      return EvalConstant::Create(constOperands[1]);
     else
-      return new EvalConstant(constOperands[2]);
+      return EvalConstant::Create(constOperands[2]);
   case SpecialOperationType::ARRAY_SEL: {
     int idx = constOperands.back().intval();
     if (idx >= constOperands.size() - 1)
       throw eval_error("array index out of bounds");
-    return new EvalConstant(constOperands.at(idx));
+    return EvalConstant::Create(constOperands.at(idx));
   }
   case SpecialOperationType::ARRAY_WRITE:
     if (constOperands.at(2).intval() == parameters.at(0).intval())
-      return new EvalConstant(constOperands.at(1));
+      return EvalConstant::Create(constOperands.at(1));
     else
-      return new EvalConstant(constOperands.at(0));
+      return EvalConstant::Create(constOperands.at(0));
+  case SpecialOperationType::MULTI_ADD: {
+    BitConstant sum = constOperands.at(0);
+    for (size_t i = 1; i < constOperands.size(); i++)
+      sum = PerformConstOperation({sum, constOperands.at(i)}, B_ADD);
+    return EvalConstant::Create(sum);
+  }
   default:
     throw eval_error("unknown special operation");
   }
@@ -645,7 +834,7 @@ EvalObject *EvalSpecialOperation::ApplyToState(Evaluator *state) {
   vector<EvalObject *> operandValues;
   transform(operands.begin(), operands.end(), back_inserter(operandValues),
             [state](EvalObject *o) { return o->GetValue(state); });
-  return new EvalSpecialOperation(type, operandValues, parameters);
+  return Create(type, operandValues, parameters);
 }
 
 void EvalSpecialOperation::AssignValue(Evaluator *state, EvalObject *value) {
@@ -657,24 +846,25 @@ void EvalSpecialOperation::AssignValue(Evaluator *state, EvalObject *value) {
 }
 
 vector<EvalObject *> EvalSpecialOperation::GetOperands() { return operands; }
-vector<EvalObject *> &EvalSpecialOperation::GetOperandsByRef() {
-  return operands;
+
+vector<BitConstant> EvalSpecialOperation::GetParameters() { return parameters; }
+
+EvalObject *
+EvalSpecialOperation::ReplaceOperands(const vector<EvalObject *> &newOperands) {
+  return Create(type, newOperands, parameters);
 }
 
 EvalObject *EvalSpecialOperation::GetValue(Evaluator *state) {
   return ApplyToState(state);
 }
 
-void EvalSpecialOperation::Synthesise(Evaluator *state, const SynthContext &sc,
+void EvalSpecialOperation::Synthesise(Evaluator *state, SynthContext &sc,
                                       HDLGen::HDLSignal *outputNet) {
   vector<HDLGen::HDLSignal *> operandSigs;
 
   transform(operands.begin(), operands.end(), back_inserter(operandSigs),
-            [sc, state](EvalObject *op) {
-              HDLGen::HDLSignal *res = sc.design->CreateTempSignal(
-                  op->GetDataType(state)->GetHDLType());
-              op->Synthesise(state, sc, res);
-              return res;
+            [&sc, state](EvalObject *op) {
+              return op->GetSynthesisedNet(state, sc);
             });
 
   switch (type) {
@@ -691,8 +881,22 @@ void EvalSpecialOperation::Synthesise(Evaluator *state, const SynthContext &sc,
         operandSigs.back(), outputNet));
     break;
   case SpecialOperationType::ARRAY_WRITE: {
-    throw eval_error("array write synthesis NYI");
+    HDLGen::HDLSignal *match = sc.design->CreateTempSignal(
+        new HDLGen::NumericPortType(1, false), "index_match");
+    sc.design->AddDevice(new HDLGen::OperationHDLDevice(
+        OperationType::B_EQ,
+        {operandSigs[2],
+         EvalConstant::Create(parameters.at(0))->GetSynthesisedNet(state, sc)},
+        match));
+    sc.design->AddDevice(new HDLGen::MultiplexerHDLDevice(
+        vector<HDLGen::HDLSignal *>{operandSigs[0], operandSigs[1]}, match,
+        outputNet));
+    break;
   }
+  case SpecialOperationType::MULTI_ADD:
+    sc.design->AddDevice(
+        new HDLGen::CompressorTreeHDLDevice(operandSigs, outputNet));
+    break;
   }
 }
 
@@ -846,15 +1050,17 @@ EvalObject *EvalRegister::ApplyToState(Evaluator *state) {
 }
 vector<EvalObject *> EvalRegister::GetOperands() { return {input}; }
 
+EvalObject *EvalRegister::ReplaceOperands(const vector<EvalObject *> &newOperands) {
+  return new EvalRegister(newOperands.at(0));
+}
+
 EvalObject *EvalRegister::GetValue(Evaluator *state) {
   return new EvalRegister(input->GetValue(state));
 }
 
-void EvalRegister::Synthesise(Evaluator *state, const SynthContext &sc,
+void EvalRegister::Synthesise(Evaluator *state, SynthContext &sc,
                               HDLGen::HDLSignal *outputNet) {
-  HDLGen::HDLSignal *inpSig =
-      sc.design->CreateTempSignal(input->GetDataType(state)->GetHDLType());
-  input->Synthesise(state, sc, inpSig);
+  HDLGen::HDLSignal *inpSig = input->GetSynthesisedNet(state, sc);
   sc.design->AddDevice(new HDLGen::RegisterHDLDevice(
       inpSig, sc.clock, outputNet, sc.clock_enable, sc.reset, false));
 }
@@ -867,7 +1073,7 @@ EvalObject *EvalDontCare::GetConstantValue(Evaluator *state) { return this; }
 BitConstant EvalDontCare::GetScalarConstValue(Evaluator *state) { return 0; }
 EvalObject *EvalDontCare::GetValue(Evaluator *state) { return this; }
 
-void EvalDontCare::Synthesise(Evaluator *state, const SynthContext &sc,
+void EvalDontCare::Synthesise(Evaluator *state, SynthContext &sc,
                               HDLGen::HDLSignal *outputNet) {
   // TODO: proper don't care signal
   sc.design->AddDevice(new HDLGen::ConstantHDLDevice(0, outputNet));
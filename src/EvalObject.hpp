@@ -1,4 +1,5 @@
 #pragma once
+#include "Arena.hpp"
 #include "Attributes.hpp"
 #include "BitConstant.hpp"
 #include "DataTypes.hpp"
@@ -17,7 +18,7 @@ class EvaluatorVariable;
 // This is effectively anything which has a value (whether constant or an
 // expression; scalar or array)
 // It is generated after parsing
-class EvalObject {
+class EvalObject : public ArenaAllocated<ArenaKind::Graph> {
 public:
   EvalObject();
 
@@ -57,6 +58,10 @@ public:
   virtual EvalObject *GetValue(Evaluator *state);
   // Return all operands
   virtual vector<EvalObject *> GetOperands();
+  // Return an equivalent EvalObject with its operands replaced, given in the
+  // same order as GetOperands. Objects that cannot be rebuilt return
+  // themselves unchanged
+  virtual EvalObject *ReplaceOperands(const vector<EvalObject *> &newOperands);
   // Returns whether or not the underlying object can be pushed into; e.g. is it
   // a reference to a stream, FIFO, etc
   virtual bool CanPushInto();
@@ -64,8 +69,19 @@ public:
   virtual EvalObject *ApplyPushInto(Evaluator *state, EvalObject *value);
   // Synthesise the EvalObject into a HDL design, connecting the output to a
   // given signal. Throws if the EvalObject is not synthesisable
-  virtual void Synthesise(Evaluator *state, const SynthContext &sc,
+  virtual void Synthesise(Evaluator *state, SynthContext &sc,
                           HDLGen::HDLSignal *outputNet);
+  // Return a net carrying the value of the EvalObject, synthesising it into a
+  // new temporary signal the first time it is requested in a given context and
+  // returning the same net on subsequent calls so shared nodes are only built
+  // once
+  HDLGen::HDLSignal *GetSynthesisedNet(Evaluator *state, SynthContext &sc);
+
+  // Line of the statement that created the EvalObject, or -1 if unknown. This
+  // is passed on to the devices it is synthesised into for timing reports
+  int sourceLine = -1;
+  // Line of the statement currently being evaluated, set by the Evaluator
+  static int currentSourceLine;
 
 protected:
   int base_id = 0;
@@ -88,10 +104,14 @@ public:
   void AssignStructureMember(Evaluator *state, string name, EvalObject *value);
   void AssignValue(Evaluator *state, EvalObject *value);
   EvalObject *GetValue(Evaluator *state);
+  bool CanPushInto();
+  EvalObject *ApplyPushInto(Evaluator *state, EvalObject *value);
 
-  void Synthesise(Evaluator *state, const SynthContext &sc,
+  void Synthesise(Evaluator *state, SynthContext &sc,
                   HDLGen::HDLSignal *outputNet);
 
+  EvaluatorVariable *GetVariable();
+
 private:
   EvaluatorVariable *var;
 };
@@ -100,6 +120,8 @@ private:
 class EvalConstant : public EvalObject {
 public:
   EvalConstant(BitConstant _val);
+  // Return the unique EvalConstant with a given value
+  static EvalConstant *Create(const BitConstant &val);
   // Return a string identifier
   string GetID();
   bool HasConstantValue(Evaluator *state);
@@ -107,7 +129,7 @@ public:
   DataType *GetDataType(Evaluator *state);
   BitConstant GetScalarConstValue(Evaluator *state);
 
-  void Synthesise(Evaluator *state, const SynthContext &sc,
+  void Synthesise(Evaluator *state, SynthContext &sc,
                   HDLGen::HDLSignal *outputNet);
 
 private:
@@ -128,8 +150,9 @@ public:
                                 vector<EvalObject *> subscript,
                                 EvalObject *value);
   vector<EvalObject *> GetOperands();
+  EvalObject *ReplaceOperands(const vector<EvalObject *> &newOperands);
 
-  void Synthesise(Evaluator *state, const SynthContext &sc,
+  void Synthesise(Evaluator *state, SynthContext &sc,
                   HDLGen::HDLSignal *outputNet);
 
 private:
@@ -149,6 +172,7 @@ public:
   EvalObject *GetStructureMember(Evaluator *state, string name);
   void AssignStructureMember(Evaluator *state, string name, EvalObject *value);
   vector<EvalObject *> GetOperands();
+  EvalObject *ReplaceOperands(const vector<EvalObject *> &newOperands);
 
 private:
   StructureType *structType;
@@ -212,15 +236,19 @@ private:
 class EvalCast : public EvalObject {
 public:
   EvalCast(IntegerType *_castTo, EvalObject *_operand);
+  // Return the unique cast of an operand to a type with a given width and
+  // signedness
+  static EvalCast *Create(IntegerType *castTo, EvalObject *operand);
   string GetID();
   DataType *GetDataType(Evaluator *state);
   bool HasConstantValue(Evaluator *state);
   EvalObject *GetConstantValue(Evaluator *state);
   BitConstant GetScalarConstValue(Evaluator *state);
   vector<EvalObject *> GetOperands();
+  EvalObject *ReplaceOperands(const vector<EvalObject *> &newOperands);
   EvalObject *GetValue(Evaluator *state);
 
-  void Synthesise(Evaluator *state, const SynthContext &sc,
+  void Synthesise(Evaluator *state, SynthContext &sc,
                   HDLGen::HDLSignal *outputNet);
 
 private:
@@ -234,13 +262,18 @@ private:
 class EvalBasicOperation : public EvalObject {
 public:
   EvalBasicOperation(OperationType _type, vector<EvalObject *> _operands);
+  // Return the unique operation of a given type on a list of operands
+  static EvalBasicOperation *Create(OperationType type,
+                                    const vector<EvalObject *> &operands);
   string GetID();
   DataType *GetDataType(Evaluator *state);
   bool HasConstantValue(Evaluator *state);
   EvalObject *GetConstantValue(Evaluator *state);
   EvalObject *ApplyToState(Evaluator *state);
   vector<EvalObject *> GetOperands();
+  EvalObject *ReplaceOperands(const vector<EvalObject *> &newOperands);
   EvalObject *GetValue(Evaluator *state);
+  OperationType GetOperationType();
 
   // Returns true if the operation is a push or assignment and therefore has
   // non-numeric result (equal to operand index 1)
@@ -252,7 +285,7 @@ public:
   EvalObject *GetResult(Evaluator *state, const vector<EvalObject *> &operands,
                         OperationType type);
 
-  void Synthesise(Evaluator *state, const SynthContext &sc,
+  void Synthesise(Evaluator *state, SynthContext &sc,
                   HDLGen::HDLSignal *outputNet);
 
 private:
@@ -269,6 +302,9 @@ enum class SpecialOperationType {
   ARRAY_WRITE, // array item conditional write; operands : original value, new
                // value, write index
                // parameters : index of item
+  MULTI_ADD,   // sum of all operands, synthesised as a compressor tree
+               // parameters : optional width of the result, if the sum is
+               // known to fit in fewer bits than the operands allow
 };
 
 class EvalSpecialOperation : public EvalObject {
@@ -276,6 +312,11 @@ public:
   EvalSpecialOperation(SpecialOperationType _type,
                        vector<EvalObject *> _operands,
                        vector<BitConstant> _parameters = {});
+  // Return the unique special operation of a given type, operands and
+  // parameters
+  static EvalSpecialOperation *
+  Create(SpecialOperationType type, const vector<EvalObject *> &operands,
+         const vector<BitConstant> &parameters = {});
   string GetID();
   DataType *GetDataType(Evaluator *state);
   bool HasConstantValue(Evaluator *state);
@@ -283,15 +324,16 @@ public:
   EvalObject *ApplyToState(Evaluator *state);
   void AssignValue(Evaluator *state, EvalObject *value);
   vector<EvalObject *> GetOperands();
-  vector<EvalObject *> &GetOperandsByRef();
+  EvalObject *ReplaceOperands(const vector<EvalObject *> &newOperands);
 
   EvalObject *GetValue(Evaluator *state);
 
-  void Synthesise(Evaluator *state, const SynthContext &sc,
+  void Synthesise(Evaluator *state, SynthContext &sc,
                   HDLGen::HDLSignal *outputNet);
 
 
   SpecialOperationType type;
+  vector<BitConstant> GetParameters();
 
 private:
   vector<EvalObject *> operands;
@@ -308,9 +350,10 @@ public:
   EvalObject *GetConstantValue(Evaluator *state);
   EvalObject *ApplyToState(Evaluator *state);
   vector<EvalObject *> GetOperands();
+  EvalObject *ReplaceOperands(const vector<EvalObject *> &newOperands);
   EvalObject *GetValue(Evaluator *state);
 
-  void Synthesise(Evaluator *state, const SynthContext &sc,
+  void Synthesise(Evaluator *state, SynthContext &sc,
                   HDLGen::HDLSignal *outputNet);
 
 private:
@@ -329,7 +372,7 @@ public:
   BitConstant GetScalarConstValue(Evaluator *state);
   EvalObject *GetValue(Evaluator *state);
 
-  void Synthesise(Evaluator *state, const SynthContext &sc,
+  void Synthesise(Evaluator *state, SynthContext &sc,
                   HDLGen::HDLSignal *outputNet);
 
 private:
@@ -364,4 +407,12 @@ public:
 };
 
 extern EvalNull_class *EvalNull;
+
+// EvalConstant, EvalCast, EvalBasicOperation and EvalSpecialOperation objects
+// created with their Create factories are interned, so structurally identical
+// expressions are represented by a single object. As interned objects may be
+// shared they must never be modified after creation.
+// This clears the intern tables, after which previously interned objects will
+// no longer be returned by the factories
+void ClearInternedEvalObjects();
 }
@@ -0,0 +1,1008 @@
+#include "EvalOptimiser.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+#include <set>
+using namespace std;
+
+namespace ElasticC {
+
+EvalOptimiser::EvalOptimiser(EvaluatedBlock *_block, DeviceTiming *_timing,
+                             bool _use_dsps)
+    : block(_block), state(_block->eval), timing(_timing),
+      use_dsps(_use_dsps){};
+
+// Rules are tried in order, so cheaper and more general rules come first
+const vector<EvalOptimiser::Rule> EvalOptimiser::rules = {
+    {"constant folding", &EvalOptimiser::FoldConstants},
+    {"identities", &EvalOptimiser::ApplyIdentities},
+    {"strength reduction", &EvalOptimiser::ReduceStrength},
+    {"cast fusion", &EvalOptimiser::FuseCasts},
+    {"conditional collapsing", &EvalOptimiser::CollapseConditionals},
+    {"select folding", &EvalOptimiser::FoldSelects},
+};
+
+void EvalOptimiser::Run() {
+  RemoveDeadValues();
+  for (auto &var : block->vars)
+    var.second = Simplify(var.second);
+  for (auto rule : ruleCount)
+    PrintMessage(MSG_DEBUG, "applied " + rule.first + " " +
+                                to_string(rule.second) + " times");
+
+  LowerConstMultiplies();
+
+  for (auto &var : block->vars)
+    var.second = Narrow(var.second);
+  PrintMessage(MSG_DEBUG, "narrowed " + to_string(numNarrowed) + " values");
+
+  CountUses();
+  int numRebalanced = 0;
+  for (auto &var : block->vars) {
+    EvalObject *value = Rebalance(var.second);
+    if (value != var.second)
+      numRebalanced++;
+    var.second = value;
+  }
+  PrintMessage(MSG_DEBUG, "rebalanced " + to_string(numRebalanced) +
+                              " variable values");
+
+  FindMemoryRanges();
+}
+
+void EvalOptimiser::RemoveDeadValues() {
+  // Values of outputs are always needed, as are inputs which are driven from
+  // outside the block. Anything else is only needed if it is referenced by a
+  // value that is needed
+  set<EvaluatorVariable *> live;
+  set<EvalObject *> visited;
+  vector<EvalObject *> worklist;
+  auto markLive = [&](EvaluatorVariable *var) {
+    auto value = block->vars.find(var);
+    if (live.insert(var).second && (value != block->vars.end()) &&
+        visited.insert(value->second).second)
+      worklist.push_back(value->second);
+  };
+  for (auto var : block->vars) {
+    VariableDir dir = var.first->GetDir();
+    if (dir.is_input || dir.is_output)
+      markLive(var.first);
+  }
+  while (!worklist.empty()) {
+    EvalObject *obj = worklist.back();
+    worklist.pop_back();
+    EvalVariable *ref = dynamic_cast<EvalVariable *>(obj);
+    if (ref != nullptr)
+      markLive(ref->GetVariable());
+    for (auto op : obj->GetOperands())
+      if (visited.insert(op).second)
+        worklist.push_back(op);
+  }
+
+  int removed = 0;
+  for (auto it = block->vars.begin(); it != block->vars.end();) {
+    if (live.find(it->first) == live.end()) {
+      it = block->vars.erase(it);
+      removed++;
+    } else {
+      ++it;
+    }
+  }
+  PrintMessage(MSG_DEBUG, "removed " + to_string(removed) + " dead variables");
+}
+
+void EvalOptimiser::CountUses() {
+  set<EvalObject *> visited;
+  vector<EvalObject *> worklist;
+  for (auto var : block->vars) {
+    useCount[var.second]++;
+    if (visited.insert(var.second).second)
+      worklist.push_back(var.second);
+  }
+  while (!worklist.empty()) {
+    EvalObject *obj = worklist.back();
+    worklist.pop_back();
+    for (auto op : obj->GetOperands()) {
+      useCount[op]++;
+      if (visited.insert(op).second)
+        worklist.push_back(op);
+    }
+  }
+}
+
+IntegerType *EvalOptimiser::GetIntType(EvalObject *obj) {
+  auto cached = intTypes.find(obj);
+  if (cached != intTypes.end())
+    return cached->second;
+  IntegerType *type = nullptr;
+  try {
+    type = dynamic_cast<IntegerType *>(obj->GetDataType(state));
+  } catch (eval_error &e) {
+    // Objects such as null values have no type
+  }
+  intTypes[obj] = type;
+  return type;
+}
+
+EvalObject *EvalOptimiser::CastTo(IntegerType *type, EvalObject *obj) {
+  IntegerType *objType = GetIntType(obj);
+  if ((objType != nullptr) && (objType->width == type->width) &&
+      (objType->is_signed == type->is_signed))
+    return obj;
+  return EvalCast::Create(type, obj);
+}
+
+EvalObject *EvalOptimiser::Simplify(EvalObject *obj) {
+  auto existing = simplified.find(obj);
+  if (existing != simplified.end())
+    return existing->second;
+
+  int oldLine = EvalObject::currentSourceLine;
+  EvalObject::currentSourceLine = obj->sourceLine;
+  vector<EvalObject *> operands = obj->GetOperands(), newOperands;
+  transform(operands.begin(), operands.end(), back_inserter(newOperands),
+            [this](EvalObject *o) { return Simplify(o); });
+  EvalObject *result =
+      (newOperands != operands) ? obj->ReplaceOperands(newOperands) : obj;
+
+  // The first rule that matches replaces the object, and its replacement is
+  // then simplified in turn. Every rule gives an object with fewer or cheaper
+  // operations, so this always terminates
+  IntegerType *type = GetIntType(result);
+  if (type != nullptr) {
+    for (auto &rule : rules) {
+      EvalObject *next = (this->*rule.apply)(result, type);
+      if ((next != nullptr) && (next != result)) {
+        ruleCount[rule.name]++;
+        result = Simplify(next);
+        break;
+      }
+    }
+  }
+  EvalObject::currentSourceLine = oldLine;
+  simplified[obj] = result;
+  simplified[result] = result;
+  return result;
+}
+
+// Return the value of a constant operand, or nullptr if it is not constant
+static EvalConstant *GetConstOperand(EvalObject *obj) {
+  return dynamic_cast<EvalConstant *>(obj);
+}
+
+static bool IsConstValue(Evaluator *state, EvalObject *obj, int value) {
+  EvalConstant *c = GetConstOperand(obj);
+  return (c != nullptr) &&
+         (AreBitsEqual(c->GetScalarConstValue(state), BitConstant(value))
+              .intval() != 0);
+}
+
+// Return k if a constant is equal to 2^k, otherwise -1
+static int Log2Exact(Evaluator *state, EvalObject *obj) {
+  EvalConstant *c = GetConstOperand(obj);
+  if (c == nullptr)
+    return -1;
+  BitConstant value = c->GetScalarConstValue(state);
+  if (value.is_negative())
+    return -1;
+  int k = -1;
+  for (int i = 0; i < value.width(); i++) {
+    if (value.get_bit(i)) {
+      if (k != -1)
+        return -1;
+      k = i;
+    }
+  }
+  return k;
+}
+
+EvalObject *EvalOptimiser::FoldConstants(EvalObject *obj, IntegerType *type) {
+  if ((dynamic_cast<EvalBasicOperation *>(obj) == nullptr) &&
+      (dynamic_cast<EvalSpecialOperation *>(obj) == nullptr) &&
+      (dynamic_cast<EvalCast *>(obj) == nullptr))
+    return nullptr;
+  vector<EvalObject *> operands = obj->GetOperands();
+  if (operands.empty() || !all_of(operands.begin(), operands.end(),
+                                  [](EvalObject *o) {
+                                    return GetConstOperand(o) != nullptr;
+                                  }))
+    return nullptr;
+  try {
+    return EvalConstant::Create(
+        obj->GetScalarConstValue(state).cast(type->width, type->is_signed));
+  } catch (runtime_error &e) {
+    // Such as division by zero, which is left to fail during synthesis
+    return nullptr;
+  }
+}
+
+EvalObject *EvalOptimiser::ApplyIdentities(EvalObject *obj,
+                                           IntegerType *type) {
+  EvalBasicOperation *oper = dynamic_cast<EvalBasicOperation *>(obj);
+  if ((oper == nullptr) || (oper->GetOperands().size() != 2))
+    return nullptr;
+  EvalObject *a = oper->GetOperands().at(0), *b = oper->GetOperands().at(1);
+  EvalObject *zero =
+      EvalConstant::Create(BitConstant(0).cast(type->width, type->is_signed));
+  switch (oper->GetOperationType()) {
+  case B_ADD:
+  case B_BWOR:
+  case B_BWXOR:
+    if (IsConstValue(state, b, 0))
+      return CastTo(type, a);
+    if (IsConstValue(state, a, 0))
+      return CastTo(type, b);
+    if (a == b)
+      return (oper->GetOperationType() == B_BWOR)
+                 ? CastTo(type, a)
+                 : ((oper->GetOperationType() == B_BWXOR) ? zero : nullptr);
+    return nullptr;
+  case B_SUB:
+    if (IsConstValue(state, b, 0))
+      return CastTo(type, a);
+    if (a == b)
+      return zero;
+    return nullptr;
+  case B_BWAND:
+    if (IsConstValue(state, a, 0) || IsConstValue(state, b, 0))
+      return zero;
+    if (a == b)
+      return CastTo(type, a);
+    return nullptr;
+  case B_MUL:
+    if (IsConstValue(state, a, 0) || IsConstValue(state, b, 0))
+      return zero;
+    if (IsConstValue(state, b, 1))
+      return CastTo(type, a);
+    if (IsConstValue(state, a, 1))
+      return CastTo(type, b);
+    return nullptr;
+  case B_DIV:
+    if (IsConstValue(state, b, 1))
+      return CastTo(type, a);
+    return nullptr;
+  case B_MOD:
+    if (IsConstValue(state, b, 1))
+      return zero;
+    return nullptr;
+  case B_LS:
+  case B_RS:
+    if (IsConstValue(state, b, 0))
+      return CastTo(type, a);
+    return nullptr;
+  default:
+    return nullptr;
+  }
+}
+
+EvalObject *EvalOptimiser::ReduceStrength(EvalObject *obj, IntegerType *type) {
+  EvalBasicOperation *oper = dynamic_cast<EvalBasicOperation *>(obj);
+  if ((oper == nullptr) || (oper->GetOperands().size() != 2))
+    return nullptr;
+  EvalObject *a = oper->GetOperands().at(0), *b = oper->GetOperands().at(1);
+  switch (oper->GetOperationType()) {
+  case B_MUL: {
+    // Multiplication by a power of two is a shift
+    for (int i = 0; i < 2; i++) {
+      EvalObject *x = (i == 0) ? a : b, *c = (i == 0) ? b : a;
+      int k = Log2Exact(state, c);
+      if (k > 0)
+        return CastTo(type, EvalBasicOperation::Create(
+                                B_LS, vector<EvalObject *>{
+                                          x, EvalConstant::Create(BitConstant(k))}));
+    }
+    return nullptr;
+  }
+  case B_DIV:
+  case B_MOD: {
+    // Only valid for unsigned values, as signed division rounds towards zero
+    IntegerType *aType = GetIntType(a);
+    int k = Log2Exact(state, b);
+    if ((aType == nullptr) || aType->is_signed || (k <= 0))
+      return nullptr;
+    if (oper->GetOperationType() == B_DIV)
+      return CastTo(type, EvalBasicOperation::Create(
+                              B_RS, vector<EvalObject *>{
+                                        a, EvalConstant::Create(BitConstant(k))}));
+    BitConstant mask = SubtractBits(
+        LeftShiftBits(BitConstant(1), BitConstant(k)), BitConstant(1));
+    return CastTo(type, EvalBasicOperation::Create(
+                            B_BWAND, vector<EvalObject *>{
+                                         a, EvalConstant::Create(
+                                                mask.cast(k, false))}));
+  }
+  default:
+    return nullptr;
+  }
+}
+
+EvalObject *EvalOptimiser::FuseCasts(EvalObject *obj, IntegerType *type) {
+  EvalCast *cast = dynamic_cast<EvalCast *>(obj);
+  if (cast == nullptr)
+    return nullptr;
+  EvalObject *x = cast->GetOperands().at(0);
+  IntegerType *xType = GetIntType(x);
+  if (xType == nullptr)
+    return nullptr;
+  if ((xType->width == type->width) && (xType->is_signed == type->is_signed))
+    return x;
+  EvalCast *inner = dynamic_cast<EvalCast *>(x);
+  if (inner == nullptr)
+    return nullptr;
+  // A cast of a cast is equivalent to a single cast if the inner cast either
+  // does not lose any bits that the outer cast keeps, or preserves the value
+  EvalObject *y = inner->GetOperands().at(0);
+  IntegerType *yType = GetIntType(y);
+  if (yType == nullptr)
+    return nullptr;
+  bool preserves =
+      ((xType->is_signed == yType->is_signed) &&
+       (xType->width >= yType->width)) ||
+      (!yType->is_signed && xType->is_signed && (xType->width > yType->width));
+  if ((xType->width >= type->width) || preserves)
+    return CastTo(type, y);
+  return nullptr;
+}
+
+EvalObject *EvalOptimiser::CollapseConditionals(EvalObject *obj,
+                                                IntegerType *type) {
+  EvalSpecialOperation *sel = dynamic_cast<EvalSpecialOperation *>(obj);
+  if ((sel == nullptr) || (sel->type != SpecialOperationType::T_COND))
+    return nullptr;
+  vector<EvalObject *> operands = sel->GetOperands();
+  EvalObject *c = operands.at(0), *a = operands.at(1), *b = operands.at(2);
+  EvalConstant *constCond = GetConstOperand(c);
+  if (constCond != nullptr)
+    return CastTo(type,
+                  constCond->GetScalarConstValue(state).is_zero() ? b : a);
+  if (a == b)
+    return a;
+  // Nested conditionals on the same condition always take the same arm
+  auto sameCond = [c](EvalObject *o) -> EvalSpecialOperation * {
+    EvalSpecialOperation *inner = dynamic_cast<EvalSpecialOperation *>(o);
+    if ((inner != nullptr) && (inner->type == SpecialOperationType::T_COND) &&
+        (inner->GetOperands().at(0) == c))
+      return inner;
+    return nullptr;
+  };
+  if (sameCond(a) != nullptr)
+    return EvalSpecialOperation::Create(
+        SpecialOperationType::T_COND,
+        vector<EvalObject *>{c, sameCond(a)->GetOperands().at(1), b});
+  if (sameCond(b) != nullptr)
+    return EvalSpecialOperation::Create(
+        SpecialOperationType::T_COND,
+        vector<EvalObject *>{c, a, sameCond(b)->GetOperands().at(2)});
+  // c ? 1 : 0 for a single bit c is just c
+  IntegerType *condType = GetIntType(c);
+  if ((type->width == 1) && !type->is_signed && (condType != nullptr) &&
+      (condType->width == 1) && !condType->is_signed &&
+      IsConstValue(state, a, 1) && IsConstValue(state, b, 0))
+    return c;
+  return nullptr;
+}
+
+EvalObject *EvalOptimiser::FoldSelects(EvalObject *obj, IntegerType *type) {
+  EvalSpecialOperation *sel = dynamic_cast<EvalSpecialOperation *>(obj);
+  if (sel == nullptr)
+    return nullptr;
+  vector<EvalObject *> operands = sel->GetOperands();
+  EvalConstant *index = GetConstOperand(operands.back());
+  if (sel->type == SpecialOperationType::ARRAY_SEL) {
+    if (index != nullptr) {
+      BitConstant idx = index->GetScalarConstValue(state);
+      if (!idx.is_negative() && (idx.intval() < int(operands.size()) - 1))
+        return CastTo(type, operands.at(idx.intval()));
+      return nullptr;
+    }
+    if (all_of(operands.begin(), operands.end() - 1,
+               [&operands](EvalObject *o) { return o == operands.at(0); }))
+      return CastTo(type, operands.at(0));
+  } else if (sel->type == SpecialOperationType::ARRAY_WRITE) {
+    if (index != nullptr) {
+      bool written = AreBitsEqual(index->GetScalarConstValue(state),
+                                  sel->GetParameters().at(0))
+                         .intval() != 0;
+      return CastTo(type, written ? operands.at(1) : operands.at(0));
+    }
+    if (operands.at(0) == operands.at(1))
+      return operands.at(0);
+  }
+  return nullptr;
+}
+
+bool EvalOptimiser::IsConstMultiply(EvalObject *obj, EvalObject *&value,
+                                    int64_t &constant) {
+  EvalBasicOperation *oper = dynamic_cast<EvalBasicOperation *>(obj);
+  if ((oper == nullptr) || (oper->GetOperationType() != B_MUL) ||
+      (GetIntType(obj) == nullptr))
+    return false;
+  for (int i = 0; i < 2; i++) {
+    EvalObject *x = oper->GetOperands().at(i),
+               *c = oper->GetOperands().at(1 - i);
+    EvalConstant *constOperand = GetConstOperand(c);
+    if ((constOperand == nullptr) || (GetConstOperand(x) != nullptr) ||
+        (GetIntType(x) == nullptr))
+      continue;
+    ValueRange range =
+        ValueRange::FromConstant(constOperand->GetScalarConstValue(state));
+    if (!range.is_bounded || (range.lo == 0))
+      return false;
+    value = x;
+    constant = range.lo;
+    return true;
+  }
+  return false;
+}
+
+// Return the area of a shift-add network on a value of the given signed width
+static double GetNetworkArea(DeviceTiming *timing, const ShiftAddNetwork &network,
+                             int width) {
+  double area = 0;
+  for (auto f : network.fundamentals)
+    if (f != 1)
+      area += timing->GetAdderArea(
+          width + ValueRange::FromInterval(f, f).GetMinWidth(false));
+  int negations = network.GetNumAdders() - int(network.steps.size());
+  return area + negations * timing->GetAdderArea(width);
+}
+
+void EvalOptimiser::LowerConstMultiplies() {
+  // Find every multiply by a constant, grouped by the value multiplied
+  map<EvalObject *, int> groupIndex;
+  map<EvalObject *, pair<int, int64_t>> multiplies;
+  set<EvalObject *> visited;
+  vector<EvalObject *> worklist;
+  for (auto var : block->vars)
+    if (visited.insert(var.second).second)
+      worklist.push_back(var.second);
+  while (!worklist.empty()) {
+    EvalObject *obj = worklist.back();
+    worklist.pop_back();
+    EvalObject *value;
+    int64_t constant;
+    if (IsConstMultiply(obj, value, constant)) {
+      if (groupIndex.find(value) == groupIndex.end()) {
+        groupIndex[value] = int(constMulGroups.size());
+        constMulGroups.push_back(ConstMultiplyGroup{value});
+      }
+      ConstMultiplyGroup &group = constMulGroups.at(groupIndex.at(value));
+      if (find(group.constants.begin(), group.constants.end(), constant) ==
+          group.constants.end())
+        group.constants.push_back(constant);
+      multiplies[obj] = make_pair(groupIndex.at(value), constant);
+    }
+    for (auto op : obj->GetOperands())
+      if (visited.insert(op).second)
+        worklist.push_back(op);
+  }
+
+  // Constants are considered cheapest first, and the set of the cheapest
+  // constants that saves the most area over using a multiplier for each is
+  // lowered. The rest are left as multipliers
+  int numLowered = 0, numKept = 0, numAdders = 0;
+  for (auto &group : constMulGroups) {
+    IntegerType *valueType = GetIntType(group.value);
+    int width = valueType->width + (valueType->is_signed ? 0 : 1);
+    stable_sort(group.constants.begin(), group.constants.end(),
+                [](int64_t a, int64_t b) {
+                  return ShiftAddNetwork::GetCSDWeight(a) <
+                         ShiftAddNetwork::GetCSDWeight(b);
+                });
+    double multiplierArea = 0, bestSaving = 0;
+    size_t bestCount = 0;
+    for (size_t n = 1; n <= group.constants.size(); n++) {
+      int64_t c = group.constants.at(n - 1);
+      multiplierArea += timing->GetMultiplierArea(
+          valueType->width, ValueRange::FromInterval(c, c).GetMinWidth(c < 0));
+      ShiftAddNetwork network(vector<int64_t>(group.constants.begin(),
+                                              group.constants.begin() + n));
+      double saving = multiplierArea - GetNetworkArea(timing, network, width);
+      if (saving >= bestSaving) {
+        bestSaving = saving;
+        bestCount = n;
+      }
+    }
+    group.constants.resize(bestCount);
+    group.network = new ShiftAddNetwork(group.constants);
+    numAdders += group.network->GetNumAdders();
+  }
+  for (auto mul : multiplies) {
+    ConstMultiplyGroup &group = constMulGroups.at(mul.second.first);
+    auto index =
+        find(group.constants.begin(), group.constants.end(), mul.second.second);
+    if (index != group.constants.end()) {
+      constMultiplies[mul.first] =
+          make_pair(mul.second.first, int(index - group.constants.begin()));
+      numLowered++;
+    } else {
+      numKept++;
+    }
+  }
+  if (numLowered > 0)
+    for (auto &var : block->vars)
+      var.second = Lower(var.second);
+  PrintMessage(MSG_DEBUG, "lowered " + to_string(numLowered) +
+                              " constant multiplies using " +
+                              to_string(numAdders) + " adders, kept " +
+                              to_string(numKept) + " as multipliers");
+}
+
+EvalObject *EvalOptimiser::Lower(EvalObject *obj) {
+  auto existing = lowered.find(obj);
+  if (existing != lowered.end())
+    return existing->second;
+
+  int oldLine = EvalObject::currentSourceLine;
+  EvalObject::currentSourceLine = obj->sourceLine;
+  EvalObject *result;
+  auto mul = constMultiplies.find(obj);
+  if (mul != constMultiplies.end()) {
+    result = CastTo(GetIntType(obj),
+                    BuildConstMultiply(constMulGroups.at(mul->second.first),
+                                       mul->second.second));
+  } else {
+    vector<EvalObject *> operands = obj->GetOperands(), newOperands;
+    transform(operands.begin(), operands.end(), back_inserter(newOperands),
+              [this](EvalObject *o) { return Lower(o); });
+    result =
+        (newOperands != operands) ? obj->ReplaceOperands(newOperands) : obj;
+  }
+  EvalObject::currentSourceLine = oldLine;
+  lowered[obj] = result;
+  return result;
+}
+
+// Return an object shifted left by a constant amount
+static EvalObject *ShiftLeft(EvalObject *obj, int shift) {
+  if (shift == 0)
+    return obj;
+  return EvalBasicOperation::Create(
+      B_LS, vector<EvalObject *>{obj, EvalConstant::Create(BitConstant(shift))});
+}
+
+EvalObject *EvalOptimiser::BuildConstMultiply(ConstMultiplyGroup &group,
+                                              int index) {
+  ShiftAddNetwork *network = group.network;
+  if (group.fundamentals.empty()) {
+    // Fundamentals are built as signed values, as they may be subtracted, and
+    // each is given a type just wide enough to hold it
+    IntegerType *valueType = GetIntType(group.value);
+    int width = valueType->width + (valueType->is_signed ? 0 : 1);
+    group.fundamentals.push_back(
+        CastTo(new IntegerType(width, true), Lower(group.value)));
+    for (size_t i = 0; i < network->steps.size(); i++) {
+      const ShiftAddNetwork::Step &step = network->steps.at(i);
+      int64_t f = network->fundamentals.at(i + 1);
+      EvalObject *sum = EvalBasicOperation::Create(
+          step.subtract ? B_SUB : B_ADD,
+          vector<EvalObject *>{
+              ShiftLeft(group.fundamentals.at(step.a), step.shiftA),
+              ShiftLeft(group.fundamentals.at(step.b), step.shiftB)});
+      group.fundamentals.push_back(CastTo(
+          new IntegerType(width +
+                              ValueRange::FromInterval(f, f).GetMinWidth(false),
+                          true),
+          sum));
+    }
+  }
+  const ShiftAddNetwork::Output &out = network->outputs.at(index);
+  EvalObject *result = group.fundamentals.at(out.fundamental);
+  if (out.negate)
+    result =
+        EvalBasicOperation::Create(U_MINUS, vector<EvalObject *>{result});
+  return ShiftLeft(result, out.shift);
+}
+
+ValueRange EvalOptimiser::GetRange(EvalObject *obj) {
+  auto cached = ranges.find(obj);
+  if (cached != ranges.end())
+    return cached->second;
+  IntegerType *type = GetIntType(obj);
+  ValueRange range;
+  if (type != nullptr)
+    range = GetExactRange(obj).Cast(type->width, type->is_signed);
+  ranges[obj] = range;
+  return range;
+}
+
+ValueRange EvalOptimiser::GetExactRange(EvalObject *obj) {
+  vector<EvalObject *> operands = obj->GetOperands();
+  vector<ValueRange> opRanges;
+  transform(operands.begin(), operands.end(), back_inserter(opRanges),
+            [this](EvalObject *o) { return GetRange(o); });
+  EvalConstant *constant = GetConstOperand(obj);
+  EvalBasicOperation *oper = dynamic_cast<EvalBasicOperation *>(obj);
+  EvalSpecialOperation *special = dynamic_cast<EvalSpecialOperation *>(obj);
+  if (constant != nullptr) {
+    return ValueRange::FromConstant(constant->GetScalarConstValue(state));
+  } else if (dynamic_cast<EvalCast *>(obj) != nullptr) {
+    return opRanges.at(0);
+  } else if (oper != nullptr) {
+    return PerformRangeOperation(opRanges, oper->GetOperationType());
+  } else if (special != nullptr) {
+    switch (special->type) {
+    case SpecialOperationType::T_COND:
+      return opRanges.at(1).Union(opRanges.at(2));
+    case SpecialOperationType::ARRAY_SEL: {
+      ValueRange r = opRanges.at(0);
+      for (size_t i = 1; i < opRanges.size() - 1; i++)
+        r = r.Union(opRanges.at(i));
+      return r;
+    }
+    case SpecialOperationType::ARRAY_WRITE:
+      return opRanges.at(0).Union(opRanges.at(1));
+    case SpecialOperationType::MULTI_ADD: {
+      ValueRange r = opRanges.at(0);
+      for (size_t i = 1; i < opRanges.size(); i++)
+        r = PerformRangeOperation({r, opRanges.at(i)}, B_ADD);
+      return r;
+    }
+    }
+  }
+  // Anything else, such as an input, can take any value of its type
+  return ValueRange();
+}
+
+bool EvalOptimiser::IsExact(EvalObject *obj) {
+  IntegerType *type = GetIntType(obj);
+  if ((type == nullptr) || !GetExactRange(obj).FitsIn(type->width,
+                                                      type->is_signed))
+    return false;
+  // Bitwise operations reinterpret the bits of operands that do not fit in
+  // the result type, rather than converting their values
+  EvalBasicOperation *oper = dynamic_cast<EvalBasicOperation *>(obj);
+  if ((oper != nullptr) && ((oper->GetOperationType() == B_BWAND) ||
+                            (oper->GetOperationType() == B_BWOR) ||
+                            (oper->GetOperationType() == B_BWXOR))) {
+    for (auto op : oper->GetOperands())
+      if (!GetRange(op).FitsIn(type->width, type->is_signed))
+        return false;
+  }
+  return true;
+}
+
+EvalObject *EvalOptimiser::Narrow(EvalObject *obj) {
+  auto existing = narrowed.find(obj);
+  if (existing != narrowed.end())
+    return existing->second;
+
+  int oldLine = EvalObject::currentSourceLine;
+  EvalObject::currentSourceLine = obj->sourceLine;
+  vector<EvalObject *> operands = obj->GetOperands(), newOperands;
+  transform(operands.begin(), operands.end(), back_inserter(newOperands),
+            [this](EvalObject *o) { return Narrow(o); });
+
+  // Narrowed operands keep their values but not their types, so they can only
+  // be used directly by operations that remain exact with the new types
+  IntegerType *type = GetIntType(obj);
+  EvalSpecialOperation *special = dynamic_cast<EvalSpecialOperation *>(obj);
+  bool is_select = (special != nullptr) &&
+                   ((special->type == SpecialOperationType::T_COND) ||
+                    (special->type == SpecialOperationType::ARRAY_SEL));
+  bool can_narrow =
+      (type != nullptr) &&
+      ((dynamic_cast<EvalBasicOperation *>(obj) != nullptr) ||
+       (dynamic_cast<EvalCast *>(obj) != nullptr) || is_select ||
+       ((special != nullptr) &&
+        (special->type == SpecialOperationType::MULTI_ADD))) &&
+      IsExact(obj);
+  EvalObject *result = nullptr;
+  EvalCast *cast = dynamic_cast<EvalCast *>(obj);
+  if (cast != nullptr) {
+    // A cast only depends on the value of its operand, not its type, so any
+    // exact cast to a narrower type before it is not needed
+    EvalObject *operand = newOperands.at(0);
+    EvalCast *inner = dynamic_cast<EvalCast *>(operand);
+    if ((inner != nullptr) && IsExact(inner))
+      operand = inner->GetOperands().at(0);
+    result = CastTo(type, operand);
+  } else if (can_narrow && is_select) {
+    // Values selected between are converted to the smallest type that holds
+    // any of them, rather than to the type of the first
+    IntegerType *selType =
+        new IntegerType(GetRange(obj).GetMinWidth(type->is_signed),
+                        type->is_signed);
+    bool is_cond = (special->type == SpecialOperationType::T_COND);
+    size_t first = is_cond ? 1 : 0,
+           last = is_cond ? newOperands.size() : (newOperands.size() - 1);
+    for (size_t i = first; i < last; i++)
+      newOperands.at(i) = CastTo(selType, newOperands.at(i));
+    result = obj->ReplaceOperands(newOperands);
+  } else if (can_narrow) {
+    result = obj->ReplaceOperands(newOperands);
+    if (!IsExact(result))
+      result = nullptr;
+  }
+  if (result == nullptr) {
+    // Convert operands back to their original types, giving an operation
+    // equivalent to the original
+    for (size_t i = 0; i < operands.size(); i++) {
+      IntegerType *opType = GetIntType(operands.at(i));
+      if (opType != nullptr)
+        newOperands.at(i) = CastTo(opType, newOperands.at(i));
+    }
+    result =
+        (newOperands != operands) ? obj->ReplaceOperands(newOperands) : obj;
+  }
+
+  // The result itself is held in a narrower type if its range allows
+  if (can_narrow) {
+    int width = GetRange(result).GetMinWidth(type->is_signed);
+    if ((width != -1) && (width < GetIntType(result)->width)) {
+      IntegerType *narrowType = new IntegerType(width, type->is_signed);
+      numNarrowed++;
+      EvalCast *resultCast = dynamic_cast<EvalCast *>(result);
+      result = CastTo(narrowType, (resultCast != nullptr)
+                                      ? resultCast->GetOperands().at(0)
+                                      : result);
+    }
+  }
+  EvalObject::currentSourceLine = oldLine;
+  narrowed[obj] = result;
+  return result;
+}
+
+static bool IsAssociative(OperationType type) {
+  return (type == B_ADD) || (type == B_BWXOR) || (type == B_BWAND) ||
+         (type == B_BWOR);
+}
+
+EvalBasicOperation *EvalOptimiser::GetChainOperation(EvalObject *obj) {
+  EvalCast *cast = dynamic_cast<EvalCast *>(obj);
+  if (cast != nullptr)
+    obj = cast->GetOperands().at(0);
+  EvalBasicOperation *oper = dynamic_cast<EvalBasicOperation *>(obj);
+  if ((oper == nullptr) || !IsAssociative(oper->GetOperationType()))
+    return nullptr;
+  return oper;
+}
+
+EvalObject *EvalOptimiser::Rebalance(EvalObject *obj) {
+  auto existing = rebalanced.find(obj);
+  if (existing != rebalanced.end())
+    return existing->second;
+
+  int oldLine = EvalObject::currentSourceLine;
+  EvalObject::currentSourceLine = obj->sourceLine;
+  EvalObject *result = nullptr;
+  if (GetChainOperation(obj) != nullptr)
+    result = RebalanceChain(obj);
+  if (result == nullptr) {
+    vector<EvalObject *> operands = obj->GetOperands(), newOperands;
+    transform(operands.begin(), operands.end(), back_inserter(newOperands),
+              [this](EvalObject *o) { return Rebalance(o); });
+    if (newOperands != operands)
+      result = obj->ReplaceOperands(newOperands);
+    else
+      result = obj;
+  }
+  EvalObject::currentSourceLine = oldLine;
+  rebalanced[obj] = result;
+  return result;
+}
+
+void EvalOptimiser::CollectLeaves(EvalObject *obj, OperationType type,
+                                  int width, bool is_root,
+                                  vector<EvalObject *> &leaves) {
+  // Nodes used elsewhere must be kept, so are treated as leaves
+  if (is_root || (useCount[obj] == 1)) {
+    EvalCast *cast = dynamic_cast<EvalCast *>(obj);
+    EvalBasicOperation *oper = dynamic_cast<EvalBasicOperation *>(obj);
+    IntegerType *objType = GetIntType(obj);
+    if ((cast != nullptr) && (objType != nullptr) &&
+        (objType->width >= width)) {
+      // Truncation does not affect the least significant bits of the result,
+      // and neither does extension of an operand that is already wide enough
+      EvalObject *inner = cast->GetOperands().at(0);
+      EvalBasicOperation *innerOper = dynamic_cast<EvalBasicOperation *>(inner);
+      IntegerType *innerType = GetIntType(inner);
+      if (((innerOper != nullptr) && (innerOper->GetOperationType() == type)) ||
+          ((innerType != nullptr) && (innerType->width >= width))) {
+        CollectLeaves(inner, type, width, false, leaves);
+        return;
+      }
+    } else if ((oper != nullptr) && (oper->GetOperationType() == type) &&
+               (objType != nullptr)) {
+      // A narrower operation can only be flattened if its result is exact,
+      // which is the case if no operands need to change signedness
+      vector<EvalObject *> operands = oper->GetOperands();
+      bool exact = all_of(operands.begin(), operands.end(),
+                          [this, objType](EvalObject *o) {
+                            IntegerType *t = GetIntType(o);
+                            return (t != nullptr) &&
+                                   (t->is_signed == objType->is_signed);
+                          });
+      if (is_root || (objType->width >= width) || exact) {
+        for (auto o : operands)
+          CollectLeaves(o, type, width, false, leaves);
+        return;
+      }
+    }
+  }
+  leaves.push_back(obj);
+}
+
+EvalObject *EvalOptimiser::RebalanceChain(EvalObject *root) {
+  OperationType type = GetChainOperation(root)->GetOperationType();
+  IntegerType *rootType = GetIntType(root);
+  if (rootType == nullptr)
+    return nullptr;
+  vector<EvalObject *> leaves;
+  CollectLeaves(root, type, rootType->width, true, leaves);
+  // A chain of two operations or fewer gains nothing from rebalancing
+  if (leaves.size() < 3)
+    return nullptr;
+
+  // Leaves are converted to a common signedness, so that every operation in
+  // the new tree is exact
+  bool any_signed = false;
+  for (auto &leaf : leaves) {
+    leaf = Rebalance(leaf);
+    any_signed |= GetIntType(leaf)->is_signed;
+  }
+  for (auto &leaf : leaves) {
+    IntegerType *leafType = GetIntType(leaf);
+    if (any_signed && !leafType->is_signed)
+      leaf = EvalCast::Create(new IntegerType(leafType->width + 1, true), leaf);
+  }
+
+  // Combine all constant leaves into one
+  vector<EvalObject *> variable;
+  BitConstant constant;
+  bool has_constant = false;
+  for (auto leaf : leaves) {
+    if (leaf->HasConstantValue(state)) {
+      BitConstant value = leaf->GetScalarConstValue(state);
+      constant = has_constant ? PerformConstOperation({constant, value}, type)
+                              : value;
+      has_constant = true;
+    } else {
+      variable.push_back(leaf);
+    }
+  }
+  // Zero is the identity of all but &
+  if (has_constant && !(constant.is_zero() && (type != B_BWAND)))
+    variable.push_back(EvalConstant::Create(constant));
+  if (variable.empty())
+    variable.push_back(EvalConstant::Create(BitConstant(0)));
+
+  EvalObject *tree =
+      (type == B_ADD) ? BuildSum(variable) : BuildTree(type, variable);
+  IntegerType *treeType = GetIntType(tree);
+  if ((treeType->width == rootType->width) &&
+      (treeType->is_signed == rootType->is_signed))
+    return tree;
+  else
+    return EvalCast::Create(rootType, tree);
+}
+
+EvalObject *EvalOptimiser::BuildTree(OperationType type,
+                                     const vector<EvalObject *> &leaves) {
+  vector<EvalObject *> level = leaves;
+  while (level.size() > 1) {
+    vector<EvalObject *> next;
+    for (size_t i = 0; i < level.size(); i += 2) {
+      if ((i + 1) < level.size())
+        next.push_back(EvalBasicOperation::Create(
+            type, vector<EvalObject *>{level.at(i), level.at(i + 1)}));
+      else
+        next.push_back(level.at(i));
+    }
+    level = next;
+  }
+  return level.at(0);
+}
+
+EvalObject *EvalOptimiser::BuildSum(const vector<EvalObject *> &leaves) {
+  if (use_dsps) {
+    vector<EvalObject *> products, others;
+    for (auto leaf : leaves)
+      (IsDSPProduct(leaf) ? products : others).push_back(leaf);
+    // Anything else is summed first, giving the initial value of the chain
+    if (!products.empty() && !others.empty())
+      return BuildMACChain(BuildSum(others), products);
+    if (products.size() >= 2)
+      return BuildMACChain(products.front(),
+                           vector<EvalObject *>(products.begin() + 1,
+                                                products.end()));
+  }
+  if (leaves.size() < 3)
+    return BuildTree(B_ADD, leaves);
+  if (int(leaves.size()) <= maxCompressorInputs) {
+    EvalObject *sum =
+        EvalSpecialOperation::Create(SpecialOperationType::MULTI_ADD, leaves);
+    // Bits of the sum that are always copies of the sign need not be computed
+    IntegerType *sumType = GetIntType(sum);
+    int width = GetRange(sum).GetMinWidth(sumType->is_signed);
+    if ((width != -1) && (width < sumType->width))
+      sum = EvalSpecialOperation::Create(SpecialOperationType::MULTI_ADD,
+                                         leaves, {BitConstant(width)});
+    return sum;
+  }
+  // Split into evenly sized groups, then sum the results of the groups
+  int groups = (int(leaves.size()) + maxCompressorInputs - 1) /
+               maxCompressorInputs;
+  vector<EvalObject *> groupSums;
+  for (int i = 0; i < groups; i++) {
+    size_t start = (leaves.size() * i) / groups,
+           end = (leaves.size() * (i + 1)) / groups;
+    groupSums.push_back(BuildSum(vector<EvalObject *>(
+        leaves.begin() + start, leaves.begin() + end)));
+  }
+  return BuildSum(groupSums);
+}
+
+bool EvalOptimiser::IsDSPProduct(EvalObject *obj) {
+  if (dynamic_cast<EvalCast *>(obj) != nullptr)
+    obj = obj->GetOperands().at(0);
+  EvalBasicOperation *oper = dynamic_cast<EvalBasicOperation *>(obj);
+  if ((oper == nullptr) || (oper->GetOperationType() != B_MUL))
+    return false;
+  vector<int> widths;
+  for (auto operand : oper->GetOperands()) {
+    IntegerType *type = GetIntType(operand);
+    if (type == nullptr)
+      return false;
+    widths.push_back(type->width + (type->is_signed ? 0 : 1));
+  }
+  return timing->UseDSPForMultiply(widths.at(0), widths.at(1));
+}
+
+EvalObject *EvalOptimiser::BuildMACChain(EvalObject *initial,
+                                        const vector<EvalObject *> &products) {
+  EvalObject *sum = initial;
+  for (auto product : products) {
+    sum = EvalBasicOperation::Create(B_ADD,
+                                     vector<EvalObject *>{sum, product});
+    IntegerType *sumType = GetIntType(sum);
+    int width = GetRange(sum).GetMinWidth(sumType->is_signed);
+    if ((width != -1) && (width < sumType->width))
+      sum = CastTo(new IntegerType(width, sumType->is_signed), sum);
+  }
+  return sum;
+}
+
+void EvalOptimiser::FindMemoryRanges() {
+  // Reads are also made by writes to a memory, which give nothing referenced
+  // by another variable and need no port. Inputs' own values refer to
+  // themselves, so are not counted
+  set<EvaluatorVariable *> referenced;
+  set<EvalObject *> visited;
+  vector<EvalObject *> worklist;
+  for (auto var : block->vars) {
+    EvalVariable *ref = dynamic_cast<EvalVariable *>(var.second);
+    if ((ref != nullptr) && (ref->GetVariable() == var.first))
+      continue;
+    if (visited.insert(var.second).second)
+      worklist.push_back(var.second);
+  }
+  while (!worklist.empty()) {
+    EvalObject *obj = worklist.back();
+    worklist.pop_back();
+    EvalVariable *ref = dynamic_cast<EvalVariable *>(obj);
+    if (ref != nullptr)
+      referenced.insert(ref->GetVariable());
+    for (auto op : obj->GetOperands())
+      if (visited.insert(op).second)
+        worklist.push_back(op);
+  }
+
+  for (auto var : state->GetAllVariables()) {
+    ExternalMemoryEvaluatorVariable *mem =
+        dynamic_cast<ExternalMemoryEvaluatorVariable *>(var);
+    if (mem == nullptr)
+      continue;
+    for (auto &access : mem->GetAccesses()) {
+      access.used = (access.q == nullptr) ||
+                    (referenced.find(access.q) != referenced.end());
+      auto value = block->vars.find(access.address);
+      if (value != block->vars.end())
+        access.range = GetRange(value->second);
+      PrintMessage(MSG_DEBUG, "address ===" + access.address->name +
+                                  "=== has range " + access.range.to_string());
+    }
+  }
+}
+
+} // namespace ElasticC
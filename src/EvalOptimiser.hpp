@@ -0,0 +1,145 @@
+#pragma once
+#include "DataTypes.hpp"
+#include "EvalObject.hpp"
+#include "EvaluatorState.hpp"
+#include "Evaluator.hpp"
+#include "Operations.hpp"
+#include "ShiftAddNetwork.hpp"
+#include "ValueRange.hpp"
+#include "timing/DeviceTiming.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace ElasticC {
+/*
+Optimisations applied to the EvalObject graph of an evaluated block before it
+is converted to a netlist. As EvalObjects may be interned and shared, the graph
+is never modified in place: optimised objects are rebuilt and replace the
+values of the block's variables.
+
+The passes are, in order:
+ - removal of variables that no output depends on
+ - simplification using a table of rewrite rules (constant folding, algebraic
+   identities, strength reduction, cast fusion and conditional collapsing),
+   applied bottom up until no rule matches
+ - lowering of multiplies by constants to networks of shifts and adders,
+   shared between all the constants that multiply the same value, where the
+   timing model estimates this is smaller than using multipliers
+ - narrowing of values to the smallest type that holds their range of values,
+   found by a range analysis over the graph
+ - rebalancing of chains of associative operations (+, ^, &, |), such as those
+   produced by reduction loops, into balanced trees so that logic depth grows
+   with the logarithm of the chain length rather than linearly. Wide sums are
+   instead built from carry-save compressor trees, except that when multiplies
+   are mapped to DSP blocks sums of products are built as chains, so that each
+   addition uses the post-adder of the DSP block computing its product
+ - recording the range of each memory address, so that accesses to a
+   partitioned memory whose bank is known need only a port in that bank
+*/
+class EvalOptimiser {
+public:
+  // If use_dsps is set, multiplies will be mapped to the DSP blocks described
+  // by the timing model
+  EvalOptimiser(EvaluatedBlock *_block, DeviceTiming *_timing,
+                bool _use_dsps = false);
+  void Run();
+
+private:
+  EvaluatedBlock *block;
+  Evaluator *state;
+  DeviceTiming *timing;
+  bool use_dsps;
+  // Number of references to each object, from other objects or variables
+  map<EvalObject *, int> useCount;
+  map<EvalObject *, EvalObject *> simplified, lowered, narrowed, rebalanced;
+  map<EvalObject *, IntegerType *> intTypes;
+  map<EvalObject *, ValueRange> ranges;
+  int numNarrowed = 0;
+
+  // Largest number of inputs to a single compressor tree. Larger sums are split
+  // into several trees, giving the pipeliner somewhere to insert registers
+  const int maxCompressorInputs = 4;
+
+  // A rewrite rule, returning a simpler object equivalent to an object of
+  // scalar integer type, or nullptr if the rule does not apply
+  struct Rule {
+    string name;
+    EvalObject *(EvalOptimiser::*apply)(EvalObject *obj, IntegerType *type);
+  };
+  static const vector<Rule> rules;
+  // Number of times each rule has been applied
+  map<string, int> ruleCount;
+
+  void RemoveDeadValues();
+  void CountUses();
+  // Return the type of an object if it is a scalar integer, otherwise nullptr
+  IntegerType *GetIntType(EvalObject *obj);
+  // Return an object with the value of obj, cast to the given type if needed
+  EvalObject *CastTo(IntegerType *type, EvalObject *obj);
+
+  EvalObject *Simplify(EvalObject *obj);
+  EvalObject *FoldConstants(EvalObject *obj, IntegerType *type);
+  EvalObject *ApplyIdentities(EvalObject *obj, IntegerType *type);
+  EvalObject *ReduceStrength(EvalObject *obj, IntegerType *type);
+  EvalObject *FuseCasts(EvalObject *obj, IntegerType *type);
+  EvalObject *CollapseConditionals(EvalObject *obj, IntegerType *type);
+  EvalObject *FoldSelects(EvalObject *obj, IntegerType *type);
+
+  // Multiplies by constants that share a variable operand, and the network
+  // replacing them
+  struct ConstMultiplyGroup {
+    EvalObject *value;
+    vector<int64_t> constants;
+    ShiftAddNetwork *network = nullptr;
+    vector<EvalObject *> fundamentals;
+  };
+  vector<ConstMultiplyGroup> constMulGroups;
+  // Group and index of the constant for each multiply that is lowered
+  map<EvalObject *, pair<int, int>> constMultiplies;
+
+  // Return whether an object is a multiply of a variable value by a constant,
+  // setting value and constant if it is
+  bool IsConstMultiply(EvalObject *obj, EvalObject *&value, int64_t &constant);
+  void LowerConstMultiplies();
+  EvalObject *Lower(EvalObject *obj);
+  // Return the product of a group's value and one of its constants, built
+  // using its network
+  EvalObject *BuildConstMultiply(ConstMultiplyGroup &group, int index);
+
+  // Return the range of values an object may take
+  ValueRange GetRange(EvalObject *obj);
+  // Return the range of the exact value of an operation, before conversion to
+  // the result type of the operation
+  ValueRange GetExactRange(EvalObject *obj);
+  // Whether an operation gives its exact result, with no operands changing
+  // value when converted to the type used to compute it and no overflow
+  bool IsExact(EvalObject *obj);
+  EvalObject *Narrow(EvalObject *obj);
+
+  // Return the associative operation at the root of a possible chain, or
+  // nullptr if obj is not one
+  EvalBasicOperation *GetChainOperation(EvalObject *obj);
+  EvalObject *Rebalance(EvalObject *obj);
+  // Rebuild a chain of associative operations rooted at root, which may be
+  // wrapped in a cast. Returns nullptr if it is not worth rebuilding
+  EvalObject *RebalanceChain(EvalObject *root);
+  // Add the leaves of a chain of operations to a list, such that combining
+  // the leaves gives the same result as obj in its least significant width bits
+  void CollectLeaves(EvalObject *obj, OperationType type, int width,
+                     bool is_root, vector<EvalObject *> &leaves);
+  EvalObject *BuildTree(OperationType type, const vector<EvalObject *> &leaves);
+  EvalObject *BuildSum(const vector<EvalObject *> &leaves);
+  // Whether an object is a product, possibly cast, that will be mapped to a
+  // DSP block
+  bool IsDSPProduct(EvalObject *obj);
+  // Add a list of DSP products onto a value one at a time, narrowing each
+  // partial sum to the width its range needs
+  EvalObject *BuildMACChain(EvalObject *initial,
+                            const vector<EvalObject *> &products);
+
+  void FindMemoryRanges();
+};
+} // namespace ElasticC
@@ -44,8 +44,8 @@ EvaluatorVariable *Evaluator::AddVariable(Parser::Variable *orig,
 
   VariableDir dir{is_block_input, is_block_output,
                   is_block_input || is_block_output};
-  EvaluatorVariable *var =
-      EvaluatorVariable::Create(dir, uname, type, is_static);
+  EvaluatorVariable *var = CreateVariable(dir, uname, type, is_static);
+  var->attributes = orig->attributes;
   AddVariable(var, orig);
   if (is_const) {
     if (init == EvalNull) {
@@ -58,12 +58,21 @@ EvaluatorVariable *Evaluator::AddVariable(Parser::Variable *orig,
       init = init->GetConstantValue(this);
     }
   }
-  if (init != EvalNull) {
+  // A static variable's initialiser gives the value it holds before it is
+  // first written, rather than a value written every cycle
+  if ((init != EvalNull) && is_static) {
+    var->SetInitialValue(this, init);
+  } else if (init != EvalNull) {
     SetVariableValue(var, init);
   }
   return var;
 }
 
+EvaluatorVariable *Evaluator::CreateVariable(VariableDir dir, string name,
+                                             DataType *type, bool is_static) {
+  return EvaluatorVariable::Create(dir, name, type, is_static);
+}
+
 vector<EvaluatorVariable *> Evaluator::GetAllVariables() {
   return allVariables;
 }
@@ -124,13 +133,11 @@ EvalObject *Evaluator::ProcessFunctionCall(
   parserVariables = cse->savedParserVariables;
   tpContext = cse->oldTpContext;
 
-  if (func->is_void) {
-    return EvalNull;
-  } else {
-    return GetVariableValue(cse->returnValue);
-  }
-
-  // TODO: delete cse?
+  EvalObject *result = EvalNull;
+  if (!func->is_void)
+    result = GetVariableValue(cse->returnValue);
+  delete cse;
+  return result;
 };
 
 BitConstant TemplateParamContext::GetNumericParameter(Evaluator *eval,
@@ -211,6 +218,9 @@ void SingleCycleEvaluator::AddVariable(EvaluatorVariable *var) {
   Evaluator::AddVariable(var);
   if (var->GetDir().is_input) {
     currentVariableValues[var] = GetInputValue(var);
+  } else if (var->HasDefaultValue()) {
+    // e.g. write enables, which are only set where a write happens
+    currentVariableValues[var] = EvalConstant::Create(var->GetDefaultValue());
   } else {
     currentVariableValues[var] = new EvalDontCare(var->GetType());
   }
@@ -218,8 +228,6 @@ void SingleCycleEvaluator::AddVariable(EvaluatorVariable *var) {
 
 void SingleCycleEvaluator::SetVariableValue(EvaluatorVariable *var,
                                             EvalObject *value) {
-  pair<EvalObject *&, int> toInsertCond =
-      FindFirstNotMatchingConds(currentVariableValues[var], 0);
   IntegerType *intt = dynamic_cast<IntegerType *>(var->GetType());
   EvalObject *castValue;
   if (var->GetType()->Equals(value->GetDataType(this))) {
@@ -231,30 +239,19 @@ void SingleCycleEvaluator::SetVariableValue(EvaluatorVariable *var,
           "cannot convert type ===" + value->GetDataType(this)->GetName() +
           "=== to ===" + var->GetType()->GetName());
     } else {
-      castValue = new EvalCast(intt, value);
+      castValue = EvalCast::Create(intt, value);
     }
   }
 
-  EvalObject *conditionalValue = castValue;
-  // process conditions
-  for (int i = conditions.size() - 1; i >= toInsertCond.second; i--) {
-    if (conditions[i].second) {
-      conditionalValue = new EvalSpecialOperation(
-          SpecialOperationType::T_COND,
-          vector<EvalObject *>{conditions[i].first, conditionalValue,
-                               new EvalDontCare(var->GetType())});
-
-    } else {
-      conditionalValue = new EvalSpecialOperation(
-          SpecialOperationType::T_COND,
-          vector<EvalObject *>{conditions[i].first, new EvalDontCare(var->GetType()),
-                               conditionalValue});
-    }
-  }
-  toInsertCond.first = conditionalValue;
+  currentVariableValues[var] =
+      InsertConditionalValue(currentVariableValues[var], castValue, 0);
 }
 
 void SingleCycleEvaluator::EvaluateStatement(Parser::Statement *stmt) {
+  // Attribute EvalObjects created to the innermost statement
+  int outerLine = EvalObject::currentSourceLine;
+  if ((stmt != Parser::NullStatement) && (stmt->codeLine != -1))
+    EvalObject::currentSourceLine = stmt->codeLine;
   try {
 
     Parser::VariableDeclaration *vardec;
@@ -268,7 +265,7 @@ void SingleCycleEvaluator::EvaluateStatement(Parser::Statement *stmt) {
         nullptr) {
       // Variable declaration
       for (auto var : vardec->declaredVariables) {
-        Evaluator::AddVariable(var);
+        AddVariable(var);
       }
     } else if ((blk = dynamic_cast<Parser::Block *>(stmt)) != nullptr) {
       // Block
@@ -315,6 +312,7 @@ void SingleCycleEvaluator::EvaluateStatement(Parser::Statement *stmt) {
   } catch (eval_error &e) {
     PrintMessage(MSG_ERROR, e.what(), stmt->codeLine);
   }
+  EvalObject::currentSourceLine = outerLine;
 }
 
 void SingleCycleEvaluator::EvaluateBlock(Parser::HardwareBlock *block) {
@@ -345,11 +343,11 @@ SingleCycleEvaluator::EvaluateExpression(Parser::Expression *expr,
               [this, tpctx](Parser::Expression *exp) {
                 return EvaluateExpression(exp, tpctx);
               });
-    return (new EvalBasicOperation(bop->operType, evalOperands))
+    return EvalBasicOperation::Create(bop->operType, evalOperands)
         ->ApplyToState(this)
         ->GetValue(this);
   } else if ((lit = dynamic_cast<Parser::Literal *>(expr)) != nullptr) {
-    return new EvalConstant(lit->value);
+    return EvalConstant::Create(lit->value);
   } else if ((vart = dynamic_cast<Parser::VariableToken *>(expr)) != nullptr) {
     if (parserVariables.find(vart->var) != parserVariables.end()) {
       return new EvalVariable(parserVariables.at(vart->var));
@@ -362,7 +360,7 @@ SingleCycleEvaluator::EvaluateExpression(Parser::Expression *expr,
       ConstantParser cp(gs);
       // TODO: const arrays
       BitConstant cnstVal = cp.ParseConstexpr(vart->var->initialiser);
-      return new EvalConstant(cnstVal);
+      return EvalConstant::Create(cnstVal);
     }
   } else if ((arrs = dynamic_cast<Parser::ArraySubscript *>(expr)) != nullptr) {
     vector<EvalObject *> evalIndex;
@@ -407,9 +405,8 @@ SingleCycleEvaluator::EvaluateExpression(Parser::Expression *expr,
         throw eval_error("cannot call __min on non-integer");
       }
       if (it->is_signed) { // signed min is 0b1000...
-        value.bits.resize(it->width);
-        value.bits.back() = true;
-        value.is_signed = true;
+        value = BitConstant(0).cast(it->width, true);
+        value.set_bit(it->width - 1, true);
       } else { // unsigned min is 0
         value = BitConstant(0);
         value.is_signed = false;
@@ -420,22 +417,20 @@ SingleCycleEvaluator::EvaluateExpression(Parser::Expression *expr,
         throw eval_error("cannot call __max on non-integer");
       }
       if (it->is_signed) { // signed max is 0b0111...
-        value.bits.resize(it->width, true);
-        value.bits.back() = false;
-        value.is_signed = true;
+        value = InvertBits(BitConstant(0).cast(it->width, true));
+        value.set_bit(it->width - 1, false);
       } else { // unsigned max is 0b1111...
-        value.bits.resize(it->width, true);
-        value.is_signed = false;
+        value = InvertBits(BitConstant(0).cast(it->width, false));
       }
     }
-    return new EvalConstant(value);
+    return EvalConstant::Create(value);
   } else if ((tpt = dynamic_cast<Parser::TemplateParamToken *>(expr)) !=
              nullptr) {
     if (tpctx == nullptr)
-      return new EvalConstant(
+      return EvalConstant::Create(
           tpContext->GetNumericParameter(this, tpt->pcontext, tpt->index));
     else
-      return new EvalConstant(
+      return EvalConstant::Create(
           tpctx->GetNumericParameter(this, tpt->pcontext, tpt->index));
   } else if (expr == Parser::NullExpression) {
     return EvalNull;
@@ -445,21 +440,24 @@ SingleCycleEvaluator::EvaluateExpression(Parser::Expression *expr,
   }
 };
 
-pair<EvalObject *&, int>
-SingleCycleEvaluator::FindFirstNotMatchingConds(EvalObject *&value, int index) {
+EvalObject *SingleCycleEvaluator::InsertConditionalValue(EvalObject *existing,
+                                                         EvalObject *value,
+                                                         int index) {
   if (index >= conditions.size())
-    return pair<EvalObject *&, int>(value, index); // end of the condition stack
-  EvalSpecialOperation *eso = dynamic_cast<EvalSpecialOperation *>(value);
-  if ((eso == nullptr) || (eso->type != SpecialOperationType::T_COND))
-    return pair<EvalObject *&, int>(value, index); // not a conditional at all
-  if (eso->GetOperands()[0] != conditions[index].first)
-    return pair<EvalObject *&, int>(value, index); // conditions do not match
-
-  // is a match, just follow the right branch
-  if (conditions[index].second)
-    return FindFirstNotMatchingConds(eso->GetOperandsByRef()[1], index + 1);
-  else
-    return FindFirstNotMatchingConds(eso->GetOperandsByRef()[2], index + 2);
+    return value; // end of the condition stack
+  vector<EvalObject *> operands;
+  EvalSpecialOperation *eso = dynamic_cast<EvalSpecialOperation *>(existing);
+  if ((eso != nullptr) && (eso->type == SpecialOperationType::T_COND) &&
+      (eso->GetOperands()[0] == conditions[index].first)) {
+    // is a match, just follow the right branch
+    operands = eso->GetOperands();
+  } else {
+    // doesn't match, so the existing value is kept when the condition fails
+    operands = {conditions[index].first, existing, existing};
+  }
+  int branch = conditions[index].second ? 1 : 2;
+  operands[branch] = InsertConditionalValue(operands[branch], value, index + 1);
+  return EvalSpecialOperation::Create(SpecialOperationType::T_COND, operands);
 }
 
 EvalObject *SingleCycleEvaluator::GetVariableValue(EvaluatorVariable *var) {
@@ -472,6 +470,89 @@ EvaluatedBlock SingleCycleEvaluator::GetEvaluatedBlock() {
 
 SingleCycleEvaluator::~SingleCycleEvaluator() {}
 
+MultiLaneEvaluator::MultiLaneEvaluator(Parser::GlobalScope *_gs, int _lanes)
+    : SingleCycleEvaluator(_gs), lanes(_lanes){};
+
+EvaluatorVariable *MultiLaneEvaluator::AddLanePort(Parser::Variable *orig,
+                                                   bool is_input) {
+  EvalObject *init = EvaluateExpression(orig->initialiser);
+  DataType *type = orig->type->Resolve(this, tpContext, init);
+  EvaluatorVariable *var = EvaluatorVariable::Create(
+      VariableDir{is_input, !is_input, true}, orig->name,
+      new ArrayType(type, lanes), false);
+  AddVariable(var, orig);
+  return var;
+}
+
+EvaluatorVariable *MultiLaneEvaluator::AddVariable(Parser::Variable *orig,
+                                                   bool is_block_input,
+                                                   bool is_block_output) {
+  // Each lane would need to see the state left by the lane before, which
+  // static variables being registers cannot provide
+  if (find(orig->qualifiers.begin(), orig->qualifiers.end(),
+           Parser::VariableQualifier::STATIC) != orig->qualifiers.end())
+    throw eval_error("static variable ===" + orig->name +
+                     "=== is not supported with multiple lanes");
+  if (currentLane > 0) {
+    auto shared = sharedStreams.find(orig);
+    int index = laneDeclarations[orig]++;
+    if ((shared != sharedStreams.end()) &&
+        (size_t(index) < shared->second.size()) &&
+        (shared->second.at(index) != nullptr)) {
+      parserVariables[orig] = shared->second.at(index);
+      return shared->second.at(index);
+    }
+  }
+  EvaluatorVariable *var = SingleCycleEvaluator::AddVariable(
+      orig, is_block_input, is_block_output);
+  // Memories inside the block hold state in the same way
+  if (!is_block_input && !is_block_output &&
+      (dynamic_cast<RAMType *>(var->GetType()) != nullptr))
+    throw eval_error("memory ===" + orig->name +
+                     "=== is not supported with multiple lanes");
+  if (currentLane == 0) {
+    StreamEvaluatorVariable *stream =
+        dynamic_cast<StreamEvaluatorVariable *>(var);
+    sharedStreams[orig].push_back(stream);
+    if (stream != nullptr)
+      streams.push_back(stream);
+  }
+  return var;
+}
+
+EvaluatorVariable *MultiLaneEvaluator::CreateVariable(VariableDir dir,
+                                                      string name,
+                                                      DataType *type,
+                                                      bool is_static) {
+  if (StreamType *st = dynamic_cast<StreamType *>(type))
+    return new StreamEvaluatorVariable(dir, name, st, lanes);
+  return SingleCycleEvaluator::CreateVariable(dir, name, type, is_static);
+}
+
+void MultiLaneEvaluator::EvaluateBlock(Parser::HardwareBlock *block) {
+  map<Parser::Variable *, EvaluatorVariable *> ports;
+  for (auto inp : block->inputs)
+    ports[inp] = AddLanePort(inp, true);
+  for (auto op : block->outputs)
+    ports[op] = AddLanePort(op, false);
+  // Variables declared in the body are created afresh for each lane, apart
+  // from streams, so only the ports need to be pointed at the lane being
+  // evaluated
+  for (currentLane = 0; currentLane < lanes; currentLane++) {
+    laneDeclarations.clear();
+    for (auto stream : streams)
+      stream->StartLane(currentLane);
+    for (auto port : ports)
+      parserVariables[port.first] =
+          port.second->GetArrayChildren().at(currentLane);
+    EvaluateStatement(block->body);
+    for (auto stream : streams)
+      stream->EndLane(this);
+  }
+  for (auto port : ports)
+    parserVariables[port.first] = port.second;
+}
+
 ConstantParser::ConstantParser(Parser::GlobalScope *_gs)
     : SingleCycleEvaluator(gs){};
 
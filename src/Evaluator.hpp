@@ -52,6 +52,9 @@ public:
   virtual EvaluatorVariable *AddVariable(Parser::Variable *orig,
                                          bool is_block_input = false,
                                          bool is_block_output = false);
+  // Create the variable for a declaration, before it is added
+  virtual EvaluatorVariable *CreateVariable(VariableDir dir, string name,
+                                            DataType *type, bool is_static);
   // Return a list of all variables
   virtual vector<EvaluatorVariable *> GetAllVariables();
   // Return the evaluator variable corresponding to a parser variable
@@ -109,6 +112,7 @@ class SingleCycleEvaluator : public Evaluator {
 public:
   SingleCycleEvaluator(Parser::GlobalScope *_gs);
   virtual void EvaluateBlock(Parser::HardwareBlock *block);
+  using Evaluator::AddVariable;
   virtual void AddVariable(EvaluatorVariable *var);
   virtual EvalObject *GetInputValue(EvaluatorVariable *var);
   virtual void SetVariableValue(EvaluatorVariable *var, EvalObject *value);
@@ -119,17 +123,46 @@ public:
 
   virtual ~SingleCycleEvaluator();
 
-private:
+protected:
   map<EvaluatorVariable *, EvalObject *> currentVariableValues;
   // Used to keep track of the current if condition. The second boolean
   // specifies whether we're in the 'true' branch or the 'false' branch
   vector<pair<EvalObject *, bool>> conditions;
 
-  // Traverse through the EvalObject tree for a variable value, returning a
-  // reference to the EvalObject first not matching the current condition stack
-  // Also returns the index where the match stopped
-  pair<EvalObject *&, int> FindFirstNotMatchingConds(EvalObject *&value,
-                                                     int index = 0);
+  // Return a new value for a variable given its existing value, such that it
+  // takes the new value when the conditions on the condition stack from index
+  // onwards are met and otherwise keeps its existing value. Existing
+  // conditionals matching the condition stack are followed rather than nested,
+  // and are rebuilt rather than modified as they may be shared
+  EvalObject *InsertConditionalValue(EvalObject *existing, EvalObject *value,
+                                     int index = 0);
+};
+
+// This processes several samples per clock cycle, for designs such as video
+// pipelines running faster than the clock. Each IO port becomes an array with
+// an item per lane, lane 0 in the least significant bits, and the block body is
+// evaluated once per lane with the ports referring to that lane's items
+class MultiLaneEvaluator : public SingleCycleEvaluator {
+public:
+  MultiLaneEvaluator(Parser::GlobalScope *_gs, int _lanes);
+  virtual void EvaluateBlock(Parser::HardwareBlock *block);
+  virtual EvaluatorVariable *AddVariable(Parser::Variable *orig,
+                                         bool is_block_input = false,
+                                         bool is_block_output = false);
+  using SingleCycleEvaluator::AddVariable;
+  virtual EvaluatorVariable *CreateVariable(VariableDir dir, string name,
+                                            DataType *type, bool is_static);
+
+private:
+  int lanes, currentLane = 0;
+  // Add a block port as an array of lanes
+  EvaluatorVariable *AddLanePort(Parser::Variable *orig, bool is_input);
+  // Streams are shared by all lanes, so the variables created by each
+  // declaration in the first lane are kept in order, with null for those that
+  // are not streams, for the same declarations in later lanes to find
+  map<Parser::Variable *, vector<StreamEvaluatorVariable *>> sharedStreams;
+  map<Parser::Variable *, int> laneDeclarations;
+  vector<StreamEvaluatorVariable *> streams;
 };
 
 // This is used for evaluating compile-time constants
@@ -3,6 +3,7 @@
 #include "Evaluator.hpp"
 #include "Util.hpp"
 #include "hdl/HDLCoreDevices.hpp"
+#include "hdl/HDLMemoryDevices.hpp"
 #include <algorithm>
 #include <iterator>
 #include <string>
@@ -30,6 +31,7 @@ EvaluatorVariable *EvaluatorVariable::Create(VariableDir _dir, string _name,
   ArrayType *arrt = dynamic_cast<ArrayType *>(_type);
   StructureType *st = dynamic_cast<StructureType *>(_type);
   RAMType *rt = dynamic_cast<RAMType *>(_type);
+  StreamType *strt = dynamic_cast<StreamType *>(_type);
   if (it != nullptr) {
     return new ScalarEvaluatorVariable(_dir, _name, it, _is_static);
   } else if (arrt != nullptr) {
@@ -38,6 +40,8 @@ EvaluatorVariable *EvaluatorVariable::Create(VariableDir _dir, string _name,
     return new ExternalMemoryEvaluatorVariable(_dir, _name, rt);
   } else if (st != nullptr) {
     return new StructureEvaluatorVariable(_dir, _name, st, _is_static);
+  } else if (strt != nullptr) {
+    return new StreamEvaluatorVariable(_dir, _name, strt);
   } else {
     throw eval_error("unable to create variable ===" + _name +
                      "===: unsupported type");
@@ -87,6 +91,11 @@ void EvaluatorVariable::HandleSubscriptedWrite(Evaluator *genst,
       "HandleSubscriptedWrite not supported for variable ===" + name + "===");
 }
 
+void EvaluatorVariable::SetInitialValue(Evaluator *genst, EvalObject *value) {
+  throw eval_error("static variable ===" + name +
+                   "=== cannot have an initialiser");
+}
+
 void EvaluatorVariable::HandlePush(Evaluator *genst, EvalObject *value) {
   throw eval_error("push (operator<<) not supported for variable ===" + name +
                    "===");
@@ -159,14 +168,69 @@ vector<EvaluatorVariable *> ScalarEvaluatorVariable::GetAllChildren() {
 void ScalarEvaluatorVariable::HandleWrite(Evaluator *genst, EvalObject *value) {
   if (is_static) {
     genst->SetVariableValue(written_value, value);
-    genst->SetVariableValue(write_enable, new EvalConstant(BitConstant(1)));
+    genst->SetVariableValue(write_enable, EvalConstant::Create(BitConstant(1)));
   } else {
     genst->SetVariableValue(this, value);
   }
 }
 
+void ScalarEvaluatorVariable::HandleIndexedWrite(Evaluator *genst,
+                                                 EvalObject *value,
+                                                 EvalObject *index,
+                                                 int position) {
+  auto select = [&](ScalarEvaluatorVariable *var, EvalObject *newValue) {
+    if (!var->type->Equals(newValue->GetDataType(genst)))
+      newValue = EvalCast::Create(var->type, newValue);
+    genst->SetVariableValue(
+        var, EvalSpecialOperation::Create(
+                 SpecialOperationType::ARRAY_WRITE,
+                 {genst->GetVariableValue(var), newValue, index},
+                 {BitConstant(position)}));
+  };
+  // A static variable keeps any earlier write when not indexed
+  if (is_static) {
+    select(written_value, value);
+    select(write_enable, EvalConstant::Create(BitConstant(1)));
+  } else {
+    select(this, value);
+  }
+}
+
+bool ScalarEvaluatorVariable::IsStatic() { return is_static; }
+
+void ScalarEvaluatorVariable::SetInitialValue(Evaluator *genst,
+                                              EvalObject *value) {
+  if (!value->HasConstantValue(genst))
+    throw eval_error("initialiser for static variable ===" + name +
+                     "=== is not constant");
+  initialValue =
+      value->GetScalarConstValue(genst).cast(type->width, type->is_signed);
+}
+
+BitConstant ScalarEvaluatorVariable::GetInitialValue() { return initialValue; }
+
+// Return the enable of a register written from a variable's write enable,
+// which only takes effect with valid inputs
+static HDLGen::HDLSignal *GetWriteEnable(SynthContext &sc,
+                                         EvaluatorVariable *write_enable) {
+  HDLGen::HDLSignal *wren = sc.design->CreateTempSignal(
+      new HDLGen::LogicSignalPortType(), "wren");
+  sc.design->AddDevice(
+      new HDLGen::BufferHDLDevice(GetVariableSignal(sc, write_enable), wren));
+  HDLGen::HDLSignal *gated_1 = sc.design->CreateTempSignal(
+      new HDLGen::LogicSignalPortType(), "enable");
+  sc.design->AddDevice(new HDLGen::OperationHDLDevice(
+      OperationType::B_BWAND, {wren, sc.input_valid}, gated_1));
+  HDLGen::HDLSignal *gated_2 = sc.design->CreateTempSignal(
+      new HDLGen::LogicSignalPortType(), "enable");
+  sc.design->AddDevice(new HDLGen::OperationHDLDevice(
+      OperationType::B_BWAND, {gated_1, sc.clock_enable}, gated_2));
+  return gated_2;
+}
+
 void ScalarEvaluatorVariable::Synthesise(SynthContext &sc) {
-  if (sc.varSignals.find(this) != sc.varSignals.end())
+  // Other variables are driven by their values
+  if (!is_static || (sc.varSignals.find(this) != sc.varSignals.end()))
     return;
   HDLGen::HDLSignal *sig =
       sc.design->CreateTempSignal(type->GetHDLType(), "sig_" + name);
@@ -175,31 +239,17 @@ void ScalarEvaluatorVariable::Synthesise(SynthContext &sc) {
   sig->timing_delay = HDLGen::HDLTimingValue<double>(sc.clock, 0);
 
   sc.varSignals[this] = sig;
+  sc.drivenSignals.insert(this);
 
-  if (is_static) {
-    write_enable->Synthesise(sc);
-    written_value->Synthesise(sc);
-    // Deal with enable gating
-    HDLGen::HDLSignal *gated_1 = sc.design->CreateTempSignal(
-        new HDLGen::LogicSignalPortType(), "enable");
-    sc.design->AddDevice(new HDLGen::OperationHDLDevice(
-        OperationType::B_BWAND,
-        {sc.varSignals.at(write_enable), sc.input_valid}, gated_1));
-    HDLGen::HDLSignal *gated_2 = sc.design->CreateTempSignal(
-        new HDLGen::LogicSignalPortType(), "enable");
-    sc.design->AddDevice(new HDLGen::OperationHDLDevice(
-        OperationType::B_BWAND, {gated_1, sc.clock_enable}, gated_2));
-
-    sc.design->AddDevice(
-        new HDLGen::RegisterHDLDevice(sc.varSignals.at(written_value), sc.clock,
-                                      sig, gated_2, sc.reset, false));
-  }
+  sc.design->AddDevice(new HDLGen::RegisterHDLDevice(
+      GetVariableSignal(sc, written_value), sc.clock, sig,
+      GetWriteEnable(sc, write_enable), sc.reset, false, initialValue));
 }
 
 ArrayEvaluatorVariable::ArrayEvaluatorVariable(VariableDir _dir, string _name,
                                                ArrayType *_type,
                                                bool _is_static)
-    : EvaluatorVariable(_dir, _name), type(_type) {
+    : EvaluatorVariable(_dir, _name), type(_type), is_static(_is_static) {
   for (int i = 0; i < type->length; i++) {
     arrayItems.push_back(EvaluatorVariable::Create(
         VariableDir(dir.is_input, dir.is_output, false),
@@ -218,6 +268,10 @@ vector<EvaluatorVariable *> ArrayEvaluatorVariable::GetArrayChildren() {
 }
 
 vector<EvaluatorVariable *> ArrayEvaluatorVariable::GetAllChildren() {
+  // The items of a static array in memory are never used, and the memory is
+  // added when first accessed
+  if (is_static && IsMemoryMapped())
+    return vector<EvaluatorVariable *>{};
   return arrayItems;
 }
 
@@ -231,6 +285,9 @@ void ArrayEvaluatorVariable::SetBitOffset(int _bitoffset) {
 }
 
 EvalObject *ArrayEvaluatorVariable::HandleRead(Evaluator *genst) {
+  if (is_static && IsMemoryMapped())
+    throw eval_error("array ===" + name +
+                     "=== is mapped to memory so must always be indexed");
   vector<EvalObject *> childValues;
   transform(
       arrayItems.begin(), arrayItems.end(), back_inserter(childValues),
@@ -239,10 +296,117 @@ EvalObject *ArrayEvaluatorVariable::HandleRead(Evaluator *genst) {
 }
 
 void ArrayEvaluatorVariable::HandleWrite(Evaluator *genst, EvalObject *value) {
+  if (is_static && IsMemoryMapped())
+    throw eval_error("array ===" + name +
+                     "=== is mapped to memory so must always be indexed");
   // TODO: multidimensional
   for (int i = 0; i < arrayItems.size(); i++) {
     arrayItems[i]->HandleWrite(
-        genst, value->ApplyArraySubscriptRead(genst, {new EvalConstant(i)}));
+        genst, value->ApplyArraySubscriptRead(genst, {EvalConstant::Create(i)}));
+  }
+}
+
+void ArrayEvaluatorVariable::SetInitialValue(Evaluator *genst,
+                                             EvalObject *value) {
+  if (IsMemoryMapped())
+    throw eval_error("array ===" + name +
+                     "=== is mapped to memory so cannot have an initialiser");
+  for (int i = 0; i < arrayItems.size(); i++) {
+    arrayItems[i]->SetInitialValue(
+        genst, value->ApplyArraySubscriptRead(genst, {EvalConstant::Create(i)}));
+  }
+}
+
+bool ArrayEvaluatorVariable::IsMemoryMapped() {
+  string value = attributes.GetAttributeValue("partition", "complete");
+  string kind = value.substr(0, value.find(','));
+  kind.erase(0, kind.find_first_not_of(" \t"));
+  kind.erase(kind.find_last_not_of(" \t") + 1);
+  return kind != "complete";
+}
+
+bool ArrayEvaluatorVariable::IsNonTrivialArrayAccess() {
+  return IsMemoryMapped();
+}
+
+int ArrayEvaluatorVariable::GetConstantItem(Evaluator *genst,
+                                            const vector<EvalObject *> &index) {
+  if (index.size() != 1)
+    throw eval_error("invalid dimensions for access to variable ===" + name +
+                     "===");
+  if (!index[0]->HasConstantValue(genst))
+    return -1;
+  BitConstant item = index[0]->GetScalarConstValue(genst);
+  if (item.is_negative() || (item.intval() >= type->length))
+    throw eval_error("array index out of bounds for variable ===" + name +
+                     "===");
+  return item.intval();
+}
+
+ExternalMemoryEvaluatorVariable *
+ArrayEvaluatorVariable::GetMemory(Evaluator *genst) {
+  IntegerType *baseType = dynamic_cast<IntegerType *>(type->baseType);
+  if (baseType == nullptr)
+    throw eval_error("only arrays of integers can be mapped to memory, unlike "
+                     "===" +
+                     name + "===");
+  // The contents of a ROM are the values of the items, which must be the same
+  // for every read
+  vector<BitConstant> values;
+  if (!is_static) {
+    for (auto item : arrayItems) {
+      EvalObject *value = item->HandleRead(genst);
+      if (!value->HasConstantValue(genst) ||
+          (dynamic_cast<EvalDontCare *>(value) != nullptr))
+        throw eval_error("array ===" + name +
+                         "=== is mapped to memory, so must be static or hold "
+                         "constants when accessed with a non-constant index");
+      values.push_back(value->GetScalarConstValue(genst));
+    }
+    if ((memory != nullptr) &&
+        !equal(values.begin(), values.end(), contents.begin(),
+               [](const BitConstant &a, const BitConstant &b) {
+                 return AreBitsEqual(a, b).intval() != 0;
+               }))
+      throw eval_error("array ===" + name +
+                       "=== is mapped to memory, so cannot be changed between "
+                       "reads with non-constant indices");
+  }
+  if (memory == nullptr) {
+    RAMType *ramType = new RAMType(*baseType, type->length);
+    ramType->is_rom = !is_static;
+    memory = new ExternalMemoryEvaluatorVariable(
+        VariableDir(false, false, false), name, ramType);
+    memory->attributes = attributes;
+    contents = values;
+    if (!is_static)
+      memory->SetContents(contents);
+    genst->AddVariable(memory);
+  }
+  return memory;
+}
+
+EvalObject *
+ArrayEvaluatorVariable::HandleSubscriptedRead(Evaluator *genst,
+                                              vector<EvalObject *> index) {
+  int item = GetConstantItem(genst, index);
+  if (!is_static && (item != -1))
+    return new EvalVariable(arrayItems.at(item));
+  return GetMemory(genst)->HandleSubscriptedRead(genst, index);
+}
+
+void ArrayEvaluatorVariable::HandleSubscriptedWrite(Evaluator *genst,
+                                                    vector<EvalObject *> index,
+                                                    EvalObject *value) {
+  int item = GetConstantItem(genst, index);
+  if (is_static) {
+    GetMemory(genst)->HandleSubscriptedWrite(genst, index, value);
+  } else if (item != -1) {
+    arrayItems.at(item)->HandleWrite(genst, value);
+  } else {
+    throw eval_error("array ===" + name +
+                     "=== is mapped to memory, so must be static to be "
+                     "written with a non-constant index");
   }
 }
 
@@ -310,15 +474,18 @@ void StructureEvaluatorVariable::HandleWrite(Evaluator *genst,
 
 ExternalMemoryEvaluatorVariable::ExternalMemoryEvaluatorVariable(
     VariableDir _dir, string _name, RAMType *_type)
-    : EvaluatorVariable(_dir, _name), type(_type) {
+    : EvaluatorVariable(_dir, _name), type(_type),
+      is_external(_dir.is_toplevel) {
   ports["_address"] = new ScalarEvaluatorVariable(
       VariableDir(false, true, _dir.is_toplevel), _name + "_address",
       new IntegerType(GetAddressBusSize(type->length), false), false);
   ports["_address"]->SetDefaultValue(BitConstant(0));
 
-  ports["_q"] =
-      new ScalarEvaluatorVariable(VariableDir(true, false, _dir.is_toplevel),
-                                  _name + "_q", &(type->baseType), false);
+  // Memories inside the block have a data output for each read instead
+  if (is_external)
+    ports["_q"] =
+        new ScalarEvaluatorVariable(VariableDir(true, false, _dir.is_toplevel),
+                                    _name + "_q", &(type->baseType), false);
 
   if (!type->is_rom) {
     ports["_wren"] = new ScalarEvaluatorVariable(
@@ -359,7 +526,13 @@ MemoryDeviceParameters ExternalMemoryEvaluatorVariable::GetMemoryParams() {
   mdp.canWrite = !type->is_rom;
   mdp.hasRden = false;
   mdp.hasWren = mdp.canWrite;
-  mdp.readLatency = 1;
+  // Extra cycles of read latency register the data out of a block RAM, for
+  // memories given a read_latency attribute
+  try {
+    mdp.readLatency = stoi(attributes.GetAttributeValue("read_latency", "1"));
+  } catch (exception &) {
+    mdp.readLatency = 0;
+  }
   mdp.seperateRWports = false;
   return mdp;
 }
@@ -375,8 +548,25 @@ EvalObject *ExternalMemoryEvaluatorVariable::HandleSubscriptedRead(
     throw eval_error("invalid dimensions for access to variable ===" + name +
                      "===");
   }
-  genst->SetVariableValue(ports.at("_address"), index[0]);
-  return new EvalVariable(ports.at("_q"));
+  if (is_external) {
+    genst->SetVariableValue(ports.at("_address"), index[0]);
+    return new EvalVariable(ports.at("_q"));
+  }
+  auto existing = readPorts.find(index[0]);
+  if (existing != readPorts.end())
+    return new EvalVariable(existing->second);
+  string port = name + "_rd" + to_string(readPorts.size());
+  ScalarEvaluatorVariable *address = new ScalarEvaluatorVariable(
+      VariableDir(false, true, false), port + "_address",
+      new IntegerType(GetAddressBusSize(type->length), false), false);
+  ScalarEvaluatorVariable *q = new ScalarEvaluatorVariable(
+      VariableDir(true, false, false), port + "_q", &(type->baseType), false);
+  genst->AddVariable(address);
+  genst->AddVariable(q);
+  genst->SetVariableValue(address, index[0]);
+  accesses.push_back(Access{address, q, ValueRange(), true});
+  readPorts[index[0]] = q;
+  return new EvalVariable(q);
 }
 
 void ExternalMemoryEvaluatorVariable::HandleSubscriptedWrite(
@@ -388,9 +578,15 @@ void ExternalMemoryEvaluatorVariable::HandleSubscriptedWrite(
   if (type->is_rom) {
     throw eval_error("cannot write to ROM type variable ===" + name + "===");
   }
-  genst->SetVariableValue(ports.at("_address"), index[0]);
-  genst->SetVariableValue(ports.at("_wren"), new EvalConstant(BitConstant(1)));
+  EvalObject *address = index[0]->GetValue(genst);
+  genst->SetVariableValue(ports.at("_address"), address);
+  genst->SetVariableValue(ports.at("_wren"), EvalConstant::Create(BitConstant(1)));
   genst->SetVariableValue(ports.at("_data"), value);
+  if (!is_external &&
+      none_of(accesses.begin(), accesses.end(),
+              [](const Access &a) { return a.q == nullptr; }))
+    accesses.push_back(
+        Access{ports.at("_address"), nullptr, ValueRange(), true});
 }
 
 EvalObject *ExternalMemoryEvaluatorVariable::HandleRead(Evaluator *genst) {
@@ -401,27 +597,307 @@ void ExternalMemoryEvaluatorVariable::HandleWrite(Evaluator *genst,
   throw eval_error("ROM device ===" + name + "=== must always be addressed");
 }
 
+vector<ExternalMemoryEvaluatorVariable::Access> &
+ExternalMemoryEvaluatorVariable::GetAccesses() {
+  return accesses;
+}
+
+void ExternalMemoryEvaluatorVariable::SetContents(
+    const vector<BitConstant> &_contents) {
+  contents = _contents;
+}
+
+const vector<BitConstant> &ExternalMemoryEvaluatorVariable::GetContents() {
+  return contents;
+}
+
+bool ExternalMemoryEvaluatorVariable::IsExternal() { return is_external; }
+
+// Return the number of banks given by a memory's partition attribute, of the
+// form none, block, N or cyclic, N, or 1 if it has none
+static int GetPartitionBanks(EvaluatorVariable *var, bool &cyclic) {
+  string value = var->attributes.GetAttributeValue("partition", "none");
+  auto trim = [](string str) {
+    str.erase(0, str.find_first_not_of(" \t"));
+    str.erase(str.find_last_not_of(" \t") + 1);
+    return str;
+  };
+  string kind = trim(value.substr(0, value.find(',')));
+  cyclic = (kind == "cyclic");
+  if (kind == "none")
+    return 1;
+  int banks = 0;
+  if (((kind == "block") || cyclic) && (value.find(',') != string::npos)) {
+    try {
+      banks = stoi(trim(value.substr(value.find(',') + 1)));
+    } catch (exception &) {
+      banks = 0;
+    }
+  }
+  if ((banks < 1) || ((banks & (banks - 1)) != 0))
+    PrintMessage(MSG_ERROR, "invalid partition ===" + value +
+                                "=== for memory ===" + var->name +
+                                "===, expected none, or block or cyclic and "
+                                "a power of two number of banks");
+  return banks;
+}
+
+void ExternalMemoryEvaluatorVariable::Synthesise(SynthContext &sc) {
+  if (is_external || (sc.varSignals.find(this) != sc.varSignals.end()))
+    return;
+  if (sc.clock == sc.design->gnd)
+    PrintMessage(MSG_ERROR,
+                 "memory ===" + name + "=== requires a clocked block");
+  if (type->is_rom && contents.empty())
+    PrintMessage(MSG_ERROR, "ROM ===" + name +
+                                "=== has no contents, as it is not a port of "
+                                "the block");
+  sc.varSignals[this] = nullptr;
+  sc.drivenSignals.insert(this);
+
+  // Block partitions select the bank from the top bits of the address, and
+  // cyclic ones from the bottom bits, with the rest addressing a word
+  bool cyclic;
+  int banks = GetPartitionBanks(this, cyclic);
+  int bankBits = 0;
+  while ((1 << bankBits) < banks)
+    bankBits++;
+  int addrWidth = GetAddressBusSize(type->length);
+  int wordBits = addrWidth - bankBits;
+  if (wordBits < 1)
+    PrintMessage(MSG_ERROR, "memory ===" + name + "=== has more banks than "
+                                                 "words");
+  int bankLow = cyclic ? 0 : wordBits, wordLow = cyclic ? bankBits : 0;
+  HDLGen::HDLPortType *bankType =
+      new HDLGen::NumericPortType(max(bankBits, 1), false);
+  HDLGen::HDLPortType *wordType = new HDLGen::NumericPortType(wordBits, false);
+  auto slice = [&](HDLGen::HDLSignal *addr, HDLGen::HDLPortType *sliceType,
+                   int low, string prefix) {
+    HDLGen::HDLSignal *net = sc.design->CreateTempSignal(sliceType, prefix);
+    sc.design->AddDevice(new HDLGen::BufferHDLDevice(
+        addr, net,
+        HDLGen::HDLBitSlice(low + sliceType->GetWidth() - 1, low)));
+    return net;
+  };
+  auto getBank = [&](const ValueRange &range) {
+    if (banks == 1)
+      return 0;
+    if (cyclic)
+      return (range.GetKnownLowBits() >= bankBits)
+                 ? int(range.knownOne & (banks - 1))
+                 : -1;
+    return (range.is_bounded &&
+            ((range.lo >> wordBits) == (range.hi >> wordBits)))
+               ? int(range.lo >> wordBits)
+               : -1;
+  };
+  auto getWord = [&](HDLGen::HDLSignal *addr) {
+    return (banks == 1) ? addr : slice(addr, wordType, wordLow, "word");
+  };
+  auto makeConstant = [&](int value, HDLGen::HDLPortType *constType) {
+    HDLGen::HDLSignal *net = sc.design->CreateTempSignal(constType, "const");
+    sc.design->AddDevice(new HDLGen::ConstantHDLDevice(
+        BitConstant(value, constType->GetWidth()), net));
+    return net;
+  };
+  // Enable an access only when the bank it selects is b
+  auto gateByBank = [&](HDLGen::HDLSignal *enable, HDLGen::HDLSignal *addr,
+                        int b) {
+    HDLGen::HDLSignal *match = sc.design->CreateTempSignal(
+        new HDLGen::LogicSignalPortType(), "bank_match");
+    sc.design->AddDevice(new HDLGen::OperationHDLDevice(
+        OperationType::B_EQ,
+        {slice(addr, bankType, bankLow, "bank"), makeConstant(b, bankType)},
+        match));
+    HDLGen::HDLSignal *gated = sc.design->CreateTempSignal(
+        new HDLGen::LogicSignalPortType(), "enable");
+    sc.design->AddDevice(new HDLGen::OperationHDLDevice(
+        OperationType::B_BWAND, {enable, match}, gated));
+    return gated;
+  };
+
+  const Access *write = nullptr;
+  vector<const Access *> reads;
+  for (const auto &access : accesses) {
+    if (access.q == nullptr) {
+      write = &access;
+      continue;
+    }
+    sc.drivenSignals.insert(access.q);
+    if (access.used)
+      reads.push_back(&access);
+  }
+  if ((write == nullptr) && !reads.empty() && contents.empty())
+    PrintMessage(MSG_WARNING, "memory ===" + name +
+                                  "=== is never written, so reads give zero");
+  // A read of a written memory sees the write of the sample before through the
+  // forwarding register, which only covers one cycle of read latency
+  int readLatency = GetMemoryParams().readLatency;
+  if (readLatency < 1)
+    PrintMessage(MSG_ERROR, "invalid read latency for memory ===" + name +
+                                "===, expected a positive number of cycles");
+  if ((write != nullptr) && (readLatency != 1))
+    PrintMessage(MSG_ERROR, "memory ===" + name +
+                                "=== is written, so its read latency must be "
+                                "one cycle");
+
+  HDLGen::HDLSignal *writeAddr = nullptr, *writeEnable = nullptr,
+                    *writeData = nullptr, *writeWord = nullptr;
+  int writeBank = -1;
+  if (write != nullptr) {
+    writeAddr = GetVariableSignal(sc, write->address);
+    writeEnable = GetWriteEnable(sc, ports.at("_wren"));
+    writeData = GetVariableSignal(sc, ports.at("_data"));
+    writeWord = getWord(writeAddr);
+    writeBank = getBank(write->range);
+  }
+
+  // Data read from each bank, for reads whose bank is not known until the
+  // address is
+  vector<vector<HDLGen::HDLSignal *>> bankData(reads.size());
+  vector<HDLGen::HDLSignal *> readWords;
+  for (auto read : reads)
+    readWords.push_back(getWord(GetVariableSignal(sc, read->address)));
+  int numRAMs = 0;
+  for (int b = 0; b < banks; b++) {
+    HDLGen::HDLSignal *bankEnable = nullptr;
+    if ((write != nullptr) && ((writeBank == b) || (writeBank == -1)))
+      bankEnable = (writeBank == -1)
+                       ? gateByBank(writeEnable, writeAddr, b)
+                       : writeEnable;
+    vector<pair<HDLGen::HDLSignal *, HDLGen::HDLSignal *>> bankReads;
+    for (int i = 0; i < int(reads.size()); i++) {
+      int readBank = getBank(reads.at(i)->range);
+      if ((readBank != b) && (readBank != -1))
+        continue;
+      HDLGen::HDLSignal *q;
+      if (readBank == -1) {
+        q = sc.design->CreateTempSignal(
+            reads.at(i)->q->GetType()->GetHDLType(), "bank_q");
+        bankData.at(i).push_back(q);
+      } else {
+        q = GetVariableSignal(sc, reads.at(i)->q);
+      }
+      // Further cycles of latency register the data out
+      for (int stage = 1; stage < readLatency; stage++) {
+        HDLGen::HDLSignal *data =
+            sc.design->CreateTempSignal(q->sigType, "ram_q");
+        sc.design->AddDevice(new HDLGen::RegisterHDLDevice(
+            data, sc.clock, q, sc.clock_enable, sc.design->gnd, true));
+        q = data;
+      }
+      bankReads.push_back(make_pair(readWords.at(i), q));
+    }
+    vector<BitConstant> bankContents;
+    for (int w = 0; w < (1 << wordBits); w++) {
+      int address = cyclic ? ((w << bankBits) | b) : ((b << wordBits) | w);
+      if (address >= int(contents.size()))
+        break;
+      bankContents.push_back(contents.at(address));
+    }
+    // Each replica of the bank has every write, and as many reads as it has
+    // ports left
+    bool written = (bankEnable != nullptr);
+    int readsPerRAM = HDLGen::RAMHDLDevice::numPorts - (written ? 1 : 0);
+    for (int first = 0; first < int(bankReads.size()); first += readsPerRAM) {
+      int last = min(first + readsPerRAM, int(bankReads.size()));
+      sc.design->AddDevice(new HDLGen::RAMHDLDevice(
+          sc.clock, sc.clock_enable, written ? writeWord : nullptr, bankEnable,
+          written ? writeData : nullptr,
+          vector<pair<HDLGen::HDLSignal *, HDLGen::HDLSignal *>>(
+              bankReads.begin() + first, bankReads.begin() + last),
+          bankContents));
+      numRAMs++;
+    }
+  }
+
+  // Reads from an unknown bank select between the banks once their data is
+  // ready, with the bank aligned to it by the pipeliner
+  for (int i = 0; i < int(reads.size()); i++) {
+    if (bankData.at(i).empty())
+      continue;
+    HDLGen::HDLSignal *q = GetVariableSignal(sc, reads.at(i)->q);
+    HDLGen::HDLSignal *bank = slice(
+        GetVariableSignal(sc, reads.at(i)->address), bankType, bankLow, "bank");
+    HDLGen::HDLSignal *bankReg =
+        sc.design->CreateTempSignal(bankType, "bank_reg");
+    sc.design->AddDevice(new HDLGen::RegisterHDLDevice(
+        bank, sc.clock, bankReg, sc.clock_enable, sc.design->gnd, true));
+    sc.design->AddDevice(
+        new HDLGen::MultiplexerHDLDevice(bankData.at(i), bankReg, q));
+  }
+  PrintMessage(MSG_NOTE, "memory ===" + name + "=== with " +
+                             to_string(reads.size()) + " reads uses " +
+                             to_string(numRAMs) + " block RAMs in " +
+                             to_string(banks) + " banks");
+}
+
 StreamEvaluatorVariable::StreamEvaluatorVariable(VariableDir _dir, string _name,
-                                                 StreamType *_type)
-    : EvaluatorVariable(_dir, _name), type(_type) {
-  int totalSize;
-  if (type->isStream2d) {
-    totalSize = type->length * type->height;
-  } else {
-    totalSize = type->length;
+                                                 StreamType *_type, int _lanes)
+    : EvaluatorVariable(_dir, _name), type(_type), lanes(_lanes) {
+  int width = type->length, height = type->isStream2d ? type->height : 1;
+  auto createItem = [&](int i) {
+    return EvaluatorVariable::Create(VariableDir(true, false, false),
+                                     _name + "_itm" + to_string(i),
+                                     type->baseType, false);
+  };
+  for (int l = 0; l < lanes; l++) {
+    string lane = (lanes > 1) ? ("_l" + to_string(l)) : "";
+    written_values.push_back(EvaluatorVariable::Create(
+        VariableDir(false, true, false), _name + lane + "_wrval",
+        type->baseType, false)); // TODO: default value for this
+    write_enables.push_back(new ScalarEvaluatorVariable(
+        VariableDir(false, true, false), name + lane + "_wren",
+        new IntegerType(1, false), false));
+    write_enables.back()->SetDefaultValue(BitConstant(0));
   }
-  for (int i = 0; i < totalSize; i++) {
-    streamWindow.push_back(EvaluatorVariable::Create(
-        VariableDir(true, false, false), _name + "_itm" + to_string(i),
-        type->baseType, false));
+  if (lanes == 1) {
+    windowDepth = width;
+    for (int i = 0; i < width * height; i++)
+      streamWindow.push_back(createItem(i));
+    for (int y = 0; y < height; y++) {
+      Chain chain;
+      for (int x = width - 1; x >= 0; x--)
+        chain.items.push_back(streamWindow.at(x * height + y));
+      if (y == height - 1) {
+        chain.source = written_values.at(0);
+        chain.depth = 0;
+      } else {
+        chain.source = streamWindow.at(y + 1);
+        chain.depth = type->lineWidth - width;
+      }
+      chains.push_back(chain);
+    }
+  } else {
+    // A row is then lineWidth / lanes cycles behind the row below
+    if (type->isStream2d && (type->lineWidth % lanes != 0))
+      throw eval_error("line width of stream ===" + name +
+                       "=== is not a multiple of the number of lanes");
+    // The first lane reads back as far as width samples before its own
+    windowDepth = (width + lanes - 1) / lanes;
+    for (int y = 0; y < height; y++)
+      for (int j = 0; j <= windowDepth; j++)
+        for (int l = 0; l < lanes; l++)
+          streamWindow.push_back(((y == height - 1) && (j == 0))
+                                     ? nullptr
+                                     : createItem(streamWindow.size()));
+    int lineCycles = type->isStream2d ? (type->lineWidth / lanes) : 0;
+    for (int y = 0; y < height; y++) {
+      for (int l = 0; l < lanes; l++) {
+        Chain chain;
+        for (int j = (y == height - 1) ? 1 : 0; j <= windowDepth; j++)
+          chain.items.push_back(GetLaneItem(y, j, l));
+        if (y == height - 1) {
+          chain.source = written_values.at(l);
+          chain.depth = 0;
+        } else {
+          chain.source = GetLaneItem(y + 1, windowDepth - 1, l);
+          chain.depth = lineCycles - windowDepth;
+        }
+        chains.push_back(chain);
+      }
+    }
   }
-  written_value = EvaluatorVariable::Create(
-      VariableDir(false, true, false), _name + "_wrval", type->baseType,
-      false); // TODO: default value for this
-  write_enable = new ScalarEvaluatorVariable(VariableDir(false, true, false),
-                                             name + "_wren",
-                                             new IntegerType(1, false), false);
-  write_enable->SetDefaultValue(BitConstant(0));
   dir.is_toplevel = false;
 };
 
@@ -431,31 +907,103 @@ bool StreamEvaluatorVariable::IsScalar() { return false; };
 
 vector<EvaluatorVariable *> StreamEvaluatorVariable::GetAllChildren() {
   vector<EvaluatorVariable *> children;
-  children.insert(children.end(), streamWindow.begin(), streamWindow.end());
-  children.push_back(write_enable);
-  children.push_back(written_value);
+  copy_if(streamWindow.begin(), streamWindow.end(), back_inserter(children),
+          [](EvaluatorVariable *item) { return item != nullptr; });
+  children.insert(children.end(), write_enables.begin(), write_enables.end());
+  children.insert(children.end(), written_values.begin(),
+                  written_values.end());
   return children;
 }
+
 vector<EvaluatorVariable *> StreamEvaluatorVariable::GetArrayChildren() {
-  return streamWindow;
+  if (lanes == 1)
+    return streamWindow;
+  // Item x of each row is width - x samples before the lane's own, which is
+  // counted here from the first lane of the cycle
+  int width = type->length, height = type->isStream2d ? type->height : 1;
+  vector<EvaluatorVariable *> view;
+  for (int x = 0; x < width; x++) {
+    int sample = currentLane - width + x;
+    int cycles = (sample >= 0) ? 0 : ((lanes - 1 - sample) / lanes);
+    for (int y = 0; y < height; y++)
+      view.push_back(GetLaneItem(y, cycles, sample + cycles * lanes));
+  }
+  return view;
 }
 
 EvaluatorVariable *StreamEvaluatorVariable::GetChildByName(string name) {
+  // The first lane's write enable is that of the whole window, as every lane
+  // must push
   if (name == "_wrval")
-    return written_value;
+    return written_values.at(0);
   else if (name == "_wren")
-    return write_enable;
+    return write_enables.at(0);
   else
     return EvaluatorVariable::GetChildByName(name);
 }
 
 void StreamEvaluatorVariable::HandlePush(Evaluator *genst, EvalObject *value) {
-  genst->SetVariableValue(write_enable, new EvalConstant(BitConstant(1)));
-  genst->SetVariableValue(written_value, value);
+  genst->SetVariableValue(write_enables.at(currentLane),
+                          EvalConstant::Create(BitConstant(1)));
+  genst->SetVariableValue(written_values.at(currentLane), value);
 }
 
 void StreamEvaluatorVariable::HandleWrite(Evaluator *genst, EvalObject *value) {
   throw eval_error("cannot assign to stream ===" + name +
                    "===, use operator<< instead");
 }
+
+void StreamEvaluatorVariable::StartLane(int lane) { currentLane = lane; }
+
+void StreamEvaluatorVariable::EndLane(Evaluator *genst) {
+  EvalObject *pushed = genst->GetVariableValue(write_enables.at(currentLane));
+  if (!pushed->HasConstantValue(genst) ||
+      (pushed->GetScalarConstValue(genst).intval() != 1))
+    throw eval_error("stream ===" + name +
+                     "=== must be pushed unconditionally by every lane");
+}
+
+const vector<StreamEvaluatorVariable::Chain> &
+StreamEvaluatorVariable::GetChains() {
+  return chains;
+}
+
+EvaluatorVariable *StreamEvaluatorVariable::GetLaneItem(int y, int j, int l) {
+  int height = type->isStream2d ? type->height : 1;
+  if ((y == height - 1) && (j == 0))
+    return written_values.at(l);
+  return streamWindow.at((y * (windowDepth + 1) + j) * lanes + l);
+}
+
+void StreamEvaluatorVariable::Synthesise(SynthContext &sc) {
+  if (sc.varSignals.find(this) != sc.varSignals.end())
+    return;
+  if (sc.clock == sc.design->gnd)
+    PrintMessage(MSG_ERROR,
+                 "stream ===" + name + "=== requires a clocked block");
+  if (type->isStream2d && (type->lineWidth < type->length))
+    PrintMessage(MSG_ERROR, "line width of stream ===" + name +
+                                "=== is less than its window width");
+  // The stream itself has no signal
+  sc.varSignals[this] = nullptr;
+  sc.drivenSignals.insert(this);
+
+  HDLGen::HDLSignal *enable = GetWriteEnable(sc, write_enables.at(0));
+  for (const auto &chain : chains)
+    sc.drivenSignals.insert(chain.items.begin(), chain.items.end());
+  for (const auto &chain : chains) {
+    HDLGen::HDLSignal *last = GetVariableSignal(sc, chain.source);
+    for (size_t i = 0; i < chain.items.size(); i++) {
+      HDLGen::HDLSignal *item = GetVariableSignal(sc, chain.items.at(i));
+      if ((i == 0) && (chain.depth != 0))
+        // The oldest values of the row below, delayed by the rest of the line
+        sc.design->AddDevice(new HDLGen::LineBufferHDLDevice(
+            last, sc.clock, item, enable, chain.depth));
+      else
+        sc.design->AddDevice(new HDLGen::RegisterHDLDevice(
+            last, sc.clock, item, enable, sc.design->gnd, false));
+      last = item;
+    }
+  }
+}
 } // namespace ElasticC
@@ -5,6 +5,7 @@
 #include "ParserCore.hpp"
 #include "ParserStructures.hpp"
 #include "SynthContext.hpp"
+#include "ValueRange.hpp"
 #include <map>
 #include <stack>
 #include <string>
@@ -90,6 +91,10 @@ public:
                                       vector<EvalObject *> index,
                                       EvalObject *value);
 
+  // Set the value a static variable holds before it is first written, given
+  // by its initialiser
+  virtual void SetInitialValue(Evaluator *genst, EvalObject *value);
+
   // Handle a push (using operator<<) - stream/stream2d types and FIFOs
   virtual void HandlePush(Evaluator *genst, EvalObject *value);
   // Handle a pop (using operator>>) - possible FIFO/stack type
@@ -125,6 +130,15 @@ public:
   EvaluatorVariable *GetChildByName(string name);
   vector<EvaluatorVariable *> GetAllChildren();
   void HandleWrite(Evaluator *genst, EvalObject *value);
+  // Handle a write to an array item with a non-constant index, which only
+  // takes effect when the index is equal to the item's position
+  void HandleIndexedWrite(Evaluator *genst, EvalObject *value,
+                          EvalObject *index, int position);
+  // Return true for a static variable, which is a register written through
+  // its _wren and _wrval children
+  bool IsStatic();
+  void SetInitialValue(Evaluator *genst, EvalObject *value);
+  BitConstant GetInitialValue();
 
 private:
   IntegerType *type;
@@ -132,10 +146,26 @@ private:
   BitConstant defaultValue;
   // Static variables only
   bool is_static = false;
+  BitConstant initialValue;
   ScalarEvaluatorVariable *write_enable = nullptr;
   ScalarEvaluatorVariable *written_value = nullptr;
 };
 
+class ExternalMemoryEvaluatorVariable;
+
+/*
+Arrays are built from a variable for each item, so are registers if static and
+otherwise just values, with multiplexers selecting the item indexed by a
+non-constant index. This is the default, or given by a partition(complete)
+attribute.
+
+A partition attribute of none, block, N or cyclic, N maps a one-dimensional
+array of integers to a memory instead, with the same banking as a partitioned
+ram (none being a single bank). A static array is then accessed in the same
+way as a ram. Other arrays may only be written with constant indices, and
+must hold constants when read with a non-constant index, making them a ROM;
+the coefficients of a filter, for example.
+*/
 class ArrayEvaluatorVariable : public EvaluatorVariable {
 public:
   ArrayEvaluatorVariable(VariableDir _dir, string _name, ArrayType *_type,
@@ -149,10 +179,27 @@ public:
 
   EvalObject *HandleRead(Evaluator *genst);
   void HandleWrite(Evaluator *genst, EvalObject *value);
+  void SetInitialValue(Evaluator *genst, EvalObject *value);
+
+  // Arrays mapped to memory handle subscripts themselves
+  bool IsNonTrivialArrayAccess();
+  EvalObject *HandleSubscriptedRead(Evaluator *genst,
+                                    vector<EvalObject *> index);
+  void HandleSubscriptedWrite(Evaluator *genst, vector<EvalObject *> index,
+                              EvalObject *value);
 
 private:
   ArrayType *type;
+  bool is_static;
   vector<EvaluatorVariable *> arrayItems;
+  // Memory holding the array, created on first use
+  ExternalMemoryEvaluatorVariable *memory = nullptr;
+  vector<BitConstant> contents;
+
+  bool IsMemoryMapped();
+  // Return the item given by a constant index, or -1 if it is not constant
+  int GetConstantItem(Evaluator *genst, const vector<EvalObject *> &index);
+  ExternalMemoryEvaluatorVariable *GetMemory(Evaluator *genst);
 };
 
 class StructureEvaluatorVariable : public EvaluatorVariable {
@@ -194,28 +241,97 @@ public:
   EvalObject *HandleRead(Evaluator *genst);
   void HandleWrite(Evaluator *genst, EvalObject *value);
 
+  // A memory declared inside a block, rather than being one of its ports, is
+  // built from block RAMs. Each distinct address read from has a read port of
+  // its own, while writes share a single write port so only the last write of
+  // a sample takes effect. Reads give the contents from before the sample's
+  // write, as with static variables, even when the write is to the same
+  // address. When there are more reads than the ports of one RAM, the memory
+  // is replicated, or split into banks if it has a partition attribute
+  void Synthesise(SynthContext &sc);
+
+  // A read or write of a memory inside a block. The range of the address is
+  // found by the optimiser, and used to find which bank is accessed
+  struct Access {
+    ScalarEvaluatorVariable *address;
+    // Data read, or nullptr for the write port
+    ScalarEvaluatorVariable *q;
+    ValueRange range;
+    // Cleared by the optimiser if the data read is never used
+    bool used = true;
+  };
+  vector<Access> &GetAccesses();
+
+  // Set the initial contents of a memory inside a block, starting from
+  // address zero, which make a ROM useful
+  void SetContents(const vector<BitConstant> &_contents);
+  const vector<BitConstant> &GetContents();
+  // Return true if the memory is one of the block's ports
+  bool IsExternal();
+
 private:
   RAMType *type;
   map<string, ScalarEvaluatorVariable *> ports;
+  bool is_external;
+  vector<BitConstant> contents;
+  vector<Access> accesses;
+  // Read port used for each address value
+  map<EvalObject *, ScalarEvaluatorVariable *> readPorts;
 };
 
+// With several lanes, one window is shared by all of them and takes a push
+// from every lane each cycle. Lane k sees the window as a single lane would
+// after the samples of the lanes before it, so the newest items of its last
+// row may be values pushed earlier in the same cycle
 class StreamEvaluatorVariable : public EvaluatorVariable {
 public:
-  StreamEvaluatorVariable(VariableDir _dir, string _name, StreamType *_type);
+  StreamEvaluatorVariable(VariableDir _dir, string _name, StreamType *_type,
+                          int _lanes = 1);
   DataType *GetType();
   bool IsScalar();
 
   vector<EvaluatorVariable *> GetAllChildren();
   EvaluatorVariable *GetChildByName(string name);
+  // The window as seen by the lane being evaluated
   vector<EvaluatorVariable *> GetArrayChildren();
   void HandlePush(Evaluator *genst, EvalObject *value);
 
   void HandleWrite(Evaluator *genst, EvalObject *value);
+  // Set the lane being evaluated, and check that a lane pushed exactly one
+  // value once it has been evaluated
+  void StartLane(int lane);
+  void EndLane(Evaluator *genst);
+
+  // The window is held in chains of items, newest first, each shifted along
+  // by a push. The newest item of a chain is fed from source, through a line
+  // buffer if depth is not zero. A source is either a written value or an
+  // item of a later chain, so updating the chains in order reads old values
+  struct Chain {
+    vector<EvaluatorVariable *> items;
+    EvaluatorVariable *source;
+    int depth;
+  };
+  const vector<Chain> &GetChains();
+  // Each chain is a shift register, with the newest value of a single lane at
+  // the highest x and y indices. Each row of a 2D window is fed from the row
+  // below through a line buffer, so a row holds the values pushed one line
+  // width earlier
+  void Synthesise(SynthContext &sc);
 
 private:
   StreamType *type;
+  int lanes, currentLane = 0;
+  // With one lane, item (x, y) is at x * height + y. With several, the
+  // sample of lane l pushed j cycles before the newest of row y is at
+  // (y * (windowDepth + 1) + j) * lanes + l, apart from the newest of the last
+  // row, which are the values written this cycle
   vector<EvaluatorVariable *> streamWindow;
-  EvaluatorVariable *written_value;
-  ScalarEvaluatorVariable *write_enable;
+  int windowDepth;
+  vector<EvaluatorVariable *> written_values;
+  vector<ScalarEvaluatorVariable *> write_enables;
+  vector<Chain> chains;
+  // Return the variable holding the sample of lane l pushed j cycles before
+  // the latest of row y, with several lanes
+  EvaluatorVariable *GetLaneItem(int y, int j, int l);
 };
 }
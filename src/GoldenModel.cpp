@@ -0,0 +1,815 @@
+#include "GoldenModel.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+using namespace std;
+
+namespace ElasticC {
+
+// Set the bits of the top limb of a value above its width to the sign
+// extension
+static void NormaliseLimbs(uint64_t *value, int width, bool is_signed) {
+  int top = max((width + 63) / 64, 1) - 1, bits = width - 64 * top;
+  uint64_t &limb = value[top];
+  if (bits <= 0) {
+    limb = 0;
+  } else if (bits < 64) {
+    uint64_t mask = (uint64_t(1) << bits) - 1;
+    if (is_signed && ((limb >> (bits - 1)) & 0x1))
+      limb |= ~mask;
+    else
+      limb &= mask;
+  }
+}
+
+GoldenModel::GoldenModel(Parser::HardwareBlock *top, EvaluatedBlock *_block)
+    : block(_block) {
+  try {
+    // Ports are packed as in the HDL design, with each scalar variable of an
+    // input sliced out of its port
+    for (auto inp : top->inputs) {
+      EvaluatorVariable *var = block->parserVariables.at(inp);
+      var->SetBitOffset(0);
+      int width = var->GetType()->GetWidth();
+      inputs.push_back(Port{var->name, width});
+      inputSlots.push_back(AddSlot(width, false));
+      AddInputFields(var, inputSlots.back());
+    }
+
+    // Variables holding state have slots of their own, which must be known
+    // before anything reading them is compiled
+    vector<EvaluatorVariable *> pending = block->eval->GetAllVariables(),
+                                stateVars;
+    set<EvaluatorVariable *> seen;
+    while (!pending.empty()) {
+      EvaluatorVariable *var = pending.back();
+      pending.pop_back();
+      if (!seen.insert(var).second)
+        continue;
+      if ((dynamic_cast<ScalarEvaluatorVariable *>(var) != nullptr) ||
+          (dynamic_cast<StreamEvaluatorVariable *>(var) != nullptr) ||
+          (dynamic_cast<ExternalMemoryEvaluatorVariable *>(var) != nullptr)) {
+        AddStateVariable(var);
+        stateVars.push_back(var);
+      }
+      for (auto child : var->GetAllChildren())
+        pending.push_back(child);
+    }
+
+    for (auto op : top->outputs) {
+      EvaluatorVariable *var = block->parserVariables.at(op);
+      var->SetBitOffset(0);
+      outputs.push_back(Port{var->name, var->GetType()->GetWidth()});
+      outputFields.emplace_back();
+      AddOutputFields(var, outputFields.back());
+    }
+
+    // Then the values written to the state
+    auto registerIter = registers.begin();
+    auto streamIter = streams.begin();
+    auto memoryIter = memories.begin();
+    for (auto var : stateVars) {
+      if (auto scalar = dynamic_cast<ScalarEvaluatorVariable *>(var)) {
+        if (!scalar->IsStatic())
+          continue;
+        registerIter->enable =
+            Compile(Node{nullptr, var->GetAllChildren().at(0)});
+        registerIter->value =
+            Compile(Node{nullptr, var->GetAllChildren().at(1)});
+        ++registerIter;
+      } else if (auto streamVar =
+                     dynamic_cast<StreamEvaluatorVariable *>(var)) {
+        streamIter->enable =
+            Compile(Node{nullptr, var->GetChildByName("_wren")});
+        for (size_t i = 0; i < streamIter->chains.size(); i++)
+          streamIter->chains.at(i).source = Compile(
+              Node{nullptr, streamVar->GetChains().at(i).source});
+        ++streamIter;
+      } else {
+        auto memory = dynamic_cast<ExternalMemoryEvaluatorVariable *>(var);
+        for (const auto &access : memory->GetAccesses()) {
+          if (access.q != nullptr)
+            continue;
+          memoryIter->enable =
+              Compile(Node{nullptr, var->GetChildByName("_wren")});
+          memoryIter->address = Compile(Node{nullptr, access.address});
+          memoryIter->data =
+              Compile(Node{nullptr, var->GetChildByName("_data")});
+        }
+        ++memoryIter;
+      }
+    }
+  } catch (runtime_error &e) {
+    PrintMessage(MSG_ERROR, "failed to compile golden model of block ===" +
+                                top->name + "===: " + e.what());
+  }
+
+  block = nullptr;
+  objectSlots.clear();
+  varSlots.clear();
+  memoryReads.clear();
+  visiting.clear();
+
+  int maxLimbs = 1;
+  for (const auto &slot : slots)
+    maxLimbs = max(maxLimbs, GetLimbCount(slot.width));
+  scratch.assign(4 * (maxLimbs + 1), 0);
+  Reset();
+  PrintMessage(MSG_NOTE, "compiled golden model of block ===" + top->name +
+                             "=== with " + to_string(program.size()) +
+                             " instructions");
+}
+
+const vector<GoldenModel::Port> &GoldenModel::GetInputs() const {
+  return inputs;
+}
+
+const vector<GoldenModel::Port> &GoldenModel::GetOutputs() const {
+  return outputs;
+}
+
+bool GoldenModel::HasState() const {
+  return !registers.empty() || !streams.empty() || !memories.empty();
+}
+
+void GoldenModel::SetInput(int index, const BitConstant &value) {
+  Load(slots.at(inputSlots.at(index)), value);
+}
+
+void GoldenModel::Step() {
+  for (const auto &ins : program)
+    Execute(ins);
+  // The values written are all computed by the program, rather than being
+  // state, so the order of the updates does not matter
+  for (const auto &reg : registers)
+    if (!IsZero(slots[reg.enable]))
+      Copy(slots[reg.state], slots[reg.value]);
+  for (auto &stream : streams)
+    if (!IsZero(slots[stream.enable]))
+      UpdateStream(stream);
+  for (auto &memory : memories) {
+    uint64_t address;
+    if ((memory.enable < 0) || IsZero(slots[memory.enable]) ||
+        !GetIndex(slots[memory.address], address) ||
+        (address >= memory.contents.size() / memory.wordLimbs))
+      continue;
+    for (int i = 0; i < memory.wordLimbs; i++)
+      memory.contents[address * memory.wordLimbs + i] =
+          GetLimb(slots[memory.data], i);
+  }
+}
+
+BitConstant GoldenModel::GetOutput(int index) const {
+  BitConstant value;
+  value.resize(outputs.at(index).width);
+  for (const auto &field : outputFields.at(index)) {
+    const Slot &slot = slots[field.slot];
+    for (int i = 0; i < GetLimbCount(slot.width); i++) {
+      uint64_t limb = limbs[slot.offset + i];
+      int bits = slot.width - 64 * i;
+      if (bits < 64)
+        limb &= (uint64_t(1) << bits) - 1;
+      int low = field.offset + 64 * i;
+      int limbShift = low / 64, bitShift = low % 64;
+      value.set_limb(limbShift,
+                     value.get_limb(limbShift) | (limb << bitShift));
+      if ((bitShift != 0) && (limbShift + 1 < value.limb_count()))
+        value.set_limb(limbShift + 1, value.get_limb(limbShift + 1) |
+                                          (limb >> (64 - bitShift)));
+    }
+  }
+  return value;
+}
+
+void GoldenModel::Reset() {
+  for (auto slot : stateSlots)
+    fill_n(limbs.begin() + slots[slot].offset, GetLimbCount(slots[slot].width),
+           0);
+  for (const auto &reg : registers)
+    Load(slots[reg.state], reg.initial);
+  for (auto &stream : streams) {
+    for (auto &chain : stream.chains) {
+      fill(chain.lineBuffer.begin(), chain.lineBuffer.end(), 0);
+      chain.position = 0;
+    }
+  }
+  for (auto &memory : memories)
+    memory.contents = memory.initial;
+}
+
+int GoldenModel::AddSlot(int width, bool is_signed) {
+  slots.push_back(Slot{int(limbs.size()), width, is_signed});
+  limbs.resize(limbs.size() + GetLimbCount(width), 0);
+  return int(slots.size()) - 1;
+}
+
+int GoldenModel::AddSlot(DataType *type, const string &what) {
+  IntegerType *intType = dynamic_cast<IntegerType *>(type);
+  if (intType == nullptr)
+    throw eval_error(what + " is not a scalar integer");
+  return AddSlot(intType->width, intType->is_signed);
+}
+
+void GoldenModel::SetConstant(int slot, const BitConstant &value) {
+  const Slot &s = slots.at(slot);
+  BitConstant cast = value.cast(s.width, s.is_signed);
+  for (int i = 0; i < GetLimbCount(s.width); i++)
+    limbs[s.offset + i] = cast.get_limb(i);
+  Normalise(s);
+}
+
+void GoldenModel::AddInstruction(Opcode op, int dest,
+                                 const vector<int> &operands, int param,
+                                 OperationType oper) {
+  program.push_back(Instruction{op, oper, dest, int(args.size()),
+                                int(operands.size()), param});
+  args.insert(args.end(), operands.begin(), operands.end());
+}
+
+void GoldenModel::AddInputFields(EvaluatorVariable *var, int portSlot) {
+  if (var->IsScalar()) {
+    int slot = AddSlot(var->GetType(), "input ===" + var->name + "===");
+    AddInstruction(Opcode::Slice, slot, {portSlot}, var->GetBitOffset());
+    varSlots[var] = slot;
+  } else {
+    for (auto child : var->GetAllChildren())
+      AddInputFields(child, portSlot);
+  }
+}
+
+void GoldenModel::AddOutputFields(EvaluatorVariable *var,
+                                  vector<OutputField> &fields) {
+  if (var->IsScalar()) {
+    fields.push_back(
+        OutputField{Compile(Node{nullptr, var}), var->GetBitOffset()});
+  } else {
+    for (auto child : var->GetAllChildren())
+      AddOutputFields(child, fields);
+  }
+}
+
+void GoldenModel::AddStateVariable(EvaluatorVariable *var) {
+  auto addState = [&](EvaluatorVariable *v) {
+    int slot = AddSlot(v->GetType(), "variable ===" + v->name + "===");
+    varSlots[v] = slot;
+    stateSlots.push_back(slot);
+    return slot;
+  };
+  if (auto scalar = dynamic_cast<ScalarEvaluatorVariable *>(var)) {
+    if (scalar->IsStatic())
+      registers.push_back(
+          Register{addState(var), -1, -1, scalar->GetInitialValue()});
+  } else if (auto streamVar = dynamic_cast<StreamEvaluatorVariable *>(var)) {
+    Stream stream;
+    for (const auto &chain : streamVar->GetChains()) {
+      if (chain.depth < 0)
+        throw eval_error("line width of stream ===" + var->name +
+                         "=== is less than its window width");
+      StreamChain state;
+      for (auto item : chain.items)
+        state.items.push_back(addState(item));
+      int itemLimbs = GetLimbCount(slots[state.items.at(0)].width);
+      state.lineBuffer.assign(size_t(chain.depth) * itemLimbs, 0);
+      state.source = -1;
+      state.depth = chain.depth;
+      state.position = 0;
+      stream.chains.push_back(state);
+    }
+    stream.enable = -1;
+    streams.push_back(stream);
+  } else if (auto memoryVar =
+                 dynamic_cast<ExternalMemoryEvaluatorVariable *>(var)) {
+    if (memoryVar->IsExternal())
+      throw eval_error("memory ===" + var->name +
+                       "=== is a port of the block");
+    RAMType *type = dynamic_cast<RAMType *>(var->GetType());
+    int width = type->baseType.width;
+    Memory memory;
+    memory.wordLimbs = GetLimbCount(width);
+    // As in hardware, there is a word for every address, not just the length
+    memory.initial.assign(
+        (size_t(1) << GetAddressBusSize(type->length)) * memory.wordLimbs, 0);
+    const vector<BitConstant> &contents = memoryVar->GetContents();
+    for (size_t w = 0; w < contents.size(); w++) {
+      uint64_t *word = &memory.initial[w * memory.wordLimbs];
+      BitConstant value = contents.at(w).cast(width, type->baseType.is_signed);
+      for (int i = 0; i < memory.wordLimbs; i++)
+        word[i] = value.get_limb(i);
+      NormaliseLimbs(word, width, type->baseType.is_signed);
+    }
+    memory.enable = memory.address = memory.data = -1;
+    for (const auto &access : memoryVar->GetAccesses())
+      if (access.q != nullptr)
+        memoryReads[access.q] = make_pair(int(memories.size()), access.address);
+    memories.push_back(memory);
+  }
+}
+
+int GoldenModel::GetSlot(const Node &node) {
+  if (node.obj != nullptr) {
+    auto found = objectSlots.find(node.obj);
+    return (found == objectSlots.end()) ? -1 : found->second;
+  }
+  auto found = varSlots.find(node.var);
+  return (found == varSlots.end()) ? -1 : found->second;
+}
+
+vector<GoldenModel::Node> GoldenModel::GetDependencies(const Node &node) {
+  vector<Node> deps;
+  if (node.obj != nullptr) {
+    if (auto var = dynamic_cast<EvalVariable *>(node.obj))
+      deps.push_back(Node{nullptr, var->GetVariable()});
+    else
+      for (auto operand : node.obj->GetOperands())
+        deps.push_back(Node{operand, nullptr});
+  } else {
+    auto read = memoryReads.find(node.var);
+    auto value = block->vars.find(node.var);
+    if (read != memoryReads.end())
+      deps.push_back(Node{nullptr, read->second.second});
+    else if (value != block->vars.end())
+      deps.push_back(Node{value->second, nullptr});
+  }
+  return deps;
+}
+
+void GoldenModel::CompileNode(const Node &node) {
+  if (node.obj == nullptr) {
+    // Variables are driven by their values, converted to their own type
+    EvaluatorVariable *var = node.var;
+    int slot = AddSlot(var->GetType(), "variable ===" + var->name + "===");
+    auto read = memoryReads.find(var);
+    auto value = block->vars.find(var);
+    if (read != memoryReads.end())
+      AddInstruction(Opcode::Read, slot, {varSlots.at(read->second.second)},
+                     read->second.first);
+    else if (value != block->vars.end())
+      AddInstruction(Opcode::Cast, slot, {objectSlots.at(value->second)});
+    else if (var->HasDefaultValue())
+      SetConstant(slot, var->GetDefaultValue());
+    varSlots[var] = slot;
+    return;
+  }
+
+  EvalObject *obj = node.obj;
+  if (auto var = dynamic_cast<EvalVariable *>(obj)) {
+    objectSlots[obj] = varSlots.at(var->GetVariable());
+    return;
+  }
+  int slot = AddSlot(obj->GetDataType(block->eval),
+                     "expression ===" + obj->GetID() + "===");
+  objectSlots[obj] = slot;
+  vector<int> operands;
+  for (auto operand : obj->GetOperands())
+    operands.push_back(objectSlots.at(operand));
+
+  if (dynamic_cast<EvalConstant *>(obj) != nullptr) {
+    SetConstant(slot, obj->GetScalarConstValue(block->eval));
+  } else if (dynamic_cast<EvalDontCare *>(obj) != nullptr) {
+    // Synthesised as zero, which the slot already is
+  } else if (dynamic_cast<EvalCast *>(obj) != nullptr) {
+    AddInstruction(Opcode::Cast, slot, operands);
+  } else if (auto basic = dynamic_cast<EvalBasicOperation *>(obj)) {
+    OperationType oper = basic->GetOperationType();
+    switch (oper) {
+    case B_ADD:
+    case B_SUB:
+    case B_MUL:
+    case B_DIV:
+    case B_MOD:
+    case B_LS:
+    case B_RS:
+    case B_BWOR:
+    case B_BWAND:
+    case B_BWXOR:
+    case B_LOR:
+    case B_LAND:
+    case B_EQ:
+    case B_NEQ:
+    case B_GT:
+    case B_GTE:
+    case B_LT:
+    case B_LTE:
+    case U_LNOT:
+    case U_MINUS:
+    case U_BWNOT:
+      AddInstruction(Opcode::Basic, slot, operands, 0, oper);
+      break;
+    default:
+      throw eval_error("operator" + LookupOperation(oper)->token +
+                       " cannot be modelled");
+    }
+  } else if (auto special = dynamic_cast<EvalSpecialOperation *>(obj)) {
+    switch (special->type) {
+    case SpecialOperationType::T_COND:
+      AddInstruction(Opcode::Cond, slot, operands);
+      break;
+    case SpecialOperationType::ARRAY_SEL:
+      AddInstruction(Opcode::Select, slot, operands);
+      break;
+    case SpecialOperationType::ARRAY_WRITE:
+      AddInstruction(Opcode::ArrayWrite, slot, operands,
+                     special->GetParameters().at(0).intval());
+      break;
+    case SpecialOperationType::MULTI_ADD:
+      AddInstruction(Opcode::Sum, slot, operands);
+      break;
+    }
+  } else {
+    throw eval_error("expression ===" + obj->GetID() +
+                     "=== cannot be modelled");
+  }
+}
+
+int GoldenModel::Compile(Node root) {
+  // Expressions may be too deep to compile recursively, so the graph is
+  // walked depth first with an explicit stack, compiling each node once all
+  // of its dependencies have been
+  vector<pair<Node, bool>> stack{make_pair(root, false)};
+  while (!stack.empty()) {
+    Node node = stack.back().first;
+    bool expanded = stack.back().second;
+    stack.pop_back();
+    if (GetSlot(node) >= 0)
+      continue;
+    if (expanded) {
+      CompileNode(node);
+      continue;
+    }
+    const void *key = node.obj;
+    if (key == nullptr)
+      key = node.var;
+    if (!visiting.insert(key).second)
+      throw eval_error("combinational loop through " +
+                       ((node.obj != nullptr)
+                            ? "expression ===" + node.obj->GetID()
+                            : "variable ===" + node.var->name) +
+                       "===");
+    stack.push_back(make_pair(node, true));
+    for (const auto &dep : GetDependencies(node))
+      if (GetSlot(dep) < 0)
+        stack.push_back(make_pair(dep, false));
+  }
+  return GetSlot(root);
+}
+
+int GoldenModel::GetLimbCount(int width) { return max((width + 63) / 64, 1); }
+
+uint64_t GoldenModel::GetLimb(const Slot &s, int i) const {
+  if (i < GetLimbCount(s.width))
+    return limbs[s.offset + i];
+  return IsNegative(s) ? ~uint64_t(0) : 0;
+}
+
+bool GoldenModel::IsNegative(const Slot &s) const {
+  return s.is_signed &&
+         (int64_t(limbs[s.offset + GetLimbCount(s.width) - 1]) < 0);
+}
+
+bool GoldenModel::IsZero(const Slot &s) const {
+  for (int i = 0; i < GetLimbCount(s.width); i++)
+    if (limbs[s.offset + i] != 0)
+      return false;
+  return true;
+}
+
+int GoldenModel::Compare(const Slot &a, const Slot &b) const {
+  bool aNeg = IsNegative(a), bNeg = IsNegative(b);
+  if (aNeg != bNeg)
+    return aNeg ? -1 : 1;
+  // Values with the same sign compare as their sign extended limbs do
+  for (int i = max(GetLimbCount(a.width), GetLimbCount(b.width)) - 1; i >= 0;
+       i--) {
+    uint64_t x = GetLimb(a, i), y = GetLimb(b, i);
+    if (x != y)
+      return (x < y) ? -1 : 1;
+  }
+  return 0;
+}
+
+bool GoldenModel::GetIndex(const Slot &s, uint64_t &index) const {
+  int count = GetLimbCount(s.width);
+  auto getBits = [&](int i) {
+    uint64_t limb = limbs[s.offset + i];
+    int bits = s.width - 64 * i;
+    return (bits < 64) ? (limb & ((uint64_t(1) << bits) - 1)) : limb;
+  };
+  for (int i = 1; i < count; i++)
+    if (getBits(i) != 0)
+      return false;
+  index = getBits(0);
+  return true;
+}
+
+void GoldenModel::Normalise(const Slot &s) {
+  NormaliseLimbs(&limbs[s.offset], s.width, s.is_signed);
+}
+
+void GoldenModel::Copy(const Slot &dest, const Slot &src) {
+  for (int i = 0; i < GetLimbCount(dest.width); i++)
+    limbs[dest.offset + i] = GetLimb(src, i);
+  Normalise(dest);
+}
+
+void GoldenModel::Load(const Slot &dest, const BitConstant &value) {
+  for (int i = 0; i < GetLimbCount(dest.width); i++)
+    limbs[dest.offset + i] = value.get_limb(i);
+  Normalise(dest);
+}
+
+void GoldenModel::Execute(const Instruction &ins) {
+  const int *operands = &args[ins.firstArg];
+  const Slot &dest = slots[ins.dest];
+  uint64_t *result = &limbs[dest.offset];
+  int count = GetLimbCount(dest.width);
+  switch (ins.op) {
+  case Opcode::Slice: {
+    const Slot &port = slots[operands[0]];
+    int limbShift = ins.param / 64, bitShift = ins.param % 64;
+    for (int i = 0; i < count; i++) {
+      uint64_t limb = GetLimb(port, i + limbShift) >> bitShift;
+      if (bitShift != 0)
+        limb |= GetLimb(port, i + limbShift + 1) << (64 - bitShift);
+      result[i] = limb;
+    }
+    Normalise(dest);
+  } break;
+  case Opcode::Cast:
+    Copy(dest, slots[operands[0]]);
+    break;
+  case Opcode::Basic:
+    ExecuteBasic(ins.oper, dest, operands);
+    break;
+  case Opcode::Cond:
+    Copy(dest, slots[operands[IsZero(slots[operands[0]]) ? 2 : 1]]);
+    break;
+  case Opcode::Select: {
+    // An index past the end gives zero, as the multiplexer built for it does
+    uint64_t index;
+    if (GetIndex(slots[operands[ins.numArgs - 1]], index) &&
+        (index < uint64_t(ins.numArgs - 1)))
+      Copy(dest, slots[operands[index]]);
+    else
+      fill_n(result, count, 0);
+  } break;
+  case Opcode::ArrayWrite: {
+    uint64_t index;
+    bool match = !IsNegative(slots[operands[2]]) &&
+                 GetIndex(slots[operands[2]], index) &&
+                 (index == uint64_t(ins.param));
+    Copy(dest, slots[operands[match ? 1 : 0]]);
+  } break;
+  case Opcode::Sum:
+    fill_n(result, count, 0);
+    for (int j = 0; j < ins.numArgs; j++) {
+      unsigned __int128 carry = 0;
+      for (int i = 0; i < count; i++) {
+        carry += (unsigned __int128)(result[i]);
+        carry += GetLimb(slots[operands[j]], i);
+        result[i] = uint64_t(carry);
+        carry >>= 64;
+      }
+    }
+    Normalise(dest);
+    break;
+  case Opcode::Read: {
+    const Memory &memory = memories[ins.param];
+    uint64_t address;
+    if (GetIndex(slots[operands[0]], address) &&
+        (address < memory.contents.size() / memory.wordLimbs))
+      copy_n(memory.contents.begin() + address * memory.wordLimbs,
+             min(count, memory.wordLimbs), result);
+    else
+      fill_n(result, count, 0);
+  } break;
+  }
+}
+
+void GoldenModel::ExecuteBasic(OperationType oper, const Slot &dest,
+                               const int *operands) {
+  const Slot &a = slots[operands[0]];
+  uint64_t *result = &limbs[dest.offset];
+  int count = GetLimbCount(dest.width);
+  auto setCondition = [&](bool condition) {
+    result[0] = condition ? 1 : 0;
+    fill_n(result + 1, count - 1, 0);
+  };
+  // Number of places to shift by, given a limit past which the result no
+  // longer changes. Negative amounts shift by nothing
+  auto getShift = [&](const Slot &amount, int limit) {
+    if (IsNegative(amount))
+      return 0;
+    for (int i = 1; i < GetLimbCount(amount.width); i++)
+      if (limbs[amount.offset + i] != 0)
+        return limit;
+    return int(min(limbs[amount.offset], uint64_t(limit)));
+  };
+
+  if ((oper == U_MINUS) || (oper == U_BWNOT)) {
+    uint64_t carry = (oper == U_MINUS) ? 1 : 0;
+    for (int i = 0; i < count; i++) {
+      uint64_t x = GetLimb(a, i);
+      result[i] = ~x + carry;
+      carry = carry && (x == 0);
+    }
+    Normalise(dest);
+    return;
+  }
+  if (oper == U_LNOT) {
+    setCondition(IsZero(a));
+    Normalise(dest);
+    return;
+  }
+
+  const Slot &b = slots[operands[1]];
+  switch (oper) {
+  case B_ADD:
+  case B_SUB: {
+    // Subtraction adds the inverse of b plus one
+    bool sub = (oper == B_SUB);
+    unsigned __int128 carry = sub ? 1 : 0;
+    for (int i = 0; i < count; i++) {
+      uint64_t y = GetLimb(b, i);
+      carry += (unsigned __int128)(GetLimb(a, i)) + (sub ? ~y : y);
+      result[i] = uint64_t(carry);
+      carry >>= 64;
+    }
+  } break;
+  case B_MUL:
+    // Only the limbs of the product within the result are needed, which are
+    // the same whether the operands are signed or not once sign extended
+    fill_n(result, count, 0);
+    for (int i = 0; i < count; i++) {
+      uint64_t x = GetLimb(a, i);
+      if (x == 0)
+        continue;
+      unsigned __int128 carry = 0;
+      for (int j = 0; i + j < count; j++) {
+        carry += (unsigned __int128)(x)*GetLimb(b, j) + result[i + j];
+        result[i + j] = uint64_t(carry);
+        carry >>= 64;
+      }
+    }
+    break;
+  case B_DIV:
+  case B_MOD:
+    ExecuteDivide(oper, dest, a, b);
+    break;
+  case B_LS: {
+    int shift = getShift(b, 64 * count);
+    int limbShift = shift / 64, bitShift = shift % 64;
+    for (int i = 0; i < count; i++) {
+      uint64_t limb = 0;
+      if (i >= limbShift) {
+        limb = GetLimb(a, i - limbShift) << bitShift;
+        if ((bitShift != 0) && (i > limbShift))
+          limb |= GetLimb(a, i - limbShift - 1) >> (64 - bitShift);
+      }
+      result[i] = limb;
+    }
+  } break;
+  case B_RS: {
+    // Arithmetic if a is signed, as the sign extension is shifted in
+    int shift = getShift(b, 64 * (GetLimbCount(a.width) + 1));
+    int limbShift = shift / 64, bitShift = shift % 64;
+    for (int i = 0; i < count; i++) {
+      uint64_t limb = GetLimb(a, i + limbShift) >> bitShift;
+      if (bitShift != 0)
+        limb |= GetLimb(a, i + limbShift + 1) << (64 - bitShift);
+      result[i] = limb;
+    }
+  } break;
+  case B_BWOR:
+  case B_BWAND:
+  case B_BWXOR:
+    for (int i = 0; i < count; i++) {
+      uint64_t x = GetLimb(a, i), y = GetLimb(b, i);
+      result[i] = (oper == B_BWOR) ? (x | y)
+                                   : ((oper == B_BWAND) ? (x & y) : (x ^ y));
+    }
+    break;
+  case B_LOR:
+    setCondition(!IsZero(a) || !IsZero(b));
+    break;
+  case B_LAND:
+    setCondition(!IsZero(a) && !IsZero(b));
+    break;
+  case B_EQ:
+    setCondition(Compare(a, b) == 0);
+    break;
+  case B_NEQ:
+    setCondition(Compare(a, b) != 0);
+    break;
+  case B_LT:
+    setCondition(Compare(a, b) < 0);
+    break;
+  case B_LTE:
+    setCondition(Compare(a, b) <= 0);
+    break;
+  case B_GT:
+    setCondition(Compare(a, b) > 0);
+    break;
+  case B_GTE:
+    setCondition(Compare(a, b) >= 0);
+    break;
+  default:
+    break;
+  }
+  Normalise(dest);
+}
+
+void GoldenModel::ExecuteDivide(OperationType oper, const Slot &dest,
+                                const Slot &a, const Slot &b) {
+  // Divide the magnitudes, with the quotient truncated towards zero and the
+  // remainder taking the sign of the dividend as in C
+  int aCount = GetLimbCount(a.width), bCount = GetLimbCount(b.width);
+  uint64_t *num = scratch.data(), *den = num + aCount, *quot = den + bCount,
+           *rem = quot + aCount;
+  bool aNeg = IsNegative(a), bNeg = IsNegative(b);
+  auto getMagnitude = [&](const Slot &s, bool negative, uint64_t *mag,
+                          int count) {
+    uint64_t carry = 1;
+    for (int i = 0; i < count; i++) {
+      uint64_t x = GetLimb(s, i);
+      mag[i] = negative ? (~x + carry) : x;
+      carry = carry && (x == 0);
+    }
+  };
+  getMagnitude(a, aNeg, num, aCount);
+  getMagnitude(b, bNeg, den, bCount);
+
+  fill_n(quot, aCount, 0);
+  fill_n(rem, bCount + 1, 0);
+  if (all_of(den, den + bCount, [](uint64_t x) { return x == 0; })) {
+    // There is no right answer for a division by zero, so give what the
+    // divider does: a quotient of all ones, and the low bits of the dividend
+    // as the remainder
+    for (int i = 0; i < aCount; i++) {
+      int bits = a.width - 64 * i;
+      quot[i] = (bits < 64) ? ((uint64_t(1) << bits) - 1) : ~uint64_t(0);
+    }
+    for (int i = 0; (i < bCount) && (i < aCount); i++) {
+      int bits = b.width - 64 * i;
+      rem[i] = (bits < 64) ? (num[i] & ((uint64_t(1) << bits) - 1)) : num[i];
+    }
+  } else if ((aCount == 1) && (bCount == 1)) {
+    quot[0] = num[0] / den[0];
+    rem[0] = num[0] % den[0];
+  } else {
+    // Restoring division, a bit at a time
+    for (int bit = 64 * aCount - 1; bit >= 0; bit--) {
+      for (int i = bCount; i > 0; i--)
+        rem[i] = (rem[i] << 1) | (rem[i - 1] >> 63);
+      rem[0] = (rem[0] << 1) | ((num[bit / 64] >> (bit % 64)) & 0x1);
+      bool fits = true;
+      for (int i = bCount; i >= 0; i--) {
+        uint64_t d = (i < bCount) ? den[i] : 0;
+        if (rem[i] != d) {
+          fits = (rem[i] > d);
+          break;
+        }
+      }
+      if (!fits)
+        continue;
+      unsigned __int128 carry = 1;
+      for (int i = 0; i <= bCount; i++) {
+        carry += (unsigned __int128)(rem[i]) + ~((i < bCount) ? den[i] : 0);
+        rem[i] = uint64_t(carry);
+        carry >>= 64;
+      }
+      quot[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+  }
+
+  const uint64_t *mag = (oper == B_DIV) ? quot : rem;
+  int magCount = (oper == B_DIV) ? aCount : (bCount + 1);
+  bool negative = (oper == B_DIV) ? (aNeg != bNeg) : aNeg;
+  uint64_t *result = &limbs[dest.offset];
+  uint64_t carry = 1;
+  for (int i = 0; i < GetLimbCount(dest.width); i++) {
+    uint64_t x = (i < magCount) ? mag[i] : 0;
+    result[i] = negative ? (~x + carry) : x;
+    carry = carry && (x == 0);
+  }
+  Normalise(dest);
+}
+
+void GoldenModel::UpdateStream(Stream &stream) {
+  // Chains are shifted in order, so that a chain feeding an earlier one still
+  // holds its old values when they are passed on
+  for (auto &chain : stream.chains) {
+    for (size_t i = chain.items.size() - 1; i > 0; i--)
+      Copy(slots[chain.items[i]], slots[chain.items[i - 1]]);
+    const Slot &newest = slots[chain.items[0]], &source = slots[chain.source];
+    if (chain.depth == 0) {
+      Copy(newest, source);
+    } else {
+      int itemLimbs = GetLimbCount(newest.width);
+      uint64_t *entry = &chain.lineBuffer[size_t(chain.position) * itemLimbs];
+      copy_n(entry, itemLimbs, &limbs[newest.offset]);
+      copy_n(&limbs[source.offset], itemLimbs, entry);
+      chain.position = (chain.position + 1) % chain.depth;
+    }
+  }
+}
+} // namespace ElasticC
@@ -0,0 +1,182 @@
+#pragma once
+#include "BitConstant.hpp"
+#include "Evaluator.hpp"
+#include "Operations.hpp"
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace ElasticC {
+/*
+A reference model of a block, compiled from its evaluated block before it is
+optimised or synthesised, to check the netlist against.
+
+The expressions giving each variable's value are flattened into a list of
+instructions in topological order, each writing the value of one expression to
+a slot of its own in a single array of 64-bit limbs. A value is held at the
+width and signedness of its expression, with any bits above the width in the
+top limb kept as the sign extension, and is computed exactly as constant
+folding (PerformConstOperation) would before being truncated to that width.
+Evaluating a sample is then a loop over the instructions, which never
+allocates.
+
+Static variables, streams and memories inside the block keep their state from
+one sample to the next. Each sample reads the state left by the one before,
+with its writes taking effect once it has been evaluated, as they would in
+hardware.
+*/
+class GoldenModel {
+public:
+  // Compile the model of a block, which does not refer to the evaluated block
+  // once compiled. Raises an error for anything that cannot be modelled, such
+  // as memories that are ports of the block
+  GoldenModel(Parser::HardwareBlock *top, EvaluatedBlock *block);
+
+  // A top level port, named and packed as it is in the HDL design
+  struct Port {
+    string name;
+    int width;
+  };
+  const vector<Port> &GetInputs() const;
+  const vector<Port> &GetOutputs() const;
+  // Return true if the block has static variables, streams or memories, so
+  // that its outputs depend on earlier samples
+  bool HasState() const;
+
+  // Set the value of an input port, given by its index in GetInputs
+  void SetInput(int index, const BitConstant &value);
+  // Evaluate a sample from the current inputs, then update the state
+  void Step();
+  // Get the value of an output port for the last sample, given by its index in
+  // GetOutputs
+  BitConstant GetOutput(int index) const;
+  // Clear all state, and restore the initial contents of memories
+  void Reset();
+
+private:
+  // A value held in the limb array
+  struct Slot {
+    int offset; // index of the least significant limb
+    int width;
+    bool is_signed;
+  };
+  enum class Opcode {
+    Slice,      // bits of an input port, from bit param of operand 0
+    Cast,       // operand 0 converted to the result type
+    Basic,      // a basic operation on the operands
+    Cond,       // operand 1 if operand 0 is non-zero, otherwise operand 2
+    Select,     // the operand indexed by the last operand, or zero
+    ArrayWrite, // operand 1 if operand 2 is equal to param, otherwise operand 0
+    Sum,        // the sum of all the operands
+    Read,       // the word of memory param at the address in operand 0
+  };
+  struct Instruction {
+    Opcode op;
+    OperationType oper; // Basic only
+    int dest;
+    // Operand slots are held in args, starting at firstArg
+    int firstArg, numArgs;
+    int param;
+  };
+  // A scalar variable packed into an output port
+  struct OutputField {
+    int slot;
+    int offset;
+  };
+  // A static variable, written with value when enable is non-zero, holding
+  // initial after a reset
+  struct Register {
+    int state, enable, value;
+    BitConstant initial;
+  };
+  // A chain of a stream's items, newest first, shifted along when the
+  // stream's enable is non-zero. The newest is fed from source, through a line
+  // buffer holding depth items if depth is not zero
+  struct StreamChain {
+    vector<int> items;
+    int source, depth;
+    vector<uint64_t> lineBuffer;
+    int position;
+  };
+  struct Stream {
+    vector<StreamChain> chains;
+    int enable;
+  };
+  // A memory inside the block, with a word for every address. A ROM has no
+  // write port, so its enable is -1
+  struct Memory {
+    int wordLimbs;
+    vector<uint64_t> contents, initial;
+    int enable, address, data;
+  };
+
+  vector<Port> inputs, outputs;
+  vector<int> inputSlots;
+  vector<vector<OutputField>> outputFields;
+
+  vector<Slot> slots;
+  vector<uint64_t> limbs;
+  vector<Instruction> program;
+  vector<int> args;
+  vector<Register> registers;
+  vector<Stream> streams;
+  vector<Memory> memories;
+  // Slots holding state, cleared on reset
+  vector<int> stateSlots;
+  // Space for the magnitudes, quotient and remainder of a division
+  vector<uint64_t> scratch;
+
+  // Used only while compiling, as the evaluated block may be released later
+  EvaluatedBlock *block;
+  map<EvalObject *, int> objectSlots;
+  map<EvaluatorVariable *, int> varSlots;
+  // Memory and address variable of each memory read
+  map<EvaluatorVariable *, pair<int, EvaluatorVariable *>> memoryReads;
+  set<const void *> visiting;
+
+  // An expression or a variable in the graph being compiled
+  struct Node {
+    EvalObject *obj;
+    EvaluatorVariable *var;
+  };
+  int AddSlot(int width, bool is_signed);
+  int AddSlot(DataType *type, const string &what);
+  void SetConstant(int slot, const BitConstant &value);
+  void AddInstruction(Opcode op, int dest, const vector<int> &operands,
+                      int param = 0, OperationType oper = B_ADD);
+  void AddInputFields(EvaluatorVariable *var, int portSlot);
+  void AddOutputFields(EvaluatorVariable *var, vector<OutputField> &fields);
+  void AddStateVariable(EvaluatorVariable *var);
+  int GetSlot(const Node &node);
+  vector<Node> GetDependencies(const Node &node);
+  void CompileNode(const Node &node);
+  // Compile the instructions computing an expression or variable, and any it
+  // depends on, returning the slot holding its value
+  int Compile(Node root);
+
+  static int GetLimbCount(int width);
+  uint64_t GetLimb(const Slot &s, int i) const;
+  bool IsNegative(const Slot &s) const;
+  bool IsZero(const Slot &s) const;
+  // Return -1, 0 or 1 as a is less than, equal to or greater than b
+  int Compare(const Slot &a, const Slot &b) const;
+  // Get the value of a slot as an unsigned index, returning false if it is too
+  // large for one
+  bool GetIndex(const Slot &s, uint64_t &index) const;
+  // Keep the bits of the top limb above the width as the sign extension
+  void Normalise(const Slot &s);
+  // Convert the value of src to the type of dest
+  void Copy(const Slot &dest, const Slot &src);
+  // Set a slot to a constant of its width
+  void Load(const Slot &dest, const BitConstant &value);
+  void Execute(const Instruction &ins);
+  void ExecuteBasic(OperationType oper, const Slot &dest, const int *operands);
+  void ExecuteDivide(OperationType oper, const Slot &dest, const Slot &a,
+                     const Slot &b);
+  void UpdateStream(Stream &stream);
+};
+} // namespace ElasticC
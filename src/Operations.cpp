@@ -4,22 +4,47 @@
 #include <stdexcept>
 namespace ElasticC {
 int GetResultWidth(vector<int> inWidths, OperationType oper,
-                   vector<BitConstant *> constants) {
+                   vector<BitConstant *> constants,
+                   const vector<bool> &inSigned) {
+  bool any_signed = any_of(inSigned.begin(), inSigned.end(),
+                           [](bool s) { return s; });
   switch (oper) {
   case B_ADD:
-    return max(inWidths[0], inWidths[1]) + 1;
-  case B_SUB:
-    return max(inWidths[0], inWidths[1]) + 1;
+  case B_SUB: {
+    // An unsigned operand of a signed result needs an extra bit, or mixing
+    // signs would wrap values such as 1 + 3 negative
+    int width = 0;
+    for (int i = 0; i < 2; i++)
+      width = max(width,
+                  inWidths[i] + ((any_signed && !inSigned.at(i)) ? 1 : 0));
+    return width + 1;
+  }
   case B_MUL:
     return inWidths[0] + inWidths[1];
-  case B_DIV:
+  case B_DIV: {
+    // The quotient magnitude is at most that of the dividend, reduced by the
+    // size of a constant divisor. A signed result needs an extra bit, as
+    // magnitudes up to 2^(width-1) are possible (e.g. -128 / -1)
+    int shift = 0;
     if (constants[1] != nullptr) {
-      return max((inWidths[0] - inWidths[1]) + 1, 1);
-    } else {
-      return inWidths[0];
+      // |divisor| >= 2^i where i is the highest bit not equal to the sign
+      BitConstant *divisor = constants[1];
+      for (int i = divisor->width() - 1; i >= 0; i--) {
+        if (divisor->get_bit(i) != divisor->is_negative()) {
+          shift = i;
+          break;
+        }
+      }
     }
+    return max(inWidths[0] - shift, 1) + (any_signed ? 1 : 0);
+  }
   case B_MOD:
-    return inWidths[1];
+    // The remainder takes the sign of the dividend, so a signed dividend and
+    // unsigned divisor need an extra bit
+    if (any_signed && !inSigned.at(1))
+      return inWidths[1] + 1;
+    else
+      return inWidths[1];
   case B_LS:
     if (constants[1] != nullptr) {
       return inWidths[0] + constants[1]->intval();
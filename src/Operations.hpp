@@ -59,9 +59,10 @@ extern const vector<Operation> binaryOperations;
 
 // Returns the width of the result of performing an operation on two values
 // constants[i] is nullptr if operand i is not a constant, or its value
-// otherwise
+// otherwise. inSigned[i] is true if operand i is signed
 int GetResultWidth(vector<int> inWidths, OperationType oper,
-                   vector<BitConstant *> constants);
+                   vector<BitConstant *> constants,
+                   const vector<bool> &inSigned = {});
 
 // Return whether or not an operation has boolean result
 bool HasBooleanResult(OperationType oper);
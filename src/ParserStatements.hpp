@@ -1,4 +1,5 @@
 #pragma once
+#include "Arena.hpp"
 #include "Attributes.hpp"
 #include "BitConstant.hpp"
 #include "DataTypes.hpp"
@@ -17,7 +18,7 @@ class Function;
 This is a fundamental statement. It could be an operation; or something more
 advanced like an if statement
 */
-class Statement {
+class Statement : public ArenaAllocated<ArenaKind::Graph> {
 public:
   Statement();
   Statement(const AttributeSet &attr);
@@ -1,9 +1,29 @@
 #include "Phases.hpp"
+#include "Arena.hpp"
+#include "EvalOptimiser.hpp"
+#include "hdl/HDLBatchSimulator.hpp"
+#include "hdl/HDLCoreDevices.hpp"
+#include "hdl/HDLDSPMapper.hpp"
+#include "hdl/HDLPipeliner.hpp"
+#include "hdl/HDLScheduler.hpp"
+#include "hdl/HDLSimulator.hpp"
+#include "hdl/HDLTimingAnalysis.hpp"
+#include "timing/DeviceTiming.hpp"
 #include "Util.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <iterator>
+#include <random>
+#include <sstream>
 using namespace std;
 
 namespace ElasticC {
 
+// Arenas for the object graphs created by each phase. The parse and evaluation
+// arenas are released in bulk once the HDL design has been made
+static Arena parseArena, evalArena, netlistArena;
+
 ParserState LoadCode(string file) {
   ifstream ifs(file);
   if (!ifs)
@@ -15,6 +35,7 @@ ParserState LoadCode(string file) {
 };
 
 Parser::GlobalScope *DoParse(ParserState &code) {
+  Arena::SetCurrent(ArenaKind::Graph, &parseArena);
   Parser::GlobalScope *gs = new Parser::GlobalScope();
 	PrintMessage(MSG_DEBUG, "starting parse");
   Parser::ECCParser(code, *gs).ParseAll();
@@ -23,16 +44,50 @@ Parser::GlobalScope *DoParse(ParserState &code) {
 
 EvaluatedBlock EvaluateCode(Evaluator *eval, Parser::HardwareBlock *top) {
 	PrintMessage(MSG_NOTE, "evaluating block ===" + top->name + "===");
+  Arena::SetCurrent(ArenaKind::Graph, &evalArena);
   eval->EvaluateBlock(top);
   return eval->GetEvaluatedBlock();
 }
 
-void OptimiseBlock(EvaluatedBlock *block) {
-	// TODO
+GoldenModel *CompileGoldenModel(Parser::HardwareBlock *top,
+                                EvaluatedBlock *block) {
+  return new GoldenModel(top, block);
+}
+
+DeviceTiming *LoadDeviceTiming(string device) {
+  if (device == "")
+    return new DeviceTiming();
+  DeviceTiming *timing = DeviceTiming::Load(device);
+  PrintMessage(MSG_NOTE, "using timing library ===" + device + "===");
+  return timing;
+}
+
+void OptimiseBlock(Parser::HardwareBlock *top, EvaluatedBlock *block,
+                   DeviceTiming *timing) {
+  // Multiplies are only mapped to DSP blocks in clocked designs, as they are
+  // registered
+  EvalOptimiser(block, timing, top->params.has_clock && timing->HasDSPs())
+      .Run();
+}
+
+SynthContext MakeHDLDesign(Parser::HardwareBlock *top, EvaluatedBlock *block,
+                           DeviceTiming *timing, bool elastic) {
+  Arena::SetCurrent(ArenaKind::Netlist, &netlistArena);
+  SynthContext sc = MakeSynthContext(top, block, elastic);
+  sc.timing = timing;
+  return sc;
 }
 
-SynthContext MakeHDLDesign(Parser::HardwareBlock *top, EvaluatedBlock *block) {
-  return MakeSynthContext(top, block);
+void ReleaseFrontend(SynthContext &sc) {
+  PrintMessage(MSG_DEBUG,
+               "releasing " +
+                   to_string(parseArena.GetUsage() + evalArena.GetUsage()) +
+                   " bytes used by parser and evaluator");
+  ClearInternedEvalObjects();
+  sc.objectNets.clear();
+  Arena::SetCurrent(ArenaKind::Graph, nullptr);
+  evalArena.Release();
+  parseArena.Release();
 }
 
 void OptimiseHDLDesign(HDLGen::HDLDesign *hdld, SynthContext &sc) {
@@ -40,12 +95,218 @@ void OptimiseHDLDesign(HDLGen::HDLDesign *hdld, SynthContext &sc) {
 }
 
 
-void PipelineHDLDesign(HDLGen::HDLDesign *hdld, SynthContext &sc) {
-  // TODO
+// Pass the outputs of an elastic design through a skid buffer, given the valid
+// signal at the end of the pipeline. The whole pipeline advances together, as
+// long as the skid register is empty, so a value arriving while the outputs are
+// stalled can always be held there. The pipeline then stalls until the skid
+// register is emptied, so the ready signal back to the pipeline and the inputs
+// comes straight from a register rather than from the output_ready input. The
+// outputs are registered, adding a cycle of latency
+static void AddSkidBuffer(HDLGen::HDLDesign *hdld, SynthContext &sc,
+                          HDLGen::HDLSignal *valid) {
+  HDLGen::HDLPortType *logicType = new HDLGen::LogicSignalPortType();
+  auto makeOperation = [&](OperationType oper,
+                           const vector<HDLGen::HDLSignal *> &inputs,
+                           string prefix) {
+    HDLGen::HDLSignal *net = hdld->CreateTempSignal(logicType, prefix);
+    hdld->AddDevice(new HDLGen::OperationHDLDevice(oper, inputs, net));
+    return net;
+  };
+  // Choose between two logic values, which keeps functions of three signals
+  // to a single LUT level
+  auto makeSelect = [&](HDLGen::HDLSignal *sel, HDLGen::HDLSignal *if_low,
+                        HDLGen::HDLSignal *if_high, string prefix) {
+    HDLGen::HDLSignal *selNum = hdld->CreateTempSignal(
+        new HDLGen::NumericPortType(1, false), prefix + "_sel");
+    hdld->AddDevice(new HDLGen::BufferHDLDevice(sel, selNum));
+    HDLGen::HDLSignal *net = hdld->CreateTempSignal(if_low->sigType, prefix);
+    hdld->AddDevice(
+        new HDLGen::MultiplexerHDLDevice({if_low, if_high}, selNum, net));
+    return net;
+  };
+  // The block's own clock enable, which is often tied high, stalls everything
+  HDLGen::HDLSignal *enable = sc.external_clock_enable;
+  auto gate = [&](HDLGen::HDLSignal *net, string prefix) {
+    return (enable == hdld->vcc)
+               ? net
+               : makeOperation(B_BWAND, {net, enable}, prefix);
+  };
+
+  // The multiplexer in front of the output registers comes after the last
+  // pipeline stage, so if that leaves too little of the clock period the data
+  // and valid signal are registered first
+  double budget = (1.0 / sc.clock->clockInfo.frequency) -
+                  sc.timing->GetFFSetupTime();
+  double muxDelay =
+      sc.timing->GetMultiplexerDelay(2) + sc.timing->GetRoutingDelay(1);
+  bool registerPipe = false;
+  for (auto port : hdld->ports) {
+    HDLGen::HDLSignal *net = port->connectedNet;
+    if ((port->dir == HDLGen::PortDirection::Output) &&
+        (net != sc.output_valid) && (net != sc.input_ready) &&
+        (net->timing_delay.domain == sc.clock) &&
+        (net->timing_delay.value + muxDelay > budget))
+      registerPipe = true;
+  }
+  if (registerPipe) {
+    HDLGen::HDLSignal *next = hdld->CreateTempSignal(logicType, "valid");
+    hdld->AddDevice(new HDLGen::RegisterHDLDevice(
+        valid, sc.clock, next, sc.clock_enable, sc.reset, true));
+    valid = next;
+  }
+
+  // Each control register is loaded from a single level of logic, fed only by
+  // registers and output_ready. The skid register's state is kept inverted, so
+  // that it can drive the pipeline enable directly
+  HDLGen::HDLSignal *skidEmpty =
+      hdld->CreateTempSignal(logicType, "skid_empty");
+  if (enable == hdld->vcc)
+    hdld->AddDevice(new HDLGen::BufferHDLDevice(skidEmpty, sc.clock_enable));
+  else
+    hdld->AddDevice(new HDLGen::OperationHDLDevice(
+        B_BWAND, {skidEmpty, enable}, sc.clock_enable));
+  // The output register can be loaded if it is empty or being read
+  HDLGen::HDLSignal *outputFree =
+      makeSelect(sc.output_valid, hdld->vcc, sc.output_ready, "output_free");
+  HDLGen::HDLSignal *outputEnable = gate(outputFree, "out_en");
+  // The skid register follows the end of the pipeline while empty, so it
+  // already holds any value accepted while the output is stalled
+  HDLGen::HDLSignal *skidLoad = gate(skidEmpty, "skid_load");
+  // The output or skid register holds a value next if the skid register holds
+  // one now, or one is accepted, as the pipeline is stalled otherwise
+  HDLGen::HDLSignal *held = makeSelect(skidEmpty, hdld->vcc, valid, "held");
+
+  // The output takes the skid register first, if it holds a value
+  HDLGen::HDLSignal *pipeSelect = hdld->CreateTempSignal(
+      new HDLGen::NumericPortType(1, false), "pipe_select");
+  hdld->AddDevice(new HDLGen::BufferHDLDevice(skidEmpty, pipeSelect));
+  int latency = 0;
+  for (auto port : hdld->ports) {
+    HDLGen::HDLSignal *net = port->connectedNet;
+    if ((port->dir != HDLGen::PortDirection::Output) ||
+        (net == sc.output_valid) || (net == sc.input_ready))
+      continue;
+    HDLGen::HDLSignal *pipe = hdld->CreateTempSignal(net->sigType, "pipe");
+    vector<HDLGen::HDLDevicePort *> devicePorts;
+    for (auto p : net->connectedPorts)
+      if (p->device != nullptr)
+        devicePorts.push_back(p);
+    for (auto p : devicePorts)
+      pipe->ConnectToPort(p);
+    pipe->pipeline_latency = net->pipeline_latency;
+    if (registerPipe) {
+      HDLGen::HDLSignal *last = pipe;
+      pipe = hdld->CreateTempSignal(net->sigType, "pipe");
+      hdld->AddDevice(new HDLGen::RegisterHDLDevice(
+          last, sc.clock, pipe, sc.clock_enable, hdld->gnd, true));
+      pipe->pipeline_latency = last->pipeline_latency;
+      if (pipe->pipeline_latency.domain == sc.clock)
+        pipe->pipeline_latency.value++;
+    }
+    HDLGen::HDLSignal *skid = hdld->CreateTempSignal(net->sigType, "skid");
+    hdld->AddDevice(new HDLGen::RegisterHDLDevice(pipe, sc.clock, skid,
+                                                  skidLoad, hdld->gnd, false));
+    HDLGen::HDLSignal *next = hdld->CreateTempSignal(net->sigType, "next");
+    hdld->AddDevice(
+        new HDLGen::MultiplexerHDLDevice({skid, pipe}, pipeSelect, next));
+    hdld->AddDevice(new HDLGen::RegisterHDLDevice(
+        next, sc.clock, net, outputEnable, hdld->gnd, true));
+    // Annotate the extra cycles for the timing report
+    net->pipeline_latency = pipe->pipeline_latency;
+    if (net->pipeline_latency.domain == sc.clock) {
+      net->pipeline_latency.value++;
+      latency = max(latency, net->pipeline_latency.value);
+    }
+  }
+  hdld->AddDevice(new HDLGen::RegisterHDLDevice(
+      held, sc.clock, sc.output_valid, outputEnable, sc.reset, true));
+  // When the skid register holds or accepts a value, it keeps it only if the
+  // output is full and not being read
+  hdld->AddDevice(new HDLGen::RegisterHDLDevice(
+      outputFree, sc.clock, skidEmpty, gate(held, "skid_en"), sc.reset, false,
+      BitConstant(1, 1)));
+  // output_valid is aligned with the data, while ready follows output_ready
+  // through the skid register a cycle later
+  sc.output_valid->pipeline_latency =
+      HDLGen::HDLTimingValue<int>(sc.clock, latency);
+  for (auto net : {skidEmpty, sc.clock_enable, sc.input_ready})
+    net->pipeline_latency = HDLGen::HDLTimingValue<int>(sc.clock, 1);
 }
 
-void PrintTiming(HDLGen::HDLDesign *hdld, SynthContext &sc) {
-  // TODO
+void PipelineHDLDesign(HDLGen::HDLDesign *hdld, SynthContext &sc,
+                       int interval) {
+  int latency = 0;
+  if ((interval > 1) && (sc.output_ready != nullptr))
+    PrintMessage(MSG_ERROR, "design ===" + hdld->name +
+                                "=== cannot share multipliers over multiple "
+                                "cycles with valid/ready handshaking");
+  if ((interval > 1) && (sc.clock == hdld->gnd))
+    PrintMessage(MSG_ERROR, "design ===" + hdld->name +
+                                "=== must have a clock to share multipliers "
+                                "over multiple cycles");
+  // A design sharing multipliers over several cycles is pipelined too, with
+  // output_valid driven from the scheduler so that it is aligned with the data
+  HDLGen::HDLScheduler scheduler(hdld, sc.timing, sc.clock, sc.clock_enable,
+                                 sc.reset, sc.input_valid, interval);
+  bool scheduled = (interval > 1) && (scheduler.Run() != 0);
+  if (scheduled && (sc.output_valid->design == hdld))
+    hdld->AddDevice(
+        new HDLGen::BufferHDLDevice(scheduler.done, sc.output_valid));
+  if (sc.clock != hdld->gnd) {
+    // DSP blocks bring their own registers, which the pipeliner then accounts
+    // for. Shared multipliers are left as they are
+    if (sc.timing->HasDSPs() && !scheduled)
+      HDLGen::HDLDSPMapper(hdld, sc.timing, sc.clock, sc.clock_enable).Run();
+    HDLGen::HDLPipeliner pipeliner(hdld, sc.timing, sc.clock, sc.clock_enable);
+    latency = pipeliner.Run();
+  }
+  if (scheduled) {
+    // The outputs follow the steps of the schedule, then the pipelining
+    for (auto port : hdld->ports)
+      if ((port->dir == HDLGen::PortDirection::Output) &&
+          (port->connectedNet->pipeline_latency.domain == sc.clock))
+        port->connectedNet->pipeline_latency.value += scheduler.GetLatency();
+    sc.input_ready = scheduler.AddReadyPort();
+    PrintMessage(MSG_NOTE, "scheduled design ===" + hdld->name +
+                               "=== with a latency of " +
+                               to_string(scheduler.GetLatency() + latency) +
+                               " cycles");
+    return;
+  }
+  if (sc.clock != hdld->gnd)
+    PrintMessage(MSG_NOTE, "pipelined design ===" + hdld->name +
+                               "=== with a latency of " + to_string(latency) +
+                               " cycles");
+  // Drive output_valid from input_valid, delayed to match the data. Unlike the
+  // data pipeline these registers are reset
+  if (sc.output_valid->design == hdld) {
+    HDLGen::HDLSignal *valid = sc.input_valid;
+    for (int i = 0; i < latency; i++) {
+      HDLGen::HDLSignal *next = hdld->CreateTempSignal(
+          new HDLGen::LogicSignalPortType(), "valid");
+      hdld->AddDevice(new HDLGen::RegisterHDLDevice(
+          valid, sc.clock, next, sc.clock_enable, sc.reset, true));
+      valid = next;
+    }
+    if (sc.output_ready != nullptr)
+      AddSkidBuffer(hdld, sc, valid);
+    else
+      hdld->AddDevice(new HDLGen::BufferHDLDevice(valid, sc.output_valid));
+  }
+}
+
+void PrintTiming(HDLGen::HDLDesign *hdld, SynthContext &sc, int numPaths,
+                 string jsonFile) {
+  HDLGen::HDLTimingAnalyser sta(hdld, sc.timing, sc.clock);
+  sta.Run();
+  sta.PrintReport(numPaths);
+  if (jsonFile != "") {
+    ofstream ofs(jsonFile);
+    if (!ofs)
+      PrintMessage(MSG_ERROR,
+                   "failed to open timing report file ===" + jsonFile + "===");
+    sta.WriteJSON(ofs, numPaths);
+  }
 }
 
 void GenerateVHDL(HDLGen::HDLDesign *hdld, string file) {
@@ -55,4 +316,562 @@ void GenerateVHDL(HDLGen::HDLDesign *hdld, string file) {
   hdld->GenerateVHDLFile(ofs);
 }
 
+void GenerateVerilog(HDLGen::HDLDesign *hdld, string file) {
+  ofstream ofs(file);
+  if (!ofs)
+    PrintMessage(MSG_ERROR, "failed to open output file ===" + file + "===");
+  hdld->GenerateVerilogFile(ofs);
+}
+
+void GenerateCppModel(HDLGen::HDLDesign *hdld, string file) {
+  ofstream ofs(file);
+  if (!ofs)
+    PrintMessage(MSG_ERROR, "failed to open C++ model file ===" + file + "===");
+  hdld->GenerateCppFile(ofs);
+}
+
+// Find the ports to simulate with the given names, or all the ports in a
+// direction but the clock if none are given
+static vector<HDLGen::HDLDevicePort *>
+FindSimPorts(HDLGen::HDLDesign *hdld, SynthContext &sc,
+             const vector<string> &names, HDLGen::PortDirection dir) {
+  vector<HDLGen::HDLDevicePort *> found;
+  if (names.empty())
+    copy_if(hdld->ports.begin(), hdld->ports.end(), back_inserter(found),
+            [&](HDLGen::HDLDevicePort *p) {
+              return (p->dir == dir) && (p->connectedNet != sc.clock);
+            });
+  for (auto name : names) {
+    auto port = find_if(hdld->ports.begin(), hdld->ports.end(),
+                        [&](HDLGen::HDLDevicePort *p) {
+                          return (p->name == name) && (p->dir == dir);
+                        });
+    if (port == hdld->ports.end())
+      PrintMessage(MSG_ERROR,
+                   string((dir == HDLGen::PortDirection::Input) ? "input"
+                                                                : "output") +
+                       " port ===" + name + "=== not found in design ===" +
+                       hdld->name + "===");
+    found.push_back(*port);
+  }
+  return found;
+}
+
+// Read the binary values on a line of a test vector file, returning false if
+// the line is blank
+static bool ParseTestVector(const string &line, int lineNumber,
+                            const string &vectorFile, size_t count,
+                            vector<BitConstant> &values) {
+  istringstream text(line);
+  vector<string> tokens{istream_iterator<string>(text),
+                        istream_iterator<string>()};
+  if (tokens.empty())
+    return false;
+  if (tokens.size() != count)
+    PrintMessage(MSG_ERROR, "expected " + to_string(count) +
+                                " values on line " + to_string(lineNumber) +
+                                " of test vector file ===" + vectorFile +
+                                "===");
+  values.clear();
+  for (const auto &token : tokens) {
+    BitConstant value;
+    value.resize(token.size());
+    for (size_t j = 0; j < token.size(); j++) {
+      if ((token.at(j) != '0') && (token.at(j) != '1'))
+        PrintMessage(MSG_ERROR, "bad binary value ===" + token +
+                                    "=== on line " + to_string(lineNumber) +
+                                    " of test vector file ===" + vectorFile +
+                                    "===");
+      value.set_bit(token.size() - 1 - j, token.at(j) == '1');
+    }
+    values.push_back(value);
+  }
+  return true;
+}
+
+// Format a value in binary, most significant bit first
+static string FormatBinary(const BitConstant &value) {
+  string bits;
+  for (int j = value.width() - 1; j >= 0; j--)
+    bits += value.get_bit(j) ? '1' : '0';
+  return bits;
+}
+
+// Write a line of binary output values
+static void WriteSimResults(ostream &results,
+                            const vector<BitConstant> &values) {
+  for (size_t i = 0; i < values.size(); i++) {
+    if (i != 0)
+      results << " ";
+    results << FormatBinary(values.at(i));
+  }
+  results << '\n';
+}
+
+void SimulateHDLDesign(HDLGen::HDLDesign *hdld, SynthContext &sc,
+                       string vectorFile, string resultFile,
+                       const vector<string> &inputs,
+                       const vector<string> &outputs) {
+  vector<HDLGen::HDLDevicePort *> inPorts =
+      FindSimPorts(hdld, sc, inputs, HDLGen::PortDirection::Input);
+  vector<HDLGen::HDLDevicePort *> outPorts =
+      FindSimPorts(hdld, sc, outputs, HDLGen::PortDirection::Output);
+
+  ifstream vectors(vectorFile);
+  if (!vectors)
+    PrintMessage(MSG_ERROR,
+                 "failed to open test vector file ===" + vectorFile + "===");
+  ofstream ofs;
+  if (!resultFile.empty()) {
+    ofs.open(resultFile);
+    if (!ofs)
+      PrintMessage(MSG_ERROR,
+                   "failed to open results file ===" + resultFile + "===");
+  }
+  ostream &results = resultFile.empty() ? cout : ofs;
+
+  HDLGen::HDLSimulator sim(hdld, (sc.clock == hdld->gnd) ? nullptr : sc.clock);
+  string line;
+  int lineNumber = 0, cycles = 0;
+  vector<BitConstant> values;
+  while (getline(vectors, line)) {
+    lineNumber++;
+    if (!ParseTestVector(line, lineNumber, vectorFile, inPorts.size(), values))
+      continue;
+    for (size_t i = 0; i < values.size(); i++)
+      sim.SetInput(inPorts.at(i), values.at(i));
+    sim.Step();
+    cycles++;
+    values.clear();
+    for (auto port : outPorts)
+      values.push_back(sim.GetValue(port));
+    WriteSimResults(results, values);
+  }
+  PrintMessage(MSG_NOTE, "simulated " + to_string(cycles) + " test vectors");
+}
+
+void BatchSimulateHDLDesign(HDLGen::HDLDesign *hdld, SynthContext &sc,
+                            string vectorFile, string resultFile,
+                            const vector<string> &inputs,
+                            const vector<string> &outputs) {
+  vector<HDLGen::HDLDevicePort *> inPorts =
+      FindSimPorts(hdld, sc, inputs, HDLGen::PortDirection::Input);
+  vector<HDLGen::HDLDevicePort *> outPorts =
+      FindSimPorts(hdld, sc, outputs, HDLGen::PortDirection::Output);
+
+  // Exhaustive tests count up through every combination of input values
+  const int maxExhaustiveBits = 24;
+  int inputBits = 0;
+  for (auto port : inPorts)
+    inputBits += port->type->GetWidth();
+  ifstream vectors;
+  if (vectorFile.empty()) {
+    if (inputBits > maxExhaustiveBits)
+      PrintMessage(MSG_ERROR, "design ===" + hdld->name + "=== has " +
+                                  to_string(inputBits) +
+                                  " input bits, more than the " +
+                                  to_string(maxExhaustiveBits) +
+                                  " that can be tested exhaustively");
+  } else {
+    vectors.open(vectorFile);
+    if (!vectors)
+      PrintMessage(MSG_ERROR,
+                   "failed to open test vector file ===" + vectorFile + "===");
+  }
+  ofstream ofs;
+  if (!resultFile.empty()) {
+    ofs.open(resultFile);
+    if (!ofs)
+      PrintMessage(MSG_ERROR,
+                   "failed to open results file ===" + resultFile + "===");
+  }
+  ostream &results = resultFile.empty() ? cout : ofs;
+
+  // Each test holds its vector on the inputs until the outputs are valid,
+  // which takes as many cycles as the latency of the slowest output
+  HDLGen::HDLSignal *clock = (sc.clock == hdld->gnd) ? nullptr : sc.clock;
+  int cycles = 1;
+  for (auto port : outPorts)
+    if ((clock != nullptr) &&
+        (port->connectedNet->pipeline_latency.domain == clock))
+      cycles = max(cycles, port->connectedNet->pipeline_latency.value);
+
+  HDLGen::HDLBatchSimulator sim(hdld, clock);
+  vector<vector<BitConstant>> batch;
+  int tests = 0, batches = 0;
+  auto runBatch = [&]() {
+    sim.Reset();
+    for (int lane = 0; lane < batch.size(); lane++)
+      for (size_t i = 0; i < inPorts.size(); i++)
+        sim.SetInput(inPorts.at(i), lane, batch.at(lane).at(i));
+    for (int i = 0; i < cycles; i++)
+      sim.Step();
+    vector<BitConstant> values;
+    for (int lane = 0; lane < batch.size(); lane++) {
+      values.clear();
+      for (auto port : outPorts)
+        values.push_back(sim.GetValue(port, lane));
+      WriteSimResults(results, values);
+    }
+    tests += batch.size();
+    batches++;
+    batch.clear();
+  };
+
+  vector<BitConstant> values;
+  if (vectorFile.empty()) {
+    for (uint64_t n = 0; n < (uint64_t(1) << inputBits); n++) {
+      // The last input is in the least significant bits
+      values.assign(inPorts.size(), BitConstant());
+      int low = 0;
+      for (int i = int(inPorts.size()) - 1; i >= 0; i--) {
+        int width = inPorts.at(i)->type->GetWidth();
+        values.at(i).resize(width);
+        for (int j = 0; j < width; j++)
+          values.at(i).set_bit(j, (n >> (low + j)) & 0x1);
+        low += width;
+      }
+      batch.push_back(values);
+      if (batch.size() == HDLGen::HDLBatchSimulator::lanes)
+        runBatch();
+    }
+  } else {
+    string line;
+    int lineNumber = 0;
+    while (getline(vectors, line)) {
+      lineNumber++;
+      if (!ParseTestVector(line, lineNumber, vectorFile, inPorts.size(),
+                           values))
+        continue;
+      batch.push_back(values);
+      if (batch.size() == HDLGen::HDLBatchSimulator::lanes)
+        runBatch();
+    }
+  }
+  if (!batch.empty())
+    runBatch();
+  PrintMessage(MSG_NOTE, "simulated " + to_string(tests) +
+                             " independent test vectors of " +
+                             to_string(cycles) + " cycles each, in " +
+                             to_string(batches) + " batches of up to " +
+                             to_string(HDLGen::HDLBatchSimulator::lanes));
+}
+
+// Find the golden model ports with the given names, returning their indices,
+// or all of them if none are given
+static vector<int> FindGoldenPorts(const vector<GoldenModel::Port> &ports,
+                                   const vector<string> &names,
+                                   const string &dir) {
+  vector<int> found;
+  if (names.empty())
+    for (size_t i = 0; i < ports.size(); i++)
+      found.push_back(i);
+  for (auto name : names) {
+    auto port = find_if(ports.begin(), ports.end(),
+                        [&](const GoldenModel::Port &p) {
+                          return p.name == name;
+                        });
+    if (port == ports.end())
+      PrintMessage(MSG_ERROR, dir + " port ===" + name +
+                                  "=== not found in golden model");
+    found.push_back(distance(ports.begin(), port));
+  }
+  return found;
+}
+
+void RunGoldenModel(GoldenModel *model, string vectorFile, string resultFile,
+                    const vector<string> &inputs,
+                    const vector<string> &outputs) {
+  vector<int> inPorts = FindGoldenPorts(model->GetInputs(), inputs, "input");
+  vector<int> outPorts =
+      FindGoldenPorts(model->GetOutputs(), outputs, "output");
+
+  ifstream vectors(vectorFile);
+  if (!vectors)
+    PrintMessage(MSG_ERROR,
+                 "failed to open test vector file ===" + vectorFile + "===");
+  ofstream ofs;
+  if (!resultFile.empty()) {
+    ofs.open(resultFile);
+    if (!ofs)
+      PrintMessage(MSG_ERROR,
+                   "failed to open results file ===" + resultFile + "===");
+  }
+  ostream &results = resultFile.empty() ? cout : ofs;
+
+  string line;
+  int lineNumber = 0, samples = 0;
+  vector<BitConstant> values;
+  while (getline(vectors, line)) {
+    lineNumber++;
+    if (!ParseTestVector(line, lineNumber, vectorFile, inPorts.size(), values))
+      continue;
+    for (size_t i = 0; i < values.size(); i++)
+      model->SetInput(inPorts.at(i), values.at(i));
+    model->Step();
+    samples++;
+    values.clear();
+    for (auto port : outPorts)
+      values.push_back(model->GetOutput(port));
+    WriteSimResults(results, values);
+  }
+  PrintMessage(MSG_NOTE,
+               "ran golden model on " + to_string(samples) + " test vectors");
+}
+
+void CheckHDLDesign(HDLGen::HDLDesign *hdld, SynthContext &sc,
+                    GoldenModel *model, int count) {
+  const vector<GoldenModel::Port> &inputs = model->GetInputs();
+  const vector<GoldenModel::Port> &outputs = model->GetOutputs();
+  vector<string> inNames, outNames;
+  for (const auto &port : inputs)
+    inNames.push_back(port.name);
+  for (const auto &port : outputs)
+    outNames.push_back(port.name);
+  vector<HDLGen::HDLDevicePort *> inPorts =
+      FindSimPorts(hdld, sc, inNames, HDLGen::PortDirection::Input);
+  vector<HDLGen::HDLDevicePort *> outPorts =
+      FindSimPorts(hdld, sc, outNames, HDLGen::PortDirection::Output);
+
+  HDLGen::HDLSignal *clock = (sc.clock == hdld->gnd) ? nullptr : sc.clock;
+  HDLGen::HDLSimulator sim(hdld, clock);
+  // A design with valid/ready handshaking is offered samples and has its
+  // outputs taken at random, so that it stalls and is checked against the
+  // samples it accepts in order. A design sharing multipliers over several
+  // cycles is offered samples at random in the same way, and each result is
+  // checked once it is done. Otherwise the control inputs are held so that a
+  // new sample is taken every cycle
+  bool elastic = (sc.output_ready != nullptr);
+  bool scheduled = !elastic && (sc.input_ready != nullptr);
+  HDLGen::HDLDevicePort *validPort = nullptr, *readyPort = nullptr,
+                        *acceptPort = nullptr, *givePort = nullptr;
+  for (auto port : hdld->ports) {
+    if (port->dir != HDLGen::PortDirection::Input) {
+      if (port->connectedNet == sc.input_ready)
+        acceptPort = port;
+      else if (port->connectedNet == sc.output_valid)
+        givePort = port;
+      continue;
+    }
+    if (port->connectedNet == sc.clock)
+      continue;
+    if (port->connectedNet == sc.reset)
+      sim.SetInput(port, BitConstant(0, 1));
+    else if ((elastic || scheduled) && (port->connectedNet == sc.input_valid))
+      validPort = port;
+    else if (elastic && (port->connectedNet == sc.output_ready))
+      readyPort = port;
+    else if ((port->connectedNet == sc.clock_enable) ||
+             (port->connectedNet == sc.external_clock_enable) ||
+             (port->connectedNet == sc.input_valid) ||
+             (port->connectedNet == sc.output_ready))
+      sim.SetInput(port, BitConstant(1, 1));
+  }
+  if (elastic && ((validPort == nullptr) || (readyPort == nullptr) ||
+                  (acceptPort == nullptr) || (givePort == nullptr)))
+    PrintMessage(MSG_ERROR, "handshake ports of design ===" + hdld->name +
+                                "=== not found");
+  if (scheduled && (acceptPort == nullptr))
+    PrintMessage(MSG_ERROR, "input_ready port of design ===" + hdld->name +
+                                "=== not found");
+
+  // Each output is compared against the sample as many cycles ago as its
+  // latency, so the golden outputs of that many samples are kept
+  vector<int> latency;
+  int maxLatency = 0;
+  for (auto port : outPorts) {
+    int value = 0;
+    if ((clock != nullptr) &&
+        (port->connectedNet->pipeline_latency.domain == clock))
+      value = port->connectedNet->pipeline_latency.value;
+    latency.push_back(value);
+    maxLatency = max(maxLatency, value);
+  }
+  vector<vector<BitConstant>> history(maxLatency + 1),
+      expected(maxLatency + 1);
+
+  // Every combination of input values is tested if there are no more than the
+  // number of test vectors, counting up as in BatchSimulateHDLDesign
+  const int maxExhaustiveBits = 24;
+  int inputBits = 0;
+  for (const auto &port : inputs)
+    inputBits += port.width;
+  bool exhaustive = (inputBits <= maxExhaustiveBits) &&
+                    ((uint64_t(1) << inputBits) <= uint64_t(count));
+  if (exhaustive)
+    count = int(uint64_t(1) << inputBits);
+
+  // Random values are mixed with all zeros, all ones and the most significant
+  // bit alone, which are where arithmetic most often goes wrong
+  mt19937_64 rng(1);
+  auto randomValue = [&](int width) {
+    BitConstant value;
+    value.resize(width);
+    switch (rng() % 8) {
+    case 0:
+      break;
+    case 1:
+      for (int i = 0; i < value.limb_count(); i++)
+        value.set_limb(i, ~uint64_t(0));
+      break;
+    case 2:
+      if (width > 0)
+        value.set_bit(width - 1, true);
+      break;
+    default:
+      for (int i = 0; i < value.limb_count(); i++)
+        value.set_limb(i, rng());
+      break;
+    }
+    return value;
+  };
+
+  // Sets the inputs of both the netlist and the golden model to a test vector
+  vector<BitConstant> values(inputs.size());
+  auto setSample = [&](int sample) {
+    int low = 0;
+    for (int i = int(inputs.size()) - 1; i >= 0; i--) {
+      int width = inputs.at(i).width;
+      if (exhaustive) {
+        values.at(i) = BitConstant();
+        values.at(i).resize(width);
+        for (int j = 0; j < width; j++)
+          values.at(i).set_bit(j, (uint64_t(sample) >> (low + j)) & 0x1);
+      } else {
+        values.at(i) = randomValue(width);
+      }
+      low += width;
+      model->SetInput(i, values.at(i));
+      sim.SetInput(inPorts.at(i), values.at(i));
+    }
+  };
+
+  const int maxReported = 10;
+  int mismatches = 0;
+  auto check = [&](size_t j, int sample, const BitConstant &golden,
+                   const vector<BitConstant> &sampleInputs) {
+    string actual = FormatBinary(sim.GetValue(outPorts.at(j)));
+    string goldenText = FormatBinary(golden);
+    if (actual == goldenText)
+      return;
+    mismatches++;
+    if (mismatches > maxReported)
+      return;
+    string inputText;
+    for (size_t i = 0; i < inputs.size(); i++)
+      inputText +=
+          " " + inputs.at(i).name + "=" + FormatBinary(sampleInputs.at(i));
+    PrintMessage(MSG_WARNING, "output ===" + outputs.at(j).name +
+                                  "=== of test vector " + to_string(sample) +
+                                  " is " + actual +
+                                  " but the golden model gives " + goldenText +
+                                  ", with inputs" + inputText);
+  };
+
+  if (!elastic && !scheduled) {
+    for (int cycle = 0; cycle < count + maxLatency; cycle++) {
+      if (cycle < count) {
+        setSample(cycle);
+        model->Step();
+        int slot = cycle % (maxLatency + 1);
+        history.at(slot) = values;
+        expected.at(slot).clear();
+        for (size_t j = 0; j < outputs.size(); j++)
+          expected.at(slot).push_back(model->GetOutput(j));
+      }
+
+      // Outputs are read before the clock edge that takes the next sample
+      sim.Settle();
+      for (size_t j = 0; j < outPorts.size(); j++) {
+        int sample = cycle - latency.at(j);
+        if ((sample < 0) || (sample >= count))
+          continue;
+        int slot = sample % (maxLatency + 1);
+        check(j, sample, expected.at(slot).at(j), history.at(slot));
+      }
+      sim.Step();
+    }
+  } else {
+    // The golden model only steps when the design accepts a sample, so static
+    // state that advances while the pipeline is stalled shows up as a
+    // mismatch. Once every sample is offered, outputs are taken every cycle.
+    // The results of a scheduled design are done when output_valid rises, or
+    // after its latency if it has no output_valid
+    struct Pending {
+      int sample, due;
+      vector<BitConstant> inputs, outputs;
+    };
+    deque<Pending> pending;
+    mt19937 handshake(2);
+    const int maxIdleCycles = 1000;
+    int accepted = 0, given = 0, loaded = -1, idle = 0;
+    bool wasDone = true;
+    for (int cycle = 0; (given < count) && (idle < maxIdleCycles); cycle++) {
+      if ((accepted < count) && (loaded != accepted)) {
+        setSample(accepted);
+        loaded = accepted;
+      }
+      bool valid = (accepted < count) && ((handshake() % 4) != 0);
+      bool ready = !elastic || (accepted == count) || ((handshake() % 4) != 0);
+      if (validPort != nullptr)
+        sim.SetInput(validPort, BitConstant(valid ? 1 : 0, 1));
+      else
+        valid = (accepted < count);
+      if (readyPort != nullptr)
+        sim.SetInput(readyPort, BitConstant(ready ? 1 : 0, 1));
+      sim.Settle();
+      bool takes = valid && !sim.GetValue(acceptPort).is_zero();
+      bool gives;
+      if (elastic) {
+        gives = ready && !sim.GetValue(givePort).is_zero();
+      } else if (givePort != nullptr) {
+        bool done = !sim.GetValue(givePort).is_zero();
+        gives = done && !wasDone;
+        wasDone = done;
+      } else {
+        gives = !pending.empty() && (pending.front().due == cycle);
+      }
+      if (gives) {
+        if (pending.empty()) {
+          mismatches++;
+          if (mismatches <= maxReported)
+            PrintMessage(MSG_WARNING, "design ===" + hdld->name +
+                                          "=== gives an output with no "
+                                          "test vector left to answer");
+        } else {
+          const Pending &next = pending.front();
+          for (size_t j = 0; j < outPorts.size(); j++)
+            check(j, next.sample, next.outputs.at(j), next.inputs);
+          pending.pop_front();
+        }
+        given++;
+      }
+      if (takes) {
+        model->Step();
+        Pending sample{accepted, cycle + maxLatency, values, {}};
+        for (size_t j = 0; j < outputs.size(); j++)
+          sample.outputs.push_back(model->GetOutput(j));
+        pending.push_back(sample);
+        accepted++;
+      }
+      idle = (takes || gives) ? 0 : (idle + 1);
+      sim.Step();
+    }
+    if (given < count)
+      PrintMessage(MSG_ERROR, "design ===" + hdld->name + "=== gave " +
+                                  to_string(given) + " outputs for " +
+                                  to_string(count) + " test vectors");
+  }
+  if (mismatches > 0)
+    PrintMessage(MSG_ERROR, to_string(mismatches) + " outputs of design ===" +
+                                hdld->name +
+                                "=== differ from its golden model");
+  PrintMessage(MSG_NOTE, "checked design ===" + hdld->name + "=== against " +
+                             "its golden model with " + to_string(count) +
+                             (exhaustive ? " exhaustive" : " random") +
+                             " test vectors" +
+                             (elastic ? ", stalling at random" : "") +
+                             (scheduled ? ", offered at random" : ""));
+}
+
 }; // namespace ElasticC
@@ -2,6 +2,7 @@
 #include "ECCParser.hpp"
 #include "EvalObject.hpp"
 #include "Evaluator.hpp"
+#include "GoldenModel.hpp"
 #include "SynthContext.hpp"
 #include "hdl/HDLDesign.hpp"
 
@@ -18,22 +19,95 @@ Parser::GlobalScope *DoParse(ParserState &code);
 // block
 EvaluatedBlock EvaluateCode(Evaluator *eval, Parser::HardwareBlock *top);
 
-// Optimise the evaluated block
-void OptimiseBlock(EvaluatedBlock *block);
+// Load the timing model for a given device, or the default model if empty
+DeviceTiming *LoadDeviceTiming(string device = "");
 
-// Convert the optimised block to a HDL style netlist
-SynthContext MakeHDLDesign(Parser::HardwareBlock *top, EvaluatedBlock *block);
+// Compile a golden model of the evaluated block, before it is optimised, as a
+// reference to check the netlist against
+GoldenModel *CompileGoldenModel(Parser::HardwareBlock *top,
+                                EvaluatedBlock *block);
+
+// Optimise the evaluated block, using the timing model to choose between
+// implementations of operations
+void OptimiseBlock(Parser::HardwareBlock *top, EvaluatedBlock *block,
+                   DeviceTiming *timing);
+
+// Convert the optimised block to a HDL style netlist, using the timing model in
+// later phases. An elastic design has valid/ready handshaking, so its outputs
+// can be stalled
+SynthContext MakeHDLDesign(Parser::HardwareBlock *top, EvaluatedBlock *block,
+                           DeviceTiming *timing, bool elastic = false);
+
+// Free the parse tree and evaluated block once the HDL design has been made.
+// Neither may be used after this
+void ReleaseFrontend(SynthContext &sc);
 
 // Optimise the synthesized HDL design
 void OptimiseHDLDesign(HDLGen::HDLDesign *hdld, SynthContext &sc);
 
-// Insert pipeline registers as needed in the HDL netlist
-void PipelineHDLDesign(HDLGen::HDLDesign *hdld, SynthContext &sc);
+// Insert pipeline registers as needed in the HDL netlist, or if the target
+// initiation interval is more than one cycle share multipliers over multiple
+// cycles instead. The outputs of an elastic design are then passed through a
+// skid buffer
+void PipelineHDLDesign(HDLGen::HDLDesign *hdld, SynthContext &sc,
+                       int interval = 1);
 
-// Print a final timing and pipeling report
-void PrintTiming(HDLGen::HDLDesign *hdld, SynthContext &sc);
+// Print a final timing and pipeling report, including the given number of
+// critical paths. The report is also written as JSON if jsonFile is not empty
+void PrintTiming(HDLGen::HDLDesign *hdld, SynthContext &sc, int numPaths,
+                 string jsonFile = "");
 
 // Save the HDL design to a VHDL file
 void GenerateVHDL(HDLGen::HDLDesign *hdld, string file);
 
+// Save the HDL design to a Verilog file, which behaves the same as the VHDL
+void GenerateVerilog(HDLGen::HDLDesign *hdld, string file);
+
+// Save a cycle accurate C++ model of the HDL design to a header file, which
+// computes the same values as the simulator
+void GenerateCppModel(HDLGen::HDLDesign *hdld, string file);
+
+// Simulate the HDL design, reading test vectors from a file and writing the
+// outputs after each one to another file, or to stdout if it is empty. Each
+// line of the vectors has a binary value for each of the given input ports, or
+// for all inputs but the clock if none are given. Each line of the results
+// likewise has a binary value for each of the given output ports, or all of
+// them. A clocked design is given a rising clock edge after each vector is
+// applied, before the outputs are written
+void SimulateHDLDesign(HDLGen::HDLDesign *hdld, SynthContext &sc,
+                       string vectorFile, string resultFile = "",
+                       const vector<string> &inputs = {},
+                       const vector<string> &outputs = {});
+
+// Simulate the HDL design as above, but with each test vector an independent
+// test, many of which are run at once by a batch simulator. Each test starts
+// with all registers cleared and holds its vector on the inputs for as many
+// clock cycles as the design's latency, or at least one, before its outputs
+// are written. If vectorFile is empty then every combination of input values
+// is tested in turn, counting up with the last input in the least significant
+// bits
+void BatchSimulateHDLDesign(HDLGen::HDLDesign *hdld, SynthContext &sc,
+                            string vectorFile, string resultFile = "",
+                            const vector<string> &inputs = {},
+                            const vector<string> &outputs = {});
+
+// Run the golden model on test vectors from a file, in the same format as
+// SimulateHDLDesign, writing the outputs of each sample to another file or to
+// stdout if it is empty
+void RunGoldenModel(GoldenModel *model, string vectorFile,
+                    string resultFile = "", const vector<string> &inputs = {},
+                    const vector<string> &outputs = {});
+
+// Simulate the HDL design with a new sample every cycle, checking that each
+// output matches the golden model once its latency has passed. The given
+// number of test vectors are random, or every combination of input values if
+// there are no more of those. A design with valid/ready handshaking is instead
+// offered samples and has its outputs taken at random, and each output it gives
+// is checked against the samples it accepted in order. A design sharing
+// multipliers over several cycles is also offered samples at random, and each
+// result is checked once output_valid rises, or after its latency if there is
+// no output_valid. An error is raised if any output differs
+void CheckHDLDesign(HDLGen::HDLDesign *hdld, SynthContext &sc,
+                    GoldenModel *model, int count);
+
 } // namespace ElasticC
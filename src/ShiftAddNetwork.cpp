@@ -0,0 +1,146 @@
+#include "ShiftAddNetwork.hpp"
+#include <algorithm>
+#include <set>
+using namespace std;
+
+namespace ElasticC {
+
+// Number of bits needed to hold a positive value
+static int BitLength(int64_t value) {
+  int n = 0;
+  while ((n < 63) && ((value >> n) != 0))
+    n++;
+  return n;
+}
+
+ShiftAddNetwork::ShiftAddNetwork(const vector<int64_t> &constants) {
+  fundamentals.push_back(1);
+  // Each constant is an odd value shifted left, and possibly negated
+  set<int64_t> targets;
+  for (auto c : constants) {
+    int64_t odd = (c < 0) ? -c : c;
+    while ((odd & 1) == 0)
+      odd >>= 1;
+    if (odd != 1)
+      targets.insert(odd);
+  }
+
+  while (!targets.empty()) {
+    // Build anything that can be made with a single adder, which may allow
+    // further targets to be made in the same way
+    bool progress = false;
+    for (auto it = targets.begin(); it != targets.end();) {
+      if ((Find(*it) != -1) || BuildFromExisting(*it)) {
+        it = targets.erase(it);
+        progress = true;
+      } else {
+        ++it;
+      }
+    }
+    if (progress || targets.empty())
+      continue;
+    // Otherwise build the cheapest remaining target from its CSD form, whose
+    // partial results may then help build the others
+    int64_t cheapest = *min_element(
+        targets.begin(), targets.end(), [](int64_t a, int64_t b) {
+          return make_pair(GetCSDWeight(a), a) < make_pair(GetCSDWeight(b), b);
+        });
+    BuildFromCSD(cheapest);
+    targets.erase(cheapest);
+  }
+
+  for (auto c : constants) {
+    Output out{0, 0, c < 0};
+    int64_t odd = (c < 0) ? -c : c;
+    while ((odd & 1) == 0) {
+      odd >>= 1;
+      out.shift++;
+    }
+    out.fundamental = Find(odd);
+    outputs.push_back(out);
+  }
+}
+
+int ShiftAddNetwork::GetNumAdders() const {
+  set<int> negated;
+  for (auto &out : outputs)
+    if (out.negate)
+      negated.insert(out.fundamental);
+  return int(steps.size() + negated.size());
+}
+
+vector<int> ShiftAddNetwork::ToCSD(int64_t value) {
+  vector<int> digits;
+  while (value != 0) {
+    if (value & 1) {
+      // Choose the digit that leaves a multiple of 4, so the next digit is 0
+      int digit = ((value & 3) == 3) ? -1 : 1;
+      digits.push_back(digit);
+      value -= digit;
+    } else {
+      digits.push_back(0);
+    }
+    value /= 2;
+  }
+  return digits;
+}
+
+int ShiftAddNetwork::GetCSDWeight(int64_t value) {
+  vector<int> digits = ToCSD(value);
+  return count_if(digits.begin(), digits.end(), [](int d) { return d != 0; });
+}
+
+int ShiftAddNetwork::Find(int64_t value) const {
+  auto it = find(fundamentals.begin(), fundamentals.end(), value);
+  return (it == fundamentals.end()) ? -1 : int(it - fundamentals.begin());
+}
+
+bool ShiftAddNetwork::BuildFromExisting(int64_t value) {
+  // value = (f1 << s) + f2, (f1 << s) - f2 or f2 - (f1 << s), with s > 0 so
+  // that the result of two odd fundamentals is odd
+  int maxShift = BitLength(value) + 1;
+  for (int i = 0; i < int(fundamentals.size()); i++) {
+    for (int j = 0; j < int(fundamentals.size()); j++) {
+      for (int s = 1; s <= maxShift; s++) {
+        __int128 shifted = __int128(fundamentals.at(i)) << s,
+                 other = fundamentals.at(j);
+        Step step;
+        if (shifted + other == value)
+          step = Step{i, s, j, 0, false};
+        else if (shifted - other == value)
+          step = Step{i, s, j, 0, true};
+        else if (other - shifted == value)
+          step = Step{j, 0, i, s, true};
+        else
+          continue;
+        fundamentals.push_back(value);
+        steps.push_back(step);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ShiftAddNetwork::BuildFromCSD(int64_t value) {
+  // Starting from the most significant digit, which is always 1, each partial
+  // result is shifted left and the next non-zero digit added
+  vector<int> digits = ShiftAddNetwork::ToCSD(value);
+  int current = 0, position = int(digits.size()) - 1;
+  int64_t partial = 1;
+  for (int i = position - 1; i >= 0; i--) {
+    if (digits.at(i) == 0)
+      continue;
+    partial = (partial << (position - i)) + digits.at(i);
+    int existing = Find(partial);
+    if (existing == -1) {
+      steps.push_back(Step{current, position - i, 0, 0, digits.at(i) < 0});
+      fundamentals.push_back(partial);
+      existing = int(fundamentals.size()) - 1;
+    }
+    current = existing;
+    position = i;
+  }
+}
+
+}; // namespace ElasticC
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+using namespace std;
+namespace ElasticC {
+/*
+A network of adders and subtractors multiplying one input by a set of constants,
+used in place of multipliers for constant coefficients.
+
+The network builds a list of fundamentals, which are odd positive multiples of
+the input. Every constant is then a fundamental shifted left and possibly
+negated. Constants are first written in canonical signed digit form, which has
+the fewest non-zero digits, but any constant that can be made from existing
+fundamentals with a single adder is made that way instead, so that the set of
+constants (such as the taps of a filter) share intermediate results.
+*/
+class ShiftAddNetwork {
+public:
+  // Plan a network for the given constants, none of which may be zero
+  ShiftAddNetwork(const vector<int64_t> &constants);
+
+  // A single adder, giving the fundamental
+  // (fundamentals[a] << shiftA) +/- (fundamentals[b] << shiftB)
+  struct Step {
+    int a, shiftA, b, shiftB;
+    bool subtract;
+  };
+  // How a constant is obtained from a fundamental
+  struct Output {
+    int fundamental, shift;
+    bool negate;
+  };
+
+  // The first fundamental is always 1, the input itself, and every other
+  // fundamental i is built by steps[i - 1]
+  vector<int64_t> fundamentals;
+  vector<Step> steps;
+  // The output for each constant, in the order they were given
+  vector<Output> outputs;
+
+  // Number of adders needed, including those for negation
+  int GetNumAdders() const;
+
+  // Return the canonical signed digit form of a value, least significant
+  // digit first, with every digit -1, 0 or 1 and no two adjacent digits
+  // non-zero
+  static vector<int> ToCSD(int64_t value);
+  // Number of non-zero digits in the CSD form of a value, which is one more
+  // than the number of adders needed to multiply by it alone
+  static int GetCSDWeight(int64_t value);
+
+private:
+  // Return the index of a fundamental, or -1 if it has not been built
+  int Find(int64_t value) const;
+  // Add a fundamental built using one adder from existing fundamentals if
+  // possible, returning whether it was
+  bool BuildFromExisting(int64_t value);
+  // Add a fundamental built digit by digit from its CSD form, adding each
+  // partial result as a fundamental too
+  void BuildFromCSD(int64_t value);
+};
+}; // namespace ElasticC
@@ -1,13 +1,16 @@
 #include "SynthContext.hpp"
+#include "EvalObject.hpp"
 #include "Evaluator.hpp"
 #include "ParserStatements.hpp"
 #include "ParserStructures.hpp"
+#include "Util.hpp"
 #include "hdl/HDLCoreDevices.hpp"
 #include "hdl/HDLDevicePort.hpp"
 #include "hdl/HDLPortType.hpp"
 #include "hdl/HDLSignal.hpp"
 
 #include <algorithm>
+#include <typeinfo>
 using namespace std;
 
 namespace ElasticC {
@@ -79,8 +82,38 @@ static void GenerateIO(SynthContext &sc, EvaluatorVariable *ev, bool is_input,
   }
 }
 
+// Drive a variable signal from an EvalObject, reusing the object's net if it
+// has already been synthesised. Otherwise the variable signal becomes the
+// object's net, provided they have the same type
+static void SynthesiseVariable(Evaluator *eval, SynthContext &sc,
+                               EvalObject *value, HDLSignal *varSig) {
+  auto existing = sc.objectNets.find(value);
+  if (existing != sc.objectNets.end()) {
+    sc.design->AddDevice(new BufferHDLDevice(existing->second, varSig));
+  } else {
+    sc.design->currentSourceLine = value->sourceLine;
+    value->Synthesise(eval, sc, varSig);
+    sc.design->currentSourceLine = -1;
+    HDLPortType *valType = value->GetDataType(eval)->GetHDLType();
+    if ((valType->GetWidth() == varSig->sigType->GetWidth()) &&
+        (valType->IsSigned() == varSig->sigType->IsSigned()) &&
+        (typeid(*valType) == typeid(*(varSig->sigType))))
+      sc.objectNets[value] = varSig;
+  }
+}
+
+HDLSignal *GetVariableSignal(SynthContext &sc, EvaluatorVariable *var) {
+  auto existing = sc.varSignals.find(var);
+  if (existing != sc.varSignals.end())
+    return existing->second;
+  HDLSignal *hdlsig = new HDLSignal(var->name, var->GetType()->GetHDLType());
+  sc.design->AddSignal(hdlsig);
+  sc.varSignals[var] = hdlsig;
+  return hdlsig;
+}
+
 SynthContext MakeSynthContext(Parser::HardwareBlock *hwblk,
-                              EvaluatedBlock *evb) {
+                              EvaluatedBlock *evb, bool elastic) {
   // Standard IO
   SynthContext ctx;
   ctx.design = new HDLDesign(hwblk->name);
@@ -88,6 +121,7 @@ SynthContext MakeSynthContext(Parser::HardwareBlock *hwblk,
 
   if (hp.has_clock) {
     ctx.clock = new HDLSignal("clock", new ClockSignalPortType());
+    ctx.clock->clockInfo.frequency = hp.clock_freq;
     ctx.design->AddPortFromSig(ctx.clock, PortDirection::Input);
   } else {
     ctx.clock = ctx.design->gnd;
@@ -99,6 +133,15 @@ SynthContext MakeSynthContext(Parser::HardwareBlock *hwblk,
   } else {
     ctx.clock_enable = ctx.design->vcc;
   }
+  if (elastic) {
+    if (!hp.has_clock)
+      PrintMessage(MSG_ERROR, "block ===" + hwblk->name +
+                                  "=== must have a clock for valid/ready "
+                                  "handshaking");
+    ctx.external_clock_enable = ctx.clock_enable;
+    ctx.clock_enable =
+        ctx.design->CreateTempSignal(new LogicSignalPortType(), "advance");
+  }
 
   if (hp.has_sync_rst) {
     ctx.reset = new HDLSignal("reset", new LogicSignalPortType());
@@ -107,7 +150,7 @@ SynthContext MakeSynthContext(Parser::HardwareBlock *hwblk,
     ctx.reset = ctx.design->gnd;
   }
 
-  if (hp.has_den) {
+  if (hp.has_den || elastic) {
     ctx.input_valid = new HDLSignal("input_valid", new LogicSignalPortType());
     ctx.design->AddPortFromSig(ctx.input_valid, PortDirection::Input);
   } else {
@@ -115,30 +158,41 @@ SynthContext MakeSynthContext(Parser::HardwareBlock *hwblk,
   }
 
   ctx.output_valid = new HDLSignal("output_valid", new LogicSignalPortType());
-  if (hp.has_den_out) {
+  if (hp.has_den_out || elastic) {
     ctx.design->AddPortFromSig(ctx.output_valid, PortDirection::Output);
   }
 
+  if (elastic) {
+    ctx.output_ready = new HDLSignal("output_ready", new LogicSignalPortType());
+    ctx.design->AddPortFromSig(ctx.output_ready, PortDirection::Input);
+    ctx.input_ready = new HDLSignal("input_ready", new LogicSignalPortType());
+    ctx.design->AddPortFromSig(ctx.input_ready, PortDirection::Output);
+    // Inputs are accepted whenever the pipeline advances. This also keeps the
+    // clock enable, which is only driven once the pipeline has been built
+    ctx.design->AddDevice(
+        new BufferHDLDevice(ctx.clock_enable, ctx.input_ready));
+  }
+
   // Design IO
   for (auto inp : hwblk->inputs)
     GenerateIO(ctx, evb->parserVariables.at(inp), true, false);
   for (auto op : hwblk->outputs)
     GenerateIO(ctx, evb->parserVariables.at(op), false, true);
 
+  // Variables with hardware of their own, such as static variables and
+  // streams, drive their own signals. Streams have no value of their own, so
+  // are not in the evaluated block
+  for (auto var : evb->eval->GetAllVariables())
+    var->Synthesise(ctx);
+
   // Internal signals
-  for (auto sigval : evb->vars) {
-    if (ctx.varSignals.find(sigval.first) == ctx.varSignals.end()) {
-      HDLSignal *hdlsig = new HDLSignal(sigval.first->name,
-                                        sigval.first->GetType()->GetHDLType());
-      ctx.design->AddSignal(hdlsig);
-      ctx.varSignals[sigval.first] = hdlsig;
-    }
-  }
+  for (auto sigval : evb->vars)
+    GetVariableSignal(ctx, sigval.first);
   for (auto sigval : evb->vars) {
     if (ctx.drivenSignals.find(sigval.first) == ctx.drivenSignals.end()) {
       ctx.drivenSignals.insert(sigval.first);
-      sigval.second->Synthesise(evb->eval, ctx,
-                                ctx.varSignals.at(sigval.first));
+      SynthesiseVariable(evb->eval, ctx, sigval.second,
+                         ctx.varSignals.at(sigval.first));
     }
   }
 
@@ -1,12 +1,14 @@
 #pragma once
 #include "hdl/HDLDesign.hpp"
 #include "hdl/HDLSignal.hpp"
+#include "timing/DeviceTiming.hpp"
 #include <map>
 #include <set>
 using namespace std;
 
 namespace ElasticC {
 class EvaluatorVariable;
+class EvalObject;
 struct EvaluatedBlock;
 namespace Parser {
 class HardwareBlock;
@@ -15,13 +17,27 @@ class HardwareBlock;
 struct SynthContext {
   HDLGen::HDLDesign *design;
   HDLGen::HDLSignal *clock, *clock_enable, *input_valid, *output_valid, *reset;
+  // Handshaking signals of an elastic block, which can be stalled by its
+  // outputs, or nullptr otherwise. The clock enable is then internal, stalling
+  // the whole pipeline, and the block's own clock enable is kept separately
+  HDLGen::HDLSignal *input_ready = nullptr, *output_ready = nullptr,
+                    *external_clock_enable = nullptr;
+  // Timing model of the target device, used for pipelining and timing reports
+  DeviceTiming *timing = nullptr;
   map<EvaluatorVariable *, HDLGen::HDLSignal *> varSignals;
   set<EvaluatorVariable *> drivenSignals;
+  // Nets that EvalObjects have already been synthesised into, so that nodes
+  // shared between several expressions are only synthesised once
+  map<EvalObject *, HDLGen::HDLSignal *> objectNets;
 };
 
+// Return the signal of a variable, adding it to the design if it does not
+// exist yet
+HDLGen::HDLSignal *GetVariableSignal(SynthContext &sc, EvaluatorVariable *var);
+
 // Construct a SynthContext and make a skeleton HDL design from a hardware block
-// and the evaluator output
+// and the evaluator output, with valid/ready handshaking if elastic
 SynthContext MakeSynthContext(Parser::HardwareBlock *hwblk,
-                              EvaluatedBlock *evb);
+                              EvaluatedBlock *evb, bool elastic = false);
 
 }; // namespace ElasticC
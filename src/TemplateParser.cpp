@@ -34,7 +34,7 @@ BitConstant BitConstantParameter::GetValue(Evaluator *eval,
   if (castType == nullptr)
     throw eval_error("template parameter ===" + name +
                      "=== must have scalar type");
-  baseVal = new EvalCast(castType, baseVal);
+  baseVal = EvalCast::Create(castType, baseVal);
   return baseVal->GetScalarConstValue(eval);
 }
 
@@ -0,0 +1,317 @@
+#include "ValueRange.hpp"
+#include <algorithm>
+#include <sstream>
+using namespace std;
+
+namespace ElasticC {
+
+// Mask of the n least significant bits
+static inline uint64_t LowMask(int n) {
+  return (n >= 64) ? ~uint64_t(0) : ((uint64_t(1) << n) - 1);
+}
+
+// Number of bits needed to hold a non-negative value
+static inline int BitLength(uint64_t value) {
+  return (value == 0) ? 0 : (64 - __builtin_clzll(value));
+}
+
+// Number of least significant bits known to be zero
+static int KnownTrailingZeros(const ValueRange &r) {
+  int n = 0;
+  while ((n < 64) && ((r.knownZero >> n) & 1))
+    n++;
+  return n;
+}
+
+ValueRange::ValueRange(){};
+
+ValueRange ValueRange::FromType(int width, bool is_signed) {
+  if (width > maxWidth)
+    return ValueRange();
+  if (is_signed)
+    return FromInterval(-(__int128(1) << (width - 1)),
+                        (__int128(1) << (width - 1)) - 1);
+  else
+    return FromInterval(0, (__int128(1) << width) - 1);
+}
+
+ValueRange ValueRange::FromConstant(const BitConstant &value) {
+  if (value.width() > maxWidth)
+    return ValueRange();
+  uint64_t bits = 0;
+  for (int i = 0; i < 64; i++)
+    if (value.get_bit(i))
+      bits |= (uint64_t(1) << i);
+  ValueRange r;
+  r.is_bounded = true;
+  r.lo = r.hi = int64_t(bits);
+  r.knownOne = bits;
+  r.knownZero = ~bits;
+  return r;
+}
+
+ValueRange ValueRange::FromInterval(__int128 lo, __int128 hi) {
+  __int128 limit = __int128(1) << maxWidth;
+  if ((lo < -limit) || (hi > limit))
+    return ValueRange();
+  ValueRange r;
+  r.is_bounded = true;
+  r.lo = int64_t(lo);
+  r.hi = int64_t(hi);
+  r.Normalise();
+  return r;
+}
+
+void ValueRange::Normalise() {
+  if (!is_bounded)
+    return;
+  // Bits above the magnitude of every value are copies of the sign
+  if (lo >= 0)
+    knownZero |= ~LowMask(BitLength(uint64_t(hi)));
+  else if (hi < 0)
+    knownOne |= ~LowMask(BitLength(~uint64_t(lo)));
+
+  // The smallest possible value has all unknown bits clear, apart from the
+  // sign, and the largest has them set
+  const uint64_t sign = uint64_t(1) << 63;
+  bool sign_known = ((knownZero | knownOne) & sign) != 0;
+  lo = max(lo, int64_t(knownOne | (sign_known ? 0 : sign)));
+  hi = min(hi, int64_t(~knownZero & (sign_known ? ~uint64_t(0) : ~sign)));
+
+  // Round the bounds to the nearest values with the known low bits
+  int t = GetKnownLowBits();
+  if ((t > 0) && (t < 63)) {
+    __int128 m = __int128(1) << t, r = knownOne & LowMask(t);
+    lo += int64_t((((r - lo) % m) + m) % m);
+    hi -= int64_t((((hi - r) % m) + m) % m);
+  }
+  // An empty range can only come from inconsistent inputs, so give up on it
+  if (lo > hi)
+    is_bounded = false;
+}
+
+bool ValueRange::FitsIn(int width, bool is_signed) const {
+  if (!is_bounded)
+    return false;
+  if (is_signed) {
+    if (width >= 64)
+      return true;
+    return (lo >= -(int64_t(1) << (width - 1))) &&
+           (hi <= (int64_t(1) << (width - 1)) - 1);
+  } else {
+    if (lo < 0)
+      return false;
+    if (width >= 63)
+      return true;
+    return hi <= (int64_t(1) << width) - 1;
+  }
+}
+
+int ValueRange::GetMinWidth(bool is_signed) const {
+  if (!is_bounded)
+    return -1;
+  for (int width = 1; width <= 64; width++)
+    if (FitsIn(width, is_signed))
+      return width;
+  return -1;
+}
+
+int ValueRange::GetKnownLowBits() const {
+  uint64_t known = knownZero | knownOne;
+  int n = 0;
+  while ((n < 64) && ((known >> n) & 1))
+    n++;
+  return n;
+}
+
+ValueRange ValueRange::Union(const ValueRange &other) const {
+  if (!is_bounded || !other.is_bounded)
+    return ValueRange();
+  ValueRange r;
+  r.is_bounded = true;
+  r.lo = min(lo, other.lo);
+  r.hi = max(hi, other.hi);
+  r.knownZero = knownZero & other.knownZero;
+  r.knownOne = knownOne & other.knownOne;
+  r.Normalise();
+  return r;
+}
+
+ValueRange ValueRange::Cast(int width, bool is_signed) const {
+  if (FitsIn(width, is_signed))
+    return *this;
+  ValueRange r = FromType(width, is_signed);
+  if (!is_bounded || !r.is_bounded)
+    return r;
+  // Only the low bits are kept, then extended according to the new type
+  uint64_t mask = LowMask(width), sign = uint64_t(1) << (width - 1);
+  r.knownZero |= knownZero & mask;
+  r.knownOne |= knownOne & mask;
+  if (is_signed && (knownZero & sign))
+    r.knownZero |= ~mask;
+  else if (is_signed && (knownOne & sign))
+    r.knownOne |= ~mask;
+  r.Normalise();
+  return r;
+}
+
+string ValueRange::to_string() const {
+  if (!is_bounded)
+    return "unbounded";
+  ostringstream ss;
+  ss << "[" << lo << ", " << hi << "]";
+  return ss.str();
+}
+
+// Range of an interval operation, given the results at the corners of the
+// operand intervals
+static ValueRange FromCorners(const vector<__int128> &corners) {
+  return ValueRange::FromInterval(
+      *min_element(corners.begin(), corners.end()),
+      *max_element(corners.begin(), corners.end()));
+}
+
+ValueRange PerformRangeOperation(const vector<ValueRange> &operands,
+                                 OperationType oper) {
+  for (auto &o : operands)
+    if (!o.is_bounded)
+      return ValueRange();
+  const ValueRange &a = operands.at(0);
+  switch (oper) {
+  case B_ADD:
+  case B_SUB:
+  case B_MUL: {
+    const ValueRange &b = operands.at(1);
+    ValueRange r;
+    uint64_t low;
+    if (oper == B_ADD) {
+      r = ValueRange::FromInterval(__int128(a.lo) + b.lo,
+                                   __int128(a.hi) + b.hi);
+      low = a.knownOne + b.knownOne;
+    } else if (oper == B_SUB) {
+      r = ValueRange::FromInterval(__int128(a.lo) - b.hi,
+                                   __int128(a.hi) - b.lo);
+      low = a.knownOne - b.knownOne;
+    } else {
+      r = FromCorners({__int128(a.lo) * b.lo, __int128(a.lo) * b.hi,
+                       __int128(a.hi) * b.lo, __int128(a.hi) * b.hi});
+      low = a.knownOne * b.knownOne;
+    }
+    if (!r.is_bounded)
+      return r;
+    // Low bits of the result only depend on the same low bits of the operands
+    uint64_t mask = LowMask(min(a.GetKnownLowBits(), b.GetKnownLowBits()));
+    r.knownOne |= low & mask;
+    r.knownZero |= ~low & mask;
+    if (oper == B_MUL)
+      r.knownZero |= LowMask(KnownTrailingZeros(a) + KnownTrailingZeros(b));
+    r.Normalise();
+    return r;
+  }
+  case B_DIV: {
+    const ValueRange &b = operands.at(1);
+    if ((b.lo <= 0) && (b.hi >= 0))
+      return ValueRange();
+    // For a divisor of fixed sign, the quotient is monotonic in both operands
+    return FromCorners({__int128(a.lo) / b.lo, __int128(a.lo) / b.hi,
+                        __int128(a.hi) / b.lo, __int128(a.hi) / b.hi});
+  }
+  case B_MOD: {
+    const ValueRange &b = operands.at(1);
+    if ((b.lo <= 0) && (b.hi >= 0))
+      return ValueRange();
+    // The remainder is smaller in magnitude than both operands, and takes the
+    // sign of the dividend
+    __int128 m = (b.lo > 0) ? (__int128(b.hi) - 1) : (-__int128(b.lo) - 1);
+    return ValueRange::FromInterval((a.lo >= 0) ? 0 : max(-m, __int128(a.lo)),
+                                    (a.hi <= 0) ? 0 : min(m, __int128(a.hi)));
+  }
+  case B_LS:
+  case B_RS: {
+    const ValueRange &s = operands.at(1);
+    if (s.lo < 0)
+      return ValueRange();
+    ValueRange r;
+    if (oper == B_LS) {
+      if (s.hi > ValueRange::maxWidth)
+        return ValueRange();
+      __int128 p0 = __int128(1) << s.lo, p1 = __int128(1) << s.hi;
+      r = FromCorners({a.lo * p0, a.lo * p1, a.hi * p0, a.hi * p1});
+      if (!r.is_bounded)
+        return r;
+      if (s.lo == s.hi) {
+        r.knownZero |= (a.knownZero << s.lo) | LowMask(s.lo);
+        r.knownOne |= a.knownOne << s.lo;
+      } else {
+        r.knownZero |= LowMask(KnownTrailingZeros(a) + s.lo);
+      }
+    } else {
+      // Right shifts round towards negative infinity, for signed values too
+      int s0 = int(min<int64_t>(s.lo, 63)), s1 = int(min<int64_t>(s.hi, 63));
+      r = FromCorners({a.lo >> s0, a.lo >> s1, a.hi >> s0, a.hi >> s1});
+      if (s0 == s1) {
+        r.knownZero |= uint64_t(int64_t(a.knownZero) >> s0);
+        r.knownOne |= uint64_t(int64_t(a.knownOne) >> s0);
+      }
+    }
+    r.Normalise();
+    return r;
+  }
+  case B_BWAND:
+  case B_BWOR:
+  case B_BWXOR: {
+    const ValueRange &b = operands.at(1);
+    // The result is no wider than the widest operand
+    ValueRange r = ValueRange::FromType(
+        max(a.GetMinWidth(true), b.GetMinWidth(true)), true);
+    if (oper == B_BWAND) {
+      r.knownZero |= a.knownZero | b.knownZero;
+      r.knownOne |= a.knownOne & b.knownOne;
+      // Anding with a non-negative value can only clear bits
+      if (a.lo >= 0)
+        r.hi = min(r.hi, a.hi);
+      if (b.lo >= 0)
+        r.hi = min(r.hi, b.hi);
+    } else if (oper == B_BWOR) {
+      r.knownZero |= a.knownZero & b.knownZero;
+      r.knownOne |= a.knownOne | b.knownOne;
+      if ((a.lo >= 0) && (b.lo >= 0))
+        r.lo = max(a.lo, b.lo);
+    } else {
+      r.knownZero |=
+          (a.knownZero & b.knownZero) | (a.knownOne & b.knownOne);
+      r.knownOne |= (a.knownZero & b.knownOne) | (a.knownOne & b.knownZero);
+    }
+    r.Normalise();
+    return r;
+  }
+  case U_BWNOT: {
+    ValueRange r = ValueRange::FromInterval(-__int128(a.hi) - 1,
+                                            -__int128(a.lo) - 1);
+    r.knownZero |= a.knownOne;
+    r.knownOne |= a.knownZero;
+    r.Normalise();
+    return r;
+  }
+  case U_MINUS: {
+    ValueRange r = ValueRange::FromInterval(-__int128(a.hi), -__int128(a.lo));
+    r.knownZero |= LowMask(KnownTrailingZeros(a));
+    r.Normalise();
+    return r;
+  }
+  case B_LOR:
+  case B_LAND:
+  case B_EQ:
+  case B_NEQ:
+  case B_GT:
+  case B_GTE:
+  case B_LT:
+  case B_LTE:
+  case U_LNOT:
+    return ValueRange::FromInterval(0, 1);
+  default:
+    return ValueRange();
+  }
+}
+
+}; // namespace ElasticC
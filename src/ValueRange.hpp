@@ -0,0 +1,58 @@
+#pragma once
+#include "BitConstant.hpp"
+#include "Operations.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+namespace ElasticC {
+/*
+The set of values that an integer may take, used to work out how many bits are
+really needed to hold it. This combines an interval with the bits known to be
+always zero or always one, which tighten each other: x & 15 is known to be in
+[0, 15] and x * 4 is known to be a multiple of 4.
+
+Values are tracked as 64-bit two's complement integers, with known bits given
+for the full sign extended value. Anything that might need more than maxWidth
+bits is treated as unbounded.
+*/
+class ValueRange {
+public:
+  // Create an unbounded range
+  ValueRange();
+  // The range of every value of an integer type
+  static ValueRange FromType(int width, bool is_signed);
+  static ValueRange FromConstant(const BitConstant &value);
+  // A range given by an interval, which is unbounded if it is too wide
+  static ValueRange FromInterval(__int128 lo, __int128 hi);
+
+  static const int maxWidth = 62;
+
+  bool is_bounded = false;
+  int64_t lo = 0, hi = 0;
+  uint64_t knownZero = 0, knownOne = 0;
+
+  // Whether every value in the range can be held in a given type
+  bool FitsIn(int width, bool is_signed) const;
+  // The smallest width of a given signedness that holds every value in the
+  // range, or -1 if there is none
+  int GetMinWidth(bool is_signed) const;
+  // Number of least significant bits whose value is known
+  int GetKnownLowBits() const;
+  // The range of values in either this or another range
+  ValueRange Union(const ValueRange &other) const;
+  // The range after conversion to a type, with values that do not fit
+  // wrapping as they do in a cast
+  ValueRange Cast(int width, bool is_signed) const;
+  string to_string() const;
+  // Tighten the interval and known bits using each other, to be called after
+  // either is changed
+  void Normalise();
+};
+
+// Return the range of the exact result of an operation on operands within
+// given ranges. This is before any conversion to the result type of the
+// operation, so values may not fit in that type
+ValueRange PerformRangeOperation(const vector<ValueRange> &operands,
+                                 OperationType oper);
+}; // namespace ElasticC
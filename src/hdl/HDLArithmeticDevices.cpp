@@ -0,0 +1,1440 @@
+#include "HDLArithmeticDevices.hpp"
+#include "HDLBatchSimulator.hpp"
+#include "HDLCoreDevices.hpp"
+#include "HDLCppModel.hpp"
+#include "HDLDevicePort.hpp"
+#include "HDLSignal.hpp"
+#include "HDLSimulator.hpp"
+#include "HDLVerilog.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+
+// Return the sign corrected value of an unsigned magnitude as a signed value
+// one bit wider, given a std_logic expression that is '1' when it is negative
+static string ApplySign(const string &magnitude, const string &negative) {
+  string positive = "signed('0' & " + magnitude + ")";
+  if (negative == "'0'")
+    return positive;
+  else if (negative == "'1'")
+    return "-" + positive;
+  else
+    return "-" + positive + " when (" + negative + ") = '1' else " + positive;
+}
+
+// Return a std_logic expression that is '1' when a value is negative
+static string IsNegative(const string &value, int width, bool is_signed) {
+  if (is_signed)
+    return value + "(" + to_string(width - 1) + ")";
+  else
+    return "'0'";
+}
+
+static string XorSigns(const string &a, const string &b) {
+  if (a == "'0'")
+    return b;
+  if (b == "'0'")
+    return a;
+  return a + " xor " + b;
+}
+
+// Verilog versions of the above, where a constant sign is 1'b0 or 1'b1. The
+// sign corrected value is assigned to a signed net one bit wider than the
+// magnitude
+static string VerilogApplySign(const string &magnitude,
+                               const string &negative) {
+  string positive = "{1'b0, " + magnitude + "}";
+  if (negative == "1'b0")
+    return positive;
+  else if (negative == "1'b1")
+    return "-" + positive;
+  else
+    return negative + " ? -" + positive + " : " + positive;
+}
+
+static string VerilogIsNegative(const string &value, int width,
+                                bool is_signed) {
+  if (is_signed)
+    return value + "[" + to_string(width - 1) + "]";
+  else
+    return "1'b0";
+}
+
+static string VerilogXorSigns(const string &a, const string &b) {
+  if (a == "1'b0")
+    return b;
+  if (b == "1'b0")
+    return a;
+  if (b == "1'b1")
+    return "~" + a;
+  return a + " ^ " + b;
+}
+
+// Return the magnitude of a value, assigned to an unsigned net of the same
+// width, where the most negative value wraps as unsigned(abs(...)) does
+static string VerilogMagnitude(const string &value, int width,
+                               bool is_signed) {
+  if (is_signed)
+    return VerilogIsNegative(value, width, true) + " ? -" + value + " : " +
+           value;
+  else
+    return value;
+}
+
+static inline string UnsignedLiteral(const BitConstant &value, int width) {
+  return "unsigned'(" + value.cast(width, false).to_string() + ")";
+}
+
+// Return the magnitude of a value as unsigned, of the same width, where the
+// most negative value wraps as unsigned(abs(...)) does
+static BitConstant GetSimMagnitude(const BitConstant &value) {
+  if (value.is_negative())
+    return SubtractBits(BitConstant(0), value).cast(value.width(), false);
+  else
+    return value.cast(value.width(), false);
+}
+
+// Return the value given by ApplySign for an unsigned magnitude
+static BitConstant ApplySimSign(const BitConstant &magnitude, bool negative) {
+  BitConstant positive = magnitude.cast(magnitude.width() + 1, true);
+  if (negative)
+    return SubtractBits(BitConstant(0), positive).cast(positive.width(), true);
+  else
+    return positive;
+}
+
+// Return a C++ statement setting the output of a divider to an unsigned
+// magnitude of a given width, sign corrected as ApplySimSign does if the output
+// is signed, given an expression that is true when it is negative
+static string CppDividerOutput(HDLDevicePort *out, int width,
+                               const string &result, const string &negative) {
+  if (out->type->IsSigned()) {
+    NumericPortType resType(width + 1, true);
+    return CppAssign(out, out->type,
+                     out->type->CppCastFrom(
+                         &resType, "ecc::apply_sign<" + to_string(width) +
+                                       ">(" + result + ", " + negative + ")"));
+  } else {
+    NumericPortType resType(width, false);
+    return CppAssign(out, out->type, out->type->CppCastFrom(&resType, result));
+  }
+}
+
+static inline string CppBool(bool value) { return value ? "true" : "false"; }
+
+ConstantDividerHDLDevice::ConstantDividerHDLDevice(OperationType _oper,
+                                                   HDLSignal *dividend,
+                                                   BitConstant _divisor,
+                                                   HDLSignal *output)
+    : oper(_oper) {
+  inst_name = "const_div_" + to_string(serial++);
+  ports.push_back(new HDLDevicePort("input_1", this, dividend->sigType,
+                                    dividend, PortDirection::Input));
+  ports.push_back(new HDLDevicePort("output", this, output->sigType, output,
+                                    PortDirection::Output));
+  divisor_negative = _divisor.is_negative();
+  divisor = divisor_negative
+                ? PerformConstOperation({BitConstant(0), _divisor}, B_SUB)
+                : _divisor;
+  divisor = divisor.cast(divisor.width(), false);
+  divisor.trim();
+  if (divisor.is_zero())
+    throw runtime_error("division by zero");
+  // a signed dividend has a magnitude of up to 2^(width-1), which still fits
+  width = dividend->sigType->GetWidth();
+}
+
+string ConstantDividerHDLDevice::GetInstanceName() { return inst_name; }
+
+vector<HDLDevicePort *> &ConstantDividerHDLDevice::GetPorts() {
+  return ports;
+};
+
+vector<string> ConstantDividerHDLDevice::GetVHDLDeps() {
+  return vector<string>{"ieee.std_logic_1164.all", "ieee.numeric_std.all"};
+}
+
+static bool IsPowerOfTwo(const BitConstant &d) {
+  return AreBitsEqual(d, LeftShiftBits(BitConstant(1), BitConstant(d.width() - 1)))
+             .intval() != 0;
+}
+
+void ConstantDividerHDLDevice::GenerateVHDLPrefix(ostream &vhdl) {
+  string vec = "(" + to_string(width - 1) + " downto 0)";
+  vhdl << "\tsignal " << inst_name << "_in : "
+       << NumericPortType(width, ports.at(0)->type->IsSigned()).GetVHDLType()
+       << ";" << endl;
+  vhdl << "\tsignal " << inst_name << "_mag, " << inst_name
+       << "_quot : unsigned" << vec << ";" << endl;
+  if (!IsPowerOfTwo(divisor) && (divisor.width() <= width))
+    vhdl << "\tsignal " << inst_name << "_prod : unsigned(" << (2 * width)
+         << " downto 0);" << endl;
+  if (oper == B_MOD)
+    vhdl << "\tsignal " << inst_name << "_rem : unsigned" << vec << ";"
+         << endl;
+  if (ports.back()->type->IsSigned())
+    vhdl << "\tsignal " << inst_name << "_res : signed(" << width
+         << " downto 0);" << endl;
+}
+
+void ConstantDividerHDLDevice::GenerateVHDL(ostream &vhdl) {
+  bool in_signed = ports.at(0)->type->IsSigned();
+  string in = inst_name + "_in", mag = inst_name + "_mag",
+         quot = inst_name + "_quot";
+  vhdl << "\t" << in << " <= "
+       << NumericPortType(width, in_signed)
+              .VHDLCastFrom(ports.at(0)->type, ports.at(0)->connectedNet->name)
+       << ";" << endl;
+  vhdl << "\t" << mag << " <= "
+       << (in_signed ? ("unsigned(abs(" + in + "))") : in) << ";" << endl;
+
+  if (IsPowerOfTwo(divisor)) {
+    vhdl << "\t" << quot << " <= shift_right(" << mag << ", "
+         << (divisor.width() - 1) << ");" << endl;
+  } else if (divisor.width() > width) {
+    // divisor larger than any dividend
+    vhdl << "\t" << quot << " <= (others => '0');" << endl;
+  } else {
+    // With l = ceil(log2(d)) and m = floor(2^(N+l) / d) + 1,
+    // floor(x / d) = floor(x * m / 2^(N+l)) for all N-bit x, and m is at most
+    // N+1 bits
+    int l = divisor.width();
+    BitConstant m = AddBits(
+        DivideBits(LeftShiftBits(BitConstant(1), BitConstant(width + l)),
+                   divisor),
+        BitConstant(1));
+    string prod = inst_name + "_prod";
+    vhdl << "\t" << prod << " <= " << mag << " * "
+         << UnsignedLiteral(m, width + 1) << ";" << endl;
+    vhdl << "\t" << quot << " <= resize(" << prod << "(" << (2 * width)
+         << " downto " << (width + l) << "), " << width << ");" << endl;
+  }
+
+  string result = quot, negate_cond;
+  string in_negative = IsNegative(in, width, in_signed);
+  if (oper == B_MOD) {
+    result = inst_name + "_rem";
+    vhdl << "\t" << result << " <= " << mag << " - resize(" << quot << " * "
+         << UnsignedLiteral(divisor, divisor.width()) << ", " << width << ");"
+         << endl;
+    negate_cond = in_negative;
+  } else {
+    negate_cond = XorSigns(in_negative, divisor_negative ? "'1'" : "'0'");
+  }
+
+  HDLPortType *outType = ports.back()->type;
+  if (outType->IsSigned()) {
+    vhdl << "\t" << inst_name << "_res <= " << ApplySign(result, negate_cond)
+         << ";" << endl;
+  }
+  vhdl << "\t" << ports.back()->connectedNet->name << " <= ";
+  if (outType->IsSigned()) {
+    NumericPortType resType(width + 1, true);
+    vhdl << outType->VHDLCastFrom(&resType, inst_name + "_res");
+  } else {
+    NumericPortType resType(width, false);
+    vhdl << outType->VHDLCastFrom(&resType, result);
+  }
+  vhdl << ";" << endl;
+}
+
+void ConstantDividerHDLDevice::GenerateVerilogPrefix(ostream &verilog) {
+  NumericPortType inType(width, ports.at(0)->type->IsSigned()),
+      magType(width, false);
+  verilog << "\t" << VerilogDecl("wire", &inType, inst_name + "_in") << ";"
+          << endl;
+  verilog << "\t" << VerilogDecl("wire", &magType, inst_name + "_mag") << ", "
+          << inst_name << "_quot;" << endl;
+  if (!IsPowerOfTwo(divisor) && (divisor.width() <= width)) {
+    NumericPortType prodType(2 * width + 1, false);
+    verilog << "\t" << VerilogDecl("wire", &prodType, inst_name + "_prod")
+            << ";" << endl;
+  }
+  if (oper == B_MOD)
+    verilog << "\t" << VerilogDecl("wire", &magType, inst_name + "_rem")
+            << ";" << endl;
+  if (ports.back()->type->IsSigned()) {
+    NumericPortType resType(width + 1, true);
+    verilog << "\t" << VerilogDecl("wire", &resType, inst_name + "_res")
+            << ";" << endl;
+  }
+}
+
+void ConstantDividerHDLDevice::GenerateVerilog(ostream &verilog) {
+  bool in_signed = ports.at(0)->type->IsSigned();
+  string in = inst_name + "_in", mag = inst_name + "_mag",
+         quot = inst_name + "_quot";
+  verilog << "\tassign " << in << " = "
+          << NumericPortType(width, in_signed)
+                 .VerilogCastFrom(ports.at(0)->type,
+                                  ports.at(0)->connectedNet->name)
+          << ";" << endl;
+  verilog << "\tassign " << mag << " = "
+          << VerilogMagnitude(in, width, in_signed) << ";" << endl;
+
+  if (IsPowerOfTwo(divisor)) {
+    verilog << "\tassign " << quot << " = " << mag << " >> "
+            << (divisor.width() - 1) << ";" << endl;
+  } else if (divisor.width() > width) {
+    // divisor larger than any dividend
+    verilog << "\tassign " << quot << " = " << width << "'d0;" << endl;
+  } else {
+    // The same reciprocal multiply as the VHDL
+    int l = divisor.width();
+    BitConstant m = AddBits(
+        DivideBits(LeftShiftBits(BitConstant(1), BitConstant(width + l)),
+                   divisor),
+        BitConstant(1));
+    NumericPortType mType(width + 1, false);
+    string prod = inst_name + "_prod";
+    verilog << "\tassign " << prod << " = " << mag << " * "
+            << GetVerilogConstant(m, &mType) << ";" << endl;
+    verilog << "\tassign " << quot << " = " << prod << "[" << (2 * width);
+    if (l != width)
+      verilog << ":" << (width + l);
+    verilog << "];" << endl;
+  }
+
+  string result = quot, negate_cond;
+  string in_negative = VerilogIsNegative(in, width, in_signed);
+  if (oper == B_MOD) {
+    NumericPortType divType(divisor.width(), false);
+    result = inst_name + "_rem";
+    verilog << "\tassign " << result << " = " << mag << " - " << quot << " * "
+            << GetVerilogConstant(divisor, &divType) << ";" << endl;
+    negate_cond = in_negative;
+  } else {
+    negate_cond =
+        VerilogXorSigns(in_negative, divisor_negative ? "1'b1" : "1'b0");
+  }
+
+  HDLPortType *outType = ports.back()->type;
+  if (outType->IsSigned()) {
+    NumericPortType resType(width + 1, true);
+    verilog << "\tassign " << inst_name
+            << "_res = " << VerilogApplySign(result, negate_cond) << ";"
+            << endl;
+    verilog << "\tassign " << ports.back()->connectedNet->name << " = "
+            << outType->VerilogCastFrom(&resType, inst_name + "_res") << ";"
+            << endl;
+  } else {
+    NumericPortType resType(width, false);
+    verilog << "\tassign " << ports.back()->connectedNet->name << " = "
+            << outType->VerilogCastFrom(&resType, result) << ";" << endl;
+  }
+}
+
+void ConstantDividerHDLDevice::AnnotateTiming(DeviceTiming *model) {
+  ports.back()->connectedNet->timing_delay =
+      ports.at(0)->connectedNet->timing_delay +
+      model->GetOperationDelay(B_MUL, {width, width + 1}) +
+      model->GetRoutingDelay(ports.back()->connectedNet->fanout);
+}
+
+void ConstantDividerHDLDevice::AnnotateLatency(DeviceTiming *model) {
+  ports.back()->connectedNet->pipeline_latency =
+      ports.at(0)->connectedNet->pipeline_latency;
+}
+
+void ConstantDividerHDLDevice::Simulate() {
+  BitConstant in = SimCast(ports.at(0)->connectedNet->sim_value,
+                           ports.at(0)->type)
+                       .cast(width, ports.at(0)->type->IsSigned());
+  BitConstant mag = GetSimMagnitude(in);
+  // The reciprocal multiply gives the exact quotient of the magnitudes
+  BitConstant result = (oper == B_MOD) ? ModuloBits(mag, divisor)
+                                       : DivideBits(mag, divisor);
+  result = result.cast(width, false);
+  bool negate = (oper == B_MOD) ? in.is_negative()
+                                : (in.is_negative() != divisor_negative);
+  if (ports.back()->type->IsSigned())
+    SetSimValue(ports.back(), SimCast(ApplySimSign(result, negate),
+                                      ports.back()->type));
+  else
+    SetSimValue(ports.back(), SimCast(result, ports.back()->type));
+}
+
+void ConstantDividerHDLDevice::SimulateBatch() { SimulateBatchByLane(this); }
+
+void ConstantDividerHDLDevice::GenerateCpp(ostream &cpp) {
+  bool in_signed = ports.at(0)->type->IsSigned();
+  NumericPortType inType(width, in_signed), magType(width, false),
+      divType(divisor.width(), false);
+  string in = inst_name + "_in", mag = inst_name + "_mag",
+         quot = inst_name + "_quot", rem = inst_name + "_rem";
+  cpp << "\t\t{" << endl;
+  cpp << "\t\t\t" << inType.GetCppType() << " " << in << " = "
+      << inType.CppCastFrom(ports.at(0)->type, CppInput(ports.at(0))) << ";"
+      << endl;
+  cpp << "\t\t\t" << magType.GetCppType() << " " << mag
+      << " = ecc::magnitude<" << width << ", " << CppBool(in_signed) << ">("
+      << in << "), " << quot << ";" << endl;
+  cpp << "\t\t\t" << divType.GetCppType() << " " << rem << ";" << endl;
+  cpp << "\t\t\tecc::divide<" << width << ", " << divisor.width() << ">("
+      << mag << ", " << GetCppConstant(divisor, &divType) << ", " << quot
+      << ", " << rem << ");" << endl;
+  string negative = "ecc::is_negative<" + CppBool(in_signed) + ">(" + in + ")";
+  string result = quot;
+  if (oper == B_MOD)
+    result = magType.CppCastFrom(&divType, rem);
+  else if (divisor_negative)
+    negative = "!" + negative;
+  cpp << "\t\t\t"
+      << CppDividerOutput(ports.back(), width, result, negative) << endl;
+  cpp << "\t\t}" << endl;
+}
+
+ConstantDividerHDLDevice::~ConstantDividerHDLDevice() {
+  for_each(ports.begin(), ports.end(), [](HDLDevicePort *p) { delete p; });
+}
+
+int ConstantDividerHDLDevice::serial = 0;
+
+DividerHDLDevice::DividerHDLDevice(OperationType _oper, HDLSignal *dividend,
+                                   HDLSignal *divisor, HDLSignal *output,
+                                   HDLSignal *clk, HDLSignal *en)
+    : oper(_oper), is_pipelined(clk != nullptr) {
+  inst_name = "div_" + to_string(serial++);
+  ports.push_back(new HDLDevicePort("input_1", this, dividend->sigType,
+                                    dividend, PortDirection::Input));
+  ports.push_back(new HDLDevicePort("input_2", this, divisor->sigType, divisor,
+                                    PortDirection::Input));
+  if (is_pipelined) {
+    ports.push_back(new HDLDevicePort("clk", this, clk->sigType, clk,
+                                      PortDirection::Input));
+    ports.push_back(
+        new HDLDevicePort("en", this, en->sigType, en, PortDirection::Input));
+  }
+  ports.push_back(new HDLDevicePort("output", this, output->sigType, output,
+                                    PortDirection::Output));
+  num_width = dividend->sigType->GetWidth();
+  den_width = divisor->sigType->GetWidth();
+  if (is_pipelined) {
+    Stage zero{BitConstant(0, den_width), BitConstant(0, num_width),
+               BitConstant(0, den_width), false, false};
+    sim_stages.assign(num_width + 1, zero);
+  }
+}
+
+string DividerHDLDevice::GetInstanceName() { return inst_name; }
+
+vector<HDLDevicePort *> &DividerHDLDevice::GetPorts() { return ports; };
+
+vector<string> DividerHDLDevice::GetVHDLDeps() {
+  return vector<string>{"ieee.std_logic_1164.all", "ieee.numeric_std.all"};
+}
+
+/*
+Stage i of the divider shifts the next dividend bit into the partial remainder
+rem(i), and subtracts the divisor if possible. The dividend is shifted out of
+the top of num(i) as quotient bits are shifted in at the bottom, so num(N) is
+the quotient and rem(N) the remainder.
+*/
+void DividerHDLDevice::GenerateVHDLPrefix(ostream &vhdl) {
+  int n = num_width, d = den_width;
+  vhdl << "\ttype " << inst_name << "_rem_t is array(0 to " << n
+       << ") of unsigned(" << (d - 1) << " downto 0);" << endl;
+  vhdl << "\ttype " << inst_name << "_num_t is array(0 to " << n
+       << ") of unsigned(" << (n - 1) << " downto 0);" << endl;
+  vhdl << "\ttype " << inst_name << "_trial_t is array(0 to " << (n - 1)
+       << ") of unsigned(" << d << " downto 0);" << endl;
+  vhdl << "\tsignal " << inst_name << "_a : "
+       << NumericPortType(n, ports.at(0)->type->IsSigned()).GetVHDLType() << ";"
+       << endl;
+  vhdl << "\tsignal " << inst_name << "_b : "
+       << NumericPortType(d, ports.at(1)->type->IsSigned()).GetVHDLType() << ";"
+       << endl;
+  vhdl << "\tsignal " << inst_name << "_rem, " << inst_name << "_den : "
+       << inst_name << "_rem_t;" << endl;
+  vhdl << "\tsignal " << inst_name << "_num : " << inst_name << "_num_t;"
+       << endl;
+  vhdl << "\tsignal " << inst_name << "_trial, " << inst_name << "_diff : "
+       << inst_name << "_trial_t;" << endl;
+  vhdl << "\tsignal " << inst_name << "_qbit : std_logic_vector(0 to "
+       << (n - 1) << ");" << endl;
+  vhdl << "\tsignal " << inst_name << "_qneg, " << inst_name
+       << "_rneg : std_logic_vector(0 to " << n << ");" << endl;
+  if (ports.back()->type->IsSigned())
+    vhdl << "\tsignal " << inst_name << "_res : signed("
+         << ((oper == B_MOD) ? d : n) << " downto 0);" << endl;
+}
+
+void DividerHDLDevice::GenerateVHDL(ostream &vhdl) {
+  int n = num_width, d = den_width;
+  bool a_signed = ports.at(0)->type->IsSigned(),
+       b_signed = ports.at(1)->type->IsSigned();
+  string a = inst_name + "_a", b = inst_name + "_b", rem = inst_name + "_rem",
+         den = inst_name + "_den", num = inst_name + "_num",
+         trial = inst_name + "_trial", diff = inst_name + "_diff",
+         qbit = inst_name + "_qbit", qneg = inst_name + "_qneg",
+         rneg = inst_name + "_rneg";
+
+  // Inputs, converted to magnitude and sign
+  vhdl << "\t" << a << " <= "
+       << NumericPortType(n, a_signed)
+              .VHDLCastFrom(ports.at(0)->type, ports.at(0)->connectedNet->name)
+       << ";" << endl;
+  vhdl << "\t" << b << " <= "
+       << NumericPortType(d, b_signed)
+              .VHDLCastFrom(ports.at(1)->type, ports.at(1)->connectedNet->name)
+       << ";" << endl;
+  vhdl << "\t" << num << "(0) <= "
+       << (a_signed ? ("unsigned(abs(" + a + "))") : a) << ";" << endl;
+  vhdl << "\t" << den << "(0) <= "
+       << (b_signed ? ("unsigned(abs(" + b + "))") : b) << ";" << endl;
+  vhdl << "\t" << rem << "(0) <= (others => '0');" << endl;
+  string a_negative = IsNegative(a, n, a_signed),
+         b_negative = IsNegative(b, d, b_signed);
+  vhdl << "\t" << qneg << "(0) <= " << XorSigns(a_negative, b_negative)
+       << ";" << endl;
+  vhdl << "\t" << rneg << "(0) <= " << a_negative << ";" << endl;
+
+  // Divider stages
+  string next_num = (n > 1) ? (num + "(i)(" + to_string(n - 2) +
+                               " downto 0) & " + qbit + "(i)")
+                            : ("(0 => " + qbit + "(i))");
+  vector<pair<string, string>> stage_regs = {
+      {rem + "(i + 1)", diff + "(i)(" + to_string(d - 1) + " downto 0)"},
+      {num + "(i + 1)", next_num},
+      {den + "(i + 1)", den + "(i)"},
+      {qneg + "(i + 1)", qneg + "(i)"},
+      {rneg + "(i + 1)", rneg + "(i)"}};
+  vhdl << "\t" << inst_name << "_stages: for i in 0 to " << (n - 1)
+       << " generate" << endl;
+  vhdl << "\t\t" << trial << "(i) <= " << rem << "(i) & " << num << "(i)("
+       << (n - 1) << ");" << endl;
+  vhdl << "\t\t" << qbit << "(i) <= '1' when " << trial << "(i) >= ('0' & "
+       << den << "(i)) else '0';" << endl;
+  vhdl << "\t\t" << diff << "(i) <= " << trial << "(i) - ('0' & " << den
+       << "(i)) when " << qbit << "(i) = '1' else " << trial << "(i);" << endl;
+  if (is_pipelined) {
+    string clksig = ports.at(2)->connectedNet->name;
+    vhdl << "\t\tprocess(" << clksig << ")" << endl;
+    vhdl << "\t\tbegin" << endl;
+    vhdl << "\t\t\tif rising_edge(" << clksig << ") then" << endl;
+    vhdl << "\t\t\t\tif " << ports.at(3)->connectedNet->name << " = '1' then"
+         << endl;
+    for (auto reg : stage_regs)
+      vhdl << "\t\t\t\t\t" << reg.first << " <= " << reg.second << ";" << endl;
+    vhdl << "\t\t\t\tend if;" << endl;
+    vhdl << "\t\t\tend if;" << endl;
+    vhdl << "\t\tend process;" << endl;
+  } else {
+    for (auto reg : stage_regs)
+      vhdl << "\t\t" << reg.first << " <= " << reg.second << ";" << endl;
+  }
+  vhdl << "\tend generate;" << endl;
+
+  // Output, with sign correction
+  string result = (oper == B_MOD) ? (rem + "(" + to_string(n) + ")")
+                                  : (num + "(" + to_string(n) + ")");
+  int result_width = (oper == B_MOD) ? d : n;
+  string negate_cond = ((oper == B_MOD) ? rneg : qneg) + "(" + to_string(n) + ")";
+  HDLPortType *outType = ports.back()->type;
+  if (outType->IsSigned()) {
+    vhdl << "\t" << inst_name << "_res <= " << ApplySign(result, negate_cond)
+         << ";" << endl;
+  }
+  vhdl << "\t" << ports.back()->connectedNet->name << " <= ";
+  if (outType->IsSigned()) {
+    NumericPortType resType(result_width + 1, true);
+    vhdl << outType->VHDLCastFrom(&resType, inst_name + "_res");
+  } else {
+    NumericPortType resType(result_width, false);
+    vhdl << outType->VHDLCastFrom(&resType, result);
+  }
+  vhdl << ";" << endl;
+}
+
+/*
+The Verilog divider has the same stages, but with each stage's values in nets
+of their own, inst_rem_i and so on, rather than arrays. When pipelined, those
+after the first stage are registers.
+*/
+void DividerHDLDevice::GenerateVerilogPrefix(ostream &verilog) {
+  int n = num_width, d = den_width;
+  NumericPortType aType(n, ports.at(0)->type->IsSigned()),
+      bType(d, ports.at(1)->type->IsSigned()), remType(d, false),
+      numType(n, false), trialType(d + 1, false);
+  LogicSignalPortType bitType;
+  verilog << "\t" << VerilogDecl("wire", &aType, inst_name + "_a") << ";"
+          << endl;
+  verilog << "\t" << VerilogDecl("wire", &bType, inst_name + "_b") << ";"
+          << endl;
+  for (int i = 0; i <= n; i++) {
+    string kind = (is_pipelined && (i > 0)) ? "reg" : "wire",
+           suffix = "_" + to_string(i);
+    verilog << "\t" << VerilogDecl(kind, &remType, inst_name + "_rem" + suffix)
+            << ", " << inst_name << "_den" << suffix << ";" << endl;
+    verilog << "\t" << VerilogDecl(kind, &numType, inst_name + "_num" + suffix)
+            << ";" << endl;
+    verilog << "\t"
+            << VerilogDecl(kind, &bitType, inst_name + "_qneg" + suffix)
+            << ", " << inst_name << "_rneg" << suffix << ";" << endl;
+  }
+  for (int i = 0; i < n; i++) {
+    string suffix = "_" + to_string(i);
+    verilog << "\t"
+            << VerilogDecl("wire", &trialType, inst_name + "_trial" + suffix)
+            << ", " << inst_name << "_diff" << suffix << ";" << endl;
+    verilog << "\t"
+            << VerilogDecl("wire", &bitType, inst_name + "_qbit" + suffix)
+            << ";" << endl;
+  }
+  if (ports.back()->type->IsSigned()) {
+    NumericPortType resType(((oper == B_MOD) ? d : n) + 1, true);
+    verilog << "\t" << VerilogDecl("wire", &resType, inst_name + "_res")
+            << ";" << endl;
+  }
+}
+
+void DividerHDLDevice::GenerateVerilog(ostream &verilog) {
+  int n = num_width, d = den_width;
+  bool a_signed = ports.at(0)->type->IsSigned(),
+       b_signed = ports.at(1)->type->IsSigned();
+  string a = inst_name + "_a", b = inst_name + "_b";
+  auto net = [&](const string &name, int i) {
+    return inst_name + "_" + name + "_" + to_string(i);
+  };
+
+  // Inputs, converted to magnitude and sign
+  verilog << "\tassign " << a << " = "
+          << NumericPortType(n, a_signed)
+                 .VerilogCastFrom(ports.at(0)->type,
+                                  ports.at(0)->connectedNet->name)
+          << ";" << endl;
+  verilog << "\tassign " << b << " = "
+          << NumericPortType(d, b_signed)
+                 .VerilogCastFrom(ports.at(1)->type,
+                                  ports.at(1)->connectedNet->name)
+          << ";" << endl;
+  verilog << "\tassign " << net("num", 0) << " = "
+          << VerilogMagnitude(a, n, a_signed) << ";" << endl;
+  verilog << "\tassign " << net("den", 0) << " = "
+          << VerilogMagnitude(b, d, b_signed) << ";" << endl;
+  verilog << "\tassign " << net("rem", 0) << " = " << d << "'d0;" << endl;
+  string a_negative = VerilogIsNegative(a, n, a_signed),
+         b_negative = VerilogIsNegative(b, d, b_signed);
+  verilog << "\tassign " << net("qneg", 0) << " = "
+          << VerilogXorSigns(a_negative, b_negative) << ";" << endl;
+  verilog << "\tassign " << net("rneg", 0) << " = " << a_negative << ";"
+          << endl;
+
+  // Divider stages
+  vector<pair<string, string>> stage_regs;
+  for (int i = 0; i < n; i++) {
+    string trial = net("trial", i), diff = net("diff", i),
+           qbit = net("qbit", i), den = "{1'b0, " + net("den", i) + "}";
+    verilog << "\tassign " << trial << " = {" << net("rem", i) << ", "
+            << net("num", i) << "[" << (n - 1) << "]};" << endl;
+    verilog << "\tassign " << qbit << " = " << trial << " >= " << den << ";"
+            << endl;
+    verilog << "\tassign " << diff << " = " << qbit << " ? " << trial << " - "
+            << den << " : " << trial << ";" << endl;
+    string next_num =
+        (n > 1) ? ("{" + net("num", i) + "[" + to_string(n - 2) +
+                   ((n > 2) ? ":0], " : "], ") + qbit + "}")
+                : qbit;
+    string next_rem = diff + "[" + to_string(d - 1) + ((d > 1) ? ":0]" : "]");
+    stage_regs.push_back(make_pair(net("rem", i + 1), next_rem));
+    stage_regs.push_back(make_pair(net("num", i + 1), next_num));
+    stage_regs.push_back(make_pair(net("den", i + 1), net("den", i)));
+    stage_regs.push_back(make_pair(net("qneg", i + 1), net("qneg", i)));
+    stage_regs.push_back(make_pair(net("rneg", i + 1), net("rneg", i)));
+  }
+  if (is_pipelined) {
+    verilog << "\talways @(posedge " << ports.at(2)->connectedNet->name << ")"
+            << endl;
+    verilog << "\t\tif (" << ports.at(3)->connectedNet->name << ") begin"
+            << endl;
+    for (auto reg : stage_regs)
+      verilog << "\t\t\t" << reg.first << " <= " << reg.second << ";"
+              << endl;
+    verilog << "\t\tend" << endl;
+  } else {
+    for (auto reg : stage_regs)
+      verilog << "\tassign " << reg.first << " = " << reg.second << ";"
+              << endl;
+  }
+
+  // Output, with sign correction
+  string result = (oper == B_MOD) ? net("rem", n) : net("num", n);
+  int result_width = (oper == B_MOD) ? d : n;
+  string negate_cond = (oper == B_MOD) ? net("rneg", n) : net("qneg", n);
+  HDLPortType *outType = ports.back()->type;
+  if (outType->IsSigned()) {
+    NumericPortType resType(result_width + 1, true);
+    verilog << "\tassign " << inst_name
+            << "_res = " << VerilogApplySign(result, negate_cond) << ";"
+            << endl;
+    verilog << "\tassign " << ports.back()->connectedNet->name << " = "
+            << outType->VerilogCastFrom(&resType, inst_name + "_res") << ";"
+            << endl;
+  } else {
+    NumericPortType resType(result_width, false);
+    verilog << "\tassign " << ports.back()->connectedNet->name << " = "
+            << outType->VerilogCastFrom(&resType, result) << ";" << endl;
+  }
+}
+
+void DividerHDLDevice::AnnotateTiming(DeviceTiming *model) {
+  double stage_delay =
+      model->GetOperationDelay(B_SUB, {den_width + 1, den_width + 1});
+  double route_delay =
+      model->GetRoutingDelay(ports.back()->connectedNet->fanout);
+  if (is_pipelined) {
+    ports.back()->connectedNet->timing_delay =
+        HDLTimingValue<double>(ports.at(2)->connectedNet,
+                               model->GetFFPropogationDelay()) +
+        (model->GetOperationDelay(U_MINUS, {max(num_width, den_width)}) +
+         route_delay);
+  } else {
+    HDLTimingValue<double> inp_delay =
+        TimingMax(ports.at(0)->connectedNet->timing_delay,
+                  ports.at(1)->connectedNet->timing_delay);
+    ports.back()->connectedNet->timing_delay =
+        inp_delay + (num_width * stage_delay + route_delay);
+  }
+}
+
+void DividerHDLDevice::AnnotateLatency(DeviceTiming *model) {
+  HDLTimingValue<int> inp_latency =
+      TimingMax(ports.at(0)->connectedNet->pipeline_latency,
+                ports.at(1)->connectedNet->pipeline_latency);
+  ports.back()->connectedNet->pipeline_latency =
+      inp_latency + (is_pipelined ? num_width : 0);
+}
+
+DividerHDLDevice::Stage DividerHDLDevice::GetSimInputStage() {
+  BitConstant a = SimCast(ports.at(0)->connectedNet->sim_value,
+                          ports.at(0)->type)
+                      .cast(num_width, ports.at(0)->type->IsSigned());
+  BitConstant b = SimCast(ports.at(1)->connectedNet->sim_value,
+                          ports.at(1)->type)
+                      .cast(den_width, ports.at(1)->type->IsSigned());
+  return Stage{BitConstant(0, den_width), GetSimMagnitude(a),
+               GetSimMagnitude(b), a.is_negative() != b.is_negative(),
+               a.is_negative()};
+}
+
+DividerHDLDevice::Stage DividerHDLDevice::GetSimNextStage(const Stage &stage) {
+  Stage next = stage;
+  BitConstant trial =
+      LeftShiftBits(stage.rem, BitConstant(1)).cast(den_width + 1, false);
+  trial.set_bit(0, stage.num.get_bit(num_width - 1));
+  BitConstant den = stage.den.cast(den_width + 1, false);
+  bool qbit = IsLessThan(trial, den).is_zero();
+  next.rem = (qbit ? SubtractBits(trial, den) : trial).cast(den_width, false);
+  next.num = LeftShiftBits(stage.num, BitConstant(1)).cast(num_width, false);
+  next.num.set_bit(0, qbit);
+  return next;
+}
+
+void DividerHDLDevice::SetSimOutput(const Stage &stage) {
+  BitConstant result = (oper == B_MOD) ? stage.rem : stage.num;
+  bool negate = (oper == B_MOD) ? stage.rneg : stage.qneg;
+  if (ports.back()->type->IsSigned())
+    SetSimValue(ports.back(), SimCast(ApplySimSign(result, negate),
+                                      ports.back()->type));
+  else
+    SetSimValue(ports.back(), SimCast(result, ports.back()->type));
+}
+
+void DividerHDLDevice::Simulate() {
+  if (is_pipelined) {
+    SetSimOutput(sim_stages.back());
+    return;
+  }
+  Stage stage = GetSimInputStage();
+  for (int i = 0; i < num_width; i++)
+    stage = GetSimNextStage(stage);
+  SetSimOutput(stage);
+}
+
+void DividerHDLDevice::SimulateClock() {
+  if (!IsSimHigh(ports.at(3)))
+    return;
+  // Later stages are updated first, so each takes the old value of the stage
+  // before it
+  for (int i = num_width; i > 1; i--)
+    sim_stages.at(i) = GetSimNextStage(sim_stages.at(i - 1));
+  sim_stages.at(1) = GetSimNextStage(GetSimInputStage());
+}
+
+void DividerHDLDevice::SimulateBatch() {
+  // The stages of a pipelined divider would be needed for every lane
+  if (is_pipelined)
+    HDLDevice::SimulateBatch();
+  else
+    SimulateBatchByLane(this);
+}
+
+string DividerHDLDevice::GenerateCppInputStage(ostream &cpp) {
+  int n = num_width, d = den_width;
+  bool a_signed = ports.at(0)->type->IsSigned(),
+       b_signed = ports.at(1)->type->IsSigned();
+  NumericPortType aType(n, a_signed), bType(d, b_signed);
+  string a = inst_name + "_a", b = inst_name + "_b";
+  cpp << "\t\t\t" << aType.GetCppType() << " " << a << " = "
+      << aType.CppCastFrom(ports.at(0)->type, CppInput(ports.at(0))) << ";"
+      << endl;
+  cpp << "\t\t\t" << bType.GetCppType() << " " << b << " = "
+      << bType.CppCastFrom(ports.at(1)->type, CppInput(ports.at(1))) << ";"
+      << endl;
+  string a_neg = "ecc::is_negative<" + CppBool(a_signed) + ">(" + a + ")",
+         b_neg = "ecc::is_negative<" + CppBool(b_signed) + ">(" + b + ")";
+  return "ecc::div_stage<" + to_string(n) + ", " + to_string(d) + ">{{}, " +
+         "ecc::magnitude<" + to_string(n) + ", " + CppBool(a_signed) + ">(" +
+         a + "), ecc::magnitude<" + to_string(d) + ", " + CppBool(b_signed) +
+         ">(" + b + "), " + a_neg + " != " + b_neg + ", " + a_neg + "}";
+}
+
+void DividerHDLDevice::GenerateCppPrefix(ostream &cpp) {
+  if (is_pipelined)
+    cpp << "\tstd::array<ecc::div_stage<" << num_width << ", " << den_width
+        << ">, " << (num_width + 1) << "> " << inst_name << "_stages{};"
+        << endl;
+}
+
+void DividerHDLDevice::GenerateCpp(ostream &cpp) {
+  int n = num_width, d = den_width;
+  string stage = inst_name + "_stage";
+  cpp << "\t\t{" << endl;
+  if (is_pipelined) {
+    cpp << "\t\t\tconst auto &" << stage << " = " << inst_name << "_stages["
+        << n << "];" << endl;
+  } else {
+    // The stages of the restoring divider together divide the magnitudes
+    string first = GenerateCppInputStage(cpp);
+    cpp << "\t\t\tauto " << stage << " = " << first << ";" << endl;
+    cpp << "\t\t\tecc::divide<" << n << ", " << d << ">(" << stage
+        << ".num, " << stage << ".den, " << stage << ".num, " << stage
+        << ".rem);" << endl;
+  }
+  if (oper == B_MOD)
+    cpp << "\t\t\t"
+        << CppDividerOutput(ports.back(), d, stage + ".rem", stage + ".rneg")
+        << endl;
+  else
+    cpp << "\t\t\t"
+        << CppDividerOutput(ports.back(), n, stage + ".num", stage + ".qneg")
+        << endl;
+  cpp << "\t\t}" << endl;
+}
+
+void DividerHDLDevice::GenerateCppClock(ostream &cpp) {
+  if (!is_pipelined)
+    return;
+  string stages = inst_name + "_stages";
+  cpp << "\t\tif (" << CppIsHigh(ports.at(3)) << ") {" << endl;
+  // Later stages are updated first, so each takes the old value of the stage
+  // before it
+  cpp << "\t\t\tfor (int i = " << num_width << "; i > 1; i--)" << endl;
+  cpp << "\t\t\t\t" << stages << "[i] = " << stages << "[i - 1].next();"
+      << endl;
+  string first = GenerateCppInputStage(cpp);
+  cpp << "\t\t\t" << stages << "[1] = " << first << ".next();" << endl;
+  cpp << "\t\t}" << endl;
+}
+
+DividerHDLDevice::~DividerHDLDevice() {
+  for_each(ports.begin(), ports.end(), [](HDLDevicePort *p) { delete p; });
+}
+
+int DividerHDLDevice::serial = 0;
+
+CompressorTreeHDLDevice::CompressorTreeHDLDevice(
+    const vector<HDLSignal *> &inputs, HDLSignal *output) {
+  inst_name = "csa_" + to_string(serial++);
+  for (size_t i = 0; i < inputs.size(); i++)
+    ports.push_back(new HDLDevicePort("input_" + to_string(i + 1), this,
+                                      inputs.at(i)->sigType, inputs.at(i),
+                                      PortDirection::Input));
+  ports.push_back(new HDLDevicePort("output", this, output->sigType, output,
+                                    PortDirection::Output));
+  width = output->sigType->GetWidth();
+}
+
+string CompressorTreeHDLDevice::GetInstanceName() { return inst_name; }
+
+vector<HDLDevicePort *> &CompressorTreeHDLDevice::GetPorts() { return ports; };
+
+vector<string> CompressorTreeHDLDevice::GetVHDLDeps() {
+  return vector<string>{"ieee.std_logic_1164.all", "ieee.numeric_std.all"};
+}
+
+/*
+Each level of the tree takes the words in groups of three and replaces each
+group with a sum word (the bitwise xor) and a carry word (the bitwise majority,
+shifted left one place), which have the same total. Words left over are passed
+on to the next level, until only two words remain.
+*/
+void CompressorTreeHDLDevice::GenerateTree(ostream &decls, ostream &assigns,
+                                           bool verilog) {
+  NumericPortType wordType(width, false);
+  int next = 0;
+  auto declare = [&](const string &name) {
+    if (verilog)
+      decls << "\t" << VerilogDecl("wire", &wordType, name) << ";" << endl;
+    else
+      decls << "\tsignal " << name << " : " << wordType.GetVHDLType() << ";"
+            << endl;
+  };
+  auto assign = [&](const string &name, const string &value) {
+    assigns << "\t" << (verilog ? "assign " : "") << name
+            << (verilog ? " = " : " <= ") << value << ";" << endl;
+  };
+  auto newWord = [&]() {
+    string name = inst_name + "_w" + to_string(next++);
+    declare(name);
+    return name;
+  };
+  string op_and = verilog ? " & " : " and ", op_or = verilog ? " | " : " or ",
+         op_xor = verilog ? " ^ " : " xor ";
+  vector<string> words;
+  for (size_t i = 0; i < ports.size() - 1; i++) {
+    string w = newWord();
+    HDLPortType *type = ports.at(i)->type;
+    string net = ports.at(i)->connectedNet->name;
+    assign(w, verilog ? wordType.VerilogCastFrom(type, net)
+                      : wordType.VHDLCastFrom(type, net));
+    words.push_back(w);
+  }
+  while (words.size() > 2) {
+    vector<string> nextWords;
+    size_t i = 0;
+    for (; (i + 2) < words.size(); i += 3) {
+      string a = words.at(i), b = words.at(i + 1), c = words.at(i + 2);
+      string sum = newWord(), carry = newWord();
+      assign(sum, a + op_xor + b + op_xor + c);
+      string majority = "(" + a + op_and + b + ")" + op_or + "(" + a +
+                        op_and + c + ")" + op_or + "(" + b + op_and + c + ")";
+      assign(carry, verilog ? ("(" + majority + ") << 1")
+                            : ("shift_left(" + majority + ", 1)"));
+      nextWords.push_back(sum);
+      nextWords.push_back(carry);
+    }
+    for (; i < words.size(); i++)
+      nextWords.push_back(words.at(i));
+    words = nextWords;
+  }
+  string total = inst_name + "_sum";
+  declare(total);
+  assign(total, words.at(0) + ((words.size() > 1) ? (" + " + words.at(1)) : ""));
+}
+
+void CompressorTreeHDLDevice::GenerateVHDLPrefix(ostream &vhdl) {
+  ostringstream assigns;
+  GenerateTree(vhdl, assigns);
+}
+
+void CompressorTreeHDLDevice::GenerateVHDL(ostream &vhdl) {
+  ostringstream decls;
+  GenerateTree(decls, vhdl);
+  NumericPortType wordType(width, false);
+  vhdl << "\t" << ports.back()->connectedNet->name << " <= "
+       << ports.back()->type->VHDLCastFrom(&wordType, inst_name + "_sum") << ";"
+       << endl;
+}
+
+void CompressorTreeHDLDevice::GenerateVerilogPrefix(ostream &verilog) {
+  ostringstream assigns;
+  GenerateTree(verilog, assigns, true);
+}
+
+void CompressorTreeHDLDevice::GenerateVerilog(ostream &verilog) {
+  ostringstream decls;
+  GenerateTree(decls, verilog, true);
+  NumericPortType wordType(width, false);
+  verilog << "\tassign " << ports.back()->connectedNet->name << " = "
+          << ports.back()->type->VerilogCastFrom(&wordType, inst_name + "_sum")
+          << ";" << endl;
+}
+
+void CompressorTreeHDLDevice::AnnotateTiming(DeviceTiming *model) {
+  HDLTimingValue<double> inp_delay;
+  for (size_t i = 0; i < ports.size() - 1; i++)
+    inp_delay = TimingMax(inp_delay, ports.at(i)->connectedNet->timing_delay);
+  ports.back()->connectedNet->timing_delay =
+      inp_delay +
+      (model->GetCompressorTreeDelay(int(ports.size()) - 1, width) +
+       model->GetRoutingDelay(ports.back()->connectedNet->fanout));
+}
+
+void CompressorTreeHDLDevice::AnnotateLatency(DeviceTiming *model) {
+  HDLTimingValue<int> inp_latency;
+  for (size_t i = 0; i < ports.size() - 1; i++)
+    inp_latency =
+        TimingMax(inp_latency, ports.at(i)->connectedNet->pipeline_latency);
+  ports.back()->connectedNet->pipeline_latency = inp_latency;
+}
+
+void CompressorTreeHDLDevice::Simulate() {
+  BitConstant sum = BitConstant().cast(width, false);
+  for (size_t i = 0; i < ports.size() - 1; i++)
+    sum = AddBits(sum, SimCast(ports.at(i)->connectedNet->sim_value,
+                               ports.at(i)->type)
+                           .cast(width, false))
+              .cast(width, false);
+  SetSimValue(ports.back(), SimCast(sum, ports.back()->type));
+}
+
+void CompressorTreeHDLDevice::SimulateBatch() {
+  BatchValue sum = BatchValue().cast(width, false);
+  for (size_t i = 0; i < ports.size() - 1; i++)
+    sum = AddBatch(sum, BatchCast(ports.at(i)->connectedNet->batch_value,
+                                  ports.at(i)->type)
+                            .cast(width, false))
+              .cast(width, false);
+  SetBatchValue(ports.back(), BatchCast(sum, ports.back()->type));
+}
+
+void CompressorTreeHDLDevice::GenerateCpp(ostream &cpp) {
+  NumericPortType sumType(width, false);
+  string sum = inst_name + "_sum";
+  cpp << "\t\t{" << endl;
+  cpp << "\t\t\t" << sumType.GetCppType() << " " << sum << "{};" << endl;
+  for (size_t i = 0; i < ports.size() - 1; i++)
+    cpp << "\t\t\t" << sum << " = ecc::add<" << width << ", false>(" << sum
+        << ", " << sumType.CppCastFrom(ports.at(i)->type, CppInput(ports.at(i)))
+        << ");" << endl;
+  cpp << "\t\t\t"
+      << CppAssign(ports.back(), ports.back()->type,
+                   ports.back()->type->CppCastFrom(&sumType, sum))
+      << endl;
+  cpp << "\t\t}" << endl;
+}
+
+CompressorTreeHDLDevice::~CompressorTreeHDLDevice() {
+  for_each(ports.begin(), ports.end(), [](HDLDevicePort *p) { delete p; });
+}
+
+int CompressorTreeHDLDevice::serial = 0;
+
+DSPHDLDevice::DSPHDLDevice(HDLSignal *a, HDLSignal *b, HDLSignal *output,
+                           HDLSignal *clk, HDLSignal *en,
+                           HDLPortType *_mul_type, HDLPortType *_m_type,
+                           optional<FusedAdder> _pre, HDLPortType *_ad_type,
+                           optional<FusedAdder> _post)
+    : pre(_pre), post(_post), mul_type(_mul_type), m_type(_m_type),
+      ad_type(_ad_type) {
+  inst_name = "dsp_" + to_string(serial++);
+  auto addPort = [&](string name, HDLSignal *net, PortDirection dir) {
+    ports.push_back(new HDLDevicePort(name, this, net->sigType, net, dir));
+    return ports.back();
+  };
+  a_port = addPort("a", a, PortDirection::Input);
+  b_port = addPort("b", b, PortDirection::Input);
+  if (pre.has_value())
+    d_port = addPort("d", pre->input, PortDirection::Input);
+  if (post.has_value())
+    c_port = addPort("c", post->input, PortDirection::Input);
+  clk_port = addPort("clk", clk, PortDirection::Input);
+  en_port = addPort("en", en, PortDirection::Input);
+  out_port = addPort("output", output, PortDirection::Output);
+}
+
+string DSPHDLDevice::GetInstanceName() { return inst_name; }
+
+vector<HDLDevicePort *> &DSPHDLDevice::GetPorts() { return ports; };
+
+vector<string> DSPHDLDevice::GetVHDLDeps() {
+  return vector<string>{"ieee.std_logic_1164.all", "ieee.numeric_std.all"};
+}
+
+int DSPHDLDevice::GetLatency() { return pre.has_value() ? 4 : 3; }
+
+int DSPHDLDevice::GetInputStage(HDLDevicePort *port) {
+  return (port == c_port) ? (GetLatency() - 1) : 0;
+}
+
+/*
+The registers are named after those of a DSP48: a, b and d are the input
+registers, ad the pre-adder register (with b delayed alongside it), m the
+product register and p the output register. The combinational sum, mul and acc
+signals hold the results of the fused operations, with the types of the nets
+they replace.
+*/
+void DSPHDLDevice::GenerateVHDLPrefix(ostream &vhdl) {
+  auto declare = [&](string name, HDLPortType *type) {
+    vhdl << "\tsignal " << inst_name << "_" << name << " : "
+         << type->GetVHDLType() << ";" << endl;
+  };
+  declare("a", a_port->type);
+  declare("b", b_port->type);
+  if (pre.has_value()) {
+    declare("d", d_port->type);
+    declare("sum", pre->type);
+    declare("ad", ad_type);
+    declare("b2", b_port->type);
+  }
+  declare("mul", mul_type);
+  declare("m", m_type);
+  if (post.has_value())
+    declare("acc", out_port->type);
+  declare("p", out_port->type);
+}
+
+void DSPHDLDevice::GenerateVHDL(ostream &vhdl) {
+  string a = inst_name + "_a", b = inst_name + "_b", m = inst_name + "_m",
+         p = inst_name + "_p";
+  vector<pair<string, string>> regs = {
+      {a, a_port->connectedNet->name}, {b, b_port->connectedNet->name}};
+  // The value of an adder, given the other operand x and its type
+  auto adderValue = [](const FusedAdder &adder, HDLPortType *xType, string x,
+                       HDLPortType *inType, string in) {
+    vector<HDLPortType *> types{xType, inType};
+    vector<string> operands{x, in};
+    if (adder.swap) {
+      swap(types.at(0), types.at(1));
+      swap(operands.at(0), operands.at(1));
+    }
+    return OperationHDLDevice::GetVHDLValue(adder.oper, types, operands,
+                                            adder.type);
+  };
+
+  HDLPortType *multType = a_port->type;
+  string mult = a, multB = b;
+  if (pre.has_value()) {
+    string d = inst_name + "_d", sum = inst_name + "_sum",
+           ad = inst_name + "_ad";
+    regs.push_back(make_pair(d, d_port->connectedNet->name));
+    vhdl << "\t" << sum << " <= "
+         << adderValue(*pre, a_port->type, a, d_port->type, d) << ";" << endl;
+    regs.push_back(make_pair(ad, ad_type->VHDLCastFrom(pre->type, sum)));
+    regs.push_back(make_pair(inst_name + "_b2", b));
+    multType = ad_type;
+    mult = ad;
+    multB = inst_name + "_b2";
+  }
+  vhdl << "\t" << inst_name << "_mul <= "
+       << OperationHDLDevice::GetVHDLValue(
+              B_MUL, vector<HDLPortType *>{multType, b_port->type},
+              vector<string>{mult, multB}, mul_type)
+       << ";" << endl;
+  regs.push_back(make_pair(m, m_type->VHDLCastFrom(mul_type, inst_name + "_mul")));
+  if (post.has_value()) {
+    vhdl << "\t" << inst_name << "_acc <= "
+         << adderValue(*post, m_type, m, c_port->type,
+                       c_port->connectedNet->name)
+         << ";" << endl;
+    regs.push_back(make_pair(p, inst_name + "_acc"));
+  } else {
+    regs.push_back(make_pair(p, out_port->type->VHDLCastFrom(m_type, m)));
+  }
+
+  string clksig = clk_port->connectedNet->name;
+  vhdl << "\tprocess(" << clksig << ")" << endl;
+  vhdl << "\tbegin" << endl;
+  vhdl << "\t\tif rising_edge(" << clksig << ") then" << endl;
+  vhdl << "\t\t\tif " << en_port->connectedNet->name << " = '1' then" << endl;
+  for (auto reg : regs)
+    vhdl << "\t\t\t\t" << reg.first << " <= " << reg.second << ";" << endl;
+  vhdl << "\t\t\tend if;" << endl;
+  vhdl << "\t\tend if;" << endl;
+  vhdl << "\tend process;" << endl;
+  vhdl << "\t" << out_port->connectedNet->name << " <= " << p << ";" << endl;
+}
+
+void DSPHDLDevice::GenerateVerilogPrefix(ostream &verilog) {
+  auto declare = [&](string kind, string name, HDLPortType *type) {
+    verilog << "\t" << VerilogDecl(kind, type, inst_name + "_" + name) << ";"
+            << endl;
+  };
+  declare("reg", "a", a_port->type);
+  declare("reg", "b", b_port->type);
+  if (pre.has_value()) {
+    declare("reg", "d", d_port->type);
+    declare("wire", "sum", pre->type);
+    declare("reg", "ad", ad_type);
+    declare("reg", "b2", b_port->type);
+  }
+  declare("wire", "mul", mul_type);
+  declare("reg", "m", m_type);
+  if (post.has_value())
+    declare("wire", "acc", out_port->type);
+  declare("reg", "p", out_port->type);
+}
+
+void DSPHDLDevice::GenerateVerilog(ostream &verilog) {
+  string a = inst_name + "_a", b = inst_name + "_b", m = inst_name + "_m",
+         p = inst_name + "_p";
+  vector<pair<string, string>> regs = {
+      {a, a_port->connectedNet->name}, {b, b_port->connectedNet->name}};
+  // Set a net to the value of an adder, given the other operand x and its type
+  auto adderValue = [&](const FusedAdder &adder, HDLPortType *xType, string x,
+                        HDLPortType *inType, string in, string result) {
+    vector<HDLPortType *> types{xType, inType};
+    vector<string> operands{x, in};
+    if (adder.swap) {
+      swap(types.at(0), types.at(1));
+      swap(operands.at(0), operands.at(1));
+    }
+    OperationHDLDevice::GenerateVerilogValue(verilog, adder.oper, types,
+                                             operands, adder.type, result,
+                                             result + "_value");
+  };
+
+  HDLPortType *multType = a_port->type;
+  string mult = a, multB = b;
+  if (pre.has_value()) {
+    string d = inst_name + "_d", sum = inst_name + "_sum",
+           ad = inst_name + "_ad";
+    regs.push_back(make_pair(d, d_port->connectedNet->name));
+    adderValue(*pre, a_port->type, a, d_port->type, d, sum);
+    regs.push_back(make_pair(ad, ad_type->VerilogCastFrom(pre->type, sum)));
+    regs.push_back(make_pair(inst_name + "_b2", b));
+    multType = ad_type;
+    mult = ad;
+    multB = inst_name + "_b2";
+  }
+  OperationHDLDevice::GenerateVerilogValue(
+      verilog, B_MUL, vector<HDLPortType *>{multType, b_port->type},
+      vector<string>{mult, multB}, mul_type, inst_name + "_mul",
+      inst_name + "_mul_value");
+  regs.push_back(
+      make_pair(m, m_type->VerilogCastFrom(mul_type, inst_name + "_mul")));
+  if (post.has_value()) {
+    adderValue(*post, m_type, m, c_port->type, c_port->connectedNet->name,
+               inst_name + "_acc");
+    regs.push_back(make_pair(p, inst_name + "_acc"));
+  } else {
+    regs.push_back(make_pair(p, out_port->type->VerilogCastFrom(m_type, m)));
+  }
+
+  verilog << "\talways @(posedge " << clk_port->connectedNet->name << ")"
+          << endl;
+  verilog << "\t\tif (" << en_port->connectedNet->name << ") begin" << endl;
+  for (auto reg : regs)
+    verilog << "\t\t\t" << reg.first << " <= " << reg.second << ";" << endl;
+  verilog << "\t\tend" << endl;
+  verilog << "\tassign " << out_port->connectedNet->name << " = " << p << ";"
+          << endl;
+}
+
+void DSPHDLDevice::AnnotateTiming(DeviceTiming *model) {
+  out_port->connectedNet->timing_delay =
+      HDLTimingValue<double>(clk_port->connectedNet,
+                             model->GetFFPropogationDelay()) +
+      model->GetRoutingDelay(out_port->connectedNet->fanout);
+}
+
+void DSPHDLDevice::AnnotateLatency(DeviceTiming *model) {
+  // Inputs needed in later stages may arrive correspondingly later
+  HDLTimingValue<int> inp_latency(clk_port->connectedNet, 0);
+  for (auto p : ports)
+    if ((p->dir == PortDirection::Input) && (p != clk_port) && (p != en_port))
+      inp_latency = TimingMax(inp_latency, p->connectedNet->pipeline_latency +
+                                               (-GetInputStage(p)));
+  out_port->connectedNet->pipeline_latency = inp_latency + GetLatency();
+}
+
+vector<pair<string, double>>
+DSPHDLDevice::GetInternalDelays(DeviceTiming *model) {
+  typedef DeviceTiming::DSPStage Stage;
+  vector<pair<string, double>> delays;
+  if (pre.has_value())
+    delays.push_back(make_pair("ad", model->GetDSPStageDelay(Stage::PreAdder)));
+  delays.push_back(make_pair("m", model->GetDSPStageDelay(Stage::Multiplier)));
+  // The product passes through the post-adder even if it adds nothing
+  delays.push_back(make_pair("p", model->GetDSPStageDelay(Stage::PostAdder)));
+  return delays;
+}
+
+void DSPHDLDevice::Simulate() { SetSimValue(out_port, sim_p); }
+
+void DSPHDLDevice::SimulateClock() {
+  if (!IsSimHigh(en_port))
+    return;
+  auto input = [](HDLDevicePort *port) {
+    return SimCast(port->connectedNet->sim_value, port->type);
+  };
+  // The value of an adder, given the other operand x and its type
+  auto adderValue = [](const FusedAdder &adder, HDLPortType *xType,
+                       const BitConstant &x, HDLPortType *inType,
+                       const BitConstant &in) {
+    vector<HDLPortType *> types{xType, inType};
+    vector<BitConstant> operands{x, in};
+    if (adder.swap) {
+      swap(types.at(0), types.at(1));
+      swap(operands.at(0), operands.at(1));
+    }
+    return OperationHDLDevice::GetSimValue(adder.oper, types, operands,
+                                           adder.type);
+  };
+
+  // All the registers are updated together from their old values
+  HDLPortType *multType = a_port->type;
+  BitConstant mult = sim_a, multB = sim_b;
+  if (pre.has_value()) {
+    BitConstant ad = SimCast(
+        adderValue(*pre, a_port->type, sim_a, d_port->type, sim_d), ad_type);
+    multType = ad_type;
+    mult = sim_ad;
+    multB = sim_b2;
+    sim_d = input(d_port);
+    sim_ad = ad;
+    sim_b2 = sim_b;
+  }
+  BitConstant mul = OperationHDLDevice::GetSimValue(
+      B_MUL, vector<HDLPortType *>{multType, b_port->type},
+      vector<BitConstant>{mult, multB}, mul_type);
+  if (post.has_value())
+    sim_p = adderValue(*post, m_type, sim_m, c_port->type, input(c_port));
+  else
+    sim_p = SimCast(sim_m, out_port->type);
+  sim_m = SimCast(mul, m_type);
+  sim_a = input(a_port);
+  sim_b = input(b_port);
+}
+
+void DSPHDLDevice::StartBatch() {
+  batch_a = batch_b = batch_d = batch_ad = batch_b2 = batch_m = batch_p =
+      BatchValue();
+}
+
+void DSPHDLDevice::SimulateBatch() { SetBatchValue(out_port, batch_p); }
+
+void DSPHDLDevice::SimulateBatchClock() {
+  // As SimulateClock, but each register only takes its new value in the lanes
+  // where the block is enabled
+  SimLanes en = GetBatchHigh(en_port);
+  auto input = [](HDLDevicePort *port) {
+    return BatchCast(port->connectedNet->batch_value, port->type);
+  };
+  auto adderValue = [](const FusedAdder &adder, HDLPortType *xType,
+                       const BatchValue &x, HDLPortType *inType,
+                       const BatchValue &in) {
+    vector<HDLPortType *> types{xType, inType};
+    vector<BatchValue> operands{x, in};
+    if (adder.swap) {
+      swap(types.at(0), types.at(1));
+      swap(operands.at(0), operands.at(1));
+    }
+    return OperationHDLDevice::GetBatchValue(adder.oper, types, operands,
+                                             adder.type);
+  };
+  auto update = [&](BatchValue &reg, const BatchValue &value) {
+    reg = SelectBatch(en, reg.cast(value.width(), value.is_signed), value);
+  };
+
+  HDLPortType *multType = a_port->type;
+  BatchValue mult = batch_a, multB = batch_b;
+  if (pre.has_value()) {
+    BatchValue ad = BatchCast(
+        adderValue(*pre, a_port->type, batch_a, d_port->type, batch_d),
+        ad_type);
+    multType = ad_type;
+    mult = batch_ad;
+    multB = batch_b2;
+    update(batch_d, input(d_port));
+    update(batch_ad, ad);
+    update(batch_b2, BatchCast(batch_b, b_port->type));
+  }
+  BatchValue mul = OperationHDLDevice::GetBatchValue(
+      B_MUL, vector<HDLPortType *>{multType, b_port->type},
+      vector<BatchValue>{mult, multB}, mul_type);
+  if (post.has_value())
+    update(batch_p,
+           adderValue(*post, m_type, batch_m, c_port->type, input(c_port)));
+  else
+    update(batch_p, BatchCast(batch_m, out_port->type));
+  update(batch_m, BatchCast(mul, m_type));
+  update(batch_a, input(a_port));
+  update(batch_b, input(b_port));
+}
+
+void DSPHDLDevice::GenerateCppPrefix(ostream &cpp) {
+  auto declare = [&](string name, HDLPortType *type) {
+    cpp << "\t" << type->GetCppType() << " " << inst_name << "_" << name
+        << "{};" << endl;
+  };
+  declare("a", a_port->type);
+  declare("b", b_port->type);
+  if (pre.has_value()) {
+    declare("d", d_port->type);
+    declare("ad", ad_type);
+    declare("b2", b_port->type);
+  }
+  declare("m", m_type);
+  declare("p", post.has_value() ? post->type : out_port->type);
+}
+
+void DSPHDLDevice::GenerateCpp(ostream &cpp) {
+  cpp << "\t\t"
+      << CppAssign(out_port, post.has_value() ? post->type : out_port->type,
+                   inst_name + "_p")
+      << endl;
+}
+
+void DSPHDLDevice::GenerateCppClock(ostream &cpp) {
+  string a = inst_name + "_a", b = inst_name + "_b", m = inst_name + "_m",
+         p = inst_name + "_p";
+  // The value of an adder, given the other operand x and its type
+  auto adderValue = [](const FusedAdder &adder, HDLPortType *xType, string x,
+                       HDLPortType *inType, string in) {
+    vector<HDLPortType *> types{xType, inType};
+    vector<string> operands{x, in};
+    if (adder.swap) {
+      swap(types.at(0), types.at(1));
+      swap(operands.at(0), operands.at(1));
+    }
+    return OperationHDLDevice::GetCppValue(adder.oper, types, operands,
+                                           adder.type);
+  };
+
+  // All the registers are updated together from their old values, so the new
+  // values of those that depend on others are worked out first
+  cpp << "\t\tif (" << CppIsHigh(en_port) << ") {" << endl;
+  HDLPortType *multType = a_port->type;
+  string mult = a, multB = b;
+  if (pre.has_value()) {
+    string d = inst_name + "_d", ad = inst_name + "_ad";
+    cpp << "\t\t\t" << ad_type->GetCppType() << " " << ad << "_next = "
+        << ad_type->CppCastFrom(
+               pre->type, adderValue(*pre, a_port->type, a, d_port->type, d))
+        << ";" << endl;
+    multType = ad_type;
+    mult = ad;
+    multB = inst_name + "_b2";
+  }
+  cpp << "\t\t\t" << m_type->GetCppType() << " " << m << "_next = "
+      << m_type->CppCastFrom(mul_type,
+                             OperationHDLDevice::GetCppValue(
+                                 B_MUL,
+                                 vector<HDLPortType *>{multType, b_port->type},
+                                 vector<string>{mult, multB}, mul_type))
+      << ";" << endl;
+  if (post.has_value())
+    cpp << "\t\t\t" << p << " = "
+        << adderValue(*post, m_type, m, c_port->type, CppInput(c_port)) << ";"
+        << endl;
+  else
+    cpp << "\t\t\t" << p << " = " << out_port->type->CppCastFrom(m_type, m)
+        << ";" << endl;
+  cpp << "\t\t\t" << m << " = " << m << "_next;" << endl;
+  if (pre.has_value()) {
+    cpp << "\t\t\t" << inst_name << "_b2 = " << b << ";" << endl;
+    cpp << "\t\t\t" << inst_name << "_ad = " << inst_name << "_ad_next;"
+        << endl;
+    cpp << "\t\t\t" << inst_name << "_d = " << CppInput(d_port) << ";"
+        << endl;
+  }
+  cpp << "\t\t\t" << a << " = " << CppInput(a_port) << ";" << endl;
+  cpp << "\t\t\t" << b << " = " << CppInput(b_port) << ";" << endl;
+  cpp << "\t\t}" << endl;
+}
+
+DSPHDLDevice::~DSPHDLDevice() {
+  for_each(ports.begin(), ports.end(), [](HDLDevicePort *p) { delete p; });
+}
+
+int DSPHDLDevice::serial = 0;
+
+} // namespace HDLGen
+} // namespace ElasticC
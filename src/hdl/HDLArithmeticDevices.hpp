@@ -0,0 +1,206 @@
+#pragma once
+#include "BitConstant.hpp"
+#include "HDLDevice.hpp"
+#include "HDLSignal.hpp"
+#include "Operations.hpp"
+#include <optional>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+// Division or modulo by a constant, performed by multiplying by a fixed point
+// reciprocal of the divisor and shifting. Signed operands are handled by
+// dividing magnitudes and fixing up the sign of the result, giving C
+// (truncating) semantics
+class ConstantDividerHDLDevice : public HDLDevice {
+public:
+  ConstantDividerHDLDevice(OperationType _oper, HDLSignal *dividend,
+                           BitConstant _divisor, HDLSignal *output);
+  string GetInstanceName();
+  vector<HDLDevicePort *> &GetPorts();
+
+  vector<string> GetVHDLDeps();
+  void GenerateVHDLPrefix(ostream &vhdl);
+  void GenerateVHDL(ostream &vhdl);
+  void GenerateVerilogPrefix(ostream &verilog);
+  void GenerateVerilog(ostream &verilog);
+
+  void AnnotateTiming(DeviceTiming *model);
+  void AnnotateLatency(DeviceTiming *model);
+
+  void Simulate();
+  void SimulateBatch();
+  void GenerateCpp(ostream &cpp);
+
+  ~ConstantDividerHDLDevice();
+
+private:
+  static int serial;
+  string inst_name;
+  OperationType oper;
+  BitConstant divisor;   // magnitude of the divisor
+  bool divisor_negative; // true if the original divisor was negative
+  int width;             // width of the dividend magnitude
+  vector<HDLDevicePort *> ports;
+};
+
+// Division or modulo by a variable, using a restoring divider with one stage
+// per quotient bit. If pipelined, each stage is registered, giving a latency
+// equal to the dividend width but a throughput of one result per cycle. A
+// division by zero gives a quotient magnitude of all ones and the low bits of
+// the dividend magnitude as the remainder, before the signs are applied, which
+// GoldenModel::ExecuteDivide matches
+class DividerHDLDevice : public HDLDevice {
+public:
+  DividerHDLDevice(OperationType _oper, HDLSignal *dividend, HDLSignal *divisor,
+                   HDLSignal *output, HDLSignal *clk = nullptr,
+                   HDLSignal *en = nullptr);
+  string GetInstanceName();
+  vector<HDLDevicePort *> &GetPorts();
+
+  vector<string> GetVHDLDeps();
+  void GenerateVHDLPrefix(ostream &vhdl);
+  void GenerateVHDL(ostream &vhdl);
+  void GenerateVerilogPrefix(ostream &verilog);
+  void GenerateVerilog(ostream &verilog);
+
+  void AnnotateTiming(DeviceTiming *model);
+  void AnnotateLatency(DeviceTiming *model);
+
+  void Simulate();
+  void SimulateBatch();
+
+  void SimulateClock();
+  void GenerateCppPrefix(ostream &cpp);
+  void GenerateCpp(ostream &cpp);
+  void GenerateCppClock(ostream &cpp);
+
+  ~DividerHDLDevice();
+
+private:
+  static int serial;
+  string inst_name;
+  OperationType oper;
+  bool is_pipelined;
+  int num_width, den_width; // width of the dividend and divisor magnitudes
+  vector<HDLDevicePort *> ports;
+
+  // The values passed between the stages of the divider
+  struct Stage {
+    BitConstant rem, num, den;
+    bool qneg, rneg;
+  };
+  // Values after each stage when simulating a pipelined divider
+  vector<Stage> sim_stages;
+  Stage GetSimInputStage();
+  Stage GetSimNextStage(const Stage &stage);
+  void SetSimOutput(const Stage &stage);
+  // Write C++ declaring locals holding the inputs, cast to the widths of the
+  // dividend and divisor, and return an expression for the first stage
+  string GenerateCppInputStage(ostream &cpp);
+};
+
+// Sum of any number of inputs using a tree of 3:2 carry-save compressors,
+// reducing the inputs to two words which are then added by a single carry
+// chain adder. The sum is computed modulo 2^N where N is the output width
+class CompressorTreeHDLDevice : public HDLDevice {
+public:
+  CompressorTreeHDLDevice(const vector<HDLSignal *> &inputs, HDLSignal *output);
+  string GetInstanceName();
+  vector<HDLDevicePort *> &GetPorts();
+
+  vector<string> GetVHDLDeps();
+  void GenerateVHDLPrefix(ostream &vhdl);
+  void GenerateVHDL(ostream &vhdl);
+  void GenerateVerilogPrefix(ostream &verilog);
+  void GenerateVerilog(ostream &verilog);
+
+  void AnnotateTiming(DeviceTiming *model);
+  void AnnotateLatency(DeviceTiming *model);
+
+  void Simulate();
+  void SimulateBatch();
+  void GenerateCpp(ostream &cpp);
+
+  ~CompressorTreeHDLDevice();
+
+private:
+  static int serial;
+  string inst_name;
+  int width; // width of the words in the tree, equal to the output width
+  vector<HDLDevicePort *> ports;
+  // Generate the declarations and assignments of the words in the tree, in
+  // VHDL or Verilog
+  void GenerateTree(ostream &decls, ostream &assigns, bool verilog = false);
+};
+
+// A multiply mapped to a DSP block, with an adder before one multiplier input
+// (the pre-adder) and an adder after the multiplier (the post-adder) optionally
+// fused into it. The inputs, pre-adder result, product and result are all
+// registered using the block's own registers, giving a latency of three cycles
+// or four with a pre-adder. The post-adder input is only needed once the
+// product is ready, so is taken later than the other inputs, letting a chain
+// of multiply-accumulates pass each sum straight on to the next block
+class DSPHDLDevice : public HDLDevice {
+public:
+  // An adder fused into the block, computing x oper input, or input oper x if
+  // swapped, where x is the multiplier input or product. The result has the
+  // given type
+  struct FusedAdder {
+    OperationType oper;
+    HDLSignal *input;
+    bool swap;
+    HDLPortType *type;
+  };
+  // A DSP computing a * b, giving a result of type mul_type which is cast to
+  // m_type when registered. With a pre-adder, a is replaced by the pre-adder
+  // result cast to ad_type, and with a post-adder the output is the
+  // post-adder result rather than the product
+  DSPHDLDevice(HDLSignal *a, HDLSignal *b, HDLSignal *output, HDLSignal *clk,
+               HDLSignal *en, HDLPortType *mul_type, HDLPortType *m_type,
+               optional<FusedAdder> _pre = optional<FusedAdder>(),
+               HDLPortType *ad_type = nullptr,
+               optional<FusedAdder> _post = optional<FusedAdder>());
+  string GetInstanceName();
+  vector<HDLDevicePort *> &GetPorts();
+
+  vector<string> GetVHDLDeps();
+  void GenerateVHDLPrefix(ostream &vhdl);
+  void GenerateVHDL(ostream &vhdl);
+  void GenerateVerilogPrefix(ostream &verilog);
+  void GenerateVerilog(ostream &verilog);
+
+  void AnnotateTiming(DeviceTiming *model);
+  void AnnotateLatency(DeviceTiming *model);
+  vector<pair<string, double>> GetInternalDelays(DeviceTiming *model);
+
+  void Simulate();
+  int GetInputStage(HDLDevicePort *port);
+
+  // Number of cycles from the inputs to the output
+  int GetLatency();
+
+  void SimulateClock();
+  void StartBatch();
+  void SimulateBatch();
+  void SimulateBatchClock();
+  void GenerateCppPrefix(ostream &cpp);
+  void GenerateCpp(ostream &cpp);
+  void GenerateCppClock(ostream &cpp);
+
+  ~DSPHDLDevice();
+
+private:
+  static int serial;
+  string inst_name;
+  optional<FusedAdder> pre, post;
+  HDLPortType *mul_type, *m_type, *ad_type;
+  HDLDevicePort *a_port, *b_port, *d_port = nullptr, *c_port = nullptr;
+  HDLDevicePort *clk_port, *en_port, *out_port;
+  vector<HDLDevicePort *> ports;
+  // Values of the registers when simulating, named as in the VHDL
+  BitConstant sim_a, sim_b, sim_d, sim_ad, sim_b2, sim_m, sim_p;
+  BatchValue batch_a, batch_b, batch_d, batch_ad, batch_b2, batch_m, batch_p;
+};
+} // namespace HDLGen
+} // namespace ElasticC
@@ -0,0 +1,86 @@
+#include "HDLBatchSimulator.hpp"
+#include "HDLSimulator.hpp"
+
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+
+HDLBatchSimulator::HDLBatchSimulator(HDLDesign *_design, HDLSignal *_clock)
+    : design(_design), clock(_clock) {
+  LevelizeHDLDesign(design, sequential, combinational);
+  Reset();
+}
+
+void HDLBatchSimulator::Reset() {
+  for (auto sig : design->signals)
+    sig->batch_value = BatchCast(BatchValue(), sig->sigType);
+  for (auto dev : design->devices)
+    dev->StartBatch();
+  for (auto dev : sequential)
+    dev->SimulateBatch();
+  Settle();
+}
+
+void HDLBatchSimulator::Settle() {
+  for (auto dev : combinational)
+    dev->SimulateBatch();
+}
+
+void HDLBatchSimulator::SetInput(HDLDevicePort *port, int lane,
+                                 const BitConstant &value) {
+  port->connectedNet->batch_value.set_lane(
+      lane, SimCast(value, port->connectedNet->sigType));
+}
+
+void HDLBatchSimulator::Step() {
+  Settle();
+  if (clock == nullptr)
+    return;
+  for (auto dev : sequential)
+    dev->SimulateBatchClock();
+  for (auto dev : sequential)
+    dev->SimulateBatch();
+  Settle();
+}
+
+BitConstant HDLBatchSimulator::GetValue(HDLDevicePort *port, int lane) {
+  return port->connectedNet->batch_value.get_lane(lane);
+}
+
+void SetBatchValue(HDLDevicePort *port, const BatchValue &value) {
+  port->connectedNet->batch_value =
+      BatchCast(value, port->connectedNet->sigType);
+}
+
+BatchValue GetBatchSlice(const BatchValue &value, int low, int width,
+                         bool is_signed) {
+  BatchValue slice;
+  slice.is_signed = is_signed;
+  slice.resize(width);
+  for (int i = 0; i < width; i++)
+    slice.set_bit(i, value.get_bit(low + i));
+  return slice;
+}
+
+void SetBatchSlice(BatchValue &value, int low, const BatchValue &bits) {
+  for (int i = 0; i < bits.width(); i++)
+    value.set_bit(low + i, bits.get_bit(i));
+}
+
+void SimulateBatchByLane(HDLDevice *dev) {
+  for (int lane = 0; lane < SimLanes::count; lane++) {
+    for (auto p : dev->GetPorts())
+      if ((p->connectedNet != nullptr) && (p->dir == PortDirection::Input))
+        p->connectedNet->sim_value =
+            p->connectedNet->batch_value.get_lane(lane);
+    dev->Simulate();
+    for (auto p : dev->GetPorts())
+      if ((p->connectedNet != nullptr) && (p->dir == PortDirection::Output))
+        p->connectedNet->batch_value.set_lane(lane,
+                                              p->connectedNet->sim_value);
+  }
+}
+
+} // namespace HDLGen
+} // namespace ElasticC
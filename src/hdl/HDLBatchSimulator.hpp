@@ -0,0 +1,71 @@
+#pragma once
+#include "BitConstant.hpp"
+#include "HDLBatchValue.hpp"
+#include "HDLDesign.hpp"
+#include "HDLDevice.hpp"
+#include "HDLDevicePort.hpp"
+#include "HDLSignal.hpp"
+
+#include <vector>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+/*
+A simulator which runs many independent copies of a design at once, one in
+each lane of a SimLanes, so that many test vectors are checked in a single
+pass. It works as HDLSimulator does, but each net holds a BatchValue, so that
+each device's logic and arithmetic is evaluated for every lane together.
+*/
+class HDLBatchSimulator {
+public:
+  // Prepare to simulate a design, with all inputs zero and registers holding
+  // their initial values. The clock is nullptr for a purely combinational
+  // design
+  HDLBatchSimulator(HDLDesign *_design, HDLSignal *_clock);
+  // Number of lanes simulated at once
+  static const int lanes = SimLanes::count;
+  // Set all inputs and state back to zero, ready for a new batch
+  void Reset();
+  // Set the value of a top level input port in one lane
+  void SetInput(HDLDevicePort *port, int lane, const BitConstant &value);
+  // Run one clock cycle in every lane, or just update the outputs if there is
+  // no clock
+  void Step();
+  // Get the current value of a top level port in one lane
+  BitConstant GetValue(HDLDevicePort *port, int lane);
+
+private:
+  HDLDesign *design;
+  HDLSignal *clock;
+  vector<HDLDevice *> sequential, combinational;
+
+  void Settle();
+};
+
+// Convert a value to a type, as SimCast does
+inline BatchValue BatchCast(const BatchValue &value, const HDLPortType *type) {
+  return value.cast(type->GetWidth(), type->IsSigned());
+}
+
+// Set the net connected to a device output to a value, converted to the net's
+// type
+void SetBatchValue(HDLDevicePort *port, const BatchValue &value);
+
+// Return the lanes where a single bit value, such as an enable, is '1'
+inline SimLanes GetBatchHigh(HDLDevicePort *port) {
+  return ~port->connectedNet->batch_value.is_zero();
+}
+
+// Return width bits of a value starting at bit low, with a given signedness
+BatchValue GetBatchSlice(const BatchValue &value, int low, int width,
+                         bool is_signed);
+// Set bits of a value starting at bit low to the bits of another value
+void SetBatchSlice(BatchValue &value, int low, const BatchValue &bits);
+
+// Simulate a combinational device one lane at a time using its Simulate, for
+// devices where working on every lane at once would gain little
+void SimulateBatchByLane(HDLDevice *dev);
+
+} // namespace HDLGen
+} // namespace ElasticC
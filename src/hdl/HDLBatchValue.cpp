@@ -0,0 +1,214 @@
+#include "HDLBatchValue.hpp"
+
+#include <algorithm>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+BatchValue::BatchValue() : is_signed(false) {}
+
+BatchValue::BatchValue(const BitConstant &value) : is_signed(value.is_signed) {
+  for (int i = 0; i < value.width(); i++)
+    bits.push_back(SimLanes::Fill(value.get_bit(i)));
+}
+
+int BatchValue::width() const { return int(bits.size()); }
+
+SimLanes BatchValue::get_bit(int i) const {
+  if (i >= width())
+    return is_negative();
+  return bits.at(i);
+}
+
+void BatchValue::set_bit(int i, SimLanes value) { bits.at(i) = value; }
+
+void BatchValue::resize(int newWidth) {
+  bits.resize(newWidth, SimLanes::Fill(false));
+}
+
+SimLanes BatchValue::is_negative() const {
+  if (is_signed && !bits.empty())
+    return bits.back();
+  return SimLanes::Fill(false);
+}
+
+SimLanes BatchValue::is_zero() const {
+  SimLanes nonzero = SimLanes::Fill(false);
+  for (auto bit : bits)
+    nonzero = nonzero | bit;
+  return ~nonzero;
+}
+
+BatchValue BatchValue::cast(int newsize, bool newsigned) const {
+  BatchValue casted;
+  casted.is_signed = newsigned;
+  casted.resize(newsize);
+  for (int i = 0; i < newsize; i++)
+    casted.set_bit(i, get_bit(i)); // sign extends if required
+  return casted;
+}
+
+BitConstant BatchValue::get_lane(int lane) const {
+  BitConstant value;
+  value.is_signed = is_signed;
+  value.resize(width());
+  for (int i = 0; i < width(); i++)
+    value.set_bit(i, bits.at(i).Get(lane));
+  return value;
+}
+
+void BatchValue::set_lane(int lane, const BitConstant &value) {
+  for (int i = 0; i < width(); i++)
+    bits.at(i).Set(lane, value.get_bit(i));
+}
+
+BatchValue InvertBatch(const BatchValue &a) {
+  BatchValue result;
+  result.is_signed = a.is_signed;
+  result.resize(a.width());
+  for (int i = 0; i < a.width(); i++)
+    result.set_bit(i, ~a.get_bit(i));
+  return result;
+}
+
+// Width of a value once converted to a signed result, if required, where an
+// unsigned value needs an extra bit
+static int GetSignedWidth(const BatchValue &a, bool is_signed) {
+  return a.width() + ((is_signed && !a.is_signed) ? 1 : 0);
+}
+
+// Add two values, or subtract the second from the first, with a ripple carry
+// across the bits
+static BatchValue AddOrSubtract(const BatchValue &a, const BatchValue &b,
+                                bool subtract) {
+  BatchValue result;
+  result.is_signed = a.is_signed || b.is_signed;
+  result.resize(max(GetSignedWidth(a, result.is_signed),
+                    GetSignedWidth(b, result.is_signed)) +
+                1);
+  SimLanes carry = SimLanes::Fill(subtract);
+  for (int i = 0; i < result.width(); i++) {
+    SimLanes x = a.get_bit(i), y = b.get_bit(i);
+    if (subtract)
+      y = ~y;
+    result.set_bit(i, x ^ y ^ carry);
+    carry = (x & y) | (carry & (x ^ y));
+  }
+  return result;
+}
+
+BatchValue AddBatch(const BatchValue &a, const BatchValue &b) {
+  return AddOrSubtract(a, b, false);
+}
+
+BatchValue SubtractBatch(const BatchValue &a, const BatchValue &b) {
+  return AddOrSubtract(a, b, true);
+}
+
+BatchValue MultiplyBatch(const BatchValue &a, const BatchValue &b) {
+  // The product fits in the sum of the operand widths, so is the same as the
+  // product of the sign extended operands modulo that width, which is built
+  // up one partial product at a time
+  BatchValue result;
+  result.is_signed = a.is_signed || b.is_signed;
+  result.resize(a.width() + b.width());
+  for (int i = 0; i < result.width(); i++) {
+    SimLanes multiplier = b.get_bit(i);
+    if (!multiplier.Any())
+      continue;
+    SimLanes carry = SimLanes::Fill(false);
+    for (int j = i; j < result.width(); j++) {
+      SimLanes x = result.get_bit(j), y = a.get_bit(j - i) & multiplier;
+      result.set_bit(j, x ^ y ^ carry);
+      carry = (x & y) | (carry & (x ^ y));
+    }
+  }
+  return result;
+}
+
+BatchValue BitwiseBatchOperation(const BatchValue &a, const BatchValue &b,
+                                 OperationType oper) {
+  BatchValue result;
+  result.is_signed = a.is_signed || b.is_signed;
+  result.resize(max(a.width(), b.width()));
+  for (int i = 0; i < result.width(); i++) {
+    SimLanes x = a.get_bit(i), y = b.get_bit(i);
+    switch (oper) {
+    case B_BWOR:
+      result.set_bit(i, x | y);
+      break;
+    case B_BWAND:
+      result.set_bit(i, x & y);
+      break;
+    case B_BWXOR:
+      result.set_bit(i, x ^ y);
+      break;
+    default:
+      break;
+    }
+  }
+  return result;
+}
+
+SimLanes AreBatchesEqual(const BatchValue &a, const BatchValue &b) {
+  // One bit past the widest value compares the sign extensions, which differ
+  // between signed and unsigned values with the same bits
+  SimLanes diff = SimLanes::Fill(false);
+  for (int i = 0; i <= max(a.width(), b.width()); i++)
+    diff = diff | (a.get_bit(i) ^ b.get_bit(i));
+  return ~diff;
+}
+
+SimLanes IsBatchLessThan(const BatchValue &a, const BatchValue &b) {
+  // The difference always has room for its sign, so its top bit is set
+  // exactly when it is negative
+  BatchValue diff = SubtractBatch(a, b);
+  return diff.get_bit(diff.width() - 1);
+}
+
+static BatchValue ShiftBatch(const BatchValue &val, const BatchValue &amt,
+                             bool left) {
+  int width = val.width();
+  SimLanes fill = left ? SimLanes::Fill(false) : val.is_negative();
+  SimLanes positive = ~amt.is_negative();
+  // Shift by each power of two in the amount in turn, and past the end of the
+  // value by any larger amount
+  BatchValue result = val;
+  SimLanes over = SimLanes::Fill(false);
+  for (int k = 0; k < amt.width() - (amt.is_signed ? 1 : 0); k++) {
+    SimLanes sel = amt.get_bit(k) & positive;
+    if ((k >= 30) || ((1 << k) >= width)) {
+      over = over | sel;
+      continue;
+    }
+    int dist = 1 << k;
+    BatchValue shifted = result;
+    for (int i = 0; i < width; i++) {
+      int from = left ? (i - dist) : (i + dist);
+      bool inside = (from >= 0) && (from < width);
+      shifted.set_bit(i, inside ? result.get_bit(from) : fill);
+    }
+    result = SelectBatch(sel, result, shifted);
+  }
+  for (int i = 0; i < width; i++)
+    result.set_bit(i, SelectLanes(over, result.get_bit(i), fill));
+  return result;
+}
+
+BatchValue LeftShiftBatch(const BatchValue &val, const BatchValue &amt) {
+  return ShiftBatch(val, amt, true);
+}
+
+BatchValue RightShiftBatch(const BatchValue &val, const BatchValue &amt) {
+  return ShiftBatch(val, amt, false);
+}
+
+BatchValue SelectBatch(SimLanes sel, const BatchValue &a, const BatchValue &b) {
+  BatchValue result = a;
+  for (int i = 0; i < a.width(); i++)
+    result.set_bit(i, SelectLanes(sel, a.get_bit(i), b.get_bit(i)));
+  return result;
+}
+
+} // namespace HDLGen
+} // namespace ElasticC
@@ -0,0 +1,140 @@
+#pragma once
+#include "BitConstant.hpp"
+#include "Operations.hpp"
+
+#include <cstdint>
+#include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+/*
+One bit from each of a group of independent simulations, or lanes, so that a
+logic operation works on every lane at once. With AVX2 there are 256 lanes in a
+vector register, otherwise there are 64 in a 64-bit word.
+*/
+#if defined(__AVX2__)
+struct SimLanes {
+  static const int count = 256;
+  __m256i bits;
+
+  static SimLanes Fill(bool value) {
+    return SimLanes{_mm256_set1_epi64x(value ? -1 : 0)};
+  }
+  bool Any() const { return !_mm256_testz_si256(bits, bits); }
+  bool Get(int lane) const {
+    alignas(32) uint64_t words[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(words), bits);
+    return (words[lane / 64] >> (lane % 64)) & 0x1;
+  }
+  void Set(int lane, bool value) {
+    alignas(32) uint64_t words[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(words), bits);
+    uint64_t mask = uint64_t(1) << (lane % 64);
+    words[lane / 64] = value ? (words[lane / 64] | mask)
+                             : (words[lane / 64] & ~mask);
+    bits = _mm256_load_si256(reinterpret_cast<__m256i *>(words));
+  }
+};
+
+inline SimLanes operator&(SimLanes a, SimLanes b) {
+  return SimLanes{_mm256_and_si256(a.bits, b.bits)};
+}
+inline SimLanes operator|(SimLanes a, SimLanes b) {
+  return SimLanes{_mm256_or_si256(a.bits, b.bits)};
+}
+inline SimLanes operator^(SimLanes a, SimLanes b) {
+  return SimLanes{_mm256_xor_si256(a.bits, b.bits)};
+}
+inline SimLanes operator~(SimLanes a) {
+  return SimLanes{_mm256_xor_si256(a.bits, _mm256_set1_epi64x(-1))};
+}
+#else
+struct SimLanes {
+  static const int count = 64;
+  uint64_t bits;
+
+  static SimLanes Fill(bool value) {
+    return SimLanes{value ? ~uint64_t(0) : 0};
+  }
+  bool Any() const { return bits != 0; }
+  bool Get(int lane) const { return (bits >> lane) & 0x1; }
+  void Set(int lane, bool value) {
+    uint64_t mask = uint64_t(1) << lane;
+    bits = value ? (bits | mask) : (bits & ~mask);
+  }
+};
+
+inline SimLanes operator&(SimLanes a, SimLanes b) {
+  return SimLanes{a.bits & b.bits};
+}
+inline SimLanes operator|(SimLanes a, SimLanes b) {
+  return SimLanes{a.bits | b.bits};
+}
+inline SimLanes operator^(SimLanes a, SimLanes b) {
+  return SimLanes{a.bits ^ b.bits};
+}
+inline SimLanes operator~(SimLanes a) { return SimLanes{~a.bits}; }
+#endif
+
+// Return b in lanes where sel is set, and a in the others
+inline SimLanes SelectLanes(SimLanes sel, SimLanes a, SimLanes b) {
+  return (sel & b) | (~sel & a);
+}
+
+/*
+A value in every lane of a batch simulation, stored bit sliced: each bit of
+the value is held for all lanes together, so that arithmetic is done a bit at a
+time as in a ripple carry adder, but for every lane at once. Otherwise it
+behaves as a BitConstant, with bits past the width reading as the sign
+extension.
+*/
+class BatchValue {
+public:
+  BatchValue();
+  // The same value in every lane
+  BatchValue(const BitConstant &value);
+  bool is_signed;
+
+  int width() const;
+  SimLanes get_bit(int i) const; // note bit 0 is LSB
+  void set_bit(int i, SimLanes value);
+  // Change the width, keeping the low bits and filling new bits with zero
+  void resize(int newWidth);
+  SimLanes is_negative() const;
+  SimLanes is_zero() const;
+  BatchValue cast(int newsize, bool newsigned) const;
+
+  // Access the value in a single lane
+  BitConstant get_lane(int lane) const;
+  void set_lane(int lane, const BitConstant &value);
+
+private:
+  vector<SimLanes> bits;
+};
+
+// These functions perform the same operations as the BitConstant functions
+// with similar names, giving results of the same width and signedness
+BatchValue InvertBatch(const BatchValue &a);
+BatchValue AddBatch(const BatchValue &a, const BatchValue &b);
+BatchValue SubtractBatch(const BatchValue &a, const BatchValue &b);
+BatchValue MultiplyBatch(const BatchValue &a, const BatchValue &b);
+BatchValue BitwiseBatchOperation(const BatchValue &a, const BatchValue &b,
+                                 OperationType oper);
+// Comparisons return the lanes where they are true
+SimLanes AreBatchesEqual(const BatchValue &a, const BatchValue &b);
+SimLanes IsBatchLessThan(const BatchValue &a, const BatchValue &b);
+// Shift a value within its width, by an amount that may differ between lanes.
+// A negative amount leaves the value unchanged, and shifting right fills with
+// the sign of a signed value
+BatchValue LeftShiftBatch(const BatchValue &val, const BatchValue &amt);
+BatchValue RightShiftBatch(const BatchValue &val, const BatchValue &amt);
+// Return b in lanes where sel is set, and a in the others. Both must have the
+// same width
+BatchValue SelectBatch(SimLanes sel, const BatchValue &a, const BatchValue &b);
+
+} // namespace HDLGen
+} // namespace ElasticC
@@ -1,6 +1,10 @@
 #include "HDLCoreDevices.hpp"
+#include "HDLBatchSimulator.hpp"
+#include "HDLCppModel.hpp"
 #include "HDLDevicePort.hpp"
 #include "HDLSignal.hpp"
+#include "HDLSimulator.hpp"
+#include "HDLVerilog.hpp"
 
 #include <algorithm>
 using namespace std;
@@ -36,30 +40,101 @@ void OperationHDLDevice::GenerateVHDLPrefix(ostream &vhdl) {
 }
 
 void OperationHDLDevice::GenerateVHDL(ostream &vhdl) {
+  vector<HDLPortType *> types;
+  vector<string> operands;
+  for (int i = 0; i < ports.size() - 1; i++) {
+    types.push_back(ports.at(i)->type);
+    operands.push_back(ports.at(i)->connectedNet->name);
+  }
+  vhdl << "\t" << ports.back()->connectedNet->name << " <= "
+       << GetVHDLValue(oper, types, operands,
+                       ports.back()->connectedNet->sigType)
+       << ";" << endl;
+}
+
+void OperationHDLDevice::GenerateVerilog(ostream &verilog) {
+  vector<HDLPortType *> types;
+  vector<string> operands;
+  for (int i = 0; i < ports.size() - 1; i++) {
+    types.push_back(ports.at(i)->type);
+    operands.push_back(ports.at(i)->connectedNet->name);
+  }
+  GenerateVerilogValue(verilog, oper, types, operands,
+                       ports.back()->connectedNet->sigType,
+                       ports.back()->connectedNet->name, inst_name + "_value");
+}
+
+OperationType OperationHDLDevice::GetOperation() { return oper; }
+
+string OperationHDLDevice::GetVHDLValue(OperationType oper,
+                                        const vector<HDLPortType *> &types,
+                                        vector<string> operands,
+                                        HDLPortType *outType) {
   string value = "";
+  // Bitwise operations on single bits, such as enables, are done directly as
+  // std_logic
+  bool all_logic = (dynamic_cast<LogicSignalPortType *>(outType) != nullptr);
+  for (auto type : types)
+    all_logic &= (dynamic_cast<LogicSignalPortType *>(type) != nullptr);
+  if (all_logic) {
+    switch (oper) {
+    case OperationType::B_BWAND:
+      return operands.at(0) + " and " + operands.at(1);
+    case OperationType::B_BWOR:
+      return operands.at(0) + " or " + operands.at(1);
+    case OperationType::B_BWXOR:
+      return operands.at(0) + " xor " + operands.at(1);
+    case OperationType::U_BWNOT:
+      return "not " + operands.at(0);
+    default:
+      break;
+    }
+  }
   int width = 0;
   bool is_signed = false;
-  vector<string> operands;
   // Work out max width and signedness
-  for (int i = 0; i < ports.size() - 1; i++) {
-    operands.push_back(ports.at(i)->connectedNet->name);
-    HDLPortType *type = ports.at(i)->type;
+  for (auto type : types) {
     width = max(width, type->GetWidth());
     is_signed |= type->IsSigned();
   }
-  // Add/sub extend width by 1 to guarantee no overflow
-  if ((oper == OperationType::B_ADD) || (oper == OperationType::B_SUB)
-      || (oper == OperationType::B_NEQ) || (oper == OperationType::B_EQ) || (oper == OperationType::B_GT)
-      || (oper == OperationType::B_GTE) || (oper == OperationType::B_LT) || (oper == OperationType::B_LTE)) {
+  // Add/sub extend width by 1 to guarantee no overflow, after converting any
+  // unsigned operands to signed. Comparisons only need an extra bit when
+  // unsigned operands are converted to signed
+  bool mixed_sign = false;
+  for (auto type : types)
+    mixed_sign |= (type->IsSigned() != is_signed);
+  if ((oper == OperationType::B_ADD) || (oper == OperationType::B_SUB)) {
+    for (auto type : types)
+      if (type->IsSigned() != is_signed)
+        width = max(width, type->GetWidth() + 1);
+    width += 1;
+  } else if (((oper == OperationType::B_NEQ) || (oper == OperationType::B_EQ) ||
+              (oper == OperationType::B_GT) || (oper == OperationType::B_GTE) ||
+              (oper == OperationType::B_LT) || (oper == OperationType::B_LTE)) &&
+             mixed_sign) {
     width += 1;
   }
-  // Multiplication keeps operand types to allow signed/unsigned and mixed
-  // width multiplies, everything else casts to a common type
-  for (int i = 0; i < ports.size() - 1; i++) {
-    HDLPortType *type = ports.at(i)->type;
-    if (oper == OperationType::B_MUL) {
-      operands.at(i) = NumericPortType(type->GetWidth(), type->IsSigned())
-                           .VHDLCastFrom(type, operands.at(i));
+  // Shifts are performed at the result width, or the input width if that is
+  // larger, with the signedness of the value being shifted
+  bool is_shift = (oper == OperationType::B_LS) || (oper == OperationType::B_RS);
+  if (is_shift) {
+    width = max(types.at(0)->GetWidth(), outType->GetWidth());
+    is_signed = types.at(0)->IsSigned();
+  }
+  // Multiplication keeps operand widths to allow mixed width multiplies, with
+  // unsigned operands gaining a bit when multiplied by a signed value. Shift
+  // amounts are used as they are, and everything else casts to a common type
+  for (int i = 0; i < types.size(); i++) {
+    HDLPortType *type = types.at(i);
+    if (is_shift && (i == 1)) {
+      operands.at(i) =
+          NumericPortType(type->GetWidth(), type->IsSigned())
+              .VHDLCastFrom(type, operands.at(i));
+    } else if (oper == OperationType::B_MUL) {
+      bool extend = is_signed && !type->IsSigned();
+      operands.at(i) =
+          NumericPortType(type->GetWidth() + (extend ? 1 : 0), is_signed)
+              .VHDLCastFrom(type, operands.at(i));
     } else {
       operands.at(i) =
           NumericPortType(width, is_signed).VHDLCastFrom(type, operands.at(i));
@@ -71,10 +146,8 @@ void OperationHDLDevice::GenerateVHDL(ostream &vhdl) {
 
   // One and zero cast to result type for use in logical operations
   NumericPortType logConstType(1, false);
-  string zero = ports.back()->connectedNet->sigType->VHDLCastFrom(
-      &logConstType, "to_unsigned(0, 1)");
-  string one = ports.back()->connectedNet->sigType->VHDLCastFrom(
-      &logConstType, "to_unsigned(1, 1)");
+  string zero = outType->VHDLCastFrom(&logConstType, "to_unsigned(0, 1)");
+  string one = outType->VHDLCastFrom(&logConstType, "to_unsigned(1, 1)");
 
   switch (oper) {
   case OperationType::B_ADD:
@@ -149,50 +222,654 @@ void OperationHDLDevice::GenerateVHDL(ostream &vhdl) {
   }
 
   NumericPortType resType(width, is_signed);
-  vhdl << "\t" << ports.back()->connectedNet->name << " <= ";
-  if (is_logical) {
-    vhdl << value;
+  if (is_logical)
+    return value;
+  else
+    return outType->VHDLCastFrom(&resType, value);
+}
+
+// Resize a value as numeric_std's resize does, which keeps the sign bit when
+// narrowing a signed value
+static BitConstant ResizeNumeric(const BitConstant &value, int width) {
+  BitConstant result = value.cast(width, value.is_signed);
+  if (value.is_signed && (width > 0) && (width < value.width()))
+    result.set_bit(width - 1, value.is_negative());
+  return result;
+}
+
+// Number of places to shift by, given the shift amount, where shifting by the
+// width or more leaves only zeros or the sign
+static int GetShiftAmount(const BitConstant &amount, int width) {
+  if (amount.is_negative())
+    return 0;
+  for (int i = 1; i < amount.limb_count(); i++)
+    if (amount.get_limb(i) != 0)
+      return width;
+  return int(min(amount.get_limb(0), uint64_t(width)));
+}
+
+// Work out the width and signedness that an operation is computed at, and cast
+// the operands to suit, exactly as GetVHDLValue does
+template <typename Value>
+static void CastOperands(OperationType oper, const vector<HDLPortType *> &types,
+                         HDLPortType *outType, vector<Value> &operands,
+                         int &width, bool &is_signed) {
+  width = 0;
+  is_signed = false;
+  for (auto type : types) {
+    width = max(width, type->GetWidth());
+    is_signed |= type->IsSigned();
+  }
+  bool mixed_sign = false;
+  for (auto type : types)
+    mixed_sign |= (type->IsSigned() != is_signed);
+  if ((oper == OperationType::B_ADD) || (oper == OperationType::B_SUB)) {
+    for (auto type : types)
+      if (type->IsSigned() != is_signed)
+        width = max(width, type->GetWidth() + 1);
+    width += 1;
+  } else if (((oper == OperationType::B_NEQ) || (oper == OperationType::B_EQ) ||
+              (oper == OperationType::B_GT) || (oper == OperationType::B_GTE) ||
+              (oper == OperationType::B_LT) || (oper == OperationType::B_LTE)) &&
+             mixed_sign) {
+    width += 1;
+  }
+  bool is_shift = (oper == OperationType::B_LS) || (oper == OperationType::B_RS);
+  if (is_shift) {
+    width = max(types.at(0)->GetWidth(), outType->GetWidth());
+    is_signed = types.at(0)->IsSigned();
+  }
+  for (int i = 0; i < types.size(); i++) {
+    HDLPortType *type = types.at(i);
+    if (is_shift && (i == 1)) {
+      continue;
+    } else if (oper == OperationType::B_MUL) {
+      bool extend = is_signed && !type->IsSigned();
+      operands.at(i) =
+          operands.at(i).cast(type->GetWidth() + (extend ? 1 : 0), is_signed);
+    } else {
+      operands.at(i) = operands.at(i).cast(width, is_signed);
+    }
+  }
+}
+
+BitConstant OperationHDLDevice::GetSimValue(OperationType oper,
+                                            const vector<HDLPortType *> &types,
+                                            vector<BitConstant> operands,
+                                            HDLPortType *outType) {
+  for (int i = 0; i < types.size(); i++)
+    operands.at(i) = SimCast(operands.at(i), types.at(i));
+  bool all_logic = (dynamic_cast<LogicSignalPortType *>(outType) != nullptr);
+  for (auto type : types)
+    all_logic &= (dynamic_cast<LogicSignalPortType *>(type) != nullptr);
+  if (all_logic) {
+    switch (oper) {
+    case OperationType::B_BWAND:
+    case OperationType::B_BWOR:
+    case OperationType::B_BWXOR:
+      return BitwiseBitOperation(operands.at(0), operands.at(1), oper);
+    case OperationType::U_BWNOT:
+      return InvertBits(operands.at(0));
+    default:
+      break;
+    }
+  }
+  int width;
+  bool is_signed;
+  CastOperands(oper, types, outType, operands, width, is_signed);
+
+  BitConstant value;
+  bool condition = false;
+  switch (oper) {
+  case OperationType::B_ADD:
+    value = AddBits(operands.at(0), operands.at(1));
+    break;
+  case OperationType::B_SUB:
+    value = SubtractBits(operands.at(0), operands.at(1));
+    break;
+  case OperationType::B_MUL:
+    // The product is as wide as both operands together
+    value = MultiplyBits(operands.at(0), operands.at(1));
+    break;
+  case OperationType::B_BWAND:
+  case OperationType::B_BWOR:
+  case OperationType::B_BWXOR:
+    value = BitwiseBitOperation(operands.at(0), operands.at(1), oper);
+    break;
+  case OperationType::U_MINUS:
+    value = SubtractBits(BitConstant(0), operands.at(0));
+    break;
+  case OperationType::U_BWNOT:
+    value = InvertBits(operands.at(0));
+    break;
+  case OperationType::B_EQ:
+    condition = !AreBitsEqual(operands.at(0), operands.at(1)).is_zero();
+    break;
+  case OperationType::B_NEQ:
+    condition = AreBitsEqual(operands.at(0), operands.at(1)).is_zero();
+    break;
+  case OperationType::B_LT:
+    condition = !IsLessThan(operands.at(0), operands.at(1)).is_zero();
+    break;
+  case OperationType::B_GT:
+    condition = !IsLessThan(operands.at(1), operands.at(0)).is_zero();
+    break;
+  case OperationType::B_LTE:
+    condition = IsLessThan(operands.at(1), operands.at(0)).is_zero();
+    break;
+  case OperationType::B_GTE:
+    condition = IsLessThan(operands.at(0), operands.at(1)).is_zero();
+    break;
+  case OperationType::B_LAND:
+  case OperationType::B_LOR:
+  case OperationType::U_LNOT:
+    condition = !LogicalBitOperation(operands, oper).is_zero();
+    break;
+  case OperationType::B_LS:
+    value = LeftShiftBits(operands.at(0),
+                          BitConstant(GetShiftAmount(operands.at(1), width)));
+    break;
+  case OperationType::B_RS:
+    value = RightShiftBits(operands.at(0),
+                           BitConstant(GetShiftAmount(operands.at(1), width)));
+    break;
+  default:
+    throw runtime_error("operation type not supported in HDL");
+  }
+
+  if (HasBooleanResult(oper))
+    return SimCast(BitConstant(condition ? 1 : 0, 1), outType);
+  // Everything but a product already has the expression's width
+  if (oper != OperationType::B_MUL)
+    value = value.cast(width, is_signed);
+  if (dynamic_cast<LogicSignalPortType *>(outType) != nullptr)
+    return SimCast(value, outType);
+  // Signed values wider than the result are truncated, and anything else
+  // resized
+  if (!(is_signed && (width > outType->GetWidth())))
+    value = ResizeNumeric(value, outType->GetWidth());
+  return SimCast(value, outType);
+}
+
+// Resize a value in every lane, as ResizeNumeric does
+static BatchValue ResizeBatchNumeric(const BatchValue &value, int width) {
+  BatchValue result = value.cast(width, value.is_signed);
+  if (value.is_signed && (width > 0) && (width < value.width()))
+    result.set_bit(width - 1, value.is_negative());
+  return result;
+}
+
+BatchValue OperationHDLDevice::GetBatchValue(OperationType oper,
+                                             const vector<HDLPortType *> &types,
+                                             vector<BatchValue> operands,
+                                             HDLPortType *outType) {
+  for (int i = 0; i < types.size(); i++)
+    operands.at(i) = BatchCast(operands.at(i), types.at(i));
+  bool all_logic = (dynamic_cast<LogicSignalPortType *>(outType) != nullptr);
+  for (auto type : types)
+    all_logic &= (dynamic_cast<LogicSignalPortType *>(type) != nullptr);
+  if (all_logic) {
+    switch (oper) {
+    case OperationType::B_BWAND:
+    case OperationType::B_BWOR:
+    case OperationType::B_BWXOR:
+      return BitwiseBatchOperation(operands.at(0), operands.at(1), oper);
+    case OperationType::U_BWNOT:
+      return InvertBatch(operands.at(0));
+    default:
+      break;
+    }
+  }
+  int width;
+  bool is_signed;
+  CastOperands(oper, types, outType, operands, width, is_signed);
+
+  BatchValue value;
+  SimLanes condition = SimLanes::Fill(false);
+  switch (oper) {
+  case OperationType::B_ADD:
+    value = AddBatch(operands.at(0), operands.at(1));
+    break;
+  case OperationType::B_SUB:
+    value = SubtractBatch(operands.at(0), operands.at(1));
+    break;
+  case OperationType::B_MUL:
+    value = MultiplyBatch(operands.at(0), operands.at(1));
+    break;
+  case OperationType::B_BWAND:
+  case OperationType::B_BWOR:
+  case OperationType::B_BWXOR:
+    value = BitwiseBatchOperation(operands.at(0), operands.at(1), oper);
+    break;
+  case OperationType::U_MINUS:
+    value = SubtractBatch(BatchValue(BitConstant(0)), operands.at(0));
+    break;
+  case OperationType::U_BWNOT:
+    value = InvertBatch(operands.at(0));
+    break;
+  case OperationType::B_EQ:
+    condition = AreBatchesEqual(operands.at(0), operands.at(1));
+    break;
+  case OperationType::B_NEQ:
+    condition = ~AreBatchesEqual(operands.at(0), operands.at(1));
+    break;
+  case OperationType::B_LT:
+    condition = IsBatchLessThan(operands.at(0), operands.at(1));
+    break;
+  case OperationType::B_GT:
+    condition = IsBatchLessThan(operands.at(1), operands.at(0));
+    break;
+  case OperationType::B_LTE:
+    condition = ~IsBatchLessThan(operands.at(1), operands.at(0));
+    break;
+  case OperationType::B_GTE:
+    condition = ~IsBatchLessThan(operands.at(0), operands.at(1));
+    break;
+  case OperationType::B_LAND:
+    condition = ~operands.at(0).is_zero() & ~operands.at(1).is_zero();
+    break;
+  case OperationType::B_LOR:
+    condition = ~operands.at(0).is_zero() | ~operands.at(1).is_zero();
+    break;
+  case OperationType::U_LNOT:
+    condition = operands.at(0).is_zero();
+    break;
+  case OperationType::B_LS:
+    value = LeftShiftBatch(operands.at(0), operands.at(1));
+    break;
+  case OperationType::B_RS:
+    value = RightShiftBatch(operands.at(0), operands.at(1));
+    break;
+  default:
+    throw runtime_error("operation type not supported in HDL");
+  }
+
+  if (HasBooleanResult(oper)) {
+    BatchValue result = BatchValue(BitConstant(0, 1));
+    result.set_bit(0, condition);
+    return BatchCast(result, outType);
+  }
+  if (oper != OperationType::B_MUL)
+    value = value.cast(width, is_signed);
+  if (dynamic_cast<LogicSignalPortType *>(outType) != nullptr)
+    return BatchCast(value, outType);
+  if (!(is_signed && (width > outType->GetWidth())))
+    value = ResizeBatchNumeric(value, outType->GetWidth());
+  return BatchCast(value, outType);
+}
+
+// An expression in a C++ model, with the width and signedness of its value,
+// so that operands can be cast by CastOperands as for simulation
+struct CppValue {
+  string expr;
+  int width;
+  bool is_signed;
+
+  CppValue cast(int newWidth, bool newSigned) const {
+    NumericPortType from(width, is_signed), to(newWidth, newSigned);
+    return CppValue{to.CppCastFrom(&from, expr), newWidth, newSigned};
+  }
+};
+
+string OperationHDLDevice::GetCppValue(OperationType oper,
+                                       const vector<HDLPortType *> &types,
+                                       vector<string> operands,
+                                       HDLPortType *outType) {
+  vector<CppValue> values;
+  for (int i = 0; i < types.size(); i++)
+    values.push_back(CppValue{operands.at(i), types.at(i)->GetWidth(),
+                              types.at(i)->IsSigned()});
+  NumericPortType bitType(1, false);
+  bool all_logic = (dynamic_cast<LogicSignalPortType *>(outType) != nullptr);
+  for (auto type : types)
+    all_logic &= (dynamic_cast<LogicSignalPortType *>(type) != nullptr);
+  if (all_logic) {
+    switch (oper) {
+    case OperationType::B_BWAND:
+      return "(" + operands.at(0) + " & " + operands.at(1) + ")";
+    case OperationType::B_BWOR:
+      return "(" + operands.at(0) + " | " + operands.at(1) + ")";
+    case OperationType::B_BWXOR:
+      return "(" + operands.at(0) + " ^ " + operands.at(1) + ")";
+    case OperationType::U_BWNOT:
+      return "ecc::norm<1, false>(~" + operands.at(0) + ")";
+    default:
+      break;
+    }
+  }
+  int width;
+  bool is_signed;
+  CastOperands(oper, types, outType, values, width, is_signed);
+
+  string params = "<" + to_string(width) + ", " +
+                  (is_signed ? "true" : "false") + ">";
+  string sign = is_signed ? "true" : "false";
+  auto nonzero = [&](int i) {
+    return "!ecc::is_zero(" + values.at(i).expr + ")";
+  };
+  string value, condition;
+  int valueWidth = width;
+  switch (oper) {
+  case OperationType::B_ADD:
+    value = "ecc::add" + params + "(" + values.at(0).expr + ", " +
+            values.at(1).expr + ")";
+    break;
+  case OperationType::B_SUB:
+    value = "ecc::sub" + params + "(" + values.at(0).expr + ", " +
+            values.at(1).expr + ")";
+    break;
+  case OperationType::B_MUL: {
+    // The product is as wide as both operands together, so the operands are
+    // extended to that width before multiplying
+    valueWidth = values.at(0).width + values.at(1).width;
+    value = "ecc::mul<" + to_string(valueWidth) + ", " + sign + ">(" +
+            values.at(0).cast(valueWidth, is_signed).expr + ", " +
+            values.at(1).cast(valueWidth, is_signed).expr + ")";
+  } break;
+  case OperationType::B_BWAND:
+    value = "(" + values.at(0).expr + " & " + values.at(1).expr + ")";
+    break;
+  case OperationType::B_BWOR:
+    value = "(" + values.at(0).expr + " | " + values.at(1).expr + ")";
+    break;
+  case OperationType::B_BWXOR:
+    value = "(" + values.at(0).expr + " ^ " + values.at(1).expr + ")";
+    break;
+  case OperationType::U_MINUS:
+    value = "ecc::sub" + params + "(ecc::uint_t<" + to_string(width) + ">{}, " +
+            values.at(0).expr + ")";
+    break;
+  case OperationType::U_BWNOT:
+    value = "ecc::norm" + params + "(~" + values.at(0).expr + ")";
+    break;
+  case OperationType::B_EQ:
+    condition = values.at(0).expr + " == " + values.at(1).expr;
+    break;
+  case OperationType::B_NEQ:
+    condition = values.at(0).expr + " != " + values.at(1).expr;
+    break;
+  case OperationType::B_LT:
+    condition = "ecc::lt<" + sign + ">(" + values.at(0).expr + ", " +
+                values.at(1).expr + ")";
+    break;
+  case OperationType::B_GT:
+    condition = "ecc::lt<" + sign + ">(" + values.at(1).expr + ", " +
+                values.at(0).expr + ")";
+    break;
+  case OperationType::B_LTE:
+    condition = "!ecc::lt<" + sign + ">(" + values.at(1).expr + ", " +
+                values.at(0).expr + ")";
+    break;
+  case OperationType::B_GTE:
+    condition = "!ecc::lt<" + sign + ">(" + values.at(0).expr + ", " +
+                values.at(1).expr + ")";
+    break;
+  case OperationType::B_LAND:
+    condition = nonzero(0) + " && " + nonzero(1);
+    break;
+  case OperationType::B_LOR:
+    condition = nonzero(0) + " || " + nonzero(1);
+    break;
+  case OperationType::U_LNOT:
+    condition = "ecc::is_zero(" + values.at(0).expr + ")";
+    break;
+  case OperationType::B_LS:
+  case OperationType::B_RS:
+    value = string((oper == OperationType::B_LS) ? "ecc::shl" : "ecc::shr") +
+            params + "(" + values.at(0).expr + ", ecc::shift_amount<" +
+            (values.at(1).is_signed ? "true" : "false") + ">(" +
+            values.at(1).expr + ", " + to_string(width) + "))";
+    break;
+  default:
+    throw runtime_error("operation type not supported in HDL");
+  }
+
+  if (HasBooleanResult(oper))
+    return outType->CppCastFrom(&bitType, "uint64_t(" + condition + ")");
+  NumericPortType valueType(valueWidth, is_signed);
+  // As for simulation, only a signed product narrowed to no less than the
+  // operand width keeps its sign bit
+  if ((oper == OperationType::B_MUL) && is_signed &&
+      (dynamic_cast<LogicSignalPortType *>(outType) == nullptr) &&
+      (width <= outType->GetWidth()) && (outType->GetWidth() < valueWidth)) {
+    NumericPortType resizedType(outType->GetWidth(), true);
+    return outType->CppCastFrom(&resizedType,
+                                "ecc::resize<" +
+                                    to_string(outType->GetWidth()) + ">(" +
+                                    value + ")");
+  }
+  return outType->CppCastFrom(&valueType, value);
+}
+
+// A Verilog net, with the width and signedness of its value, so that operands
+// can be cast by CastOperands as for simulation. Casting gives an expression
+// rather than a net, so it can only be done once
+struct VerilogValue {
+  string expr;
+  int width;
+  bool is_signed;
+
+  VerilogValue cast(int newWidth, bool newSigned) const {
+    NumericPortType from(width, is_signed), to(newWidth, newSigned);
+    return VerilogValue{to.VerilogCastFrom(&from, expr), newWidth, newSigned};
+  }
+};
+
+void OperationHDLDevice::GenerateVerilogValue(
+    ostream &verilog, OperationType oper, const vector<HDLPortType *> &types,
+    const vector<string> &operands, HDLPortType *outType, const string &result,
+    const string &temp) {
+  auto assign = [&](const string &value) {
+    verilog << "\tassign " << result << " = " << value << ";" << endl;
+  };
+  vector<VerilogValue> values;
+  for (int i = 0; i < types.size(); i++)
+    values.push_back(VerilogValue{operands.at(i), types.at(i)->GetWidth(),
+                                  types.at(i)->IsSigned()});
+  bool all_logic = (dynamic_cast<LogicSignalPortType *>(outType) != nullptr);
+  for (auto type : types)
+    all_logic &= (dynamic_cast<LogicSignalPortType *>(type) != nullptr);
+  if (all_logic) {
+    switch (oper) {
+    case OperationType::B_BWAND:
+      return assign(operands.at(0) + " & " + operands.at(1));
+    case OperationType::B_BWOR:
+      return assign(operands.at(0) + " | " + operands.at(1));
+    case OperationType::B_BWXOR:
+      return assign(operands.at(0) + " ^ " + operands.at(1));
+    case OperationType::U_BWNOT:
+      return assign("~" + operands.at(0));
+    default:
+      break;
+    }
+  }
+  int width;
+  bool is_signed;
+  CastOperands(oper, types, outType, values, width, is_signed);
+
+  auto binary = [&](const string &op) {
+    return values.at(0).expr + " " + op + " " + values.at(1).expr;
+  };
+  string value, condition;
+  int valueWidth = width;
+  switch (oper) {
+  case OperationType::B_ADD:
+    value = binary("+");
+    break;
+  case OperationType::B_SUB:
+    value = binary("-");
+    break;
+  case OperationType::B_MUL:
+    // The product is as wide as both operands together
+    valueWidth = values.at(0).width + values.at(1).width;
+    value = binary("*");
+    break;
+  case OperationType::B_BWAND:
+    value = binary("&");
+    break;
+  case OperationType::B_BWOR:
+    value = binary("|");
+    break;
+  case OperationType::B_BWXOR:
+    value = binary("^");
+    break;
+  case OperationType::U_MINUS:
+    value = "-" + values.at(0).expr;
+    break;
+  case OperationType::U_BWNOT:
+    value = "~" + values.at(0).expr;
+    break;
+  case OperationType::B_EQ:
+    condition = binary("==");
+    break;
+  case OperationType::B_NEQ:
+    condition = binary("!=");
+    break;
+  case OperationType::B_LT:
+    condition = binary("<");
+    break;
+  case OperationType::B_GT:
+    condition = binary(">");
+    break;
+  case OperationType::B_LTE:
+    condition = binary("<=");
+    break;
+  case OperationType::B_GTE:
+    condition = binary(">=");
+    break;
+  case OperationType::B_LAND:
+    condition = "(" + values.at(0).expr + " != 0) && (" + values.at(1).expr +
+                " != 0)";
+    break;
+  case OperationType::B_LOR:
+    condition = "(" + values.at(0).expr + " != 0) || (" + values.at(1).expr +
+                " != 0)";
+    break;
+  case OperationType::U_LNOT:
+    condition = values.at(0).expr + " == 0";
+    break;
+  case OperationType::B_LS:
+  case OperationType::B_RS: {
+    // Verilog shift amounts are always unsigned, so a negative amount is
+    // checked for separately and shifts by nothing, as in simulation
+    string op =
+        (oper == OperationType::B_LS) ? "<<" : (is_signed ? ">>>" : ">>");
+    value = binary(op);
+    if (types.at(1)->IsSigned()) {
+      NumericPortType bitType(1, false);
+      value = bitType.VerilogCastFrom(types.at(1), operands.at(1),
+                                      types.at(1)->GetWidth() - 1, 1) +
+              " ? " + values.at(0).expr + " : (" + value + ")";
+    }
+  } break;
+  default:
+    throw runtime_error("operation type not supported in HDL");
+  }
+
+  // A condition is a single unsigned bit, so is zero extended to the result
+  if (HasBooleanResult(oper))
+    return assign(condition);
+  int outWidth = outType->GetWidth();
+  // As for simulation, only a signed product narrowed to no less than the
+  // operand width keeps its sign bit
+  bool keepSign = (oper == OperationType::B_MUL) && is_signed &&
+                  (dynamic_cast<LogicSignalPortType *>(outType) == nullptr) &&
+                  (width <= outWidth) && (outWidth < valueWidth);
+  if (!keepSign && (outWidth <= valueWidth))
+    return assign(value);
+  NumericPortType valueType(valueWidth, is_signed);
+  verilog << "\t" << VerilogDecl("wire", &valueType, temp) << " = " << value
+          << ";" << endl;
+  if (keepSign) {
+    NumericPortType signType(1, false), lowType(outWidth - 1, false);
+    string sign =
+        signType.VerilogCastFrom(&valueType, temp, valueWidth - 1, 1);
+    if (outWidth > 1)
+      sign = "{" + sign + ", " +
+             lowType.VerilogCastFrom(&valueType, temp, 0, outWidth - 1) + "}";
+    assign(sign);
   } else {
-    vhdl << ports.back()->connectedNet->sigType->VHDLCastFrom(&resType, value);
+    assign(outType->VerilogCastFrom(&valueType, temp));
   }
-  vhdl << ";" << endl;
 }
 
 void OperationHDLDevice::AnnotateTiming(DeviceTiming *model) {
-  HDLTimingValue<double> inp_delay =
-      (*max_element(ports.begin(), ports.end() - 1,
-                    [](HDLDevicePort *a, HDLDevicePort *b) {
-                      return a->connectedNet->timing_delay <
-                             b->connectedNet->timing_delay;
-                    }))
-          ->connectedNet->timing_delay;
-  // TODO: use model to calculate device delay
-  double dev_delay = 0;
+  HDLTimingValue<double> inp_delay;
+  for (auto p = ports.begin(); p != ports.end() - 1; ++p)
+    inp_delay = TimingMax(inp_delay, (*p)->connectedNet->timing_delay);
+  vector<int> widths;
+  for (auto p = ports.begin(); p != ports.end() - 1; ++p)
+    widths.push_back((*p)->type->GetWidth());
+  double dev_delay = model->GetOperationDelay(oper, widths) +
+                     model->GetRoutingDelay(ports.back()->connectedNet->fanout);
   ports.back()->connectedNet->timing_delay = inp_delay + dev_delay;
-  // TODO: should we propogate clock domains?
 }
 
 void OperationHDLDevice::AnnotateLatency(DeviceTiming *model) {
-  HDLTimingValue<int> inp_latency =
-      (*max_element(ports.begin(), ports.end() - 1,
-                    [](HDLDevicePort *a, HDLDevicePort *b) {
-                      return a->connectedNet->pipeline_latency <
-                             b->connectedNet->pipeline_latency;
-                    }))
-          ->connectedNet->pipeline_latency;
+  HDLTimingValue<int> inp_latency;
+  for (auto p = ports.begin(); p != ports.end() - 1; ++p)
+    inp_latency = TimingMax(inp_latency, (*p)->connectedNet->pipeline_latency);
   ports.back()->connectedNet->pipeline_latency = inp_latency;
 }
 
+void OperationHDLDevice::Simulate() {
+  vector<HDLPortType *> types;
+  vector<BitConstant> operands;
+  for (int i = 0; i < ports.size() - 1; i++) {
+    types.push_back(ports.at(i)->type);
+    operands.push_back(ports.at(i)->connectedNet->sim_value);
+  }
+  SetSimValue(ports.back(),
+              GetSimValue(oper, types, operands,
+                          ports.back()->connectedNet->sigType));
+}
+
+void OperationHDLDevice::SimulateBatch() {
+  vector<HDLPortType *> types;
+  vector<BatchValue> operands;
+  for (int i = 0; i < ports.size() - 1; i++) {
+    types.push_back(ports.at(i)->type);
+    operands.push_back(ports.at(i)->connectedNet->batch_value);
+  }
+  SetBatchValue(ports.back(),
+                GetBatchValue(oper, types, operands,
+                              ports.back()->connectedNet->sigType));
+}
+
+void OperationHDLDevice::GenerateCpp(ostream &cpp) {
+  vector<HDLPortType *> types;
+  vector<string> operands;
+  for (int i = 0; i < ports.size() - 1; i++) {
+    types.push_back(ports.at(i)->type);
+    operands.push_back(CppInput(ports.at(i)));
+  }
+  cpp << "\t\t"
+      << CppAssign(ports.back(), ports.back()->connectedNet->sigType,
+                   GetCppValue(oper, types, operands,
+                               ports.back()->connectedNet->sigType))
+      << endl;
+}
+
 OperationHDLDevice::~OperationHDLDevice() {
   for_each(ports.begin(), ports.end(), [](HDLDevicePort *p) { delete p; });
 }
 
 int OperationHDLDevice::serial = 0;
 
+// Return a VHDL expression for a constant value of a type
+static string GetVHDLConstant(const BitConstant &value, HDLPortType *type) {
+  if (dynamic_cast<LogicSignalPortType *>(type) != nullptr)
+    return value.is_zero() ? "'0'" : "'1'";
+  NumericPortType cType(value.width(), value.is_signed);
+  return type->VHDLCastFrom(&cType,
+                            string(value.is_signed ? "signed'(" : "unsigned'(") +
+                                value.to_string() + ")");
+}
+
 RegisterHDLDevice::RegisterHDLDevice(HDLSignal *d, HDLSignal *clk, HDLSignal *q,
                                      HDLSignal *en, HDLSignal *rst,
-                                     bool _is_pipeline)
-    : is_pipeline(_is_pipeline) {
+                                     bool _is_pipeline, BitConstant _init)
+    : is_pipeline(_is_pipeline), init(_init) {
   inst_name = "reg_" + to_string(serial++);
   ports.push_back(
       new HDLDevicePort("d", this, d->sigType, d, PortDirection::Input));
@@ -204,6 +881,7 @@ RegisterHDLDevice::RegisterHDLDevice(HDLSignal *d, HDLSignal *clk, HDLSignal *q,
       new HDLDevicePort("en", this, en->sigType, en, PortDirection::Input));
   ports.push_back(
       new HDLDevicePort("rst", this, rst->sigType, rst, PortDirection::Input));
+  sim_state = SimCast(init, q->sigType);
 }
 
 string RegisterHDLDevice::GetInstanceName() { return inst_name; }
@@ -214,31 +892,75 @@ vector<string> RegisterHDLDevice::GetVHDLDeps() {
   return vector<string>{"ieee.std_logic_1164.all", "ieee.numeric_std.all"};
 }
 
-void RegisterHDLDevice::GenerateVHDLPrefix(ostream &vhdl) {}
+void RegisterHDLDevice::GenerateVHDLPrefix(ostream &vhdl) {
+  // The signals of the design have no initial value, so a register starting
+  // from anything but zero holds its state in a signal of its own
+  if (!init.is_zero())
+    vhdl << "\tsignal " << inst_name
+         << "_q : " << ports.at(2)->type->GetVHDLType()
+         << " := " << GetVHDLConstant(init, ports.at(2)->type) << ";" << endl;
+}
 
 void RegisterHDLDevice::GenerateVHDL(ostream &vhdl) {
   string clksig = ports.at(1)->connectedNet->name;
+  string q = init.is_zero() ? ports.at(2)->connectedNet->name
+                            : (inst_name + "_q");
   vhdl << "\tprocess(" << clksig << ")" << endl;
   vhdl << "\tbegin" << endl;
-  vhdl << "\t\tif rising_edge(clksig) then" << endl;
+  vhdl << "\t\tif rising_edge(" << clksig << ") then" << endl;
   vhdl << "\t\t\tif " << ports.at(4)->connectedNet->name << " = '1' then"
        << endl;
-  vhdl << "\t\t\t\t" << ports.at(2)->connectedNet->name
-       << " <= " << ports.at(2)->type->GetZero() << ";" << endl;
+  vhdl << "\t\t\t\t" << q << " <= "
+       << (init.is_zero() ? ports.at(2)->type->GetZero()
+                          : GetVHDLConstant(init, ports.at(2)->type))
+       << ";" << endl;
   vhdl << "\t\t\telsif " << ports.at(3)->connectedNet->name << " = '1' then"
        << endl;
-  vhdl << "\t\t\t\t" << ports.at(2)->connectedNet->name << " <= "
+  vhdl << "\t\t\t\t" << q << " <= "
        << ports.at(2)->type->VHDLCastFrom(ports.at(0)->type,
                                           ports.at(0)->connectedNet->name)
        << ";" << endl;
   vhdl << "\t\t\tend if;" << endl;
   vhdl << "\t\tend if;" << endl;
-  vhdl << "\tend process;" << endl << endl;
+  vhdl << "\tend process;" << endl;
+  if (!init.is_zero())
+    vhdl << "\t" << ports.at(2)->connectedNet->name << " <= " << q << ";"
+         << endl;
+  vhdl << endl;
+}
+
+void RegisterHDLDevice::GenerateVerilogPrefix(ostream &verilog) {
+  verilog << "\t" << VerilogDecl("reg", ports.at(2)->type, inst_name + "_q");
+  if (!init.is_zero())
+    verilog << " = " << GetVerilogConstant(init, ports.at(2)->type);
+  verilog << ";" << endl;
+}
+
+void RegisterHDLDevice::GenerateVerilog(ostream &verilog) {
+  string q = inst_name + "_q";
+  verilog << "\talways @(posedge " << ports.at(1)->connectedNet->name << ")"
+          << endl;
+  verilog << "\t\tif (" << ports.at(4)->connectedNet->name << ")" << endl;
+  verilog << "\t\t\t" << q << " <= "
+          << (init.is_zero() ? ports.at(2)->type->GetVerilogZero()
+                             : GetVerilogConstant(init, ports.at(2)->type))
+          << ";" << endl;
+  verilog << "\t\telse if (" << ports.at(3)->connectedNet->name << ")"
+          << endl;
+  verilog << "\t\t\t" << q << " <= "
+          << ports.at(2)->type->VerilogCastFrom(ports.at(0)->type,
+                                                ports.at(0)->connectedNet->name)
+          << ";" << endl;
+  verilog << "\tassign " << ports.at(2)->connectedNet->name << " = " << q
+          << ";" << endl
+          << endl;
 }
 
 void RegisterHDLDevice::AnnotateTiming(DeviceTiming *model) {
   ports.at(2)->connectedNet->timing_delay = HDLTimingValue<double>(
-      ports.at(1)->connectedNet, model->GetFFPropogationDelay());
+      ports.at(1)->connectedNet,
+      model->GetFFPropogationDelay() +
+          model->GetRoutingDelay(ports.at(2)->connectedNet->fanout));
 }
 
 void RegisterHDLDevice::AnnotateLatency(DeviceTiming *model) {
@@ -246,6 +968,72 @@ void RegisterHDLDevice::AnnotateLatency(DeviceTiming *model) {
       ports.at(0)->connectedNet->pipeline_latency + (is_pipeline ? 1 : 0);
 }
 
+bool RegisterHDLDevice::IsPipeline() { return is_pipeline; }
+
+void RegisterHDLDevice::Simulate() { SetSimValue(ports.at(2), sim_state); }
+
+void RegisterHDLDevice::SimulateClock() {
+  if (IsSimHigh(ports.at(4)))
+    sim_state = SimCast(init, ports.at(2)->type);
+  else if (IsSimHigh(ports.at(3)))
+    sim_state =
+        SimCast(ports.at(0)->connectedNet->sim_value, ports.at(2)->type);
+}
+
+void RegisterHDLDevice::StartBatch() {
+  batch_state = BatchCast(BatchValue(init), ports.at(2)->type);
+}
+
+void RegisterHDLDevice::SimulateBatch() {
+  SetBatchValue(ports.at(2), batch_state);
+}
+
+void RegisterHDLDevice::SimulateBatchClock() {
+  batch_state = SelectBatch(
+      GetBatchHigh(ports.at(3)), batch_state,
+      BatchCast(ports.at(0)->connectedNet->batch_value, ports.at(2)->type));
+  batch_state = SelectBatch(GetBatchHigh(ports.at(4)), batch_state,
+                            BatchCast(BatchValue(init), ports.at(2)->type));
+}
+
+void RegisterHDLDevice::GenerateCppPrefix(ostream &cpp) {
+  cpp << "\t" << ports.at(2)->type->GetCppType() << " " << inst_name
+      << "_state";
+  if (init.is_zero())
+    cpp << "{};" << endl;
+  else
+    cpp << " = " << GetCppConstant(init, ports.at(2)->type) << ";" << endl;
+}
+
+void RegisterHDLDevice::GenerateCpp(ostream &cpp) {
+  cpp << "\t\t" << CppAssign(ports.at(2), ports.at(2)->type, inst_name + "_state")
+      << endl;
+}
+
+void RegisterHDLDevice::GenerateCppClock(ostream &cpp) {
+  // Most registers are never reset and always enabled, so the checks are left
+  // out for the gnd and vcc rails
+  string state = inst_name + "_state";
+  string load = state + " = " +
+                ports.at(2)->type->CppCastFrom(ports.at(0)->connectedNet->sigType,
+                                               ports.at(0)->connectedNet->name) +
+                ";";
+  bool has_rst = (ports.at(4)->connectedNet != design->gnd);
+  bool has_en = (ports.at(3)->connectedNet != design->vcc);
+  if (has_rst)
+    cpp << "\t\tif (" << CppIsHigh(ports.at(4)) << ")" << endl
+        << "\t\t\t" << state << " = "
+        << (init.is_zero() ? string("{}")
+                           : GetCppConstant(init, ports.at(2)->type))
+        << ";" << endl
+        << "\t\telse ";
+  else
+    cpp << "\t\t";
+  if (has_en)
+    cpp << "if (" << CppIsHigh(ports.at(3)) << ")" << endl << "\t\t\t";
+  cpp << load << endl;
+}
+
 RegisterHDLDevice::~RegisterHDLDevice() {
   for_each(ports.begin(), ports.end(), [](HDLDevicePort *p) { delete p; });
 }
@@ -270,21 +1058,17 @@ vector<string> ConstantHDLDevice::GetVHDLDeps() {
 void ConstantHDLDevice::GenerateVHDLPrefix(ostream &vhdl) {}
 
 void ConstantHDLDevice::GenerateVHDL(ostream &vhdl) {
-  if(dynamic_cast<LogicSignalPortType*>(ports.at(0)->type) != nullptr) {
-    if(value.intval() == 0) {
-      vhdl << "\t" << ports.at(0)->connectedNet->name << " <= '0';" << endl;
-    } else {
-      vhdl << "\t" << ports.at(0)->connectedNet->name << " <= '1';" << endl;
-    }
-  } else {
-    NumericPortType cType(value.bits.size(), value.is_signed);
-    vhdl << "\t" << ports.at(0)->connectedNet->name << " <= "
-         << ports.at(0)->type->VHDLCastFrom(
-                &cType, string(value.is_signed ? "signed'(" : "unsigned'(") +
-                            value.to_string() + ")")
-         << ";" << endl;
-  }
+  vhdl << "\t" << ports.at(0)->connectedNet->name << " <= "
+       << GetVHDLConstant(value, ports.at(0)->type) << ";" << endl;
+}
 
+void ConstantHDLDevice::GenerateVerilog(ostream &verilog) {
+  verilog << "\tassign " << ports.at(0)->connectedNet->name << " = ";
+  if (dynamic_cast<LogicSignalPortType *>(ports.at(0)->type) != nullptr)
+    verilog << ((value.intval() == 0) ? "1'b0" : "1'b1");
+  else
+    verilog << GetVerilogConstant(value, ports.at(0)->type);
+  verilog << ";" << endl;
 }
 
 void ConstantHDLDevice::AnnotateTiming(DeviceTiming *model) {
@@ -295,6 +1079,33 @@ void ConstantHDLDevice::AnnotateLatency(DeviceTiming *model) {
   ports.at(0)->connectedNet->pipeline_latency = HDLTimingValue<int>();
 }
 
+void ConstantHDLDevice::Simulate() {
+  if (dynamic_cast<LogicSignalPortType *>(ports.at(0)->type) != nullptr)
+    SetSimValue(ports.at(0), BitConstant((value.intval() == 0) ? 0 : 1, 1));
+  else
+    SetSimValue(ports.at(0), SimCast(value, ports.at(0)->type));
+}
+
+void ConstantHDLDevice::SimulateBatch() {
+  Simulate();
+  SetBatchValue(ports.at(0), BatchValue(ports.at(0)->connectedNet->sim_value));
+}
+
+void ConstantHDLDevice::GenerateCpp(ostream &cpp) {
+  if (dynamic_cast<LogicSignalPortType *>(ports.at(0)->type) != nullptr) {
+    NumericPortType bitType(1, false);
+    cpp << "\t\t"
+        << CppAssign(ports.at(0), &bitType,
+                     (value.intval() == 0) ? "uint64_t(0)" : "uint64_t(1)")
+        << endl;
+  } else {
+    cpp << "\t\t"
+        << CppAssign(ports.at(0), ports.at(0)->type,
+                     GetCppConstant(value, ports.at(0)->type))
+        << endl;
+  }
+}
+
 ConstantHDLDevice::~ConstantHDLDevice() {
   for_each(ports.begin(), ports.end(), [](HDLDevicePort *p) { delete p; });
 }
@@ -335,6 +1146,20 @@ void BufferHDLDevice::GenerateVHDL(ostream &vhdl) {
   }
 }
 
+void BufferHDLDevice::GenerateVerilog(ostream &verilog) {
+  verilog << "\tassign " << ports.at(1)->connectedNet->name << " = ";
+  if (slice.has_value())
+    verilog << ports.at(1)->type->VerilogCastFrom(
+        ports.at(0)->type, ports.at(0)->connectedNet->name, slice->low,
+        slice->width());
+  else
+    verilog << ports.at(1)->type->VerilogCastFrom(
+        ports.at(0)->type, ports.at(0)->connectedNet->name);
+  verilog << ";" << endl;
+}
+
+bool BufferHDLDevice::IsSlice() { return slice.has_value(); }
+
 void BufferHDLDevice::AnnotateTiming(DeviceTiming *model) {
   ports.at(1)->connectedNet->timing_delay =
       ports.at(0)->connectedNet->timing_delay;
@@ -344,6 +1169,48 @@ void BufferHDLDevice::AnnotateLatency(DeviceTiming *model) {
       ports.at(0)->connectedNet->pipeline_latency;
 }
 
+void BufferHDLDevice::Simulate() {
+  const BitConstant &in = ports.at(0)->connectedNet->sim_value;
+  if (slice.has_value())
+    SetSimValue(ports.at(1),
+                SimCast(GetSimSlice(in, slice->low, slice->width(),
+                                    ports.at(0)->type->IsSigned()),
+                        ports.at(1)->type));
+  else
+    SetSimValue(ports.at(1), SimCast(in, ports.at(1)->type));
+}
+
+void BufferHDLDevice::SimulateBatch() {
+  const BatchValue &in = ports.at(0)->connectedNet->batch_value;
+  if (slice.has_value())
+    SetBatchValue(ports.at(1),
+                  BatchCast(GetBatchSlice(in, slice->low, slice->width(),
+                                          ports.at(0)->type->IsSigned()),
+                            ports.at(1)->type));
+  else
+    SetBatchValue(ports.at(1), BatchCast(in, ports.at(1)->type));
+}
+
+void BufferHDLDevice::GenerateCpp(ostream &cpp) {
+  HDLSignal *in = ports.at(0)->connectedNet;
+  if (slice.has_value()) {
+    NumericPortType sliceType(slice->width(), ports.at(0)->type->IsSigned());
+    string value = "ecc::slice<" + to_string(slice->width()) + ", " +
+                   (sliceType.IsSigned() ? "true" : "false") + ", " +
+                   (in->sigType->IsSigned() ? "true" : "false") + ">(" +
+                   in->name + ", " + to_string(slice->low) + ")";
+    cpp << "\t\t"
+        << CppAssign(ports.at(1), ports.at(1)->type,
+                     ports.at(1)->type->CppCastFrom(&sliceType, value))
+        << endl;
+  } else {
+    cpp << "\t\t"
+        << CppAssign(ports.at(1), ports.at(1)->type,
+                     ports.at(1)->type->CppCastFrom(in->sigType, in->name))
+        << endl;
+  }
+}
+
 BufferHDLDevice::~BufferHDLDevice() {
   for_each(ports.begin(), ports.end(), [](HDLDevicePort *p) { delete p; });
 }
@@ -388,31 +1255,94 @@ void MultiplexerHDLDevice::GenerateVHDL(ostream &vhdl) {
   vhdl << "\t\t\t\t" << ports.back()->type->GetZero() << ";" << endl;
 }
 
+void MultiplexerHDLDevice::GenerateVerilog(ostream &verilog) {
+  HDLDevicePort *sel = ports.at(ports.size() - 2), *out = ports.back();
+  auto input = [&](int i) {
+    return out->type->VerilogCastFrom(ports.at(i)->type,
+                                      ports.at(i)->connectedNet->name);
+  };
+  verilog << "\tassign " << out->connectedNet->name << " = ";
+  if ((size == 2) && (sel->type->GetWidth() == 1)) {
+    verilog << sel->connectedNet->name << " ? " << input(1) << " : "
+            << input(0) << ";" << endl;
+    return;
+  }
+  // The select is compared as unsigned
+  string selValue = sel->type->IsSigned()
+                        ? ("$unsigned(" + sel->connectedNet->name + ")")
+                        : sel->connectedNet->name;
+  for (int i = 0; i < size; i++) {
+    if (i != 0)
+      verilog << "\t\t\t\t";
+    verilog << "(" << selValue << " == " << i << ") ? " << input(i) << " :"
+            << endl;
+  }
+  verilog << "\t\t\t\t" << out->type->GetVerilogZero() << ";" << endl;
+}
+
 void MultiplexerHDLDevice::AnnotateTiming(DeviceTiming *model) {
-  HDLTimingValue<double> inp_delay =
-      (*max_element(ports.begin(), ports.end() - 1,
-                    [](HDLDevicePort *a, HDLDevicePort *b) {
-                      return a->connectedNet->timing_delay <
-                             b->connectedNet->timing_delay;
-                    }))
-          ->connectedNet->timing_delay;
-  // TODO: use model to calculate device delay
-  double dev_delay = 0;
+  HDLTimingValue<double> inp_delay;
+  for (auto p = ports.begin(); p != ports.end() - 1; ++p)
+    inp_delay = TimingMax(inp_delay, (*p)->connectedNet->timing_delay);
+  double dev_delay =
+      model->GetMultiplexerDelay(size) +
+      model->GetRoutingDelay(ports.back()->connectedNet->fanout);
   ports.back()->connectedNet->timing_delay = inp_delay + dev_delay;
-  // TODO: should we propogate clock domains?
 }
 
 void MultiplexerHDLDevice::AnnotateLatency(DeviceTiming *model) {
-  HDLTimingValue<int> inp_latency =
-      (*max_element(ports.begin(), ports.end() - 1,
-                    [](HDLDevicePort *a, HDLDevicePort *b) {
-                      return a->connectedNet->pipeline_latency <
-                             b->connectedNet->pipeline_latency;
-                    }))
-          ->connectedNet->pipeline_latency;
+  HDLTimingValue<int> inp_latency;
+  for (auto p = ports.begin(); p != ports.end() - 1; ++p)
+    inp_latency = TimingMax(inp_latency, (*p)->connectedNet->pipeline_latency);
   ports.back()->connectedNet->pipeline_latency = inp_latency;
 }
 
+void MultiplexerHDLDevice::Simulate() {
+  int sel = GetSimIndex(ports.at(ports.size() - 2));
+  if ((sel >= 0) && (sel < size))
+    SetSimValue(ports.back(), SimCast(ports.at(sel)->connectedNet->sim_value,
+                                      ports.back()->type));
+  else
+    SetSimValue(ports.back(), BitConstant());
+}
+
+void MultiplexerHDLDevice::SimulateBatch() {
+  // The select is compared as unsigned, and lanes where it is out of range
+  // are left as zero
+  BatchValue sel = ports.at(ports.size() - 2)->connectedNet->batch_value;
+  sel.is_signed = false;
+  BatchValue value = BatchCast(BatchValue(), ports.back()->type);
+  for (int i = 0; i < size; i++)
+    value = SelectBatch(AreBatchesEqual(sel, BatchValue(BitConstant(i))), value,
+                        BatchCast(ports.at(i)->connectedNet->batch_value,
+                                  ports.back()->type));
+  SetBatchValue(ports.back(), value);
+}
+
+void MultiplexerHDLDevice::GenerateCpp(ostream &cpp) {
+  HDLDevicePort *sel = ports.at(ports.size() - 2), *out = ports.back();
+  auto input = [&](int i) {
+    HDLSignal *net = ports.at(i)->connectedNet;
+    return CppAssign(out, out->type, out->type->CppCastFrom(net->sigType, net->name));
+  };
+  if ((size == 2) && (sel->connectedNet->sigType->GetWidth() == 1)) {
+    cpp << "\t\tif (" << CppIsHigh(sel) << ")" << endl
+        << "\t\t\t" << input(1) << endl
+        << "\t\telse" << endl
+        << "\t\t\t" << input(0) << endl;
+    return;
+  }
+  cpp << "\t\tswitch (ecc::index<" << sel->connectedNet->sigType->GetWidth()
+      << ">(" << sel->connectedNet->name << ")) {" << endl;
+  for (int i = 0; i < size; i++)
+    cpp << "\t\tcase " << i << ":" << endl
+        << "\t\t\t" << input(i) << endl
+        << "\t\t\tbreak;" << endl;
+  cpp << "\t\tdefault:" << endl
+      << "\t\t\t" << out->connectedNet->name << " = {};" << endl
+      << "\t\t}" << endl;
+}
+
 MultiplexerHDLDevice::~MultiplexerHDLDevice() {
   for_each(ports.begin(), ports.end(), [](HDLDevicePort *p) { delete p; });
 }
@@ -455,31 +1385,85 @@ void CombinerHDLDevice::GenerateVHDL(ostream &vhdl) {
   }
 }
 
+void CombinerHDLDevice::GenerateVerilog(ostream &verilog) {
+  HDLSignal *out = ports.back()->connectedNet;
+  for (int i = 0; i < input_slices.size(); i++) {
+    HDLBitSlice &slice = input_slices.at(i).second;
+    NumericPortType sliceType(slice.width(), false);
+    verilog << "\tassign " << out->name;
+    if (slice.width() != ports.back()->type->GetWidth()) {
+      verilog << "[" << slice.high;
+      if (slice.high != slice.low)
+        verilog << ":" << slice.low;
+      verilog << "]";
+    }
+    verilog << " = "
+            << sliceType.VerilogCastFrom(ports.at(i)->type,
+                                         ports.at(i)->connectedNet->name)
+            << ";" << endl;
+  }
+}
+
 void CombinerHDLDevice::AnnotateTiming(DeviceTiming *model) {
-  HDLTimingValue<double> inp_delay =
-      (*max_element(ports.begin(), ports.end() - 1,
-                    [](HDLDevicePort *a, HDLDevicePort *b) {
-                      return a->connectedNet->timing_delay <
-                             b->connectedNet->timing_delay;
-                    }))
-          ->connectedNet->timing_delay;
-  // TODO: use model to calculate device delay
-  double dev_delay = 0;
-  ports.back()->connectedNet->timing_delay = inp_delay + dev_delay;
-  // TODO: should we propogate clock domains?
+  HDLTimingValue<double> inp_delay;
+  for (auto p = ports.begin(); p != ports.end() - 1; ++p)
+    inp_delay = TimingMax(inp_delay, (*p)->connectedNet->timing_delay);
+  // Combining slices is just wiring so adds no delay
+  ports.back()->connectedNet->timing_delay = inp_delay;
 }
 
 void CombinerHDLDevice::AnnotateLatency(DeviceTiming *model) {
-  HDLTimingValue<int> inp_latency =
-      (*max_element(ports.begin(), ports.end() - 1,
-                    [](HDLDevicePort *a, HDLDevicePort *b) {
-                      return a->connectedNet->pipeline_latency <
-                             b->connectedNet->pipeline_latency;
-                    }))
-          ->connectedNet->pipeline_latency;
+  HDLTimingValue<int> inp_latency;
+  for (auto p = ports.begin(); p != ports.end() - 1; ++p)
+    inp_latency = TimingMax(inp_latency, (*p)->connectedNet->pipeline_latency);
   ports.back()->connectedNet->pipeline_latency = inp_latency;
 }
 
+void CombinerHDLDevice::Simulate() {
+  BitConstant value = SimCast(BitConstant(), ports.back()->type);
+  for (int i = 0; i < input_slices.size(); i++) {
+    HDLBitSlice &slice = input_slices.at(i).second;
+    SetSimSlice(value, slice.low,
+                ports.at(i)->connectedNet->sim_value.cast(slice.width(),
+                                                          false));
+  }
+  SetSimValue(ports.back(), value);
+}
+
+void CombinerHDLDevice::SimulateBatch() {
+  BatchValue value = BatchCast(BatchValue(), ports.back()->type);
+  for (int i = 0; i < input_slices.size(); i++) {
+    HDLBitSlice &slice = input_slices.at(i).second;
+    SetBatchSlice(value, slice.low,
+                  ports.at(i)->connectedNet->batch_value.cast(slice.width(),
+                                                              false));
+  }
+  SetBatchValue(ports.back(), value);
+}
+
+void CombinerHDLDevice::GenerateCpp(ostream &cpp) {
+  HDLPortType *type = ports.back()->type;
+  string value = inst_name + "_value";
+  cpp << "\t\t{" << endl;
+  cpp << "\t\t\t" << type->GetCppType() << " " << value << "{};" << endl;
+  for (int i = 0; i < input_slices.size(); i++) {
+    HDLBitSlice &slice = input_slices.at(i).second;
+    HDLSignal *net = ports.at(i)->connectedNet;
+    NumericPortType sliceType(slice.width(), false);
+    cpp << "\t\t\tecc::deposit(" << value << ", " << slice.low << ", "
+        << slice.width() << ", "
+        << sliceType.CppCastFrom(net->sigType, net->name) << ");" << endl;
+  }
+  // Sign extend from the top slice
+  cpp << "\t\t\t"
+      << CppAssign(ports.back(), type,
+                   "ecc::norm<" + to_string(type->GetWidth()) + ", " +
+                       (type->IsSigned() ? "true" : "false") + ">(" + value +
+                       ")")
+      << endl;
+  cpp << "\t\t}" << endl;
+}
+
 CombinerHDLDevice::~CombinerHDLDevice() {
   for_each(ports.begin(), ports.end(), [](HDLDevicePort *p) { delete p; });
 }
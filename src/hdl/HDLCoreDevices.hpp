@@ -19,10 +19,48 @@ public:
   vector<string> GetVHDLDeps();
   void GenerateVHDLPrefix(ostream &vhdl);
   void GenerateVHDL(ostream &vhdl);
+  void GenerateVerilog(ostream &verilog);
 
   void AnnotateTiming(DeviceTiming *model);
   void AnnotateLatency(DeviceTiming *model);
 
+  void Simulate();
+  void SimulateBatch();
+  void GenerateCpp(ostream &cpp);
+
+  OperationType GetOperation();
+  // Return a VHDL expression of type outType giving the result of an
+  // operation on operands of the given types, exactly as computed by an
+  // OperationHDLDevice
+  static string GetVHDLValue(OperationType oper,
+                             const vector<HDLPortType *> &types,
+                             vector<string> operands, HDLPortType *outType);
+  // Write Verilog setting the net result, of type outType, to the result of
+  // an operation on the nets named by operands, as GetVHDLValue does. Verilog
+  // would evaluate the operation at the width of the result, so if the result
+  // is wider it is first computed into a wire named temp
+  static void GenerateVerilogValue(ostream &verilog, OperationType oper,
+                                   const vector<HDLPortType *> &types,
+                                   const vector<string> &operands,
+                                   HDLPortType *outType, const string &result,
+                                   const string &temp);
+  // Return the result of an operation on operand values of the given types,
+  // as the value of the VHDL expression given by GetVHDLValue
+  static BitConstant GetSimValue(OperationType oper,
+                                 const vector<HDLPortType *> &types,
+                                 vector<BitConstant> operands,
+                                 HDLPortType *outType);
+  // The same as GetSimValue, but for the values in every lane of a batch
+  static BatchValue GetBatchValue(OperationType oper,
+                                  const vector<HDLPortType *> &types,
+                                  vector<BatchValue> operands,
+                                  HDLPortType *outType);
+  // The same as GetSimValue, but as a C++ expression for a C++ model, given
+  // C++ expressions for the operands
+  static string GetCppValue(OperationType oper,
+                            const vector<HDLPortType *> &types,
+                            vector<string> operands, HDLPortType *outType);
+
   ~OperationHDLDevice();
 
 private:
@@ -35,25 +73,45 @@ private:
 // A basic register, either for a functional delay or for pipelining
 class RegisterHDLDevice : public HDLDevice {
 public:
+  // The register holds init before it is first loaded, and after a reset
   RegisterHDLDevice(HDLSignal *d, HDLSignal *clk, HDLSignal *q, HDLSignal *en,
-                    HDLSignal *rst, bool _is_pipeline = false);
+                    HDLSignal *rst, bool _is_pipeline = false,
+                    BitConstant _init = BitConstant());
   string GetInstanceName();
   vector<HDLDevicePort *> &GetPorts();
 
   vector<string> GetVHDLDeps();
   void GenerateVHDLPrefix(ostream &vhdl);
   void GenerateVHDL(ostream &vhdl);
+  void GenerateVerilogPrefix(ostream &verilog);
+  void GenerateVerilog(ostream &verilog);
 
   void AnnotateTiming(DeviceTiming *model);
   void AnnotateLatency(DeviceTiming *model);
 
+  void Simulate();
+  void SimulateClock();
+  void StartBatch();
+  void SimulateBatch();
+  void SimulateBatchClock();
+  void GenerateCppPrefix(ostream &cpp);
+  void GenerateCpp(ostream &cpp);
+  void GenerateCppClock(ostream &cpp);
+
+  // Return true if the register was inserted for pipelining, rather than
+  // being part of the design's function
+  bool IsPipeline();
+
   ~RegisterHDLDevice();
 
 private:
   static int serial;
   string inst_name;
   bool is_pipeline;
+  BitConstant init;
   vector<HDLDevicePort *> ports;
+  BitConstant sim_state;
+  BatchValue batch_state;
 };
 
 // A multiplexer, used for conditionals and array access
@@ -67,10 +125,15 @@ public:
   vector<string> GetVHDLDeps();
   void GenerateVHDLPrefix(ostream &vhdl);
   void GenerateVHDL(ostream &vhdl);
+  void GenerateVerilog(ostream &verilog);
 
   void AnnotateTiming(DeviceTiming *model);
   void AnnotateLatency(DeviceTiming *model);
 
+  void Simulate();
+  void SimulateBatch();
+  void GenerateCpp(ostream &cpp);
+
   ~MultiplexerHDLDevice();
 
 private:
@@ -90,10 +153,15 @@ public:
   vector<string> GetVHDLDeps();
   void GenerateVHDLPrefix(ostream &vhdl);
   void GenerateVHDL(ostream &vhdl);
+  void GenerateVerilog(ostream &verilog);
 
   void AnnotateTiming(DeviceTiming *model);
   void AnnotateLatency(DeviceTiming *model);
 
+  void Simulate();
+  void SimulateBatch();
+  void GenerateCpp(ostream &cpp);
+
   ~ConstantHDLDevice();
 
 private:
@@ -114,10 +182,19 @@ public:
   vector<string> GetVHDLDeps();
   void GenerateVHDLPrefix(ostream &vhdl);
   void GenerateVHDL(ostream &vhdl);
+  void GenerateVerilog(ostream &verilog);
 
   void AnnotateTiming(DeviceTiming *model);
   void AnnotateLatency(DeviceTiming *model);
 
+  void Simulate();
+  void SimulateBatch();
+  void GenerateCpp(ostream &cpp);
+
+  // Whether the buffer selects a slice of its input, rather than casting all
+  // of it to the output type
+  bool IsSlice();
+
   ~BufferHDLDevice();
 
 private:
@@ -137,10 +214,15 @@ public:
   vector<string> GetVHDLDeps();
   void GenerateVHDLPrefix(ostream &vhdl);
   void GenerateVHDL(ostream &vhdl);
+  void GenerateVerilog(ostream &verilog);
 
   void AnnotateTiming(DeviceTiming *model);
   void AnnotateLatency(DeviceTiming *model);
 
+  void Simulate();
+  void SimulateBatch();
+  void GenerateCpp(ostream &cpp);
+
   ~CombinerHDLDevice();
 
 private:
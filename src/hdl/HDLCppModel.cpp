@@ -0,0 +1,401 @@
+#include "HDLCppModel.hpp"
+#include "HDLSignal.hpp"
+
+#include <iomanip>
+#include <sstream>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+
+// The support code is guarded so that models of several designs can be used
+// together. Every function works on any of the three representations, with
+// ecc::wide providing the operators that the built in types already have
+static const char *cppSupport = R"(#ifndef ECC_MODEL_SUPPORT
+#define ECC_MODEL_SUPPORT
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Support for models generated by ElasticC. A value of width W is held in the
+// smallest of uint64_t, unsigned __int128 and ecc::wide that fits, in two's
+// complement with the bits above W copies of the sign bit for a signed value,
+// or zero for an unsigned one
+namespace ecc {
+typedef unsigned __int128 uint128_t;
+
+// An integer of N 64-bit limbs, least significant first
+template <int N> struct wide {
+  uint64_t limb[N];
+};
+
+template <int W>
+using uint_t = typename std::conditional<
+    (W <= 64), uint64_t,
+    typename std::conditional<(W <= 128), uint128_t,
+                              wide<(W + 63) / 64>>::type>::type;
+
+template <typename T> struct limbs;
+template <> struct limbs<uint64_t> { static const int count = 1; };
+template <> struct limbs<uint128_t> { static const int count = 2; };
+template <int N> struct limbs<wide<N>> { static const int count = N; };
+
+template <typename T> constexpr int storage_bits() {
+  return 64 * limbs<T>::count;
+}
+
+inline uint64_t get_limb(uint64_t x, int i) { return x; }
+inline uint64_t get_limb(uint128_t x, int i) { return uint64_t(x >> (64 * i)); }
+template <int N> inline uint64_t get_limb(const wide<N> &x, int i) {
+  return x.limb[i];
+}
+inline void set_limb(uint64_t &x, int i, uint64_t v) { x = v; }
+inline void set_limb(uint128_t &x, int i, uint64_t v) {
+  x = (i == 0) ? (((x >> 64) << 64) | v)
+               : ((x & ~uint64_t(0)) | (uint128_t(v) << 64));
+}
+template <int N> inline void set_limb(wide<N> &x, int i, uint64_t v) {
+  x.limb[i] = v;
+}
+
+template <int N> inline wide<N> operator~(const wide<N> &a) {
+  wide<N> r;
+  for (int i = 0; i < N; i++)
+    r.limb[i] = ~a.limb[i];
+  return r;
+}
+template <int N> inline wide<N> operator&(const wide<N> &a, const wide<N> &b) {
+  wide<N> r;
+  for (int i = 0; i < N; i++)
+    r.limb[i] = a.limb[i] & b.limb[i];
+  return r;
+}
+template <int N> inline wide<N> operator|(const wide<N> &a, const wide<N> &b) {
+  wide<N> r;
+  for (int i = 0; i < N; i++)
+    r.limb[i] = a.limb[i] | b.limb[i];
+  return r;
+}
+template <int N> inline wide<N> operator^(const wide<N> &a, const wide<N> &b) {
+  wide<N> r;
+  for (int i = 0; i < N; i++)
+    r.limb[i] = a.limb[i] ^ b.limb[i];
+  return r;
+}
+template <int N> inline bool operator==(const wide<N> &a, const wide<N> &b) {
+  for (int i = 0; i < N; i++)
+    if (a.limb[i] != b.limb[i])
+      return false;
+  return true;
+}
+template <int N> inline bool operator!=(const wide<N> &a, const wide<N> &b) {
+  return !(a == b);
+}
+// Unsigned comparison
+template <int N> inline bool operator<(const wide<N> &a, const wide<N> &b) {
+  for (int i = N - 1; i >= 0; i--)
+    if (a.limb[i] != b.limb[i])
+      return a.limb[i] < b.limb[i];
+  return false;
+}
+template <int N> inline wide<N> operator+(const wide<N> &a, const wide<N> &b) {
+  wide<N> r;
+  uint64_t carry = 0;
+  for (int i = 0; i < N; i++) {
+    uint128_t sum = uint128_t(a.limb[i]) + b.limb[i] + carry;
+    r.limb[i] = uint64_t(sum);
+    carry = uint64_t(sum >> 64);
+  }
+  return r;
+}
+template <int N> inline wide<N> operator-(const wide<N> &a, const wide<N> &b) {
+  wide<N> r;
+  uint64_t borrow = 0;
+  for (int i = 0; i < N; i++) {
+    uint128_t diff = uint128_t(a.limb[i]) - b.limb[i] - borrow;
+    r.limb[i] = uint64_t(diff);
+    borrow = uint64_t(diff >> 64) & 0x1;
+  }
+  return r;
+}
+template <int N> inline wide<N> operator*(const wide<N> &a, const wide<N> &b) {
+  wide<N> r{};
+  for (int i = 0; i < N; i++) {
+    uint64_t carry = 0;
+    for (int j = 0; (i + j) < N; j++) {
+      uint128_t t = uint128_t(a.limb[i]) * b.limb[j] + r.limb[i + j] + carry;
+      r.limb[i + j] = uint64_t(t);
+      carry = uint64_t(t >> 64);
+    }
+  }
+  return r;
+}
+// Shifts by less than the number of bits held
+template <int N> inline wide<N> operator<<(const wide<N> &a, int n) {
+  wide<N> r{};
+  int shift = n / 64, bits = n % 64;
+  for (int i = N - 1; i >= shift; i--) {
+    r.limb[i] = a.limb[i - shift] << bits;
+    if ((bits != 0) && (i > shift))
+      r.limb[i] |= a.limb[i - shift - 1] >> (64 - bits);
+  }
+  return r;
+}
+template <int N> inline wide<N> operator>>(const wide<N> &a, int n) {
+  wide<N> r{};
+  int shift = n / 64, bits = n % 64;
+  for (int i = 0; (i + shift) < N; i++) {
+    r.limb[i] = a.limb[i + shift] >> bits;
+    if ((bits != 0) && ((i + shift + 1) < N))
+      r.limb[i] |= a.limb[i + shift + 1] << (64 - bits);
+  }
+  return r;
+}
+
+template <typename T> inline T from_u64(uint64_t v) {
+  T r{};
+  set_limb(r, 0, v);
+  return r;
+}
+template <typename T> inline bool bit(const T &x, int i) {
+  return (get_limb(x, i / 64) >> (i % 64)) & 0x1;
+}
+template <typename T> inline bool top_bit(const T &x) {
+  return (get_limb(x, limbs<T>::count - 1) >> 63) != 0;
+}
+template <typename T> inline bool is_zero(const T &x) { return x == T{}; }
+template <bool S, typename T> inline bool is_negative(const T &x) {
+  return S && top_bit(x);
+}
+// Arithmetic shift right
+template <typename T> inline T sar(const T &x, int n) {
+  if (n >= storage_bits<T>())
+    return top_bit(x) ? ~T{} : T{};
+  return top_bit(x) ? T(~(T(~x) >> n)) : T(x >> n);
+}
+
+// Set the bits above W as the sign extension if S, or zero otherwise
+template <int W, bool S, typename T> inline T norm(const T &x) {
+  if constexpr (W >= storage_bits<T>()) {
+    return x;
+  } else {
+    const int sh = storage_bits<T>() - W;
+    return S ? sar(T(x << sh), sh) : T(T(x << sh) >> sh);
+  }
+}
+// Change representation, sign extending if S
+template <typename To, bool S, typename From> inline To extend(const From &x) {
+  if constexpr (std::is_same<To, From>::value) {
+    return x;
+  } else {
+    uint64_t fill = (S && top_bit(x)) ? ~uint64_t(0) : 0;
+    To r{};
+    for (int i = 0; i < limbs<To>::count; i++)
+      set_limb(r, i, (i < limbs<From>::count) ? get_limb(x, i) : fill);
+    return r;
+  }
+}
+// Convert a value, signed if S, to width W2 and signedness S2
+template <int W2, bool S2, bool S, typename T>
+inline uint_t<W2> cast(const T &x) {
+  return norm<W2, S2>(extend<uint_t<W2>, S>(x));
+}
+// Resize a signed value as numeric_std's resize does, keeping the sign bit
+template <int W, typename T> inline uint_t<W> resize(const T &x) {
+  uint_t<W> r = extend<uint_t<W>, true>(x), high = ~uint_t<W>{} << (W - 1);
+  return top_bit(x) ? (r | high) : (r & ~high);
+}
+
+template <int W, bool S, typename T> inline T add(const T &a, const T &b) {
+  return norm<W, S>(T(a + b));
+}
+template <int W, bool S, typename T> inline T sub(const T &a, const T &b) {
+  return norm<W, S>(T(a - b));
+}
+template <int W, bool S, typename T> inline T mul(const T &a, const T &b) {
+  return norm<W, S>(T(a * b));
+}
+template <bool S, typename T> inline bool lt(const T &a, const T &b) {
+  if (S && (top_bit(a) != top_bit(b)))
+    return top_bit(a);
+  return a < b;
+}
+// Number of places to shift by, where a negative amount gives no shift and
+// shifting by more than the width is the same as shifting by the width
+template <bool S, typename T> inline int shift_amount(const T &amt, int width) {
+  if (is_negative<S>(amt))
+    return 0;
+  for (int i = 1; i < limbs<T>::count; i++)
+    if (get_limb(amt, i) != 0)
+      return width;
+  uint64_t n = get_limb(amt, 0);
+  return (n > uint64_t(width)) ? width : int(n);
+}
+template <int W, bool S, typename T> inline T shl(const T &x, int n) {
+  return (n >= storage_bits<T>()) ? T{} : norm<W, S>(T(x << n));
+}
+template <int W, bool S, typename T> inline T shr(const T &x, int n) {
+  if (S)
+    return sar(x, n);
+  return (n >= storage_bits<T>()) ? T{} : T(x >> n);
+}
+
+// Return W bits of x, which is signed if S, from bit low upwards with the
+// signedness S2
+template <int W, bool S2, bool S, typename T>
+inline uint_t<W> slice(const T &x, int low) {
+  return cast<W, S2, S>(S ? sar(x, low) : T(x >> low));
+}
+// Set width bits of x from bit low upwards to the bits of an unsigned value
+template <typename T, typename B>
+inline void deposit(T &x, int low, int width, const B &bits) {
+  T mask = (width >= storage_bits<T>()) ? ~T{} : T(~(~T{} << width));
+  mask = mask << low;
+  x = (x & ~mask) | (T(extend<T, false>(bits) << low) & mask);
+}
+// Return the W bit value x as an unsigned index, or -1 if it is too large
+// for an int
+template <int W, typename T> inline int index(const T &x) {
+  T u = norm<W, false>(x);
+  for (int i = 1; i < limbs<T>::count; i++)
+    if (get_limb(u, i) != 0)
+      return -1;
+  uint64_t n = get_limb(u, 0);
+  return (n > 0x7fffffff) ? -1 : int(n);
+}
+
+// Return the magnitude of a value of width W as unsigned, of the same width,
+// where the most negative value wraps
+template <int W, bool S, typename T> inline T magnitude(const T &x) {
+  return norm<W, false>(is_negative<S>(x) ? T(T{} - x) : x);
+}
+// Return an unsigned magnitude as a signed value one bit wider, negated if
+// negative is true
+template <int W>
+inline uint_t<W + 1> apply_sign(const uint_t<W> &mag, bool negative) {
+  uint_t<W + 1> positive = cast<W + 1, true, false>(mag);
+  return negative ? sub<W + 1, true>(uint_t<W + 1>{}, positive) : positive;
+}
+// Divide unsigned values of widths N and D, as a restoring divider does, so
+// that dividing by zero gives a quotient of all ones and the low bits of the
+// dividend as the remainder
+template <int N, int D>
+inline void divide(const uint_t<N> &num, const uint_t<D> &den, uint_t<N> &quot,
+                   uint_t<D> &rem) {
+  typedef uint_t<((N > D) ? N : D) + 1> T;
+  T n = extend<T, false>(num), d = extend<T, false>(den), q{}, r{};
+  if (is_zero(d)) {
+    q = ~T{};
+    r = n;
+  } else if constexpr (limbs<T>::count <= 2) {
+    q = n / d;
+    r = n % d;
+  } else {
+    for (int i = N - 1; i >= 0; i--) {
+      r = (r << 1) | from_u64<T>(bit(n, i));
+      if (!(r < d)) {
+        r = r - d;
+        q = q | (from_u64<T>(1) << i);
+      }
+    }
+  }
+  quot = cast<N, false, false>(q);
+  rem = cast<D, false, false>(r);
+}
+// A stage of a pipelined divider, which shifts the next dividend bit into the
+// partial remainder and subtracts the divisor if it can. The dividend is
+// shifted out of the top of num as quotient bits are shifted in
+template <int N, int D> struct div_stage {
+  uint_t<D> rem{};
+  uint_t<N> num{};
+  uint_t<D> den{};
+  bool qneg = false, rneg = false;
+
+  div_stage next() const {
+    typedef uint_t<D + 1> T;
+    T trial = T(extend<T, false>(rem) << 1) | from_u64<T>(bit(num, N - 1));
+    T d = extend<T, false>(den);
+    bool qbit = !(trial < d);
+    div_stage r = *this;
+    r.rem = cast<D, false, false>(qbit ? T(trial - d) : trial);
+    r.num = norm<N, false>(uint_t<N>(num << 1) | from_u64<uint_t<N>>(qbit));
+    return r;
+  }
+};
+
+constexpr uint128_t make128(uint64_t high, uint64_t low) {
+  return (uint128_t(high) << 64) | low;
+}
+// A memory of n words, starting with the given contents and then zeros
+template <typename T>
+inline std::vector<T> memory(size_t n, std::initializer_list<T> contents) {
+  std::vector<T> mem(contents);
+  mem.resize(n);
+  return mem;
+}
+
+// Read and write values as strings of binary digits, most significant first,
+// as used by ElasticC's simulator. Inputs set from them are only converted to
+// their type when the model is next evaluated
+template <typename T> inline void from_binary(T &x, const std::string &digits) {
+  x = T{};
+  for (char c : digits)
+    x = T(x << 1) | from_u64<T>(c == '1');
+}
+template <typename T> inline std::string to_binary(const T &x, int width) {
+  std::string digits(width, '0');
+  for (int i = 0; (i < width) && (i < storage_bits<T>()); i++)
+    if (bit(x, i))
+      digits.at(width - 1 - i) = '1';
+  return digits;
+}
+} // namespace ecc
+#endif
+)";
+
+void GenerateCppSupport(ostream &cpp) { cpp << cppSupport; }
+
+string GetCppConstant(const BitConstant &value, const HDLPortType *type) {
+  int width = type->GetWidth();
+  BitConstant v = value.cast(width, type->IsSigned());
+  // BitConstant keeps the bits above the width as zero, but a model holds
+  // them as the sign extension
+  auto limb = [&](int i) {
+    uint64_t bits = v.get_limb(i);
+    if ((i == (width - 1) / 64) && ((width % 64) != 0) && v.is_negative())
+      bits |= ~uint64_t(0) << (width % 64);
+    ostringstream hex;
+    hex << "0x" << std::hex << bits << "ull";
+    return hex.str();
+  };
+  if (width <= 64)
+    return limb(0);
+  if (width <= 128)
+    return "ecc::make128(" + limb(1) + ", " + limb(0) + ")";
+  int count = (width + 63) / 64;
+  string result = type->GetCppType() + "{{";
+  for (int i = 0; i < count; i++)
+    result += ((i != 0) ? ", " : "") + limb(i);
+  return result + "}}";
+}
+
+string CppInput(HDLDevicePort *port) {
+  return port->type->CppCastFrom(port->connectedNet->sigType,
+                                 port->connectedNet->name);
+}
+
+string CppAssign(HDLDevicePort *port, const HDLPortType *type,
+                 const string &value) {
+  return port->connectedNet->name + " = " +
+         port->connectedNet->sigType->CppCastFrom(type, value) + ";";
+}
+
+string CppIsHigh(HDLDevicePort *port) {
+  return "!ecc::is_zero(" + port->connectedNet->name + ")";
+}
+
+} // namespace HDLGen
+} // namespace ElasticC
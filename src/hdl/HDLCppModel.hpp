@@ -0,0 +1,40 @@
+#pragma once
+#include "BitConstant.hpp"
+#include "HDLDevicePort.hpp"
+#include "HDLPortType.hpp"
+
+#include <iostream>
+#include <string>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+/*
+Helpers for generating a C++ model of a design. The model holds each net in
+the smallest of uint64_t, unsigned __int128 and ecc::wide (a fixed number of
+64-bit limbs) that fits it, in two's complement with the bits above its width
+copies of the sign bit for a signed value, or zero for an unsigned one. The
+support code for this is written at the top of each model.
+*/
+
+// Write the support code used by generated models
+void GenerateCppSupport(ostream &cpp);
+
+// Return a C++ expression for a constant, converted to a type
+string GetCppConstant(const BitConstant &value, const HDLPortType *type);
+
+// Return a C++ expression for the value of the net connected to a device
+// input, converted to the type of the port, as SimCast does
+string CppInput(HDLDevicePort *port);
+
+// Return a C++ statement setting the net connected to a device output to a
+// value of a given type, converted to the net's type
+string CppAssign(HDLDevicePort *port, const HDLPortType *type,
+                 const string &value);
+
+// Return a C++ expression that is true if a single bit value, such as an
+// enable, is '1'
+string CppIsHigh(HDLDevicePort *port);
+
+} // namespace HDLGen
+} // namespace ElasticC
@@ -0,0 +1,191 @@
+#include "HDLDSPMapper.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+
+HDLDSPMapper::HDLDSPMapper(HDLDesign *_design, DeviceTiming *_model,
+                           HDLSignal *_clock, HDLSignal *_clock_enable)
+    : design(_design), model(_model), clock(_clock),
+      clock_enable(_clock_enable) {}
+
+static bool IsNumeric(HDLSignal *net) {
+  return dynamic_cast<NumericPortType *>(net->sigType) != nullptr;
+}
+
+static bool IsOperation(HDLDevice *dev, OperationType type) {
+  OperationHDLDevice *oper = dynamic_cast<OperationHDLDevice *>(dev);
+  return (oper != nullptr) && (oper->GetOperation() == type);
+}
+
+static bool IsAdder(HDLDevice *dev) {
+  return IsOperation(dev, B_ADD) || IsOperation(dev, B_SUB);
+}
+
+// Return the device driving a net, or nullptr if it is a top level input
+static HDLDevice *GetDriver(HDLSignal *net) {
+  for (auto p : net->connectedPorts)
+    if ((p->device != nullptr) && (p->dir == PortDirection::Output))
+      return p->device;
+  return nullptr;
+}
+
+// Return the device input that is the only use of a net, or nullptr if there
+// are other uses
+static HDLDevicePort *GetOnlyReader(HDLSignal *net) {
+  if (net->fanout != 1)
+    return nullptr;
+  for (auto p : net->connectedPorts)
+    if (p->IsFanout())
+      return (p->device != nullptr) ? p : nullptr;
+  return nullptr;
+}
+
+// Whether a net may be moved inside a DSP block
+static bool IsFusable(HDLSignal *net) {
+  return (net->fanout == 1) && !net->dont_pipeline && IsNumeric(net);
+}
+
+int HDLDSPMapper::GetSignedWidth(HDLSignal *net) {
+  return net->sigType->GetWidth() + (net->sigType->IsSigned() ? 0 : 1);
+}
+
+OperationHDLDevice *HDLDSPMapper::GetFusableDriver(HDLSignal *net,
+                                                   BufferHDLDevice *&buffer) {
+  buffer = nullptr;
+  if (!IsFusable(net))
+    return nullptr;
+  HDLDevice *driver = GetDriver(net);
+  BufferHDLDevice *buf = dynamic_cast<BufferHDLDevice *>(driver);
+  if ((buf != nullptr) && !buf->IsSlice()) {
+    HDLSignal *in = buf->GetPorts().at(0)->connectedNet;
+    if (!IsFusable(in))
+      return nullptr;
+    buffer = buf;
+    driver = GetDriver(in);
+  }
+  if (!IsAdder(driver))
+    return nullptr;
+  return dynamic_cast<OperationHDLDevice *>(driver);
+}
+
+OperationHDLDevice *HDLDSPMapper::GetFusableReader(HDLSignal *net,
+                                                   BufferHDLDevice *&buffer) {
+  buffer = nullptr;
+  HDLDevicePort *reader = GetOnlyReader(net);
+  if ((reader == nullptr) || !IsFusable(net))
+    return nullptr;
+  BufferHDLDevice *buf = dynamic_cast<BufferHDLDevice *>(reader->device);
+  if ((buf != nullptr) && !buf->IsSlice()) {
+    HDLSignal *out = buf->GetPorts().at(1)->connectedNet;
+    reader = GetOnlyReader(out);
+    if ((reader == nullptr) || !IsFusable(out))
+      return nullptr;
+    buffer = buf;
+  }
+  if (!IsAdder(reader->device))
+    return nullptr;
+  HDLSignal *result = reader->device->GetPorts().back()->connectedNet;
+  if (result->dont_pipeline || !IsNumeric(result))
+    return nullptr;
+  return dynamic_cast<OperationHDLDevice *>(reader->device);
+}
+
+bool HDLDSPMapper::MapMultiply(OperationHDLDevice *mul) {
+  vector<HDLDevicePort *> &mulPorts = mul->GetPorts();
+  HDLSignal *inputs[2] = {mulPorts.at(0)->connectedNet,
+                          mulPorts.at(1)->connectedNet};
+  HDLSignal *product = mulPorts.at(2)->connectedNet;
+  for (auto net : {inputs[0], inputs[1], product})
+    if (net->dont_pipeline || !IsNumeric(net))
+      return false;
+  if (!model->UseDSPForMultiply(GetSignedWidth(inputs[0]),
+                                GetSignedWidth(inputs[1])))
+    return false;
+
+  // Devices and intermediate nets replaced by the DSP block
+  vector<HDLDevice *> fused{mul};
+  vector<HDLSignal *> internal;
+  auto fuseBuffer = [&](BufferHDLDevice *buffer) {
+    if (buffer == nullptr)
+      return;
+    fused.push_back(buffer);
+    internal.push_back(buffer->GetPorts().at(0)->connectedNet);
+  };
+
+  // The pre-adder may be on either multiplier input
+  int a = 0;
+  optional<DSPHDLDevice::FusedAdder> pre;
+  HDLSignal *aNet = inputs[0];
+  for (int i = 0; i < 2; i++) {
+    BufferHDLDevice *buffer;
+    OperationHDLDevice *adder = GetFusableDriver(inputs[i], buffer);
+    if (adder == nullptr)
+      continue;
+    vector<HDLDevicePort *> &addPorts = adder->GetPorts();
+    a = i;
+    aNet = addPorts.at(0)->connectedNet;
+    pre = DSPHDLDevice::FusedAdder{adder->GetOperation(),
+                                   addPorts.at(1)->connectedNet, false,
+                                   addPorts.at(2)->connectedNet->sigType};
+    fused.push_back(adder);
+    fuseBuffer(buffer);
+    internal.push_back(inputs[i]);
+    break;
+  }
+
+  optional<DSPHDLDevice::FusedAdder> post;
+  HDLPortType *mType = product->sigType;
+  HDLSignal *output = product;
+  BufferHDLDevice *postBuffer;
+  OperationHDLDevice *postAdder = GetFusableReader(product, postBuffer);
+  if (postAdder != nullptr) {
+    vector<HDLDevicePort *> &addPorts = postAdder->GetPorts();
+    HDLSignal *m = product;
+    if (postBuffer != nullptr) {
+      m = postBuffer->GetPorts().at(1)->connectedNet;
+      mType = m->sigType;
+      fused.push_back(postBuffer);
+    }
+    bool swap = (addPorts.at(0)->connectedNet != m);
+    output = addPorts.at(2)->connectedNet;
+    post = DSPHDLDevice::FusedAdder{
+        postAdder->GetOperation(), addPorts.at(swap ? 0 : 1)->connectedNet,
+        swap, output->sigType};
+    fused.push_back(postAdder);
+    internal.push_back(product);
+    if (postBuffer != nullptr)
+      internal.push_back(m);
+  }
+
+  design->AddDevice(new DSPHDLDevice(
+      aNet, inputs[1 - a], output, clock, clock_enable, product->sigType, mType,
+      pre, pre.has_value() ? inputs[a]->sigType : nullptr, post));
+  for (auto dev : fused)
+    design->RemoveDevice(dev);
+  for (auto net : internal)
+    design->RemoveSignal(net);
+  return true;
+}
+
+int HDLDSPMapper::Run() {
+  design->MarkFeedbackNets(clock);
+  vector<OperationHDLDevice *> multiplies;
+  for (auto dev : design->devices)
+    if (IsOperation(dev, B_MUL))
+      multiplies.push_back(dynamic_cast<OperationHDLDevice *>(dev));
+  int count = 0;
+  for (auto mul : multiplies)
+    if (MapMultiply(mul))
+      count++;
+  PrintMessage(MSG_DEBUG, "mapped " + to_string(count) + " of " +
+                              to_string(multiplies.size()) +
+                              " multiplies to DSP blocks");
+  return count;
+}
+
+} // namespace HDLGen
+} // namespace ElasticC
@@ -0,0 +1,52 @@
+#pragma once
+#include "HDLArithmeticDevices.hpp"
+#include "HDLCoreDevices.hpp"
+#include "HDLDesign.hpp"
+#include "HDLSignal.hpp"
+#include "timing/DeviceTiming.hpp"
+
+#include <vector>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+/*
+Maps multiplies onto the DSP blocks of the target device, replacing each
+multiply that the timing model says is best done by a single DSP block with a
+DSPHDLDevice. An add or subtract producing one of the multiplier inputs is
+fused into the block as its pre-adder, and one using the product as its
+post-adder, as long as nothing else uses the intermediate result. The block's
+internal registers then let multiply-accumulates run at the speed of the DSP
+block, rather than that of a multiplier and adders in fabric logic.
+
+The added registers change the latency of the design, so this is run on
+clocked designs only, just before pipelining, and never maps multiplies in a
+feedback loop through a static variable.
+*/
+class HDLDSPMapper {
+public:
+  HDLDSPMapper(HDLDesign *_design, DeviceTiming *_model, HDLSignal *_clock,
+               HDLSignal *_clock_enable);
+  // Run the pass, returning the number of DSP blocks used
+  int Run();
+
+private:
+  HDLDesign *design;
+  DeviceTiming *model;
+  HDLSignal *clock, *clock_enable;
+
+  // Map a single multiply, returning whether it was mapped
+  bool MapMultiply(OperationHDLDevice *mul);
+  // Return the add or subtract producing net, possibly through a buffer, if
+  // its result is used nowhere else. buffer is set to the buffer, if any
+  OperationHDLDevice *GetFusableDriver(HDLSignal *net,
+                                       BufferHDLDevice *&buffer);
+  // Return the add or subtract using net, possibly through a buffer, if it is
+  // the only use of net. buffer is set to the buffer, if any
+  OperationHDLDevice *GetFusableReader(HDLSignal *net,
+                                       BufferHDLDevice *&buffer);
+  // Width of a value when converted to the signed inputs of a DSP block
+  static int GetSignedWidth(HDLSignal *net);
+};
+} // namespace HDLGen
+} // namespace ElasticC
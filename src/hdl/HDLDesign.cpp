@@ -1,8 +1,13 @@
 #include "HDLDesign.hpp"
 #include "HDLCoreDevices.hpp"
+#include "HDLCppModel.hpp"
+#include "HDLMemoryDevices.hpp"
+#include "HDLSimulator.hpp"
 #include "Util.hpp"
 #include <algorithm>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 using namespace std;
 
 namespace ElasticC {
@@ -17,7 +22,12 @@ HDLDesign::HDLDesign(string _name) : name(_name) {
   AddDevice(new ConstantHDLDevice(1, vcc));
 }
 
-void HDLDesign::AddSignal(HDLSignal *sig) { signals.push_back(sig); }
+void HDLDesign::AddSignal(HDLSignal *sig) {
+  if (sig->design == this)
+    return;
+  sig->design = this;
+  sig->designEntry = signals.insert(signals.end(), sig);
+}
 
 HDLSignal *HDLDesign::CreateTempSignal(HDLPortType *type, string prefix) {
   static int inc = 0;
@@ -26,13 +36,16 @@ HDLSignal *HDLDesign::CreateTempSignal(HDLPortType *type, string prefix) {
   return sig;
 }
 
-void HDLDesign::AddDevice(HDLDevice *dev) { devices.push_back(dev); }
+void HDLDesign::AddDevice(HDLDevice *dev) {
+  if (dev->sourceLine == -1)
+    dev->sourceLine = currentSourceLine;
+  dev->design = this;
+  dev->designEntry = devices.insert(devices.end(), dev);
+}
 
 void HDLDesign::AddPort(HDLDevicePort *port) {
   if (port->connectedNet != nullptr)
-    if (find(signals.begin(), signals.end(), port->connectedNet) ==
-        signals.end())
-      signals.push_back(port->connectedNet);
+    AddSignal(port->connectedNet);
   ports.push_back(port);
 }
 
@@ -41,21 +54,15 @@ void HDLDesign::AddPortFromSig(HDLSignal *sig, PortDirection dir) {
 }
 
 void HDLDesign::RemoveDevice(HDLDevice *dev) {
-  for (auto p : dev->GetPorts()) {
-    if (p->connectedNet != nullptr) {
-      auto p_fnd = find(p->connectedNet->connectedPorts.begin(),
-                        p->connectedNet->connectedPorts.end(), p);
-      if (p_fnd == p->connectedNet->connectedPorts.end())
-        throw runtime_error("can't remove port as it does not exist in design");
-      p->connectedNet->connectedPorts.erase(p_fnd);
-    }
-    p->connectedNet = nullptr;
-  }
-  auto dev_fnd = find(devices.begin(), devices.end(), dev);
-  if (dev_fnd == devices.end())
+  if (dev->design != this)
     throw runtime_error("can't remove device ===" + dev->GetInstanceName() +
                         "=== as it does not exist in design");
-  devices.erase(dev_fnd);
+  for (auto p : dev->GetPorts()) {
+    if (p->connectedNet != nullptr)
+      p->connectedNet->DisconnectPort(p);
+  }
+  devices.erase(dev->designEntry);
+  dev->design = nullptr;
   delete dev;
 }
 
@@ -63,54 +70,107 @@ void HDLDesign::RemoveSignal(HDLSignal *sig) {
   if (sig->connectedPorts.size() != 0)
     throw runtime_error("can't remove signal ===" + sig->name +
                         "=== as it still has connections to it");
-
-  auto signal_fnd = find(signals.begin(), signals.end(), sig);
-  if (signal_fnd == signals.end())
+  if (sig->design != this)
     throw runtime_error("can't remove signal ===" + sig->name +
                         "=== as it does not exist in design");
-  signals.erase(signal_fnd);
+  signals.erase(sig->designEntry);
+  sig->design = nullptr;
   delete sig;
 }
 
-int HDLDesign::GetSignalFanout(HDLSignal *sig) {
-  int fanout = 0;
-  for (auto port : sig->connectedPorts) {
-    // count device inputs and top level outputs
-    if ((port->device != nullptr) && (port->dir == PortDirection::Input))
-      fanout++;
-    if ((port->device == nullptr) && (port->dir == PortDirection::Output))
-      fanout++;
-  }
-  return fanout;
-}
+int HDLDesign::GetSignalFanout(HDLSignal *sig) { return sig->fanout; }
 
 int HDLDesign::GetDeviceFanout(HDLDevice *dev) {
   int totalFanout = 0;
   for (auto port : dev->GetPorts()) {
     if ((port->connectedNet != nullptr) &&
         (port->dir == PortDirection::Output)) {
-      totalFanout += GetSignalFanout(port->connectedNet);
+      totalFanout += port->connectedNet->fanout;
     }
   }
   return totalFanout;
 }
 
-bool HDLDesign::PruneDevicesPass() {
-  vector<HDLDevice *> toRemove;
-  copy_if(devices.begin(), devices.end(), back_inserter(toRemove),
-          [this](HDLDevice *d) { return GetDeviceFanout(d) == 0; });
-  for_each(toRemove.begin(), toRemove.end(), [this](HDLDevice *d) {
-    PrintMessage(MSG_DEBUG, "pruning device ===" + d->GetInstanceName() +
-                                "=== as it has no connections");
-    RemoveDevice(d);
-  });
-  return toRemove.size() > 0;
+bool HDLDesign::IsRailDriver(HDLDevice *dev) {
+  auto &devPorts = dev->GetPorts();
+  return (devPorts.size() == 1) && ((devPorts.at(0)->connectedNet == gnd) ||
+                                    (devPorts.at(0)->connectedNet == vcc));
+}
+
+vector<HDLDevice *> HDLDesign::GetTopologicalOrder() {
+  // Kahn's algorithm, counting for each device the inputs that are driven by
+  // devices not yet placed. When only devices in loops remain, a register or
+  // memory in one of them is placed early to break the loop
+  vector<HDLDevice *> order;
+  unordered_map<HDLDevice *, int> pending;
+  auto place = [&](HDLDevice *dev) {
+    pending[dev] = -1;
+    order.push_back(dev);
+  };
+  for (auto dev : devices) {
+    int count = 0;
+    for (auto p : dev->GetPorts()) {
+      if ((p->connectedNet == nullptr) || (p->dir != PortDirection::Input))
+        continue;
+      for (auto np : p->connectedNet->connectedPorts)
+        if ((np->device != nullptr) && (np->dir == PortDirection::Output))
+          count++;
+    }
+    pending[dev] = count;
+    if (count == 0)
+      place(dev);
+  }
+  size_t i = 0;
+  while (order.size() < devices.size()) {
+    if (i == order.size()) {
+      // Registers already known to be in a loop are preferred, as others are
+      // only waiting on a loop and should follow the values they depend on
+      auto isBreak = [&](HDLDevice *dev, bool in_loop) {
+        if (pending.at(dev) <= 0)
+          return false;
+        if (dynamic_cast<RAMHDLDevice *>(dev) != nullptr)
+          return true;
+        RegisterHDLDevice *reg = dynamic_cast<RegisterHDLDevice *>(dev);
+        return (reg != nullptr) &&
+               (!in_loop || reg->GetPorts().at(2)->connectedNet->dont_pipeline);
+      };
+      auto reg = find_if(devices.begin(), devices.end(),
+                         [&](HDLDevice *dev) { return isBreak(dev, true); });
+      if (reg == devices.end())
+        reg = find_if(devices.begin(), devices.end(),
+                      [&](HDLDevice *dev) { return isBreak(dev, false); });
+      if (reg == devices.end())
+        break;
+      place(*reg);
+    }
+    for (auto p : order.at(i++)->GetPorts()) {
+      if ((p->connectedNet == nullptr) || (p->dir != PortDirection::Output))
+        continue;
+      for (auto np : p->connectedNet->connectedPorts) {
+        if ((np->device == nullptr) || (np->dir != PortDirection::Input))
+          continue;
+        auto pend = pending.find(np->device);
+        if ((pend != pending.end()) && (--(pend->second) == 0))
+          order.push_back(np->device);
+      }
+    }
+  }
+  if (order.size() != devices.size()) {
+    PrintMessage(MSG_WARNING, "design ===" + name +
+                                  "=== contains combinational loops");
+    for (auto dev : devices)
+      if (pending.at(dev) > 0)
+        order.push_back(dev);
+  }
+  return order;
 }
 
 void HDLDesign::PruneNetsPass() {
   vector<HDLSignal *> toRemove;
   copy_if(signals.begin(), signals.end(), back_inserter(toRemove),
-          [this](HDLSignal *s) { return s->connectedPorts.size() == 0; });
+          [this](HDLSignal *s) {
+            return (s->connectedPorts.size() == 0) && (s != gnd) && (s != vcc);
+          });
   for_each(toRemove.begin(), toRemove.end(), [this](HDLSignal *s) {
     PrintMessage(MSG_DEBUG, "pruning signal ===" + s->name +
                                 "=== as it has no connections");
@@ -119,17 +179,99 @@ void HDLDesign::PruneNetsPass() {
 }
 
 void HDLDesign::Prune() {
-  bool changed = false;
-  do {
-    changed = PruneDevicesPass();
-    PruneNetsPass();
-  } while (changed);
+  // Start with the devices that drive nothing, then work backwards as removing
+  // a device may leave the drivers of its inputs with no fanout
+  vector<HDLDevice *> worklist;
+  unordered_set<HDLDevice *> queued;
+  for (auto dev : devices) {
+    if ((GetDeviceFanout(dev) == 0) && !IsRailDriver(dev)) {
+      worklist.push_back(dev);
+      queued.insert(dev);
+    }
+  }
+  while (!worklist.empty()) {
+    HDLDevice *dev = worklist.back();
+    worklist.pop_back();
+    vector<HDLSignal *> inputNets;
+    for (auto p : dev->GetPorts())
+      if ((p->connectedNet != nullptr) && (p->dir == PortDirection::Input))
+        inputNets.push_back(p->connectedNet);
+    PrintMessage(MSG_DEBUG, "pruning device ===" + dev->GetInstanceName() +
+                                "=== as it has no connections");
+    RemoveDevice(dev);
+    for (auto net : inputNets) {
+      if (net->fanout != 0)
+        continue;
+      for (auto p : net->connectedPorts) {
+        if ((p->device != nullptr) && (p->dir == PortDirection::Output) &&
+            (queued.find(p->device) == queued.end()) &&
+            (GetDeviceFanout(p->device) == 0) && !IsRailDriver(p->device)) {
+          worklist.push_back(p->device);
+          queued.insert(p->device);
+        }
+      }
+    }
+  }
+  PruneNetsPass();
+}
+
+void HDLDesign::MarkFeedbackNets(HDLSignal *clock) {
+  // Nets that can both be reached from the output of a functional register or
+  // memory and reach one of its inputs are part of a feedback loop through it.
+  // Searches pass through other registers, so a path from one register to
+  // another (such as the shift register of a stream window) is not a loop
+  auto search = [clock](HDLSignal *start, PortDirection from, PortDirection to,
+                        unordered_set<HDLSignal *> &found) {
+    vector<HDLSignal *> worklist;
+    if (found.insert(start).second)
+      worklist.push_back(start);
+    while (!worklist.empty()) {
+      HDLSignal *net = worklist.back();
+      worklist.pop_back();
+      for (auto p : net->connectedPorts) {
+        if ((p->device == nullptr) || (p->dir != from))
+          continue;
+        for (auto dp : p->device->GetPorts())
+          if ((dp->dir == to) && (dp->connectedNet != nullptr) &&
+              (dp->connectedNet != clock) &&
+              found.insert(dp->connectedNet).second)
+            worklist.push_back(dp->connectedNet);
+      }
+    }
+  };
+  for (auto dev : devices) {
+    RegisterHDLDevice *reg = dynamic_cast<RegisterHDLDevice *>(dev);
+    bool is_ram = (dynamic_cast<RAMHDLDevice *>(dev) != nullptr);
+    if (!is_ram && ((reg == nullptr) || reg->IsPipeline()))
+      continue;
+    // Registers on a loop already found share all of its nets
+    if ((reg != nullptr) && reg->GetPorts().at(2)->connectedNet->dont_pipeline)
+      continue;
+    unordered_set<HDLSignal *> fromReg, toReg;
+    for (auto p : dev->GetPorts())
+      if (p->dir == PortDirection::Output)
+        search(p->connectedNet, PortDirection::Input, PortDirection::Output,
+               fromReg);
+    for (auto p : dev->GetPorts())
+      if ((p->dir == PortDirection::Input) && (p->connectedNet != clock))
+        search(p->connectedNet, PortDirection::Output, PortDirection::Input,
+               toReg);
+    for (auto net : fromReg)
+      if (toReg.find(net) != toReg.end())
+        net->dont_pipeline = true;
+  }
 }
 
 void HDLDesign::GenerateVHDLFile(ostream &out) {
   out << "--Generated by ElasticC version " << GetVersion() << endl << endl;
+  // The gnd and vcc rails are only written out if something uses them
+  auto unusedRail = [this](HDLSignal *sig) {
+    return ((sig == gnd) || (sig == vcc)) && (sig->fanout == 0);
+  };
   set<string> deps;
   for (auto dev : devices) {
+    if (IsRailDriver(dev) && unusedRail(dev->GetPorts().at(0)->connectedNet))
+      continue;
     auto ddeps = dev->GetVHDLDeps();
     deps.insert(ddeps.begin(), ddeps.end());
   }
@@ -150,19 +292,129 @@ void HDLDesign::GenerateVHDLFile(ostream &out) {
   out << "end " << name << ";" << endl << endl;
 
   out << "architecture hls_gen of " << name << " is" << endl;
+  set<HDLSignal *> portNets;
+  for (auto port : ports)
+    portNets.insert(port->connectedNet);
   for (auto sig : signals) {
-    if (find_if(ports.begin(), ports.end(), [this, sig](HDLDevicePort *p) {
-          return (p->connectedNet == sig);
-        }) == ports.end())
+    if ((portNets.find(sig) == portNets.end()) && !unusedRail(sig))
       sig->GenerateVHDL(out);
   }
-  for (auto dev : devices)
+  vector<HDLDevice *> usedDevices;
+  copy_if(devices.begin(), devices.end(), back_inserter(usedDevices),
+          [&](HDLDevice *dev) {
+            return !IsRailDriver(dev) ||
+                   !unusedRail(dev->GetPorts().at(0)->connectedNet);
+          });
+  for (auto dev : usedDevices)
     dev->GenerateVHDLPrefix(out);
   out << "begin" << endl;
   out << endl;
-  for (auto dev : devices)
+  for (auto dev : usedDevices)
     dev->GenerateVHDL(out);
   out << "end hls_gen;" << endl;
 };
+
+void HDLDesign::GenerateVerilogFile(ostream &out) {
+  out << "// Generated by ElasticC version " << GetVersion() << endl << endl;
+  auto unusedRail = [this](HDLSignal *sig) {
+    return ((sig == gnd) || (sig == vcc)) && (sig->fanout == 0);
+  };
+  out << "module " << name << "(" << endl;
+  for (int i = 0; i < ports.size(); i++) {
+    ports.at(i)->GenerateVerilog(out, (i == (ports.size() - 1)));
+  }
+  out << "\t);" << endl << endl;
+
+  set<HDLSignal *> portNets;
+  for (auto port : ports)
+    portNets.insert(port->connectedNet);
+  for (auto sig : signals) {
+    if ((portNets.find(sig) == portNets.end()) && !unusedRail(sig))
+      sig->GenerateVerilog(out);
+  }
+  vector<HDLDevice *> usedDevices;
+  copy_if(devices.begin(), devices.end(), back_inserter(usedDevices),
+          [&](HDLDevice *dev) {
+            return !IsRailDriver(dev) ||
+                   !unusedRail(dev->GetPorts().at(0)->connectedNet);
+          });
+  for (auto dev : usedDevices)
+    dev->GenerateVerilogPrefix(out);
+  out << endl;
+  for (auto dev : usedDevices)
+    dev->GenerateVerilog(out);
+  out << "endmodule" << endl;
+};
+
+void HDLDesign::GenerateCppFile(ostream &out) {
+  out << "// Generated by ElasticC version " << GetVersion() << endl;
+  out << "#pragma once" << endl;
+  GenerateCppSupport(out);
+  out << endl;
+  // Clock nets are left out, as tick() gives the clock edge
+  auto isClock = [](HDLSignal *sig) {
+    return dynamic_cast<ClockSignalPortType *>(sig->sigType) != nullptr;
+  };
+  auto unusedRail = [this](HDLSignal *sig) {
+    return ((sig == gnd) || (sig == vcc)) && (sig->fanout == 0);
+  };
+  vector<HDLDevice *> sequential, combinational;
+  LevelizeHDLDesign(this, sequential, combinational);
+  auto used = [&](HDLDevice *dev) {
+    return !IsRailDriver(dev) ||
+           !unusedRail(dev->GetPorts().at(0)->connectedNet);
+  };
+
+  out << "class " << name << " {" << endl;
+  out << "public:" << endl;
+  set<HDLSignal *> portNets;
+  for (auto port : ports) {
+    portNets.insert(port->connectedNet);
+    if (!isClock(port->connectedNet))
+      port->GenerateCpp(out);
+  }
+  out << endl;
+
+  out << "\t// Update the outputs from the inputs and the current state" << endl;
+  out << "\tvoid eval() {" << endl;
+  // Inputs may have been set to any value, so are first converted to their
+  // types as the simulator does
+  for (auto port : ports)
+    if ((port->dir == PortDirection::Input) && !isClock(port->connectedNet))
+      out << "\t\t" << port->name << " = ecc::norm<"
+          << port->type->GetWidth() << ", "
+          << (port->type->IsSigned() ? "true" : "false") << ">(" << port->name
+          << ");" << endl;
+  for (auto dev : sequential)
+    dev->GenerateCpp(out);
+  for (auto dev : combinational)
+    if (used(dev))
+      dev->GenerateCpp(out);
+  out << "\t}" << endl << endl;
+
+  out << "\t// Run one clock cycle, with the inputs held at their current values"
+      << endl;
+  out << "\tvoid tick() {" << endl;
+  out << "\t\teval();" << endl;
+  if (!sequential.empty()) {
+    for (auto dev : sequential)
+      dev->GenerateCppClock(out);
+    out << "\t\teval();" << endl;
+  }
+  out << "\t}" << endl << endl;
+
+  out << "private:" << endl;
+  for (auto sig : signals)
+    if ((portNets.find(sig) == portNets.end()) && !isClock(sig) &&
+        !unusedRail(sig))
+      sig->GenerateCpp(out);
+  for (auto dev : sequential)
+    dev->GenerateCppPrefix(out);
+  for (auto dev : combinational)
+    if (used(dev))
+      dev->GenerateCppPrefix(out);
+  out << "};" << endl;
+}
+
 } // namespace HDLGen
 } // namespace ElasticC
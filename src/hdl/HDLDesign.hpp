@@ -17,9 +17,11 @@ public:
   HDLDesign(string _name);
 
   string name;
-  vector<HDLSignal *> signals;
+  // Signals and devices are kept in lists, with each storing its position so
+  // that they can be removed in constant time
+  list<HDLSignal *> signals;
   vector<HDLDevicePort *> ports;
-  vector<HDLDevice *> devices;
+  list<HDLDevice *> devices;
 
   void AddSignal(HDLSignal *sig);
   void AddPort(HDLDevicePort *port);
@@ -35,17 +37,42 @@ public:
   // Return the total number of inputs drvien by all outputs of a device
   int GetDeviceFanout(HDLDevice *dev);
 
-  // Remove devices and signals that have no bearing on the output
+  // Return the devices ordered so that each comes after the drivers of all of
+  // its inputs. Registers and memories in feedback loops start new paths, so
+  // they come before the drivers of their inputs
+  vector<HDLDevice *> GetTopologicalOrder();
+
+  // Mark nets on a feedback loop through a functional register (i.e. a static
+  // variable) or a memory as dont_pipeline, as adding latency to them would
+  // change the design's behaviour
+  void MarkFeedbackNets(HDLSignal *clock);
+
+  // Remove devices and signals that have no bearing on the output. The gnd and
+  // vcc rails are always kept, as later passes may connect to them
   void Prune();
-  // Run a single pass removing devices with no fanout, returning true on change
-  bool PruneDevicesPass();
   // Run a single pass pruning nets with no connections
   void PruneNetsPass();
 
   void GenerateVHDLFile(ostream &out);
+  // Generate the design as a Verilog module, with the same ports and
+  // behaviour as the VHDL, in a plain subset of Verilog-2005
+  void GenerateVerilogFile(ostream &out);
+  // Generate a cycle accurate C++ model of the design, as a header containing
+  // a class named after the design, which starts with all inputs zero and
+  // registers holding their initial values. Its eval() updates the outputs
+  // from the inputs, as the simulator settles the design, and tick() runs a
+  // clock cycle
+  void GenerateCppFile(ostream &out);
 
   // Special constant forced signals
   HDLSignal *gnd, *vcc;
+
+  // Source line attributed to devices as they are added, or -1 if unknown
+  int currentSourceLine = -1;
+
+private:
+  // Return true if a device only drives the gnd or vcc rail
+  bool IsRailDriver(HDLDevice *dev);
 };
 }
 }
@@ -1,4 +1,5 @@
 #include "HDLDevice.hpp"
+#include "Util.hpp"
 #include <algorithm>
 using namespace std;
 namespace ElasticC {
@@ -7,8 +8,35 @@ namespace HDLGen {
 vector<string> HDLDevice::GetVHDLDeps() { return vector<string>{}; };
 void HDLDevice::GenerateVHDLPrefix(ostream &vhdl) {}
 void HDLDevice::GenerateVHDL(ostream &vhdl) {}
+void HDLDevice::GenerateVerilogPrefix(ostream &verilog) {}
+void HDLDevice::GenerateVerilog(ostream &verilog) {
+  PrintMessage(MSG_ERROR, "device ===" + GetInstanceName() +
+                              "=== cannot be written as Verilog");
+}
 void HDLDevice::AnnotateTiming(DeviceTiming *model) {}
 void HDLDevice::AnnotateLatency(DeviceTiming *model) {}
+int HDLDevice::GetInputStage(HDLDevicePort *port) { return 0; }
+vector<pair<string, double>>
+HDLDevice::GetInternalDelays(DeviceTiming *model) {
+  return {};
+}
+void HDLDevice::Simulate() {
+  PrintMessage(MSG_ERROR,
+               "device ===" + GetInstanceName() + "=== cannot be simulated");
+}
+void HDLDevice::SimulateClock() {}
+void HDLDevice::StartBatch() {}
+void HDLDevice::SimulateBatch() {
+  PrintMessage(MSG_ERROR, "device ===" + GetInstanceName() +
+                              "=== cannot be batch simulated");
+}
+void HDLDevice::SimulateBatchClock() {}
+void HDLDevice::GenerateCppPrefix(ostream &cpp) {}
+void HDLDevice::GenerateCpp(ostream &cpp) {
+  PrintMessage(MSG_ERROR, "device ===" + GetInstanceName() +
+                              "=== cannot be written as a C++ model");
+}
+void HDLDevice::GenerateCppClock(ostream &cpp) {}
 HDLDevice::~HDLDevice() {};
 
 
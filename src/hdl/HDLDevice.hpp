@@ -1,15 +1,19 @@
 #pragma once
+#include "Arena.hpp"
 #include "timing/DeviceTiming.hpp"
 #include <iostream>
+#include <list>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 namespace ElasticC {
 namespace HDLGen {
 class HDLDevicePort;
 class HDLSignal;
+class HDLDesign;
 
-class HDLDevice {
+class HDLDevice : public ArenaAllocated<ArenaKind::Netlist> {
 public:
   virtual string GetInstanceName() = 0;
   virtual vector<HDLDevicePort *> &GetPorts() = 0;
@@ -20,12 +24,50 @@ public:
   virtual void GenerateVHDLPrefix(ostream &vhdl);
   // Generate VHDL for the device itself
   virtual void GenerateVHDL(ostream &vhdl);
+  // Generate Verilog declarations (wires, regs and memories) and the Verilog
+  // for the device itself, as above
+  virtual void GenerateVerilogPrefix(ostream &verilog);
+  virtual void GenerateVerilog(ostream &verilog);
 
   // Annotate timing and latencies for this device only
   virtual void AnnotateTiming(DeviceTiming *model);
   virtual void AnnotateLatency(DeviceTiming *model);
+  // Number of cycles after the device's other inputs that an input is needed,
+  // for pipelined devices which only use some inputs in later stages
+  virtual int GetInputStage(HDLDevicePort *port);
+  // Delays between registers inside the device, each named after the register
+  // it ends at. These must fit into a clock period, but cannot be pipelined
+  virtual vector<pair<string, double>> GetInternalDelays(DeviceTiming *model);
+
+  // Simulation, used by HDLSimulator. Simulate sets the outputs from the
+  // inputs, or from the state of a sequential device (one with a clock input).
+  // SimulateClock updates the state at a rising clock edge, without changing
+  // any outputs so that all devices see the values from before the edge
+  virtual void Simulate();
+  virtual void SimulateClock();
+  // Batch simulation, used by HDLBatchSimulator, which works as above but on
+  // the values in every lane at once. StartBatch clears any state before a
+  // new batch is run
+  virtual void StartBatch();
+  virtual void SimulateBatch();
+  virtual void SimulateBatchClock();
+  // C++ model generation, used by HDLDesign::GenerateCppFile, which works as
+  // simulation does. GenerateCppPrefix declares any state as members of the
+  // model, GenerateCpp writes statements setting the outputs as Simulate
+  // does, and GenerateCppClock writes statements updating the state as
+  // SimulateClock does
+  virtual void GenerateCppPrefix(ostream &cpp);
+  virtual void GenerateCpp(ostream &cpp);
+  virtual void GenerateCppClock(ostream &cpp);
 
   virtual ~HDLDevice();
+
+  // The design containing the device, and its position in the design's device
+  // list so that it can be removed in constant time
+  HDLDesign *design = nullptr;
+  list<HDLDevice *>::iterator designEntry;
+  // Line in the source that the device was created from, or -1 if unknown
+  int sourceLine = -1;
 };
 // Represents some arbitrary HDL device; for example a vendor provided primitive
 // or user created VHDL component
@@ -1,5 +1,6 @@
 #include "HDLDevicePort.hpp"
 #include "HDLSignal.hpp"
+#include "HDLVerilog.hpp"
 #include <algorithm>
 using namespace std;
 namespace ElasticC {
@@ -7,11 +8,16 @@ namespace HDLGen {
 
 HDLDevicePort::HDLDevicePort(string _name, HDLDevice *_dev, HDLPortType *_type,
                              HDLSignal *_net, PortDirection _dir)
-    : name(_name), device(_dev), type(_type), connectedNet(_net), dir(_dir) {
-  if (connectedNet != nullptr)
-    connectedNet->ConnectToPort(this);
+    : name(_name), device(_dev), type(_type), dir(_dir) {
+  if (_net != nullptr)
+    _net->ConnectToPort(this);
 };
 
+bool HDLDevicePort::IsFanout() const {
+  return ((device != nullptr) && (dir == PortDirection::Input)) ||
+         ((device == nullptr) && (dir == PortDirection::Output));
+}
+
 void HDLDevicePort::GenerateVHDL(ostream &vhdl, bool is_last) {
   vhdl << "\t\t" << name << " : "
        << ((dir == PortDirection::Input)
@@ -34,11 +40,29 @@ void HDLDevicePort::GenerateVHDLWire(ostream &vhdl) {
   }
 }
 
+void HDLDevicePort::GenerateVerilog(ostream &verilog, bool is_last) {
+  verilog << "\t\t"
+          << VerilogDecl(((dir == PortDirection::Input)
+                              ? "input wire"
+                              : ((dir == PortDirection::Output)
+                                     ? "output wire"
+                                     : "inout wire")),
+                         type, name)
+          << (is_last ? "" : ",") << endl;
+}
+
+void HDLDevicePort::GenerateCpp(ostream &cpp) {
+  cpp << "\t" << type->GetCppType() << " " << name << "{}; // "
+      << ((dir == PortDirection::Input)
+              ? "in"
+              : ((dir == PortDirection::Output) ? "out" : "inout"))
+      << ", " << type->GetWidth() << " bit "
+      << (type->IsSigned() ? "signed" : "unsigned") << endl;
+}
+
 HDLDevicePort::~HDLDevicePort() {
-  if (connectedNet != nullptr) {
-    remove(connectedNet->connectedPorts.begin(),
-           connectedNet->connectedPorts.end(), this);
-  }
+  if (connectedNet != nullptr)
+    connectedNet->DisconnectPort(this);
 }
 }
 }
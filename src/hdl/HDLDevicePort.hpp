@@ -1,6 +1,7 @@
 #pragma once
 #include "HDLPortType.hpp"
 #include <iostream>
+#include <list>
 #include <string>
 #include <vector>
 
@@ -22,8 +23,17 @@ public:
   HDLPortType *type = nullptr;
   HDLSignal *connectedNet = nullptr;
   PortDirection dir = PortDirection::Input;
+  // Position in the connected net's list of ports
+  list<HDLDevicePort *>::iterator netEntry;
+  // Return true if the port counts towards the fanout of its net, i.e. it is a
+  // device input or top level output
+  bool IsFanout() const;
   void GenerateVHDL(ostream &vhdl, bool is_last = false);
   void GenerateVHDLWire(ostream &vhdl);
+  // Generate the declaration of a top level port in a Verilog module header
+  void GenerateVerilog(ostream &verilog, bool is_last = false);
+  // Generate the member of a C++ model for a top level port
+  void GenerateCpp(ostream &cpp);
   ~HDLDevicePort();
 };
 }
@@ -0,0 +1,646 @@
+#include "HDLMemoryDevices.hpp"
+#include "HDLBatchSimulator.hpp"
+#include "HDLCppModel.hpp"
+#include "HDLDevicePort.hpp"
+#include "HDLPortType.hpp"
+#include "HDLSimulator.hpp"
+#include "HDLVerilog.hpp"
+
+#include <algorithm>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+
+LineBufferHDLDevice::LineBufferHDLDevice(HDLSignal *d, HDLSignal *clk,
+                                         HDLSignal *q, HDLSignal *en,
+                                         int _depth)
+    : depth(_depth) {
+  inst_name = "linebuf_" + to_string(serial++);
+  ports.push_back(
+      new HDLDevicePort("d", this, d->sigType, d, PortDirection::Input));
+  ports.push_back(
+      new HDLDevicePort("clk", this, clk->sigType, clk, PortDirection::Input));
+  ports.push_back(
+      new HDLDevicePort("q", this, q->sigType, q, PortDirection::Output));
+  ports.push_back(
+      new HDLDevicePort("en", this, en->sigType, en, PortDirection::Input));
+}
+
+string LineBufferHDLDevice::GetInstanceName() { return inst_name; }
+
+vector<HDLDevicePort *> &LineBufferHDLDevice::GetPorts() { return ports; };
+
+vector<string> LineBufferHDLDevice::GetVHDLDeps() {
+  return vector<string>{"ieee.std_logic_1164.all", "ieee.numeric_std.all"};
+}
+
+bool LineBufferHDLDevice::IsRAM() {
+  return (depth > maxShiftDepth) &&
+         (depth * ports.at(2)->type->GetWidth() >= minRAMBits);
+}
+
+/*
+The line is stored in the type of the output, in inst_mem. A block RAM line also
+has the address counter inst_addr, which wraps after depth values.
+*/
+void LineBufferHDLDevice::GenerateVHDLPrefix(ostream &vhdl) {
+  vhdl << "\ttype " << inst_name << "_t is array(0 to " << (depth - 1)
+       << ") of " << ports.at(2)->type->GetVHDLType() << ";" << endl;
+  vhdl << "\tsignal " << inst_name << "_mem : " << inst_name << "_t;" << endl;
+  if (IsRAM()) {
+    int addrWidth = 1;
+    while ((1 << addrWidth) < depth)
+      addrWidth++;
+    vhdl << "\tsignal " << inst_name << "_addr : unsigned(" << (addrWidth - 1)
+         << " downto 0) := (others => '0');" << endl;
+  }
+}
+
+void LineBufferHDLDevice::GenerateVHDL(ostream &vhdl) {
+  string clksig = ports.at(1)->connectedNet->name;
+  string mem = inst_name + "_mem", q = ports.at(2)->connectedNet->name;
+  string d = ports.at(2)->type->VHDLCastFrom(ports.at(0)->type,
+                                             ports.at(0)->connectedNet->name);
+  vhdl << "\tprocess(" << clksig << ")" << endl;
+  vhdl << "\tbegin" << endl;
+  vhdl << "\t\tif rising_edge(" << clksig << ") then" << endl;
+  vhdl << "\t\t\tif " << ports.at(3)->connectedNet->name << " = '1' then"
+       << endl;
+  if (IsRAM()) {
+    // The old value is read before it is overwritten, as a read-first block
+    // RAM port
+    string addr = inst_name + "_addr";
+    string word = mem + "(to_integer(" + addr + "))";
+    vhdl << "\t\t\t\t" << q << " <= " << word << ";" << endl;
+    vhdl << "\t\t\t\t" << word << " <= " << d << ";" << endl;
+    vhdl << "\t\t\t\tif " << addr << " = " << (depth - 1) << " then" << endl;
+    vhdl << "\t\t\t\t\t" << addr << " <= (others => '0');" << endl;
+    vhdl << "\t\t\t\telse" << endl;
+    vhdl << "\t\t\t\t\t" << addr << " <= " << addr << " + 1;" << endl;
+    vhdl << "\t\t\t\tend if;" << endl;
+  } else {
+    vhdl << "\t\t\t\t" << q << " <= " << mem << "(" << (depth - 1) << ");"
+         << endl;
+    if (depth > 1) {
+      vhdl << "\t\t\t\tfor i in 1 to " << (depth - 1) << " loop" << endl;
+      vhdl << "\t\t\t\t\t" << mem << "(i) <= " << mem << "(i - 1);" << endl;
+      vhdl << "\t\t\t\tend loop;" << endl;
+    }
+    vhdl << "\t\t\t\t" << mem << "(0) <= " << d << ";" << endl;
+  }
+  vhdl << "\t\t\tend if;" << endl;
+  vhdl << "\t\tend if;" << endl;
+  vhdl << "\tend process;" << endl << endl;
+}
+
+/*
+The Verilog is the same, with the registered output in inst_q and the index
+of the shift register loop in inst_i.
+*/
+void LineBufferHDLDevice::GenerateVerilogPrefix(ostream &verilog) {
+  HDLPortType *type = ports.at(2)->type;
+  verilog << "\t" << VerilogDecl("reg", type, inst_name + "_mem") << " [0:"
+          << (depth - 1) << "];" << endl;
+  verilog << "\t" << VerilogDecl("reg", type, inst_name + "_q") << ";"
+          << endl;
+  if (IsRAM()) {
+    int addrWidth = 1;
+    while ((1 << addrWidth) < depth)
+      addrWidth++;
+    NumericPortType addrType(addrWidth, false);
+    verilog << "\t" << VerilogDecl("reg", &addrType, inst_name + "_addr")
+            << " = " << addrType.GetVerilogZero() << ";" << endl;
+  } else if (depth > 1) {
+    verilog << "\tinteger " << inst_name << "_i;" << endl;
+  }
+}
+
+void LineBufferHDLDevice::GenerateVerilog(ostream &verilog) {
+  string mem = inst_name + "_mem", q = inst_name + "_q";
+  string d = ports.at(2)->type->VerilogCastFrom(
+      ports.at(0)->type, ports.at(0)->connectedNet->name);
+  verilog << "\talways @(posedge " << ports.at(1)->connectedNet->name << ")"
+          << endl;
+  verilog << "\t\tif (" << ports.at(3)->connectedNet->name << ") begin"
+          << endl;
+  if (IsRAM()) {
+    // The old value is read before it is overwritten, as a read-first block
+    // RAM port
+    string addr = inst_name + "_addr";
+    string word = mem + "[" + addr + "]";
+    verilog << "\t\t\t" << q << " <= " << word << ";" << endl;
+    verilog << "\t\t\t" << word << " <= " << d << ";" << endl;
+    verilog << "\t\t\tif (" << addr << " == " << (depth - 1) << ")" << endl;
+    verilog << "\t\t\t\t" << addr << " <= 0;" << endl;
+    verilog << "\t\t\telse" << endl;
+    verilog << "\t\t\t\t" << addr << " <= " << addr << " + 1;" << endl;
+  } else {
+    verilog << "\t\t\t" << q << " <= " << mem << "[" << (depth - 1) << "];"
+            << endl;
+    if (depth > 1) {
+      string i = inst_name + "_i";
+      verilog << "\t\t\tfor (" << i << " = 1; " << i << " < " << depth
+              << "; " << i << " = " << i << " + 1)" << endl;
+      verilog << "\t\t\t\t" << mem << "[" << i << "] <= " << mem << "[" << i
+              << " - 1];" << endl;
+    }
+    verilog << "\t\t\t" << mem << "[0] <= " << d << ";" << endl;
+  }
+  verilog << "\t\tend" << endl;
+  verilog << "\tassign " << ports.at(2)->connectedNet->name << " = " << q
+          << ";" << endl
+          << endl;
+}
+
+void LineBufferHDLDevice::AnnotateTiming(DeviceTiming *model) {
+  ports.at(2)->connectedNet->timing_delay = HDLTimingValue<double>(
+      ports.at(1)->connectedNet,
+      model->GetFFPropogationDelay() +
+          model->GetRoutingDelay(ports.at(2)->connectedNet->fanout));
+}
+
+void LineBufferHDLDevice::AnnotateLatency(DeviceTiming *model) {
+  // Like a functional register, the delay is part of the design's behaviour
+  // rather than pipelining
+  HDLTimingValue<int> inp_latency;
+  for (auto p : ports)
+    if ((p->dir == PortDirection::Input) && (p != ports.at(1)))
+      inp_latency = TimingMax(inp_latency, p->connectedNet->pipeline_latency);
+  ports.at(2)->connectedNet->pipeline_latency = inp_latency;
+}
+
+void LineBufferHDLDevice::Simulate() { SetSimValue(ports.at(2), sim_q); }
+
+void LineBufferHDLDevice::SimulateClock() {
+  if (!IsSimHigh(ports.at(3)))
+    return;
+  if (sim_line.empty())
+    sim_line.assign(depth, SimCast(BitConstant(), ports.at(2)->type));
+  sim_q = sim_line.at(sim_pos);
+  sim_line.at(sim_pos) =
+      SimCast(ports.at(0)->connectedNet->sim_value, ports.at(2)->type);
+  sim_pos = (sim_pos + 1) % depth;
+}
+
+void LineBufferHDLDevice::StartBatch() {
+  batch_q = BatchCast(BatchValue(), ports.at(2)->type);
+  batch_line.assign(depth, batch_q);
+}
+
+void LineBufferHDLDevice::SimulateBatch() {
+  SetBatchValue(ports.at(2), batch_q);
+}
+
+void LineBufferHDLDevice::SimulateBatchClock() {
+  SimLanes en = GetBatchHigh(ports.at(3));
+  batch_q = SelectBatch(en, batch_q, batch_line.back());
+  for (int i = depth - 1; i > 0; i--)
+    batch_line.at(i) = SelectBatch(en, batch_line.at(i), batch_line.at(i - 1));
+  batch_line.at(0) = SelectBatch(
+      en, batch_line.at(0),
+      BatchCast(ports.at(0)->connectedNet->batch_value, ports.at(2)->type));
+}
+
+void LineBufferHDLDevice::GenerateCppPrefix(ostream &cpp) {
+  string type = ports.at(2)->type->GetCppType();
+  cpp << "\tstd::vector<" << type << "> " << inst_name << "_line = std::vector<"
+      << type << ">(" << depth << ");" << endl;
+  cpp << "\tint " << inst_name << "_pos = 0;" << endl;
+  cpp << "\t" << type << " " << inst_name << "_q{};" << endl;
+}
+
+void LineBufferHDLDevice::GenerateCpp(ostream &cpp) {
+  cpp << "\t\t" << CppAssign(ports.at(2), ports.at(2)->type, inst_name + "_q")
+      << endl;
+}
+
+void LineBufferHDLDevice::GenerateCppClock(ostream &cpp) {
+  string line = inst_name + "_line", pos = inst_name + "_pos";
+  cpp << "\t\tif (" << CppIsHigh(ports.at(3)) << ") {" << endl;
+  cpp << "\t\t\t" << inst_name << "_q = " << line << "[" << pos << "];"
+      << endl;
+  cpp << "\t\t\t" << line << "[" << pos << "] = "
+      << ports.at(2)->type->CppCastFrom(ports.at(0)->connectedNet->sigType,
+                                        ports.at(0)->connectedNet->name)
+      << ";" << endl;
+  cpp << "\t\t\t" << pos << " = (" << pos << " + 1) % " << depth << ";"
+      << endl;
+  cpp << "\t\t}" << endl;
+}
+
+LineBufferHDLDevice::~LineBufferHDLDevice() {
+  for_each(ports.begin(), ports.end(), [](HDLDevicePort *p) { delete p; });
+}
+
+int LineBufferHDLDevice::serial = 0;
+
+RAMHDLDevice::RAMHDLDevice(
+    HDLSignal *clk, HDLSignal *en, HDLSignal *waddr, HDLSignal *wren,
+    HDLSignal *data, const vector<pair<HDLSignal *, HDLSignal *>> &reads,
+    const vector<BitConstant> &_contents)
+    : contents(_contents) {
+  inst_name = "ram_" + to_string(serial++);
+  clk_port =
+      new HDLDevicePort("clk", this, clk->sigType, clk, PortDirection::Input);
+  ports.push_back(clk_port);
+  en_port =
+      new HDLDevicePort("en", this, en->sigType, en, PortDirection::Input);
+  ports.push_back(en_port);
+  if (wren != nullptr) {
+    waddr_port = new HDLDevicePort("waddr", this, waddr->sigType, waddr,
+                                   PortDirection::Input);
+    wren_port = new HDLDevicePort("wren", this, wren->sigType, wren,
+                                  PortDirection::Input);
+    data_port = new HDLDevicePort("data", this, data->sigType, data,
+                                  PortDirection::Input);
+    ports.insert(ports.end(), {waddr_port, wren_port, data_port});
+  }
+  for (int i = 0; i < int(reads.size()); i++) {
+    HDLSignal *addr = reads.at(i).first, *q = reads.at(i).second;
+    read_ports.push_back(make_pair(
+        new HDLDevicePort("raddr" + to_string(i), this, addr->sigType, addr,
+                          PortDirection::Input),
+        new HDLDevicePort("q" + to_string(i), this, q->sigType, q,
+                          PortDirection::Output)));
+    ports.push_back(read_ports.back().first);
+    ports.push_back(read_ports.back().second);
+  }
+  HDLSignal *addr = reads.empty() ? waddr : reads.front().first;
+  length = 1 << addr->sigType->GetWidth();
+}
+
+string RAMHDLDevice::GetInstanceName() { return inst_name; }
+
+vector<HDLDevicePort *> &RAMHDLDevice::GetPorts() { return ports; };
+
+vector<string> RAMHDLDevice::GetVHDLDeps() {
+  return vector<string>{"ieee.std_logic_1164.all", "ieee.numeric_std.all"};
+}
+
+int RAMHDLDevice::GetInputStage(HDLDevicePort *port) {
+  return ((port == waddr_port) || (port == wren_port) || (port == data_port))
+             ? 1
+             : 0;
+}
+
+/*
+The words are held in inst_mem, of the type of the data read. With a write port,
+each read i has the word read from the memory in inst_rdi, and inst_fwdi set if
+it was written at the same time, in which case the data written is taken from
+inst_wdata instead.
+*/
+void RAMHDLDevice::GenerateVHDLPrefix(ostream &vhdl) {
+  HDLPortType *word =
+      read_ports.empty() ? data_port->type : read_ports.front().second->type;
+  vhdl << "	type " << inst_name << "_t is array(0 to " << (length - 1)
+       << ") of " << word->GetVHDLType() << ";" << endl;
+  vhdl << "	signal " << inst_name << "_mem : " << inst_name << "_t := (";
+  for (int i = 0; i < int(contents.size()); i++)
+    vhdl << i << " => "
+         << contents.at(i).cast(word->GetWidth(), word->IsSigned()).to_string()
+         << ", ";
+  vhdl << "others => (others => '0'));" << endl;
+  if (data_port == nullptr)
+    return;
+  vhdl << "	signal " << inst_name << "_wdata : " << word->GetVHDLType() << ";"
+       << endl;
+  for (int i = 0; i < int(read_ports.size()); i++) {
+    vhdl << "	signal " << inst_name << "_rd" << i << " : "
+         << word->GetVHDLType() << ";" << endl;
+    vhdl << "	signal " << inst_name << "_fwd" << i << " : std_logic;" << endl;
+  }
+}
+
+void RAMHDLDevice::GenerateVHDL(ostream &vhdl) {
+  string clksig = clk_port->connectedNet->name;
+  string mem = inst_name + "_mem";
+  auto word = [&](HDLDevicePort *addr) {
+    return mem + "(to_integer(" + addr->connectedNet->name + "))";
+  };
+  vhdl << "	process(" << clksig << ")" << endl;
+  vhdl << "	begin" << endl;
+  vhdl << "		if rising_edge(" << clksig << ") then" << endl;
+  vhdl << "			if " << en_port->connectedNet->name << " = '1' then" << endl;
+  for (int i = 0; i < int(read_ports.size()); i++) {
+    HDLDevicePort *raddr = read_ports.at(i).first, *q = read_ports.at(i).second;
+    if (data_port == nullptr) {
+      vhdl << "				" << q->connectedNet->name << " <= " << word(raddr)
+           << ";" << endl;
+      continue;
+    }
+    string fwd = inst_name + "_fwd" + to_string(i);
+    vhdl << "				" << inst_name << "_rd" << i << " <= " << word(raddr)
+         << ";" << endl;
+    vhdl << "				if " << wren_port->connectedNet->name << " = '1' and "
+         << waddr_port->connectedNet->name << " = "
+         << raddr->connectedNet->name << " then" << endl;
+    vhdl << "					" << fwd << " <= '1';" << endl;
+    vhdl << "				else" << endl;
+    vhdl << "					" << fwd << " <= '0';" << endl;
+    vhdl << "				end if;" << endl;
+  }
+  if (data_port != nullptr) {
+    string data =
+        (read_ports.empty() ? data_port->type : read_ports.front().second->type)
+            ->VHDLCastFrom(data_port->type, data_port->connectedNet->name);
+    vhdl << "				" << inst_name << "_wdata <= " << data << ";" << endl;
+    vhdl << "				if " << wren_port->connectedNet->name << " = '1' then"
+         << endl;
+    vhdl << "					" << word(waddr_port) << " <= " << data << ";" << endl;
+    vhdl << "				end if;" << endl;
+  }
+  vhdl << "			end if;" << endl;
+  vhdl << "		end if;" << endl;
+  vhdl << "	end process;" << endl;
+  if (data_port != nullptr)
+    for (int i = 0; i < int(read_ports.size()); i++)
+      vhdl << "	" << read_ports.at(i).second->connectedNet->name << " <= "
+           << inst_name << "_wdata when " << inst_name << "_fwd" << i
+           << " = '1' else " << inst_name << "_rd" << i << ";" << endl;
+  vhdl << endl;
+}
+
+/*
+The Verilog is the same, except that every read has the word read in inst_rdi,
+as the outputs are driven by continuous assignments. The memory is cleared,
+and then given its contents, in an initial block using the loop index inst_i.
+*/
+void RAMHDLDevice::GenerateVerilogPrefix(ostream &verilog) {
+  HDLPortType *word = GetWordType();
+  string mem = inst_name + "_mem", i = inst_name + "_i";
+  verilog << "\t" << VerilogDecl("reg", word, mem) << " [0:" << (length - 1)
+          << "];" << endl;
+  verilog << "\tinteger " << i << ";" << endl;
+  verilog << "\tinitial begin" << endl;
+  verilog << "\t\tfor (" << i << " = 0; " << i << " < " << length << "; " << i
+          << " = " << i << " + 1)" << endl;
+  verilog << "\t\t\t" << mem << "[" << i << "] = " << word->GetVerilogZero()
+          << ";" << endl;
+  for (int j = 0; j < int(contents.size()); j++)
+    verilog << "\t\t" << mem << "[" << j
+            << "] = " << GetVerilogConstant(contents.at(j), word) << ";"
+            << endl;
+  verilog << "\tend" << endl;
+  for (int j = 0; j < int(read_ports.size()); j++)
+    verilog << "\t" << VerilogDecl("reg", word, inst_name + "_rd" + to_string(j))
+            << ";" << endl;
+  if (data_port == nullptr)
+    return;
+  verilog << "\t" << VerilogDecl("reg", word, inst_name + "_wdata") << ";"
+          << endl;
+  for (int j = 0; j < int(read_ports.size()); j++)
+    verilog << "\treg " << inst_name << "_fwd" << j << ";" << endl;
+}
+
+void RAMHDLDevice::GenerateVerilog(ostream &verilog) {
+  string mem = inst_name + "_mem";
+  auto word = [&](HDLDevicePort *addr) {
+    return mem + "[" + addr->connectedNet->name + "]";
+  };
+  verilog << "\talways @(posedge " << clk_port->connectedNet->name << ")"
+          << endl;
+  verilog << "\t\tif (" << en_port->connectedNet->name << ") begin" << endl;
+  for (int i = 0; i < int(read_ports.size()); i++) {
+    HDLDevicePort *raddr = read_ports.at(i).first;
+    verilog << "\t\t\t" << inst_name << "_rd" << i << " <= " << word(raddr)
+            << ";" << endl;
+    if (data_port != nullptr)
+      verilog << "\t\t\t" << inst_name << "_fwd" << i
+              << " <= " << wren_port->connectedNet->name << " && ("
+              << waddr_port->connectedNet->name
+              << " == " << raddr->connectedNet->name << ");" << endl;
+  }
+  if (data_port != nullptr) {
+    string data = GetWordType()->VerilogCastFrom(
+        data_port->type, data_port->connectedNet->name);
+    verilog << "\t\t\t" << inst_name << "_wdata <= " << data << ";" << endl;
+    verilog << "\t\t\tif (" << wren_port->connectedNet->name << ")" << endl;
+    verilog << "\t\t\t\t" << word(waddr_port) << " <= " << data << ";"
+            << endl;
+  }
+  verilog << "\t\tend" << endl;
+  for (int i = 0; i < int(read_ports.size()); i++) {
+    string rd = inst_name + "_rd" + to_string(i);
+    verilog << "\tassign " << read_ports.at(i).second->connectedNet->name
+            << " = ";
+    if (data_port != nullptr)
+      verilog << inst_name << "_fwd" << i << " ? " << inst_name << "_wdata : "
+              << rd;
+    else
+      verilog << rd;
+    verilog << ";" << endl;
+  }
+  verilog << endl;
+}
+
+void RAMHDLDevice::AnnotateTiming(DeviceTiming *model) {
+  for (auto rp : read_ports) {
+    HDLSignal *q = rp.second->connectedNet;
+    double delay = model->GetFFPropogationDelay() +
+                   model->GetRoutingDelay(q->fanout);
+    if (data_port != nullptr)
+      delay += model->GetMultiplexerDelay(2);
+    q->timing_delay = HDLTimingValue<double>(clk_port->connectedNet, delay);
+  }
+}
+
+void RAMHDLDevice::AnnotateLatency(DeviceTiming *model) {
+  // Writes needed a stage later may arrive correspondingly later
+  HDLTimingValue<int> inp_latency(clk_port->connectedNet, 0);
+  for (auto p : ports)
+    if ((p->dir == PortDirection::Input) && (p != clk_port) && (p != en_port))
+      inp_latency = TimingMax(inp_latency, p->connectedNet->pipeline_latency +
+                                               (-GetInputStage(p)));
+  for (auto rp : read_ports)
+    rp.second->connectedNet->pipeline_latency = inp_latency + 1;
+}
+
+HDLPortType *RAMHDLDevice::GetWordType() {
+  return read_ports.empty() ? data_port->type : read_ports.front().second->type;
+}
+
+// Set up the memory with its initial contents, and the registers as zero
+void RAMHDLDevice::StartSimulation() {
+  HDLPortType *word = GetWordType();
+  sim_mem.assign(length, SimCast(BitConstant(), word));
+  for (int i = 0; i < int(contents.size()); i++)
+    sim_mem.at(i) = SimCast(contents.at(i), word);
+  sim_rd.assign(read_ports.size(), SimCast(BitConstant(), word));
+  sim_fwd.assign(read_ports.size(), false);
+}
+
+void RAMHDLDevice::Simulate() {
+  if (sim_mem.empty())
+    StartSimulation();
+  for (int i = 0; i < int(read_ports.size()); i++) {
+    bool forward = (data_port != nullptr) && sim_fwd.at(i);
+    SetSimValue(read_ports.at(i).second, forward ? sim_wdata : sim_rd.at(i));
+  }
+}
+
+void RAMHDLDevice::SimulateClock() {
+  HDLPortType *word = GetWordType();
+  if (sim_mem.empty())
+    StartSimulation();
+  if (!IsSimHigh(en_port))
+    return;
+  // Addresses outside the memory read as zero and are not written, where the
+  // VHDL would fail
+  auto read = [&](int addr) {
+    return ((addr >= 0) && (addr < length)) ? sim_mem.at(addr)
+                                            : SimCast(BitConstant(), word);
+  };
+  int waddr = (data_port != nullptr) ? GetSimIndex(waddr_port) : -1;
+  bool wren = (data_port != nullptr) && IsSimHigh(wren_port);
+  for (int i = 0; i < int(read_ports.size()); i++) {
+    int raddr = GetSimIndex(read_ports.at(i).first);
+    sim_rd.at(i) = read(raddr);
+    sim_fwd.at(i) = wren && (waddr == raddr);
+  }
+  if (data_port != nullptr) {
+    sim_wdata = SimCast(data_port->connectedNet->sim_value, word);
+    if (wren && (waddr >= 0) && (waddr < length))
+      sim_mem.at(waddr) = sim_wdata;
+  }
+}
+
+void RAMHDLDevice::StartBatch() {
+  HDLPortType *word = GetWordType();
+  batch_mem.assign(length, BatchCast(BatchValue(), word));
+  for (int i = 0; i < int(contents.size()); i++)
+    batch_mem.at(i) = BatchCast(BatchValue(contents.at(i)), word);
+  batch_rd.assign(read_ports.size(), BatchCast(BatchValue(), word));
+  batch_fwd.assign(read_ports.size(), SimLanes::Fill(false));
+  batch_wdata = BatchCast(BatchValue(), word);
+}
+
+void RAMHDLDevice::SimulateBatch() {
+  for (int i = 0; i < int(read_ports.size()); i++) {
+    SimLanes forward = (data_port != nullptr) ? batch_fwd.at(i)
+                                              : SimLanes::Fill(false);
+    SetBatchValue(read_ports.at(i).second,
+                  SelectBatch(forward, batch_rd.at(i), batch_wdata));
+  }
+}
+
+void RAMHDLDevice::SimulateBatchClock() {
+  // Each lane may use a different address, so every word is compared with
+  // each address. Addresses outside the memory match no word, so read as zero
+  // and are not written
+  HDLPortType *word = GetWordType();
+  SimLanes en = GetBatchHigh(en_port);
+  auto getAddress = [](HDLDevicePort *port) {
+    BatchValue addr = port->connectedNet->batch_value;
+    addr.is_signed = false;
+    return addr;
+  };
+  BatchValue waddr;
+  SimLanes wren = SimLanes::Fill(false);
+  if (data_port != nullptr) {
+    waddr = getAddress(waddr_port);
+    wren = GetBatchHigh(wren_port) & en;
+  }
+  for (int i = 0; i < int(read_ports.size()); i++) {
+    BatchValue raddr = getAddress(read_ports.at(i).first);
+    BatchValue read = BatchCast(BatchValue(), word);
+    for (int j = 0; j < length; j++)
+      read = SelectBatch(AreBatchesEqual(raddr, BatchValue(BitConstant(j))),
+                         read, batch_mem.at(j));
+    batch_rd.at(i) = SelectBatch(en, batch_rd.at(i), read);
+    if (data_port != nullptr)
+      batch_fwd.at(i) = SelectLanes(en, batch_fwd.at(i),
+                                    wren & AreBatchesEqual(waddr, raddr));
+  }
+  if (data_port != nullptr) {
+    BatchValue data = BatchCast(data_port->connectedNet->batch_value, word);
+    batch_wdata = SelectBatch(en, batch_wdata, data);
+    for (int j = 0; j < length; j++)
+      batch_mem.at(j) = SelectBatch(
+          wren & AreBatchesEqual(waddr, BatchValue(BitConstant(j))),
+          batch_mem.at(j), data);
+  }
+}
+
+void RAMHDLDevice::GenerateCppPrefix(ostream &cpp) {
+  HDLPortType *word = GetWordType();
+  string type = word->GetCppType();
+  cpp << "\tstd::vector<" << type << "> " << inst_name << "_mem = ecc::memory<"
+      << type << ">(" << length << ", {";
+  for (int i = 0; i < int(contents.size()); i++) {
+    if (i != 0)
+      cpp << ",";
+    cpp << (((i % 4) == 0) ? "\n\t\t" : " ")
+        << GetCppConstant(contents.at(i), word);
+  }
+  cpp << "});" << endl;
+  if (!read_ports.empty()) {
+    cpp << "\tstd::array<" << type << ", " << read_ports.size() << "> "
+        << inst_name << "_rd{};" << endl;
+    cpp << "\tstd::array<bool, " << read_ports.size() << "> " << inst_name
+        << "_fwd{};" << endl;
+  }
+  if (data_port != nullptr)
+    cpp << "\t" << type << " " << inst_name << "_wdata{};" << endl;
+}
+
+void RAMHDLDevice::GenerateCpp(ostream &cpp) {
+  HDLPortType *word = GetWordType();
+  for (int i = 0; i < int(read_ports.size()); i++) {
+    string rd = inst_name + "_rd[" + to_string(i) + "]";
+    if (data_port != nullptr)
+      rd = inst_name + "_fwd[" + to_string(i) + "] ? " + inst_name +
+           "_wdata : " + rd;
+    cpp << "\t\t" << CppAssign(read_ports.at(i).second, word, rd) << endl;
+  }
+}
+
+void RAMHDLDevice::GenerateCppClock(ostream &cpp) {
+  HDLPortType *word = GetWordType();
+  string mem = inst_name + "_mem", waddr = inst_name + "_waddr",
+         wren = inst_name + "_wren";
+  // Return an expression for the index given by a net, as GetSimIndex does
+  auto index = [](HDLDevicePort *port) {
+    return "ecc::index<" + to_string(port->connectedNet->sigType->GetWidth()) +
+           ">(" + port->connectedNet->name + ")";
+  };
+  cpp << "\t\tif (" << CppIsHigh(en_port) << ") {" << endl;
+  if (data_port != nullptr) {
+    cpp << "\t\t\tint " << waddr << " = " << index(waddr_port) << ";"
+        << endl;
+    cpp << "\t\t\tbool " << wren << " = " << CppIsHigh(wren_port) << ";"
+        << endl;
+  }
+  // Addresses outside the memory read as zero and are not written
+  for (int i = 0; i < int(read_ports.size()); i++) {
+    string raddr = inst_name + "_raddr" + to_string(i);
+    cpp << "\t\t\tint " << raddr << " = " << index(read_ports.at(i).first)
+        << ";" << endl;
+    cpp << "\t\t\t" << inst_name << "_rd[" << i << "] = ((" << raddr
+        << " >= 0) && (" << raddr << " < " << length << ")) ? " << mem << "["
+        << raddr << "] : " << word->GetCppType() << "{};" << endl;
+    if (data_port != nullptr)
+      cpp << "\t\t\t" << inst_name << "_fwd[" << i << "] = " << wren
+          << " && (" << waddr << " == " << raddr << ");" << endl;
+  }
+  if (data_port != nullptr) {
+    cpp << "\t\t\t" << inst_name << "_wdata = "
+        << word->CppCastFrom(data_port->connectedNet->sigType,
+                             data_port->connectedNet->name)
+        << ";" << endl;
+    cpp << "\t\t\tif (" << wren << " && (" << waddr << " >= 0) && ("
+        << waddr << " < " << length << "))" << endl;
+    cpp << "\t\t\t\t" << mem << "[" << waddr << "] = " << inst_name
+        << "_wdata;" << endl;
+  }
+  cpp << "\t\t}" << endl;
+}
+
+RAMHDLDevice::~RAMHDLDevice() {
+  for_each(ports.begin(), ports.end(), [](HDLDevicePort *p) { delete p; });
+}
+
+int RAMHDLDevice::serial = 0;
+
+} // namespace HDLGen
+} // namespace ElasticC
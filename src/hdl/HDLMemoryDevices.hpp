@@ -0,0 +1,139 @@
+#pragma once
+#include "BitConstant.hpp"
+#include "HDLDevice.hpp"
+#include "HDLSignal.hpp"
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+// A delay line for the rows of a 2D stream window, holding a given number of
+// values and giving the value written depth + 1 enabled cycles earlier on its
+// registered output. Long lines are held in a block RAM, addressed by a counter
+// and read before being written in the same cycle. Short or narrow lines would
+// waste a block RAM, so are built as a shift register instead, which maps onto
+// SRL primitives
+class LineBufferHDLDevice : public HDLDevice {
+public:
+  LineBufferHDLDevice(HDLSignal *d, HDLSignal *clk, HDLSignal *q,
+                      HDLSignal *en, int _depth);
+  string GetInstanceName();
+  vector<HDLDevicePort *> &GetPorts();
+
+  vector<string> GetVHDLDeps();
+  void GenerateVHDLPrefix(ostream &vhdl);
+  void GenerateVHDL(ostream &vhdl);
+  void GenerateVerilogPrefix(ostream &verilog);
+  void GenerateVerilog(ostream &verilog);
+
+  void AnnotateTiming(DeviceTiming *model);
+  void AnnotateLatency(DeviceTiming *model);
+
+  void Simulate();
+  void SimulateClock();
+  void StartBatch();
+  void SimulateBatch();
+  void SimulateBatchClock();
+  void GenerateCppPrefix(ostream &cpp);
+  void GenerateCpp(ostream &cpp);
+  void GenerateCppClock(ostream &cpp);
+
+  // Return true if the line is held in a block RAM, rather than a shift
+  // register
+  bool IsRAM();
+
+  ~LineBufferHDLDevice();
+
+private:
+  static int serial;
+  string inst_name;
+  int depth;
+  vector<HDLDevicePort *> ports;
+  // The line and registered output when simulating. Both implementations
+  // behave as a circular buffer, with sim_pos the oldest value
+  vector<BitConstant> sim_line;
+  int sim_pos = 0;
+  BitConstant sim_q;
+  // The same when batch simulating, where the line is a shift register as
+  // each lane may be enabled at different times, oldest value last
+  vector<BatchValue> batch_line;
+  BatchValue batch_q;
+
+  // Longest line held in a shift register, one SRL32 per bit
+  static const int maxShiftDepth = 32;
+  // Smallest line, in bits, worth a block RAM
+  static const int minRAMBits = 1024;
+};
+
+/*
+A block RAM with an optional write port and one or more registered read ports,
+written as a vendor-neutral template that synthesis tools infer block RAM from.
+Inputs are only sampled, and the memory only written, while en is high.
+
+Reads have a latency of one cycle. Writes are needed a cycle after the reads
+of the same sample (so that a value read may be modified and written back, as
+in a histogram) and the memory is read before it is written, so a read also
+sees the write of the previous sample through a forwarding register when the
+addresses match. A memory with a write port has one read port left of the two
+of a dual-port block RAM, and one that is never written has two. The memory
+is initialised to zero, or to given contents, which make a memory that is
+never written a ROM.
+*/
+class RAMHDLDevice : public HDLDevice {
+public:
+  // A memory addressed by the width of the read addresses, written with data
+  // at waddr when wren is high unless they are all nullptr. Each read is a
+  // pair of an address and the data out net. Words past the end of the
+  // contents are initialised to zero
+  RAMHDLDevice(HDLSignal *clk, HDLSignal *en, HDLSignal *waddr,
+               HDLSignal *wren, HDLSignal *data,
+               const vector<pair<HDLSignal *, HDLSignal *>> &reads,
+               const vector<BitConstant> &_contents = {});
+  string GetInstanceName();
+  vector<HDLDevicePort *> &GetPorts();
+
+  vector<string> GetVHDLDeps();
+  void GenerateVHDLPrefix(ostream &vhdl);
+  void GenerateVHDL(ostream &vhdl);
+  void GenerateVerilogPrefix(ostream &verilog);
+  void GenerateVerilog(ostream &verilog);
+
+  void AnnotateTiming(DeviceTiming *model);
+  void AnnotateLatency(DeviceTiming *model);
+
+  void Simulate();
+  void SimulateClock();
+  void StartBatch();
+  void SimulateBatch();
+  void SimulateBatchClock();
+  void GenerateCppPrefix(ostream &cpp);
+  void GenerateCpp(ostream &cpp);
+  void GenerateCppClock(ostream &cpp);
+  // The write port is needed a cycle after the read addresses
+  int GetInputStage(HDLDevicePort *port);
+
+  // Number of ports of each block RAM
+  static const int numPorts = 2;
+
+  ~RAMHDLDevice();
+
+private:
+  static int serial;
+  string inst_name;
+  int length;
+  vector<BitConstant> contents;
+  vector<HDLDevicePort *> ports;
+  HDLDevicePort *clk_port, *en_port, *waddr_port = nullptr,
+                                     *wren_port = nullptr, *data_port = nullptr;
+  vector<pair<HDLDevicePort *, HDLDevicePort *>> read_ports;
+  // Memory contents and registers when simulating, named as in the VHDL
+  vector<BitConstant> sim_mem, sim_rd;
+  vector<bool> sim_fwd;
+  BitConstant sim_wdata;
+  vector<BatchValue> batch_mem, batch_rd;
+  vector<SimLanes> batch_fwd;
+  BatchValue batch_wdata;
+  HDLPortType *GetWordType();
+  void StartSimulation();
+};
+} // namespace HDLGen
+} // namespace ElasticC
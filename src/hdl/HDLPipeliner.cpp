@@ -0,0 +1,272 @@
+#include "HDLPipeliner.hpp"
+#include "HDLCoreDevices.hpp"
+#include "HDLMemoryDevices.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+
+HDLPipeliner::HDLPipeliner(HDLDesign *_design, DeviceTiming *_model,
+                           HDLSignal *_clock, HDLSignal *_clock_enable)
+    : design(_design), model(_model), clock(_clock),
+      clock_enable(_clock_enable) {
+  budget = (1.0 / clock->clockInfo.frequency) - model->GetFFSetupTime();
+}
+
+bool HDLPipeliner::IsClocked(const HDLTimingValue<int> &latency) {
+  return latency.domain == clock;
+}
+
+bool HDLPipeliner::IsClocked(const HDLTimingValue<double> &arrival) {
+  return arrival.domain == clock;
+}
+
+int HDLPipeliner::Run() {
+  InitialiseTiming();
+  design->MarkFeedbackNets(clock);
+  for (auto dev : design->GetTopologicalOrder()) {
+    PipelineDevice(dev);
+    pipelined.insert(dev);
+  }
+  AnnotateStateLatency();
+  return AlignOutputs();
+}
+
+void HDLPipeliner::InitialiseTiming() {
+  for (auto sig : design->signals) {
+    sig->timing_delay = HDLTimingValue<double>();
+    sig->pipeline_latency = HDLTimingValue<int>();
+  }
+  // Inputs are assumed to come straight from registers in the same domain
+  for (auto port : design->ports) {
+    HDLSignal *net = port->connectedNet;
+    if ((port->dir != PortDirection::Input) || (net == clock) ||
+        (net == clock_enable))
+      continue;
+    net->timing_delay =
+        HDLTimingValue<double>(clock, model->GetFFPropogationDelay());
+    net->pipeline_latency = HDLTimingValue<int>(clock, 0);
+  }
+}
+
+HDLTimingValue<double> HDLPipeliner::GetOutputArrival(HDLDevice *dev) {
+  HDLTimingValue<double> arrival;
+  for (auto p : dev->GetPorts())
+    if ((p->dir == PortDirection::Output) && (p->connectedNet != nullptr))
+      arrival = TimingMax(arrival, p->connectedNet->timing_delay);
+  return arrival;
+}
+
+HDLTimingValue<double> HDLPipeliner::GetInputArrival(HDLDevice *dev) {
+  HDLTimingValue<double> arrival;
+  for (auto p : dev->GetPorts())
+    if ((p->dir == PortDirection::Input) && (p->connectedNet != nullptr) &&
+        (p->connectedNet != clock))
+      arrival = TimingMax(arrival, p->connectedNet->timing_delay);
+  return arrival;
+}
+
+void HDLPipeliner::AlignInputs(HDLDevice *dev, int latency, bool in_feedback) {
+  for (auto p : dev->GetPorts()) {
+    if ((p->dir != PortDirection::Input) || (p->connectedNet == nullptr))
+      continue;
+    HDLSignal *net = p->connectedNet;
+    int target = latency + dev->GetInputStage(p);
+    if (!(in_feedback && net->dont_pipeline) &&
+        IsClocked(net->pipeline_latency) &&
+        (net->pipeline_latency.value < target))
+      GetDelayed(net, target - net->pipeline_latency.value)->ConnectToPort(p);
+  }
+}
+
+int HDLPipeliner::GetLoopEntryLatency(HDLDevice *dev, bool *complete) {
+  int latency = 0;
+  if (complete != nullptr)
+    *complete = true;
+  unordered_set<HDLSignal *> visited;
+  vector<HDLSignal *> worklist;
+  for (auto p : dev->GetPorts())
+    if ((p->dir == PortDirection::Input) && (p->connectedNet != nullptr) &&
+        p->connectedNet->dont_pipeline)
+      worklist.push_back(p->connectedNet);
+  while (!worklist.empty()) {
+    HDLSignal *net = worklist.back();
+    worklist.pop_back();
+    if (!visited.insert(net).second)
+      continue;
+    if (!net->dont_pipeline) {
+      if (IsClocked(net->pipeline_latency))
+        latency = max(latency, net->pipeline_latency.value);
+      if (complete != nullptr)
+        for (auto np : net->connectedPorts)
+          if ((np->device != nullptr) && (np->dir == PortDirection::Output) &&
+              (pipelined.find(np->device) == pipelined.end()))
+            *complete = false;
+      continue;
+    }
+    // The loop starts at its registers and memories
+    for (auto np : net->connectedPorts) {
+      if ((np->device == nullptr) || (np->dir != PortDirection::Output) ||
+          (dynamic_cast<RegisterHDLDevice *>(np->device) != nullptr) ||
+          (dynamic_cast<RAMHDLDevice *>(np->device) != nullptr))
+        continue;
+      for (auto dp : np->device->GetPorts())
+        if ((dp->dir == PortDirection::Input) &&
+            (dp->connectedNet != nullptr) && (dp->connectedNet != clock))
+          worklist.push_back(dp->connectedNet);
+    }
+  }
+  return latency;
+}
+
+void HDLPipeliner::PipelineDevice(HDLDevice *dev) {
+  bool in_feedback = false, is_sequential = false;
+  int latency = 0;
+  double inp_arrival = 0;
+  for (auto p : dev->GetPorts()) {
+    if (p->connectedNet == nullptr)
+      continue;
+    if (p->dir == PortDirection::Output) {
+      in_feedback |= p->connectedNet->dont_pipeline;
+    } else if (p->connectedNet == clock) {
+      is_sequential = true;
+    } else if (p->dir == PortDirection::Input) {
+      if (IsClocked(p->connectedNet->pipeline_latency))
+        latency = max(latency, p->connectedNet->pipeline_latency.value -
+                                   dev->GetInputStage(p));
+      if (IsClocked(p->connectedNet->timing_delay))
+        inp_arrival = max(inp_arrival, p->connectedNet->timing_delay.value);
+    }
+  }
+
+  // Functional registers outside feedback loops, such as those of a stream
+  // window, keep their enable aligned with their data
+  RegisterHDLDevice *reg = dynamic_cast<RegisterHDLDevice *>(dev);
+  if (reg != nullptr) {
+    if (!reg->IsPipeline() && !in_feedback)
+      AlignInputs(dev, latency);
+    dev->AnnotateTiming(model);
+    dev->AnnotateLatency(model);
+    HDLSignal *q = reg->GetPorts().at(2)->connectedNet;
+    if (in_feedback && !IsClocked(q->pipeline_latency)) {
+      bool complete;
+      int entry = GetLoopEntryLatency(dev, &complete);
+      if (complete)
+        q->pipeline_latency = HDLTimingValue<int>(clock, entry);
+    }
+    return;
+  }
+
+  // Devices with their own registers must meet timing at their inputs rather
+  // than their outputs
+  auto getArrival = [&]() {
+    return is_sequential ? GetInputArrival(dev) : GetOutputArrival(dev);
+  };
+  // Memories are placed before the rest of any loop through them, so their
+  // latency must allow for the values entering the loop, which are written a
+  // stage after the reads. Values entering a loop elsewhere are aligned with it
+  if (dynamic_cast<RAMHDLDevice *>(dev) != nullptr)
+    latency = max(latency, GetLoopEntryLatency(dev) - 1);
+  AlignInputs(dev, latency, in_feedback);
+  dev->AnnotateTiming(model);
+  HDLTimingValue<double> arrival = getArrival();
+
+  if (IsClocked(arrival) && (arrival.value > budget)) {
+    // Registering the inputs only helps if they arrive later than the output
+    // of a register would
+    if (!in_feedback && (inp_arrival > model->GetFFPropogationDelay())) {
+      AlignInputs(dev, latency + 1);
+      dev->AnnotateTiming(model);
+      arrival = getArrival();
+    }
+    if (arrival.value > budget)
+      PrintMessage(MSG_WARNING,
+                   "unable to meet timing at " +
+                       string(is_sequential ? "input" : "output") +
+                       " of device ===" + dev->GetInstanceName() +
+                       "=== (arrival " +
+                       to_string(arrival.value * 1e9) + "ns, budget " +
+                       to_string(budget * 1e9) + "ns)");
+  }
+  // Stages inside the device cannot be pipelined any further
+  for (const auto &internal : dev->GetInternalDelays(model))
+    if (internal.second > budget)
+      PrintMessage(MSG_WARNING,
+                   "unable to meet timing inside device ===" +
+                       dev->GetInstanceName() + "=== at register " +
+                       internal.first + " (delay " +
+                       to_string(internal.second * 1e9) + "ns, budget " +
+                       to_string(budget * 1e9) + "ns)");
+  dev->AnnotateLatency(model);
+}
+
+HDLSignal *HDLPipeliner::GetDelayed(HDLSignal *net, int cycles) {
+  // Delaying an already delayed net extends the original chain
+  auto origin = delayOrigins.find(net);
+  if (origin != delayOrigins.end())
+    return GetDelayed(origin->second.first, origin->second.second + cycles);
+  HDLSignal *prev = net;
+  for (int i = 1; i <= cycles; i++) {
+    auto existing = delayedNets.find(make_pair(net, i));
+    if (existing != delayedNets.end()) {
+      prev = existing->second;
+      continue;
+    }
+    HDLSignal *q = design->CreateTempSignal(net->sigType, "pipe");
+    RegisterHDLDevice *reg =
+        new RegisterHDLDevice(prev, clock, q, clock_enable, design->gnd, true);
+    design->AddDevice(reg);
+    reg->AnnotateTiming(model);
+    reg->AnnotateLatency(model);
+    delayedNets[make_pair(net, i)] = q;
+    delayOrigins[q] = make_pair(net, i);
+    prev = q;
+  }
+  return prev;
+}
+
+void HDLPipeliner::AnnotateStateLatency() {
+  for (auto dev : design->GetTopologicalOrder())
+    dev->AnnotateLatency(model);
+}
+
+int HDLPipeliner::AlignOutputs() {
+  int latency = 0;
+  for (auto port : design->ports)
+    if ((port->dir == PortDirection::Output) &&
+        IsClocked(port->connectedNet->pipeline_latency))
+      latency = max(latency, port->connectedNet->pipeline_latency.value);
+
+  for (auto port : design->ports) {
+    HDLSignal *net = port->connectedNet;
+    if ((port->dir != PortDirection::Output) ||
+        !IsClocked(net->pipeline_latency) ||
+        (net->pipeline_latency.value == latency))
+      continue;
+    auto driver = find_if(
+        net->connectedPorts.begin(), net->connectedPorts.end(),
+        [](HDLDevicePort *p) {
+          return (p->device != nullptr) && (p->dir == PortDirection::Output);
+        });
+    if (driver == net->connectedPorts.end())
+      continue;
+    // Move the driver onto a new net, then delay that onto the output
+    HDLSignal *early = design->CreateTempSignal(net->sigType, net->name);
+    early->timing_delay = net->timing_delay;
+    early->pipeline_latency = net->pipeline_latency;
+    early->ConnectToPort(*driver);
+    HDLSignal *delayed =
+        GetDelayed(early, latency - net->pipeline_latency.value);
+    design->AddDevice(new BufferHDLDevice(delayed, net));
+    net->timing_delay = delayed->timing_delay;
+    net->pipeline_latency = delayed->pipeline_latency;
+  }
+  return latency;
+}
+
+} // namespace HDLGen
+} // namespace ElasticC
@@ -0,0 +1,85 @@
+#pragma once
+#include "HDLDesign.hpp"
+#include "HDLDevice.hpp"
+#include "HDLSignal.hpp"
+#include "timing/DeviceTiming.hpp"
+
+#include <map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+/*
+Inserts pipeline registers into a single clock domain design so that no path
+exceeds the clock period, then balances latencies so that all outputs are
+aligned.
+
+Arrival times are propagated through the netlist in topological order using
+each device's AnnotateTiming. Where a device's output would arrive too late, its
+inputs are registered; for devices with their own registers, such as DSP
+blocks, it is the inputs that must arrive in time. Inputs of a device arriving
+at different latencies are delayed to match, allowing for inputs that are only
+needed in a later stage of a pipelined device, and nets in feedback loops
+through non-pipeline registers (i.e. static variables) or memories are never
+pipelined as that would change behaviour. Values entering a loop are instead
+delayed to the latency of the loop, and a memory's latency allows for the
+values entering any loop through it. Other non-pipeline registers and line
+buffers delay their enables along with their data, so their outputs have the
+latency of their inputs.
+
+The registers of a loop are reached before the values written to them, so once
+the design is pipelined the latencies are annotated again, giving the state
+they hold the latency of the stage writing it. Outputs read from state are then
+aligned with the rest, rather than being left at an unknown latency. Where
+every value entering a loop is already pipelined when its first register is
+reached, as for the state counter of a schedule, the register takes their
+latency straight away, so that logic reading it can be pipelined too.
+*/
+class HDLPipeliner {
+public:
+  HDLPipeliner(HDLDesign *_design, DeviceTiming *_model, HDLSignal *_clock,
+               HDLSignal *_clock_enable);
+  // Run the pass, returning the resulting latency in clock cycles from inputs
+  // to outputs
+  int Run();
+  // Return a copy of a net delayed by a given number of cycles. Registers are
+  // shared between all users of a net
+  HDLSignal *GetDelayed(HDLSignal *net, int cycles);
+
+private:
+  HDLDesign *design;
+  DeviceTiming *model;
+  HDLSignal *clock, *clock_enable;
+  double budget; // maximum arrival time at a register input in seconds
+  // Delayed copies of nets, keyed by original net and number of cycles, and
+  // the reverse mapping
+  map<pair<HDLSignal *, int>, HDLSignal *> delayedNets;
+  map<HDLSignal *, pair<HDLSignal *, int>> delayOrigins;
+  // Devices already visited in topological order
+  unordered_set<HDLDevice *> pipelined;
+
+  void InitialiseTiming();
+  void PipelineDevice(HDLDevice *dev);
+  // Delay the inputs of a device so that they all arrive with the given
+  // latency, except for nets in a feedback loop that the device is part of
+  void AlignInputs(HDLDevice *dev, int latency, bool in_feedback = false);
+  // Return the latency of the latest value entering a feedback loop through a
+  // device, found by searching back from its inputs to the start of the loop.
+  // If complete is given, it is set to whether every value entering the loop
+  // has been pipelined already, so that the latency is final
+  int GetLoopEntryLatency(HDLDevice *dev, bool *complete = nullptr);
+  // Annotate latencies again in topological order, now that the values
+  // written to the registers of each loop are known
+  void AnnotateStateLatency();
+  HDLTimingValue<double> GetInputArrival(HDLDevice *dev);
+  HDLTimingValue<double> GetOutputArrival(HDLDevice *dev);
+  int AlignOutputs();
+
+  bool IsClocked(const HDLTimingValue<int> &latency);
+  bool IsClocked(const HDLTimingValue<double> &arrival);
+};
+} // namespace HDLGen
+} // namespace ElasticC
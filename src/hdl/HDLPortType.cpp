@@ -12,6 +12,69 @@ string HDLPortType::VHDLCastFrom(const HDLPortType *other,
   return value;
 }
 
+string HDLPortType::VerilogCastFrom(const HDLPortType *other,
+                                    const string &net) const {
+  return VerilogCastFrom(other, net, 0, other->GetWidth());
+}
+
+string HDLPortType::VerilogCastFrom(const HDLPortType *other,
+                                    const string &net, int low,
+                                    int width) const {
+  int netWidth = other->GetWidth(), newWidth = GetWidth();
+  // Single bit nets may be declared without a range, so are never indexed
+  auto bit = [&](int i) {
+    return (netWidth == 1) ? net : (net + "[" + to_string(i) + "]");
+  };
+  auto bits = [&](int high, int first) -> string {
+    if ((first == 0) && (high == netWidth - 1))
+      return net;
+    else if (high == first)
+      return bit(high);
+    else
+      return net + "[" + to_string(high) + ":" + to_string(first) + "]";
+  };
+  string value;
+  if (newWidth <= width) {
+    value = bits(low + newWidth - 1, low);
+  } else {
+    string fill = other->IsSigned() ? bit(low + width - 1) : "1'b0";
+    value = "{{" + to_string(newWidth - width) + "{" + fill + "}}, " +
+            bits(low + width - 1, low) + "}";
+  }
+  // Selects and concatenations are always unsigned, while the net itself
+  // keeps the signedness it is declared with
+  if (value == net) {
+    if (other->IsSigned() != IsSigned())
+      value = string(IsSigned() ? "$signed(" : "$unsigned(") + value + ")";
+  } else if (IsSigned()) {
+    value = "$signed(" + value + ")";
+  }
+  return value;
+}
+
+string HDLPortType::GetVerilogZero() const {
+  return to_string(GetWidth()) + "'d0";
+}
+
+string HDLPortType::GetCppType() const {
+  int width = GetWidth();
+  if (width <= 64)
+    return "uint64_t";
+  else if (width <= 128)
+    return "ecc::uint128_t";
+  else
+    return "ecc::wide<" + to_string((width + 63) / 64) + ">";
+}
+
+string HDLPortType::CppCastFrom(const HDLPortType *other,
+                                const string &value) const {
+  if ((other->GetWidth() == GetWidth()) && (other->IsSigned() == IsSigned()))
+    return value;
+  return "ecc::cast<" + to_string(GetWidth()) + ", " +
+         (IsSigned() ? "true" : "false") + ", " +
+         (other->IsSigned() ? "true" : "false") + ">(" + value + ")";
+}
+
 string LogicSignalPortType::GetVHDLType() const { return "std_logic"; }
 
 int LogicSignalPortType::GetWidth() const { return 1; }
@@ -27,6 +90,8 @@ string LogicSignalPortType::VHDLCastFrom(const HDLPortType *other,
 
 string LogicSignalPortType::GetZero() const { return "'0'"; }
 
+string LogicSignalPortType::GetVerilogType() const { return ""; }
+
 HDLPortType *LogicSignalPortType::Resize(int newWidth) const {
   if (newWidth == 1)
     return new LogicSignalPortType();
@@ -49,7 +114,12 @@ string LogicVectorPortType::VHDLCastFrom(const HDLPortType *other,
   if (dynamic_cast<const LogicSignalPortType *>(other) != nullptr) {
     return "std_logic_vector(" + zeros(width - 1) + " & " + value + ")";
   } else if (dynamic_cast<const NumericPortType *>(other) != nullptr) {
-    return "std_logic_vector(resize(" + value + ", " + to_string(width) + "))";
+    // Narrower signed values are truncated, rather than keeping their sign bit
+    string numeric = (other->IsSigned() && (other->GetWidth() > width))
+                         ? ("unsigned(" + value + ")")
+                         : value;
+    return "std_logic_vector(resize(" + numeric + ", " + to_string(width) +
+           "))";
   } else {
     ostringstream out;
     if (width > other->GetWidth()) {
@@ -73,6 +143,10 @@ HDLPortType *LogicVectorPortType::Resize(int newWidth) const {
   return new LogicVectorPortType(newWidth);
 }
 
+string LogicVectorPortType::GetVerilogType() const {
+  return "[" + to_string(width - 1) + ":0]";
+}
+
 NumericPortType::NumericPortType(int _width, bool _signed)
     : width(_width), is_signed(_signed){};
 
@@ -94,6 +168,11 @@ string NumericPortType::VHDLCastFrom(const HDLPortType *other,
     curr_value =
         LogicVectorPortType(other->GetWidth()).VHDLCastFrom(other, value);
     curr_value = string(is_signed ? "signed(" : "unsigned(") + curr_value + ")";
+  } else if (other->IsSigned() && (other->GetWidth() > width)) {
+    // resize would keep the sign bit of a signed value, so it is truncated as
+    // an unsigned value instead, as in C
+    curr_value = "unsigned(" + value + ")";
+    same_signedness = !is_signed;
   } else {
     if (other->IsSigned() == is_signed)
       same_signedness = true;
@@ -115,6 +194,11 @@ HDLPortType *NumericPortType::Resize(int newWidth) const {
   return new NumericPortType(newWidth, is_signed);
 }
 
+string NumericPortType::GetVerilogType() const {
+  return string(is_signed ? "signed " : "") + "[" + to_string(width - 1) +
+         ":0]";
+}
+
 
 } // namespace HDLGen
 } // namespace ElasticC
@@ -14,6 +14,27 @@ public:
                               const string &value) const;
   virtual string GetZero() const = 0;
   virtual HDLPortType *Resize(int newWidth) const = 0;
+
+  // Verilog vectors only differ in width and signedness. Return the range and
+  // signedness used to declare a net of this type, which is empty for a single
+  // std_logic bit
+  virtual string GetVerilogType() const = 0;
+  // Return a Verilog expression converting a value of another type, held in a
+  // net, to this type, as VHDLCastFrom does. The result is exactly as wide as
+  // this type, so it can be used as an operand without being extended
+  string VerilogCastFrom(const HDLPortType *other, const string &net) const;
+  // The same for width bits of a net of another type starting at bit low,
+  // which are taken to have the signedness of the other type
+  string VerilogCastFrom(const HDLPortType *other, const string &net, int low,
+                         int width) const;
+  string GetVerilogZero() const;
+
+  // C++ models hold every type as an unsigned integer of at least its width,
+  // so only the width and signedness matter. Return the C++ type used
+  string GetCppType() const;
+  // Return a C++ expression converting a value of another type to this type,
+  // as SimCast does
+  string CppCastFrom(const HDLPortType *other, const string &value) const;
 };
 
 class LogicSignalPortType : public HDLPortType {
@@ -24,6 +45,7 @@ public:
                               const string &value) const;
   virtual string GetZero() const;
   virtual HDLPortType *Resize(int newWidth) const;
+  virtual string GetVerilogType() const;
 };
 
 class ClockSignalPortType : public LogicSignalPortType {};
@@ -37,6 +59,7 @@ public:
                               const string &value) const;
   virtual string GetZero() const;
   virtual HDLPortType *Resize(int newWidth) const;
+  virtual string GetVerilogType() const;
 
 private:
   int width;
@@ -52,6 +75,7 @@ public:
                               const string &value) const;
   virtual string GetZero() const;
   virtual HDLPortType *Resize(int newWidth) const;
+  virtual string GetVerilogType() const;
 
 private:
   int width;
@@ -0,0 +1,422 @@
+#include "HDLScheduler.hpp"
+#include "HDLMemoryDevices.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+
+HDLScheduler::HDLScheduler(HDLDesign *_design, DeviceTiming *_model,
+                           HDLSignal *_clock, HDLSignal *_clock_enable,
+                           HDLSignal *_reset, HDLSignal *_input_valid,
+                           int _target)
+    : design(_design), model(_model), clock(_clock),
+      clock_enable(_clock_enable), reset(_reset), input_valid(_input_valid),
+      target(_target) {}
+
+static bool IsNumeric(HDLSignal *net) {
+  return dynamic_cast<NumericPortType *>(net->sigType) != nullptr;
+}
+
+// Width of a value when converted to the signed inputs of a shared multiplier
+static int GetSignedWidth(HDLSignal *net) {
+  return net->sigType->GetWidth() + (net->sigType->IsSigned() ? 0 : 1);
+}
+
+void HDLScheduler::FindOperations() {
+  // Multiplies each net depends on without passing through another multiply
+  unordered_map<HDLSignal *, set<int>> netDeps;
+  for (auto dev : design->GetTopologicalOrder()) {
+    set<int> deps;
+    for (auto p : dev->GetPorts()) {
+      if ((p->dir != PortDirection::Input) || (p->connectedNet == nullptr))
+        continue;
+      auto found = netDeps.find(p->connectedNet);
+      if (found != netDeps.end())
+        deps.insert(found->second.begin(), found->second.end());
+    }
+    OperationHDLDevice *oper = dynamic_cast<OperationHDLDevice *>(dev);
+    bool shared = (oper != nullptr) && (oper->GetOperation() == B_MUL);
+    if (shared)
+      for (auto p : oper->GetPorts())
+        shared &= IsNumeric(p->connectedNet);
+    if (shared) {
+      predecessors.push_back(vector<int>(deps.begin(), deps.end()));
+      deps = set<int>{int(operations.size())};
+      operations.push_back(oper);
+    }
+    for (auto p : dev->GetPorts())
+      if ((p->dir == PortDirection::Output) && (p->connectedNet != nullptr))
+        netDeps[p->connectedNet] = deps;
+  }
+}
+
+void HDLScheduler::Schedule() {
+  int n = operations.size();
+  // Priority is the length of the longest chain of multiplies starting at an
+  // operation, found in reverse topological order
+  vector<int> height(n, 1);
+  for (int i = n - 1; i >= 0; i--)
+    for (auto pred : predecessors.at(i))
+      height.at(pred) = max(height.at(pred), height.at(i) + 1);
+
+  // One cycle of each iteration is used to load the inputs
+  int available = max(target - 1, 1);
+  numUnits = (n + available - 1) / available;
+  steps = vector<int>(n, 0);
+  int scheduled = 0;
+  while (scheduled < n) {
+    numSteps++;
+    vector<int> ready;
+    for (int i = 0; i < n; i++) {
+      if (steps.at(i) != 0)
+        continue;
+      vector<int> &preds = predecessors.at(i);
+      if (all_of(preds.begin(), preds.end(), [&](int p) {
+            return (steps.at(p) != 0) && (steps.at(p) < numSteps);
+          }))
+        ready.push_back(i);
+    }
+    stable_sort(ready.begin(), ready.end(),
+                [&](int a, int b) { return height.at(a) > height.at(b); });
+    for (int i = 0; (i < int(ready.size())) && (i < numUnits); i++) {
+      steps.at(ready.at(i)) = numSteps;
+      scheduled++;
+    }
+  }
+  // Dependencies may leave some multipliers unused
+  numUnits = 0;
+  for (int s = 1; s <= numSteps; s++)
+    numUnits = max(numUnits, int(count(steps.begin(), steps.end(), s)));
+}
+
+HDLSignal *HDLScheduler::MakeConstant(int value, HDLPortType *type) {
+  HDLSignal *net = design->CreateTempSignal(type, "const");
+  design->AddDevice(
+      new ConstantHDLDevice(BitConstant(value, type->GetWidth()), net));
+  return net;
+}
+
+HDLSignal *HDLScheduler::MakeOperation(OperationType oper,
+                                       const vector<HDLSignal *> &inputs,
+                                       HDLPortType *type, string prefix) {
+  HDLSignal *net = design->CreateTempSignal(type, prefix);
+  design->AddDevice(new OperationHDLDevice(oper, inputs, net));
+  return net;
+}
+
+void HDLScheduler::RegisterInputs(HDLSignal *load) {
+  vector<HDLSignal *> inputs;
+  for (auto port : design->ports) {
+    HDLSignal *net = port->connectedNet;
+    if ((port->dir == PortDirection::Input) && (net != clock) &&
+        (net != clock_enable) && (net != reset) && (net != input_valid))
+      inputs.push_back(net);
+  }
+  for (auto net : inputs) {
+    HDLSignal *q = design->CreateTempSignal(net->sigType, net->name + "_reg");
+    vector<HDLDevicePort *> readers;
+    for (auto p : net->connectedPorts)
+      if ((p->device != nullptr) && (p->dir == PortDirection::Input))
+        readers.push_back(p);
+    for (auto p : readers)
+      q->ConnectToPort(p);
+    design->AddDevice(
+        new RegisterHDLDevice(net, clock, q, load, design->gnd, false));
+  }
+}
+
+void HDLScheduler::BuildUnits(const vector<HDLSignal *> &stepEnables) {
+  // Within each step, the widest operations share the first units
+  vector<vector<int>> units(numUnits);
+  for (int s = 1; s <= numSteps; s++) {
+    vector<int> inStep;
+    for (int i = 0; i < int(operations.size()); i++)
+      if (steps.at(i) == s)
+        inStep.push_back(i);
+    auto width = [&](int i) {
+      vector<HDLDevicePort *> &ports = operations.at(i)->GetPorts();
+      return max(GetSignedWidth(ports.at(0)->connectedNet),
+                 GetSignedWidth(ports.at(1)->connectedNet));
+    };
+    stable_sort(inStep.begin(), inStep.end(),
+                [&](int a, int b) { return width(a) > width(b); });
+    for (int u = 0; u < int(inStep.size()); u++)
+      units.at(u).push_back(inStep.at(u));
+  }
+
+  for (auto &unit : units) {
+    // The wider operand of each multiply goes to the first input
+    vector<pair<HDLSignal *, HDLSignal *>> operands;
+    int widthA = 0, widthB = 0;
+    for (auto i : unit) {
+      vector<HDLDevicePort *> &ports = operations.at(i)->GetPorts();
+      HDLSignal *a = ports.at(0)->connectedNet, *b = ports.at(1)->connectedNet;
+      if (GetSignedWidth(b) > GetSignedWidth(a))
+        swap(a, b);
+      operands.push_back(make_pair(a, b));
+      widthA = max(widthA, GetSignedWidth(a));
+      widthB = max(widthB, GetSignedWidth(b));
+    }
+    // Operand multiplexers are indexed by state, with unused states taking the
+    // first operation's operands
+    auto makeOperand = [&](bool second, int width) {
+      HDLSignal *net =
+          design->CreateTempSignal(new NumericPortType(width, true), "share");
+      vector<HDLSignal *> inputs(numSteps + 1, second ? operands.at(0).second
+                                                     : operands.at(0).first);
+      for (int j = 0; j < int(unit.size()); j++)
+        inputs.at(steps.at(unit.at(j))) =
+            second ? operands.at(j).second : operands.at(j).first;
+      if (unit.size() == 1)
+        design->AddDevice(new BufferHDLDevice(inputs.at(0), net));
+      else
+        design->AddDevice(new MultiplexerHDLDevice(inputs, step, net));
+      return net;
+    };
+    HDLSignal *a = makeOperand(false, widthA), *b = makeOperand(true, widthB);
+    HDLSignal *product = MakeOperation(
+        B_MUL, {a, b}, new NumericPortType(widthA + widthB, true), "product");
+    // Each operation's result is now the product registered at the end of its
+    // step, truncated or extended to the original type
+    for (auto i : unit) {
+      OperationHDLDevice *oper = operations.at(i);
+      HDLSignal *result = oper->GetPorts().at(2)->connectedNet;
+      design->RemoveDevice(oper);
+      RegisterHDLDevice *reg =
+          new RegisterHDLDevice(product, clock, result,
+                                stepEnables.at(steps.at(i)), design->gnd, false);
+      design->AddDevice(reg);
+      results.push_back(reg);
+    }
+  }
+}
+
+int HDLScheduler::PipelineSteps() {
+  double budget = (1.0 / clock->clockInfo.frequency) - model->GetFFSetupTime();
+  // The logic of the steps is everything that the products depend on, back to
+  // the registered inputs, the registered products and the step
+  unordered_set<HDLDevice *> logic;
+  vector<HDLSignal *> worklist;
+  for (auto reg : results)
+    worklist.push_back(reg->GetPorts().at(0)->connectedNet);
+  while (!worklist.empty()) {
+    HDLSignal *net = worklist.back();
+    worklist.pop_back();
+    for (auto p : net->connectedPorts) {
+      if ((p->device == nullptr) || (p->dir != PortDirection::Output) ||
+          (dynamic_cast<RegisterHDLDevice *>(p->device) != nullptr) ||
+          !logic.insert(p->device).second)
+        continue;
+      for (auto dp : p->device->GetPorts())
+        if ((dp->dir == PortDirection::Input) && (dp->connectedNet != nullptr))
+          worklist.push_back(dp->connectedNet);
+    }
+  }
+
+  // Arrival times are propagated from the registers, registering the inputs of
+  // any device that would finish too late. A step must last a cycle longer
+  // than the most registers on any path through it, so that every register
+  // holds values from the step by its last cycle
+  HDLTimingValue<double> fromRegister(clock, model->GetFFPropogationDelay());
+  for (auto dev : design->devices)
+    for (auto p : dev->GetPorts())
+      if (p->connectedNet != nullptr)
+        p->connectedNet->timing_delay = HDLTimingValue<double>();
+  for (auto dev : design->devices)
+    if (dynamic_cast<RegisterHDLDevice *>(dev) != nullptr)
+      dev->AnnotateTiming(model);
+  step->timing_delay = fromRegister;
+  unordered_map<HDLSignal *, int> depth;
+  unordered_map<HDLSignal *, HDLSignal *> registered;
+  for (auto dev : design->GetTopologicalOrder()) {
+    if (logic.find(dev) == logic.end())
+      continue;
+    auto getDepth = [&]() {
+      int value = 0;
+      for (auto p : dev->GetPorts())
+        if ((p->dir == PortDirection::Input) && (p->connectedNet != nullptr))
+          value = max(value, depth[p->connectedNet]);
+      return value;
+    };
+    auto getArrival = [&]() {
+      HDLTimingValue<double> arrival;
+      for (auto p : dev->GetPorts())
+        if ((p->dir == PortDirection::Output) && (p->connectedNet != nullptr))
+          arrival = TimingMax(arrival, p->connectedNet->timing_delay);
+      return arrival;
+    };
+    dev->AnnotateTiming(model);
+    HDLTimingValue<double> arrival = getArrival();
+    if ((arrival.domain == clock) && (arrival.value > budget)) {
+      for (auto p : dev->GetPorts()) {
+        HDLSignal *net = p->connectedNet;
+        if ((p->dir != PortDirection::Input) || (net == nullptr) ||
+            (net->timing_delay.domain != clock) ||
+            (net->timing_delay.value <= fromRegister.value))
+          continue;
+        auto found = registered.find(net);
+        if (found == registered.end()) {
+          HDLSignal *q = design->CreateTempSignal(net->sigType, "stage");
+          RegisterHDLDevice *reg = new RegisterHDLDevice(
+              net, clock, q, clock_enable, design->gnd, false);
+          design->AddDevice(reg);
+          reg->AnnotateTiming(model);
+          depth[q] = depth[net] + 1;
+          found = registered.insert(make_pair(net, q)).first;
+        }
+        found->second->ConnectToPort(p);
+      }
+      dev->AnnotateTiming(model);
+    }
+    int value = getDepth();
+    for (auto p : dev->GetPorts())
+      if ((p->dir == PortDirection::Output) && (p->connectedNet != nullptr))
+        depth[p->connectedNet] = value;
+  }
+  int stages = 0;
+  for (auto reg : results)
+    stages = max(stages, depth[reg->GetPorts().at(0)->connectedNet]);
+  return stages;
+}
+
+int HDLScheduler::Run() {
+  for (auto dev : design->devices) {
+    if ((dynamic_cast<RegisterHDLDevice *>(dev) != nullptr) ||
+        (dynamic_cast<RAMHDLDevice *>(dev) != nullptr)) {
+      PrintMessage(MSG_WARNING, "design ===" + design->name +
+                                    "=== contains registers or memories so "
+                                    "multipliers will not be shared, and it "
+                                    "is pipelined instead");
+      return 0;
+    }
+  }
+  FindOperations();
+  if (operations.empty()) {
+    PrintMessage(MSG_NOTE, "design ===" + design->name +
+                               "=== has no multipliers to share");
+    return 0;
+  }
+  Schedule();
+
+  // The operands of the shared multipliers are selected by the step, which is
+  // driven from the state once the length of each step is known
+  int stepWidth = 1;
+  while ((1 << stepWidth) <= numSteps)
+    stepWidth++;
+  HDLPortType *logicType = new LogicSignalPortType();
+  step = design->CreateTempSignal(new NumericPortType(stepWidth, false), "step");
+  HDLSignal *load = design->CreateTempSignal(logicType, "load");
+  RegisterInputs(load);
+  vector<HDLSignal *> stepEnables{load};
+  for (int s = 1; s <= numSteps; s++)
+    stepEnables.push_back(design->CreateTempSignal(logicType, "step_en"));
+  BuildUnits(stepEnables);
+  stepCycles = PipelineSteps() + 1;
+
+  // The state counts from zero, waiting for valid inputs, through the cycles
+  // of each step, with the step in its upper bits
+  int phaseWidth = 0;
+  while ((1 << phaseWidth) < stepCycles)
+    phaseWidth++;
+  int stateWidth = stepWidth + phaseWidth;
+  HDLPortType *stateType = new NumericPortType(stateWidth, false);
+  state = design->CreateTempSignal(stateType, "state");
+  design->AddDevice(new BufferHDLDevice(
+      state, step, HDLBitSlice(stateWidth - 1, phaseWidth)));
+  auto encode = [&](int s, int phase) { return (s << phaseWidth) + phase; };
+
+  idle = MakeOperation(B_EQ, {state, MakeConstant(0, stateType)}, logicType,
+                       "idle");
+  design->AddDevice(new OperationHDLDevice(
+      B_BWAND,
+      {MakeOperation(B_BWAND, {idle, input_valid}, logicType, "start"),
+       clock_enable},
+      load));
+  // Products are registered in the last cycle of their step
+  for (int s = 1; s <= numSteps; s++)
+    design->AddDevice(new OperationHDLDevice(
+        B_BWAND,
+        {MakeOperation(B_EQ,
+                       {state, MakeConstant(encode(s, stepCycles - 1),
+                                            stateType)},
+                       logicType, "step_end"),
+         clock_enable},
+        stepEnables.at(s)));
+
+  // The state is the only loop left for the pipeliner, so its next value is a
+  // single multiplexer, indexed by the state and input_valid together: idle
+  // moves to the first step when the inputs are valid, and each cycle of a
+  // step moves to the next
+  HDLSignal *index = design->CreateTempSignal(
+      new NumericPortType(stateWidth + 1, false), "next_index");
+  design->AddDevice(new CombinerHDLDevice(
+      {make_pair(state, HDLBitSlice(stateWidth - 1, 0)),
+       make_pair(input_valid, HDLBitSlice(stateWidth, stateWidth))},
+      index));
+  HDLSignal *zero = MakeConstant(0, stateType);
+  vector<HDLSignal *> nextStates(2 << stateWidth, zero);
+  nextStates.at(1 << stateWidth) = MakeConstant(encode(1, 0), stateType);
+  for (int s = 1; s <= numSteps; s++)
+    for (int phase = 0; phase < stepCycles; phase++) {
+      int next = 0;
+      if (phase + 1 < stepCycles)
+        next = encode(s, phase + 1);
+      else if (s < numSteps)
+        next = encode(s + 1, 0);
+      if (next == 0)
+        continue;
+      HDLSignal *net = MakeConstant(next, stateType);
+      nextStates.at(encode(s, phase)) = net;
+      nextStates.at((1 << stateWidth) + encode(s, phase)) = net;
+    }
+  HDLSignal *next = design->CreateTempSignal(stateType, "next_state");
+  design->AddDevice(new MultiplexerHDLDevice(nextStates, index, next));
+  design->AddDevice(
+      new RegisterHDLDevice(next, clock, state, clock_enable, reset, false));
+
+  // Outputs are valid once the last step is complete, until the next load
+  done = design->CreateTempSignal(logicType, "done");
+  design->AddDevice(new RegisterHDLDevice(
+      MakeOperation(B_EQ,
+                    {state, MakeConstant(encode(numSteps, stepCycles - 1),
+                                         stateType)},
+                    logicType, "last"),
+      clock, done,
+      MakeOperation(B_BWOR, {stepEnables.back(), load}, logicType, "update"),
+      reset, false));
+
+  int interval = GetLatency();
+  PrintMessage(MSG_NOTE,
+               "shared " + to_string(numUnits) + " multipliers between " +
+                   to_string(operations.size()) + " multiplies over " +
+                   to_string(numSteps) + " steps of " +
+                   to_string(stepCycles) +
+                   " cycles, with an initiation interval of " +
+                   to_string(interval) + " cycles");
+  if (interval > target)
+    PrintMessage(MSG_WARNING,
+                 "initiation interval target of " + to_string(target) +
+                     " cycles not met due to " +
+                     ((stepCycles > 1) ? "the clock period and " : "") +
+                     "dependencies between multiplies");
+  return interval;
+}
+
+int HDLScheduler::GetLatency() { return numSteps * stepCycles + 1; }
+
+HDLSignal *HDLScheduler::AddReadyPort() {
+  HDLSignal *ready = new HDLSignal("input_ready", new LogicSignalPortType());
+  design->AddPortFromSig(ready, PortDirection::Output);
+  design->AddDevice(new BufferHDLDevice(idle, ready));
+  ready->pipeline_latency = idle->pipeline_latency;
+  return ready;
+}
+
+} // namespace HDLGen
+} // namespace ElasticC
@@ -0,0 +1,86 @@
+#pragma once
+#include "HDLCoreDevices.hpp"
+#include "HDLDesign.hpp"
+#include "HDLSignal.hpp"
+#include "timing/DeviceTiming.hpp"
+
+#include <map>
+#include <vector>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+/*
+Shares multipliers between the operations of a design that only needs to
+accept new inputs every few cycles, trading throughput for area.
+
+The multiplies are list scheduled into control steps, giving priority to those
+with the longest chain of multiplies after them, with no more in each step than
+there are shared multipliers. The number of multipliers is chosen so that the
+target initiation interval can be met if dependencies allow. Each shared
+multiplier has operand multiplexers selected by a state counter, and each
+product is registered at the end of its step for use by later steps and the
+outputs.
+
+Inputs are registered when a new iteration is started, which takes a cycle
+before the steps, and the outputs are valid from the cycle after the last step
+until the next iteration starts. An input_ready output shows when inputs are
+accepted. Designs with registers of their own (i.e. static variables) or
+memories are left unchanged, as are those with no multiplies to share.
+
+Products feed later steps through the same multipliers, so the logic of the
+steps forms loops that the pipeliner cannot retime. Instead it is registered
+here wherever it would take longer than the clock period, with each step then
+lasting as many cycles as it takes for values to pass through those registers.
+The rest of the design, including the control logic, is left to the pipeliner;
+the state counter is the only loop there, so it is kept to a single
+multiplexer.
+*/
+class HDLScheduler {
+public:
+  HDLScheduler(HDLDesign *_design, DeviceTiming *_model, HDLSignal *_clock,
+               HDLSignal *_clock_enable, HDLSignal *_reset,
+               HDLSignal *_input_valid, int _target);
+  // Run the pass, returning the initiation interval achieved in clock cycles,
+  // or zero if the design was left unchanged
+  int Run();
+  // Number of cycles from inputs being accepted to outputs being valid
+  int GetLatency();
+  // Add the input_ready output, returning its net. This is done once the design
+  // is pipelined, as ready must not be delayed to align with the other outputs
+  HDLSignal *AddReadyPort();
+  // High while the outputs hold the results of the last iteration
+  HDLSignal *done = nullptr;
+
+private:
+  HDLDesign *design;
+  DeviceTiming *model;
+  HDLSignal *clock, *clock_enable, *reset, *input_valid;
+  int target;
+
+  // Multiplies being shared, in topological order, along with the indices of
+  // the multiplies each depends on directly, and the step each is scheduled in
+  vector<OperationHDLDevice *> operations;
+  vector<vector<int>> predecessors;
+  vector<int> steps;
+  int numSteps = 0, numUnits = 0, stepCycles = 1;
+  // The registers holding each product
+  vector<RegisterHDLDevice *> results;
+
+  HDLSignal *state = nullptr, *step = nullptr, *idle = nullptr;
+
+  void FindOperations();
+  void Schedule();
+  void RegisterInputs(HDLSignal *load);
+  void BuildUnits(const vector<HDLSignal *> &stepEnables);
+  // Register the logic of the steps to meet the clock period, returning the
+  // most registers on any path through a step
+  int PipelineSteps();
+
+  // Helpers creating control logic
+  HDLSignal *MakeConstant(int value, HDLPortType *type);
+  HDLSignal *MakeOperation(OperationType oper, const vector<HDLSignal *> &inputs,
+                           HDLPortType *type, string prefix);
+};
+} // namespace HDLGen
+} // namespace ElasticC
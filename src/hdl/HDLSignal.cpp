@@ -1,4 +1,5 @@
 #include "HDLSignal.hpp"
+#include "HDLVerilog.hpp"
 #include <algorithm>
 #include <cmath>
 using namespace std;
@@ -18,22 +19,38 @@ HDLSignal::HDLSignal(string _name, HDLPortType *_type)
 void HDLSignal::ConnectToSignal(HDLSignal *other) {
   for_each(connectedPorts.begin(), connectedPorts.end(),
            [other](HDLDevicePort *p) { p->connectedNet = other; });
-  other->connectedPorts.insert(other->connectedPorts.end(),
-                               connectedPorts.begin(), connectedPorts.end());
-  connectedPorts.clear();
+  // splicing keeps the ports' list iterators valid
+  other->connectedPorts.splice(other->connectedPorts.end(), connectedPorts);
+  other->fanout += fanout;
+  fanout = 0;
 }
 
 void HDLSignal::ConnectToPort(HDLDevicePort *port) {
-  if (port->connectedNet != nullptr) {
-    remove(port->connectedNet->connectedPorts.begin(),
-           port->connectedNet->connectedPorts.end(), port);
-  }
+  if (port->connectedNet != nullptr)
+    port->connectedNet->DisconnectPort(port);
   port->connectedNet = this;
-  connectedPorts.push_back(port);
+  port->netEntry = connectedPorts.insert(connectedPorts.end(), port);
+  if (port->IsFanout())
+    fanout++;
+}
+
+void HDLSignal::DisconnectPort(HDLDevicePort *port) {
+  connectedPorts.erase(port->netEntry);
+  if (port->IsFanout())
+    fanout--;
+  port->connectedNet = nullptr;
 }
 
 void HDLSignal::GenerateVHDL(ostream &vhdl) {
   vhdl << "\tsignal " << name << " : " << sigType->GetVHDLType() << ";" << endl;
 }
+
+void HDLSignal::GenerateVerilog(ostream &verilog) {
+  verilog << "\t" << VerilogDecl("wire", sigType, name) << ";" << endl;
+}
+
+void HDLSignal::GenerateCpp(ostream &cpp) {
+  cpp << "\t" << sigType->GetCppType() << " " << name << "{};" << endl;
+}
 }
 }
@@ -1,9 +1,12 @@
 #pragma once
+#include "BitConstant.hpp"
+#include "HDLBatchValue.hpp"
 #include "HDLDevice.hpp"
 #include "HDLDevicePort.hpp"
 #include "HDLPortType.hpp"
 #include "HDLTiming.hpp"
 #include <iostream>
+#include <list>
 #include <string>
 #include <vector>
 using namespace std;
@@ -20,21 +23,32 @@ public:
   double GetFallingEdgePos();
 };
 
+class HDLDesign;
+
 class HDLSignal {
 public:
   HDLSignal(string _name, HDLPortType *_type);
   string name;
   HDLPortType *sigType;
-  vector<HDLDevicePort *> connectedPorts;
+  list<HDLDevicePort *> connectedPorts;
+  // Number of device inputs and top level outputs connected to the signal,
+  // kept up to date as ports are connected and disconnected
+  int fanout = 0;
   ClockInfo clockInfo; // clock type signals only
 
   // Connect another signal to this one, replacing all instances of this signal
   // with the passed one
   void ConnectToSignal(HDLSignal *other);
-  // Connect to a device port
+  // Connect to a device port, disconnecting it from any existing signal
   void ConnectToPort(HDLDevicePort *port);
+  // Disconnect a device port from this signal
+  void DisconnectPort(HDLDevicePort *port);
   // Generate a VHDL signal definition
   void GenerateVHDL(ostream &vhdl);
+  // Generate a Verilog wire declaration
+  void GenerateVerilog(ostream &verilog);
+  // Generate a member of a C++ model holding the signal's value
+  void GenerateCpp(ostream &cpp);
 
   // Timing and latency data
   HDLSignal *clockDomain = nullptr;
@@ -44,6 +58,16 @@ public:
   HDLTimingValue<int> pipeline_latency;
   // Force no pipelining to occur to this signal
   bool dont_pipeline = false;
+
+  // Value during simulation, with the width and signedness of the signal type
+  BitConstant sim_value;
+  // Values in every lane during batch simulation
+  BatchValue batch_value;
+
+  // The design containing the signal, and its position in the design's signal
+  // list so that it can be removed in constant time
+  HDLDesign *design = nullptr;
+  list<HDLSignal *>::iterator designEntry;
 };
 
 struct HDLBitSlice {
@@ -0,0 +1,134 @@
+#include "HDLSimulator.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+
+HDLSimulator::HDLSimulator(HDLDesign *_design, HDLSignal *_clock)
+    : design(_design), clock(_clock) {
+  for (auto sig : design->signals)
+    sig->sim_value = BitConstant().cast(sig->sigType->GetWidth(),
+                                        sig->sigType->IsSigned());
+  LevelizeHDLDesign(design, sequential, combinational);
+  for (auto dev : sequential)
+    dev->Simulate();
+  Settle();
+}
+
+void HDLSimulator::Settle() {
+  for (auto dev : combinational)
+    dev->Simulate();
+}
+
+void HDLSimulator::SetInput(HDLDevicePort *port, const BitConstant &value) {
+  port->connectedNet->sim_value = SimCast(value, port->connectedNet->sigType);
+}
+
+void HDLSimulator::Step() {
+  Settle();
+  if (clock == nullptr)
+    return;
+  for (auto dev : sequential)
+    dev->SimulateClock();
+  for (auto dev : sequential)
+    dev->Simulate();
+  Settle();
+}
+
+const BitConstant &HDLSimulator::GetValue(HDLDevicePort *port) {
+  return port->connectedNet->sim_value;
+}
+
+void SetSimValue(HDLDevicePort *port, const BitConstant &value) {
+  port->connectedNet->sim_value = SimCast(value, port->connectedNet->sigType);
+}
+
+int GetSimIndex(HDLDevicePort *port) {
+  // Read as unsigned, so that the limbs are not sign extended
+  BitConstant value = port->connectedNet->sim_value;
+  value.is_signed = false;
+  for (int i = 1; i < value.limb_count(); i++)
+    if (value.get_limb(i) != 0)
+      return -1;
+  uint64_t index = value.get_limb(0);
+  return (index > uint64_t(numeric_limits<int>::max())) ? -1 : int(index);
+}
+
+BitConstant GetSimSlice(const BitConstant &value, int low, int width,
+                        bool is_signed) {
+  BitConstant slice;
+  slice.is_signed = is_signed;
+  slice.resize(width);
+  int limbShift = low / 64, bitShift = low % 64;
+  for (int i = 0; i < slice.limb_count(); i++) {
+    uint64_t limb = value.get_limb(i + limbShift) >> bitShift;
+    if (bitShift != 0)
+      limb |= value.get_limb(i + limbShift + 1) << (64 - bitShift);
+    slice.set_limb(i, limb);
+  }
+  return slice;
+}
+
+void SetSimSlice(BitConstant &value, int low, const BitConstant &bits) {
+  for (int i = 0; i < bits.width(); i++)
+    value.set_bit(low + i, bits.get_bit(i));
+}
+
+static bool IsSequential(HDLDevice *dev) {
+  for (auto p : dev->GetPorts())
+    if ((p->dir == PortDirection::Input) && (p->connectedNet != nullptr) &&
+        (dynamic_cast<ClockSignalPortType *>(p->connectedNet->sigType) !=
+         nullptr))
+      return true;
+  return false;
+}
+
+void LevelizeHDLDesign(HDLDesign *design, vector<HDLDevice *> &sequential,
+                       vector<HDLDevice *> &combinational) {
+  // Kahn's algorithm over the combinational devices only, counting for each
+  // the inputs driven by combinational devices not yet placed
+  unordered_map<HDLDevice *, int> pending;
+  for (auto dev : design->devices) {
+    if (IsSequential(dev)) {
+      sequential.push_back(dev);
+      continue;
+    }
+    int count = 0;
+    for (auto p : dev->GetPorts()) {
+      if ((p->connectedNet == nullptr) || (p->dir != PortDirection::Input))
+        continue;
+      for (auto np : p->connectedNet->connectedPorts)
+        if ((np->device != nullptr) && (np->dir == PortDirection::Output) &&
+            !IsSequential(np->device))
+          count++;
+    }
+    pending[dev] = count;
+    if (count == 0)
+      combinational.push_back(dev);
+  }
+  for (size_t i = 0; i < combinational.size(); i++) {
+    for (auto p : combinational.at(i)->GetPorts()) {
+      if ((p->connectedNet == nullptr) || (p->dir != PortDirection::Output))
+        continue;
+      for (auto np : p->connectedNet->connectedPorts) {
+        if ((np->device == nullptr) || (np->dir != PortDirection::Input))
+          continue;
+        auto pend = pending.find(np->device);
+        if ((pend != pending.end()) && (--(pend->second) == 0))
+          combinational.push_back(np->device);
+      }
+    }
+  }
+  if (combinational.size() != pending.size())
+    PrintMessage(MSG_ERROR, "design ===" + design->name +
+                                "=== contains combinational loops so cannot "
+                                "be simulated");
+}
+
+} // namespace HDLGen
+} // namespace ElasticC
@@ -0,0 +1,79 @@
+#pragma once
+#include "BitConstant.hpp"
+#include "HDLDesign.hpp"
+#include "HDLDevice.hpp"
+#include "HDLDevicePort.hpp"
+#include "HDLSignal.hpp"
+
+#include <vector>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+/*
+A cycle accurate simulator, which runs a design's netlist directly rather than
+going through the generated VHDL. Each net holds its value as a BitConstant,
+packed into 64-bit words, and each device computes the same values as its VHDL
+would.
+
+The combinational devices are levelized once, so that each is evaluated after
+the drivers of its inputs, with sequential devices (those with a clock input)
+starting new paths. A step settles the combinational logic from the inputs,
+then applies a rising edge to all the sequential devices at once and settles
+the logic again, matching the testbench used by the test framework.
+*/
+class HDLSimulator {
+public:
+  // Prepare to simulate a design, with all inputs zero and registers holding
+  // their initial values. The clock is nullptr for a purely combinational
+  // design
+  HDLSimulator(HDLDesign *_design, HDLSignal *_clock);
+  // Set the value of a top level input port
+  void SetInput(HDLDevicePort *port, const BitConstant &value);
+  // Run one clock cycle, or just update the outputs if there is no clock
+  void Step();
+  // Update the outputs from the inputs without a clock edge, so that they can
+  // be read before the next one
+  void Settle();
+  // Get the current value of a top level port
+  const BitConstant &GetValue(HDLDevicePort *port);
+
+private:
+  HDLDesign *design;
+  HDLSignal *clock;
+  vector<HDLDevice *> sequential, combinational;
+};
+
+// Split a design's devices into sequential devices, and combinational devices
+// in an order where each comes after the drivers of its inputs, raising an
+// error if there are combinational loops
+void LevelizeHDLDesign(HDLDesign *design, vector<HDLDevice *> &sequential,
+                       vector<HDLDevice *> &combinational);
+
+// Convert a value to a type, as VHDLCastFrom does from the type the value has.
+// The value's signedness decides whether it is sign extended
+inline BitConstant SimCast(const BitConstant &value, const HDLPortType *type) {
+  return value.cast(type->GetWidth(), type->IsSigned());
+}
+
+// Set the net connected to a device output to a value, converted to the net's
+// type
+void SetSimValue(HDLDevicePort *port, const BitConstant &value);
+
+// Return true if a single bit value, such as an enable, is '1'
+inline bool IsSimHigh(HDLDevicePort *port) {
+  return !port->connectedNet->sim_value.is_zero();
+}
+
+// Return the value of a net as an unsigned index, as to_integer(unsigned(...))
+// does, or -1 if it is too large for an int
+int GetSimIndex(HDLDevicePort *port);
+
+// Return width bits of a value starting at bit low, with a given signedness
+BitConstant GetSimSlice(const BitConstant &value, int low, int width,
+                        bool is_signed);
+// Set bits of a value starting at bit low to the bits of another value
+void SetSimSlice(BitConstant &value, int low, const BitConstant &bits);
+
+} // namespace HDLGen
+} // namespace ElasticC
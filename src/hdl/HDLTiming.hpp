@@ -64,6 +64,19 @@ inline bool operator>(const HDLTimingValue<T> &a, const HDLTimingValue<T> &b) {
   }
 };
 
+// Return the later of two timing values. Don't care values are ignored, and if
+// the domains are mismatched the first value is kept
+template <typename T>
+inline HDLTimingValue<T> TimingMax(const HDLTimingValue<T> &a,
+                                   const HDLTimingValue<T> &b) {
+  if (a.domain == nullptr)
+    return b;
+  else if (b > a)
+    return b;
+  else
+    return a;
+}
+
 template <typename T>
 inline HDLTimingValue<T> operator+(const HDLTimingValue<T> &a, T b) {
   if (a.domain == nullptr)
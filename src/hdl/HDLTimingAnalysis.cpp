@@ -0,0 +1,325 @@
+#include "HDLTimingAnalysis.hpp"
+#include "HDLDevicePort.hpp"
+#include "HDLPortType.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <set>
+#include <sstream>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+
+HDLTimingAnalyser::HDLTimingAnalyser(HDLDesign *_design, DeviceTiming *_model,
+                                     HDLSignal *_clock)
+    : design(_design), model(_model), clock(_clock) {
+  is_clocked = (clock != design->gnd);
+}
+
+bool HDLTimingAnalyser::IsSequential(HDLDevice *dev) {
+  for (auto p : dev->GetPorts())
+    if ((p->dir == PortDirection::Input) && (p->connectedNet != nullptr) &&
+        (dynamic_cast<ClockSignalPortType *>(p->connectedNet->sigType) !=
+         nullptr))
+      return true;
+  return false;
+}
+
+void HDLTimingAnalyser::PropagateArrivals() {
+  for (auto sig : design->signals)
+    sig->timing_delay = HDLTimingValue<double>();
+  // Inputs of clocked designs are assumed to come straight from registers
+  for (auto port : design->ports) {
+    if ((port->dir != PortDirection::Input) || (port->connectedNet == clock))
+      continue;
+    port->connectedNet->timing_delay = HDLTimingValue<double>(
+        clock, is_clocked ? model->GetFFPropogationDelay() : 0);
+  }
+
+  for (auto dev : design->GetTopologicalOrder()) {
+    dev->AnnotateTiming(model);
+    HDLSignal *latest = nullptr;
+    if (!IsSequential(dev)) {
+      for (auto p : dev->GetPorts()) {
+        if ((p->dir != PortDirection::Input) || (p->connectedNet == nullptr) ||
+            (p->connectedNet->timing_delay.domain != clock))
+          continue;
+        if ((latest == nullptr) || (p->connectedNet->timing_delay.value >
+                                    latest->timing_delay.value))
+          latest = p->connectedNet;
+      }
+    }
+    for (auto p : dev->GetPorts()) {
+      if ((p->dir != PortDirection::Output) || (p->connectedNet == nullptr))
+        continue;
+      driver[p->connectedNet] = dev;
+      if (latest != nullptr)
+        criticalInput[p->connectedNet] = latest;
+    }
+  }
+}
+
+TimingPath HDLTimingAnalyser::TracePath(string endpoint, HDLSignal *net) {
+  TimingPath path;
+  path.endpoint = endpoint;
+  path.arrival = net->timing_delay.value;
+  path.slack = 0;
+  HDLSignal *cur = net;
+  // The step limit guards against combinational loops
+  for (size_t i = 0; (cur != nullptr) && (i <= design->devices.size()); i++) {
+    auto drv = driver.find(cur);
+    auto inp = criticalInput.find(cur);
+    HDLDevice *dev = (drv == driver.end()) ? nullptr : drv->second;
+    HDLSignal *prev = (inp == criticalInput.end()) ? nullptr : inp->second;
+    double delay = cur->timing_delay.value -
+                   ((prev == nullptr) ? 0 : prev->timing_delay.value);
+    // Wiring such as buffers adds nothing useful to the report
+    if ((prev == nullptr) || (delay != 0))
+      path.steps.push_back(
+          TimingPathStep{dev, cur, delay, cur->timing_delay.value});
+    cur = prev;
+  }
+  reverse(path.steps.begin(), path.steps.end());
+  return path;
+}
+
+void HDLTimingAnalyser::FindLatencies() {
+  // Only follow data inputs, not the clock, enable and reset of registers
+  auto isControl = [](HDLDevicePort *p) {
+    return (p->name == "clk") || (p->name == "en") || (p->name == "rst");
+  };
+  for (auto inPort : design->ports) {
+    if ((inPort->dir != PortDirection::Input) ||
+        (inPort->connectedNet == clock))
+      continue;
+    set<HDLSignal *> reached{inPort->connectedNet};
+    vector<HDLSignal *> worklist{inPort->connectedNet};
+    while (!worklist.empty()) {
+      HDLSignal *net = worklist.back();
+      worklist.pop_back();
+      for (auto p : net->connectedPorts) {
+        if ((p->device == nullptr) || (p->dir != PortDirection::Input) ||
+            isControl(p))
+          continue;
+        for (auto dp : p->device->GetPorts())
+          if ((dp->dir == PortDirection::Output) &&
+              (dp->connectedNet != nullptr) &&
+              reached.insert(dp->connectedNet).second)
+            worklist.push_back(dp->connectedNet);
+      }
+    }
+    for (auto outPort : design->ports) {
+      if ((outPort->dir != PortDirection::Output) ||
+          (reached.find(outPort->connectedNet) == reached.end()))
+        continue;
+      int cycles = 0;
+      if (is_clocked) {
+        const HDLTimingValue<int> &lat = outPort->connectedNet->pipeline_latency;
+        cycles = (lat.domain == clock) ? lat.value : -1;
+      }
+      latencies.push_back(IOLatency{inPort->name, outPort->name, cycles});
+    }
+  }
+}
+
+void HDLTimingAnalyser::Run() {
+  PropagateArrivals();
+
+  ClockDomainTiming domain;
+  domain.clock = is_clocked ? clock : nullptr;
+  domain.period = is_clocked ? (1.0 / clock->clockInfo.frequency) : 0;
+  domain.worstSlack = numeric_limits<double>::infinity();
+  domain.maxArrival = 0;
+  double required = domain.period - model->GetFFSetupTime();
+
+  auto addPath = [&](TimingPath path) {
+    if (is_clocked) {
+      path.slack = required - path.arrival;
+      domain.worstSlack = min(domain.worstSlack, path.slack);
+      if (path.slack < 0)
+        domain.failingEndpoints++;
+    }
+    domain.maxArrival = max(domain.maxArrival, path.arrival);
+    domain.endpoints++;
+    paths.push_back(path);
+  };
+  auto addEndpoint = [&](string name, HDLSignal *net) {
+    if (net->timing_delay.domain == clock)
+      addPath(TracePath(name, net));
+  };
+  for (auto dev : design->devices) {
+    if (!IsSequential(dev))
+      continue;
+    for (auto p : dev->GetPorts())
+      if ((p->dir == PortDirection::Input) && (p->connectedNet != nullptr) &&
+          (p->connectedNet != clock))
+        addEndpoint(dev->GetInstanceName() + "." + p->name, p->connectedNet);
+    // Registers inside the device are endpoints too, reached in a single step
+    if (is_clocked)
+      for (const auto &internal : dev->GetInternalDelays(model))
+        addPath(TimingPath{
+            dev->GetInstanceName() + "." + internal.first, internal.second, 0,
+            {TimingPathStep{dev, nullptr, internal.second, internal.second}}});
+  }
+  for (auto port : design->ports)
+    if (port->dir == PortDirection::Output)
+      addEndpoint(port->name, port->connectedNet);
+
+  if (domain.endpoints == 0)
+    domain.worstSlack = required;
+  domain.fmax = 1.0 / (domain.maxArrival + model->GetFFSetupTime());
+  domains.push_back(domain);
+
+  stable_sort(paths.begin(), paths.end(),
+              [](const TimingPath &a, const TimingPath &b) {
+                return a.arrival > b.arrival;
+              });
+  FindLatencies();
+}
+
+void HDLTimingAnalyser::PrintReport(int numPaths) {
+  ostringstream ss;
+  ss << fixed << setprecision(3);
+  for (auto &domain : domains) {
+    ss.str("");
+    if (domain.clock != nullptr) {
+      ss << "clock ===" << domain.clock->name << "=== at "
+         << (1e-6 / domain.period) << "MHz: worst slack "
+         << (domain.worstSlack * 1e9) << "ns, estimated Fmax "
+         << (domain.fmax * 1e-6) << "MHz, " << domain.failingEndpoints
+         << " of " << domain.endpoints << " endpoints failing";
+      PrintMessage((domain.failingEndpoints > 0) ? MSG_WARNING : MSG_NOTE,
+                   ss.str());
+    } else {
+      ss << "combinational design with a maximum delay of "
+         << (domain.maxArrival * 1e9) << "ns";
+      PrintMessage(MSG_NOTE, ss.str());
+    }
+  }
+
+  for (int i = 0; (i < numPaths) && (i < int(paths.size())); i++) {
+    const TimingPath &path = paths.at(i);
+    ss.str("");
+    ss << "critical path " << (i + 1) << " to ===" << path.endpoint
+       << "===, arrival " << (path.arrival * 1e9) << "ns";
+    if (is_clocked)
+      ss << ", slack " << (path.slack * 1e9) << "ns";
+    for (auto &step : path.steps) {
+      ss << endl << "  ";
+      if (step.device == nullptr)
+        ss << "input ";
+      else
+        ss << step.device->GetInstanceName() << " ";
+      ss << ((step.net != nullptr) ? step.net->name : "(internal)") << " +"
+         << (step.delay * 1e9) << "ns = "
+         << (step.arrival * 1e9) << "ns";
+      if ((step.device != nullptr) && (step.device->sourceLine != -1))
+        ss << " (line " << step.device->sourceLine << ")";
+    }
+    PrintMessage(MSG_NOTE, ss.str());
+  }
+
+  if (is_clocked && !latencies.empty()) {
+    ss.str("");
+    ss << "latencies:";
+    for (auto &lat : latencies) {
+      ss << endl << "  " << lat.input << " -> " << lat.output << ": ";
+      if (lat.cycles == -1)
+        ss << "unknown";
+      else
+        ss << lat.cycles << " cycles";
+    }
+    PrintMessage(MSG_NOTE, ss.str());
+  }
+}
+
+// Quote and escape a string for JSON output
+static string JSONString(const string &str) {
+  string result = "\"";
+  for (char c : str) {
+    if ((c == '"') || (c == '\\'))
+      result += '\\';
+    result += c;
+  }
+  return result + "\"";
+}
+
+void HDLTimingAnalyser::WriteJSON(ostream &out, int numPaths) {
+  out << setprecision(6);
+  out << "{" << endl;
+  out << "  \"design\": " << JSONString(design->name) << "," << endl;
+  out << "  \"clock_domains\": [" << endl;
+  for (size_t i = 0; i < domains.size(); i++) {
+    const ClockDomainTiming &domain = domains.at(i);
+    out << "    {";
+    if (domain.clock != nullptr) {
+      out << "\"clock\": " << JSONString(domain.clock->name) << ", ";
+      out << "\"period_ns\": " << (domain.period * 1e9) << ", ";
+      out << "\"worst_slack_ns\": " << (domain.worstSlack * 1e9) << ", ";
+      out << "\"failing_endpoints\": " << domain.failingEndpoints << ", ";
+    } else {
+      out << "\"clock\": null, ";
+    }
+    out << "\"endpoints\": " << domain.endpoints << ", ";
+    out << "\"max_delay_ns\": " << (domain.maxArrival * 1e9) << ", ";
+    out << "\"fmax_mhz\": " << (domain.fmax * 1e-6) << "}";
+    out << ((i + 1 < domains.size()) ? "," : "") << endl;
+  }
+  out << "  ]," << endl;
+
+  out << "  \"critical_paths\": [" << endl;
+  int n = min(numPaths, int(paths.size()));
+  for (int i = 0; i < n; i++) {
+    const TimingPath &path = paths.at(i);
+    out << "    {\"endpoint\": " << JSONString(path.endpoint) << ", ";
+    out << "\"arrival_ns\": " << (path.arrival * 1e9) << ", ";
+    if (is_clocked)
+      out << "\"slack_ns\": " << (path.slack * 1e9) << ", ";
+    out << "\"steps\": [" << endl;
+    for (size_t j = 0; j < path.steps.size(); j++) {
+      const TimingPathStep &step = path.steps.at(j);
+      out << "      {\"device\": ";
+      if (step.device == nullptr)
+        out << "null";
+      else
+        out << JSONString(step.device->GetInstanceName());
+      out << ", \"net\": ";
+      if (step.net == nullptr)
+        out << "null";
+      else
+        out << JSONString(step.net->name);
+      out << ", ";
+      out << "\"line\": ";
+      if ((step.device == nullptr) || (step.device->sourceLine == -1))
+        out << "null";
+      else
+        out << step.device->sourceLine;
+      out << ", \"delay_ns\": " << (step.delay * 1e9) << ", ";
+      out << "\"arrival_ns\": " << (step.arrival * 1e9) << "}";
+      out << ((j + 1 < path.steps.size()) ? "," : "") << endl;
+    }
+    out << "    ]}" << ((i + 1 < n) ? "," : "") << endl;
+  }
+  out << "  ]," << endl;
+
+  out << "  \"latencies\": [" << endl;
+  for (size_t i = 0; i < latencies.size(); i++) {
+    const IOLatency &lat = latencies.at(i);
+    out << "    {\"input\": " << JSONString(lat.input) << ", ";
+    out << "\"output\": " << JSONString(lat.output) << ", ";
+    out << "\"cycles\": ";
+    if (lat.cycles == -1)
+      out << "null";
+    else
+      out << lat.cycles;
+    out << "}" << ((i + 1 < latencies.size()) ? "," : "") << endl;
+  }
+  out << "  ]" << endl;
+  out << "}" << endl;
+}
+
+} // namespace HDLGen
+} // namespace ElasticC
@@ -0,0 +1,82 @@
+#pragma once
+#include "HDLDesign.hpp"
+#include "HDLDevice.hpp"
+#include "HDLSignal.hpp"
+#include "timing/DeviceTiming.hpp"
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+// One device along a timing path
+struct TimingPathStep {
+  HDLDevice *device; // nullptr for a top level input
+  HDLSignal *net;    // net driven by the device, or nullptr inside it
+  double delay;      // delay added by the device in seconds
+  double arrival;    // arrival time at the net in seconds
+};
+
+// A path from a startpoint (top level input or register) to an endpoint
+// (register input or top level output), or between registers inside a device
+struct TimingPath {
+  string endpoint;
+  double arrival, slack; // slack is only meaningful for clocked designs
+  vector<TimingPathStep> steps;
+};
+
+// Summary of a single clock domain. Combinational designs are reported as a
+// domain with no clock
+struct ClockDomainTiming {
+  HDLSignal *clock; // nullptr for combinational designs
+  double period, worstSlack, maxArrival, fmax;
+  int endpoints = 0, failingEndpoints = 0;
+};
+
+// Latency from a top level input to a top level output
+struct IOLatency {
+  string input, output;
+  int cycles; // -1 if unknown, e.g. if the path is through a static variable
+};
+
+/*
+Static timing analysis of a HDLDesign, run after pipelining. Arrival times are
+propagated in topological order using each device's AnnotateTiming, recording
+the latest input to each device so that critical paths can be traced back from
+their endpoints.
+*/
+class HDLTimingAnalyser {
+public:
+  HDLTimingAnalyser(HDLDesign *_design, DeviceTiming *_model,
+                    HDLSignal *_clock);
+  void Run();
+
+  vector<ClockDomainTiming> domains;
+  // Paths to each endpoint, worst first
+  vector<TimingPath> paths;
+  vector<IOLatency> latencies;
+
+  // Print a report to the console, including the given number of paths
+  void PrintReport(int numPaths);
+  // Write the report as JSON, including the given number of paths
+  void WriteJSON(ostream &out, int numPaths);
+
+private:
+  HDLDesign *design;
+  DeviceTiming *model;
+  HDLSignal *clock;
+  bool is_clocked;
+  // The input of the device driving a net that arrives latest
+  map<HDLSignal *, HDLSignal *> criticalInput;
+  map<HDLSignal *, HDLDevice *> driver;
+
+  void PropagateArrivals();
+  TimingPath TracePath(string endpoint, HDLSignal *net);
+  void FindLatencies();
+  bool IsSequential(HDLDevice *dev);
+};
+} // namespace HDLGen
+} // namespace ElasticC
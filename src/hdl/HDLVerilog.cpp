@@ -0,0 +1,31 @@
+#include "HDLVerilog.hpp"
+
+#include <iomanip>
+#include <sstream>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+
+string VerilogDecl(const string &kind, const HDLPortType *type,
+                   const string &name) {
+  string range = type->GetVerilogType();
+  return kind + " " + (range.empty() ? "" : (range + " ")) + name;
+}
+
+string GetVerilogConstant(const BitConstant &value, const HDLPortType *type) {
+  int width = type->GetWidth();
+  BitConstant v = value.cast(width, type->IsSigned());
+  ostringstream hex;
+  hex << width << (type->IsSigned() ? "'sh" : "'h") << std::hex;
+  for (int i = v.limb_count() - 1; i >= 0; i--) {
+    if (i == v.limb_count() - 1)
+      hex << v.get_limb(i);
+    else
+      hex << setw(16) << setfill('0') << v.get_limb(i);
+  }
+  return hex.str();
+}
+
+} // namespace HDLGen
+} // namespace ElasticC
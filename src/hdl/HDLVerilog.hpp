@@ -0,0 +1,26 @@
+#pragma once
+#include "BitConstant.hpp"
+#include "HDLPortType.hpp"
+
+#include <string>
+using namespace std;
+
+namespace ElasticC {
+namespace HDLGen {
+/*
+Helpers for generating Verilog. Every net in the netlist is a Verilog wire,
+declared with the width and signedness of its type. Devices with state hold
+it in regs of their own, which drive their outputs through continuous
+assignments, in the same way as the DSP device's VHDL.
+*/
+
+// Return a declaration of a net or variable of a given kind (e.g. wire or reg)
+// and type, without the terminating semicolon
+string VerilogDecl(const string &kind, const HDLPortType *type,
+                   const string &name);
+
+// Return a Verilog literal for a constant, converted to a type
+string GetVerilogConstant(const BitConstant &value, const HDLPortType *type);
+
+} // namespace HDLGen
+} // namespace ElasticC
@@ -1,13 +1,225 @@
 #include "DeviceTiming.hpp"
+#include "Util.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
 
 namespace ElasticC {
 
-// Default delay values for testing
-double DeviceTiming::GetFFSetupTime() { return 0.1e-9; }
-double DeviceTiming::GetFFPropogationDelay() { return 1e-9; }
+DeviceTiming::DeviceTiming() {}
+
+DeviceTiming *DeviceTiming::Load(string device) {
+  string file = device;
+  ifstream test(file);
+  if (!test)
+    file = FindFile("timing/" + device + ".timing",
+                    EnvironmentVars::ecc_incdir);
+  ifstream ifs(file);
+  if ((file == "") || !ifs)
+    PrintMessage(MSG_ERROR, "failed to find timing library for device ===" +
+                                device + "===");
+
+  DeviceTiming *dt = new DeviceTiming();
+  dt->is_flat = false;
+  dt->name = device;
+  // Delays are given in ns in the library file, sizes are integers
+  map<string, double *> delays{{"ff_setup", &dt->ff_setup},
+                               {"ff_clk_to_q", &dt->ff_clk_to_q},
+                               {"lut_delay", &dt->lut_delay},
+                               {"carry_entry", &dt->carry_entry},
+                               {"carry_per_bit", &dt->carry_per_bit},
+                               {"dsp_preadd_delay", &dt->dsp_preadd_delay},
+                               {"dsp_mult_delay", &dt->dsp_mult_delay},
+                               {"dsp_post_delay", &dt->dsp_post_delay},
+                               {"route_delay", &dt->route_delay},
+                               {"route_per_fanout", &dt->route_per_fanout}};
+  map<string, int *> sizes{{"lut_inputs", &dt->lut_inputs},
+                           {"dsp_width_a", &dt->dsp_width_a},
+                           {"dsp_width_b", &dt->dsp_width_b},
+                           {"dsp_area", &dt->dsp_area}};
+
+  string line;
+  int lineNo = 0;
+  while (getline(ifs, line)) {
+    lineNo++;
+    line = line.substr(0, line.find('#'));
+    if (line.find_first_not_of(" \t\r") == string::npos)
+      continue;
+    istringstream ls(line);
+    string key, eq;
+    double value;
+    if (!(ls >> key >> eq >> value) || (eq != "=")) {
+      PrintMessage(MSG_ERROR, "malformed line in timing library ===" + file +
+                                  "===: " + line,
+                   lineNo);
+    }
+    if (key == "name") {
+      continue;
+    } else if (delays.find(key) != delays.end()) {
+      *(delays.at(key)) = value * 1e-9;
+    } else if (sizes.find(key) != sizes.end()) {
+      *(sizes.at(key)) = int(value);
+    } else {
+      PrintMessage(MSG_WARNING, "unknown parameter ===" + key +
+                                    "=== in timing library ===" + file + "===",
+                   lineNo);
+    }
+  }
+  if (dt->lut_inputs < 2)
+    PrintMessage(MSG_ERROR, "timing library ===" + file +
+                                "=== must have at least 2 LUT inputs");
+  PrintMessage(MSG_DEBUG, "loaded timing library " + file);
+  return dt;
+}
+
+double DeviceTiming::GetFFSetupTime() { return ff_setup; }
+double DeviceTiming::GetFFPropogationDelay() { return ff_clk_to_q; }
+
+int DeviceTiming::GetLUTLevels(int inputs) {
+  int levels = 1;
+  while (inputs > lut_inputs) {
+    inputs = (inputs + lut_inputs - 1) / lut_inputs;
+    levels++;
+  }
+  return levels;
+}
+
+int DeviceTiming::GetLUTMuxSize() {
+  // A N:1 mux needs N data inputs and log2(N) select inputs
+  int size = 2;
+  while ((2 * size + int(log2(2 * size))) <= lut_inputs)
+    size *= 2;
+  return size;
+}
+
+double DeviceTiming::GetCarryChainDelay(int width) {
+  return lut_delay + carry_entry + carry_per_bit * width;
+}
+
+int DeviceTiming::GetDSPTiles(int width_a, int width_b) {
+  auto tiles = [](int a, int b, int da, int db) {
+    return ((a + da - 1) / da) * ((b + db - 1) / db);
+  };
+  return min(tiles(width_a, width_b, dsp_width_a, dsp_width_b),
+             tiles(width_b, width_a, dsp_width_a, dsp_width_b));
+}
+
+double DeviceTiming::GetMultiplierDelay(int width_a, int width_b) {
+  if ((width_a <= 1) || (width_b <= 1))
+    return lut_delay;
+  if ((dsp_width_a > 0) && (dsp_width_b > 0)) {
+    // Wide multiplies are split over several DSPs, used without their
+    // registers, with an adder tree to sum the partial products
+    int n = GetDSPTiles(width_a, width_b);
+    return dsp_mult_delay + dsp_post_delay +
+           ceil(log2(n)) * GetCarryChainDelay(width_a + width_b);
+  } else {
+    // Partial products are formed in LUTs then summed using an adder tree
+    return lut_delay + ceil(log2(min(width_a, width_b))) *
+                           GetCarryChainDelay(width_a + width_b);
+  }
+}
+
 double DeviceTiming::GetOperationDelay(OperationType ot,
                                        vector<int> operandWidths) {
-  return 1e-9;
+  if (is_flat)
+    return 1e-9;
+  int width = 0, total = 0;
+  for (auto w : operandWidths) {
+    width = max(width, w);
+    total += w;
+  }
+  switch (ot) {
+  case B_ADD:
+  case B_SUB:
+  case U_MINUS:
+  case B_GT:
+  case B_GTE:
+  case B_LT:
+  case B_LTE:
+    return GetCarryChainDelay(width + 1);
+  case B_MUL:
+    return GetMultiplierDelay(operandWidths.at(0), operandWidths.at(1));
+  case B_DIV:
+  case B_MOD:
+    // One subtract per quotient bit
+    return operandWidths.at(0) * GetCarryChainDelay(operandWidths.at(1) + 1);
+  case B_EQ:
+  case B_NEQ:
+    return GetLUTLevels(2 * width) * lut_delay;
+  case B_LOR:
+  case B_LAND:
+  case U_LNOT:
+    return GetLUTLevels(total) * lut_delay;
+  case B_LS:
+  case B_RS: {
+    // A barrel shifter, with one 2:1 mux stage per bit of the shift amount
+    int stages = min(operandWidths.at(1), int(ceil(log2(max(width, 2)))));
+    int perLUT = int(log2(GetLUTMuxSize()));
+    return max(1, (stages + perLUT - 1) / perLUT) * lut_delay;
+  }
+  default:
+    return lut_delay;
+  }
+}
+
+double DeviceTiming::GetMultiplexerDelay(int numInputs) {
+  if (is_flat)
+    return 1e-9;
+  int levels = 1, size = GetLUTMuxSize();
+  for (int n = size; n < numInputs; n *= size)
+    levels++;
+  return levels * lut_delay;
+}
+
+double DeviceTiming::GetCompressorTreeDelay(int numInputs, int width) {
+  if (is_flat)
+    return 1e-9;
+  // Each 3:2 level is a single LUT, but needs routing to the next level
+  int levels = 0;
+  for (int n = numInputs; n > 2; n = 2 * (n / 3) + (n % 3))
+    levels++;
+  return levels * (lut_delay + route_delay) + GetCarryChainDelay(width);
+}
+
+double DeviceTiming::GetRoutingDelay(int fanout) {
+  return route_delay + route_per_fanout * log2(max(fanout, 1));
+}
+
+double DeviceTiming::GetAdderArea(int width) {
+  // One LUT per bit, feeding the carry chain
+  return width;
+}
+
+double DeviceTiming::GetMultiplierArea(int width_a, int width_b) {
+  if ((width_a <= 1) || (width_b <= 1))
+    return max(width_a, width_b);
+  if ((dsp_width_a > 0) && (dsp_width_b > 0))
+    return GetDSPTiles(width_a, width_b) * dsp_area;
+  // One LUT per partial product bit, with the adder tree summing them
+  return width_a * width_b;
+}
+
+bool DeviceTiming::HasDSPs() { return (dsp_width_a > 0) && (dsp_width_b > 0); }
+
+double DeviceTiming::GetDSPStageDelay(DSPStage stage) {
+  if (is_flat)
+    return 1e-9;
+  switch (stage) {
+  case DSPStage::PreAdder:
+    return dsp_preadd_delay;
+  case DSPStage::Multiplier:
+    return dsp_mult_delay;
+  default:
+    return dsp_post_delay;
+  }
+}
+
+bool DeviceTiming::UseDSPForMultiply(int width_a, int width_b) {
+  return HasDSPs() && (GetDSPTiles(width_a, width_b) == 1) &&
+         (width_a * width_b >= dsp_area);
 }
 
 }; // namespace ElasticC
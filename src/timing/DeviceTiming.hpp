@@ -1,11 +1,80 @@
 #pragma once
 #include "Operations.hpp"
+#include <string>
+#include <vector>
+using namespace std;
 // Provides a generic interface for devices to calculate timings
 namespace ElasticC {
+/*
+Timing model of a target FPGA. The default model gives a flat delay for every
+operation, and is mainly useful for testing. Timing libraries for real device
+families and speed grades are loaded from text files, which model LUT delays,
+carry chains, DSP blocks and routing.
+
+All values returned are in seconds.
+*/
 class DeviceTiming {
 public:
+  // Create the default flat model
+  DeviceTiming();
+  // Load a timing library, given either a path to a library file or the name
+  // of one in the timing directory of the standard library (e.g. xc7-1)
+  static DeviceTiming *Load(string device);
+
+  string name = "default";
+
   double GetFFSetupTime();
   double GetFFPropogationDelay();
+  // Delay of an operation, excluding routing delay at its output
   double GetOperationDelay(OperationType ot, vector<int> operandWidths);
+  // Delay of a multiplexer, which is the same for any width as each bit has its
+  // own LUTs
+  double GetMultiplexerDelay(int numInputs);
+  // Delay of a carry-save compressor tree summing the given number of inputs,
+  // including the final carry chain adder
+  double GetCompressorTreeDelay(int numInputs, int width);
+  // Routing delay of a net driving the given number of inputs
+  double GetRoutingDelay(int fanout);
+
+  // Area of an adder or subtractor
+  double GetAdderArea(int width);
+  // Area of a multiplier, with each DSP block used counted as dsp_area LUTs
+  double GetMultiplierArea(int width_a, int width_b);
+
+  // Whether the device has DSP blocks
+  bool HasDSPs();
+  // Register to register delay of a stage of a DSP block, excluding setup
+  enum class DSPStage {
+    PreAdder,   // A and D registers to the AD register
+    Multiplier, // A or AD and B registers to the M register
+    PostAdder,  // M register and C input to the P register
+  };
+  double GetDSPStageDelay(DSPStage stage);
+  // Whether a signed multiply of the given widths is best done by a single
+  // DSP block, which it must fit into and be large enough to be worth using
+  bool UseDSPForMultiply(int width_a, int width_b);
+
+private:
+  bool is_flat = true;
+  // Library parameters, in seconds unless noted otherwise
+  double ff_setup = 0.1e-9, ff_clk_to_q = 1e-9;
+  int lut_inputs = 6;
+  double lut_delay = 1e-9;
+  double carry_entry = 0, carry_per_bit = 0;
+  int dsp_width_a = 0, dsp_width_b = 0; // 0 if there are no DSP blocks
+  double dsp_preadd_delay = 0, dsp_mult_delay = 0, dsp_post_delay = 0;
+  // Number of LUTs that a DSP block is considered to be worth, so that DSP
+  // blocks are only used when they save at least that much logic
+  int dsp_area = 0;
+  double route_delay = 0, route_per_fanout = 0;
+
+  // Number of LUT levels needed to combine the given number of signals
+  int GetLUTLevels(int inputs);
+  // Largest multiplexer that fits into a single LUT
+  int GetLUTMuxSize();
+  double GetCarryChainDelay(int width);
+  double GetMultiplierDelay(int width_a, int width_b);
+  // Number of DSP blocks needed for a multiplier
+  int GetDSPTiles(int width_a, int width_b);
 };
-};
+}; // namespace ElasticC
@@ -0,0 +1,30 @@
+import tester, sys
+
+# The ROM has a latency of one cycle, so with outputs sampled after each clock
+# edge the results appear in the same row as their inputs
+res = tester.run_test(input_file="coefficients.ecc", uut_name="coefficients",
+        inputs=[("i", 4), ("x", 8)], outputs=[("y", 16), ("z", 8)],
+        is_clocked=True,
+        input_vectors=  [[8, 183], [0, 238], [7, 26], [5, 57], [11, 240],
+                         [7, 194], [3, 127], [0, 110], [13, 143], [5, 199],
+                         [5, 36], [4, 227], [4, 67], [0, 2], [6, 110], [5, 85]],
+        output_results= [[12261, 204], [714, 239], [1352, 37], [1596, 68],
+                         [29760, 5], [10088, 205], [1524, 128], [330, 111],
+                         [24596, 174], [5572, 210], [1008, 47], [4313, 238],
+                         [1273, 78], [6, 3], [4290, 121], [2380, 96]])
+
+# Two more cycles of read latency delay the results by two rows
+if res == 0:
+    res = tester.run_test(input_file="coefficients_registered.ecc",
+            uut_name="coefficients_registered",
+            inputs=[("i", 4), ("x", 8)], outputs=[("y", 16)],
+            is_clocked=True,
+            input_vectors=  [[8, 183], [0, 238], [7, 26], [5, 57], [11, 240],
+                             [7, 194], [3, 127], [0, 110], [0, 0], [0, 0]],
+            output_results= [[None]] * 2 +
+                            [[12261], [714], [1352], [1596], [29760],
+                             [10088], [1524], [330]])
+if res == 0:
+    res = tester.run_golden_check(input_file="coefficients_registered.ecc",
+            uut_name="coefficients_registered", count=2000)
+sys.exit(res)
@@ -4,4 +4,13 @@ res = tester.run_test(input_file="cond.ecc", uut_name="conditional",
         inputs=[("x", 8)], outputs=[("y", 8)], is_clocked=False,
         input_vectors=[[5], [127], [255]],
         output_results= [[5], [127], [1]])
+if res == 0:
+    res = tester.run_test(input_file="kept.ecc", uut_name="kept",
+            inputs=[("x", 8), ("a", 8)], outputs=[("y", 8), ("z", 8)],
+            is_clocked=False,
+            input_vectors=[[5, 3], [255, 8], [20, 200], [20, 1], [0, 8]],
+            output_results= [[3, 4], [0, 3], [200, 2], [1, 1], [8, 3]])
+if res == 0:
+    res = tester.run_golden_check(input_file="kept.ecc", uut_name="kept",
+            count=65536)
 sys.exit(res)
@@ -0,0 +1,13 @@
+import tester, sys
+
+res = tester.run_test(input_file="constmul.ecc", uut_name="constmul",
+        inputs=[("x", 8), ("u", 8)],
+        outputs=[("p", 16), ("q", 16), ("r", 16), ("s", 16), ("t", 16), ("z", 16)],
+        is_clocked=False,
+        input_vectors=[[3, 5], [0x80, 255], [0x7F, 200], [0xF9, 1], [0, 128]],
+        output_results= [[21, 69, 65401, 243, 36, 575],
+                         [64640, 62592, 5760, 55168, 64000, 29325],
+                         [889, 2921, 59821, 10287, 1524, 23000],
+                         [65487, 65375, 315, 64969, 65452, 115],
+                         [0, 0, 0, 0, 0, 14720]])
+sys.exit(res)
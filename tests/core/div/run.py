@@ -0,0 +1,30 @@
+import tester, sys
+
+res = tester.run_test(input_file="div.ecc", uut_name="divide",
+        inputs=[("a", 16), ("b", 8), ("c", 8)],
+        outputs=[("q3", 16), ("r3", 8), ("qc", 16), ("rc", 8), ("q4", 8), ("r4", 8)],
+        is_clocked=False,
+        input_vectors=  [[1000, 156, 7],                 [65535, 127, 1],
+                         [5, 128, 3],                    [12345, 249, 2]],
+        output_results= [[333, 1, 65522, 254, 231, 0],   [21845, 0, 127, 0, 31, 3],
+                         [1, 2, 65494, 254, 224, 0],     [4115, 0, 65533, 255, 255, 253]])
+
+# The pipelined dividers have a latency of eight cycles, so results appear seven
+# rows after their inputs. Dividing by zero gives a quotient magnitude of all
+# ones and the dividend as the remainder, with the sign of the dividend
+if res == 0:
+    res = tester.run_test(input_file="div_clocked.ecc", uut_name="divide_clocked",
+            inputs=[("n", 8), ("s", 8), ("d", 8)],
+            outputs=[("q", 8), ("r", 8), ("qs", 16), ("rs", 8), ("p", 8)],
+            is_clocked=True,
+            input_vectors=  [[200, 100, 7], [255, 128, 0], [17, 243, 0], [0, 5, 0],
+                             [99, 236, 3], [7, 127, 255]] + [[0, 0, 1]] * 8,
+            output_results= [[None] * 5] * 7 +
+                            [[28, 4, 14, 2, 207], [255, 255, 65281, 128, 255],
+                             [255, 17, 65281, 243, 17], [255, 0, 255, 5, 0],
+                             [33, 0, 65530, 254, 102], [0, 7, 0, 127, 6],
+                             [0, 0, 0, 0, 1]])
+if res == 0:
+    res = tester.run_golden_check(input_file="div_clocked.ecc",
+            uut_name="divide_clocked", count=5000)
+sys.exit(res)
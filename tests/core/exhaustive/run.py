@@ -0,0 +1,11 @@
+import tester, sys
+
+def model(a, b):
+    sb = b - 256 if b >= 128 else b
+    d = a - sb if a > sb else sb - a
+    return [d, a * sb, (a >> (sb & 7)) ^ (sb << 1)]
+
+res = tester.run_exhaustive_test(input_file="exhaustive.ecc", uut_name="exhaustive",
+        inputs=[("a", 8), ("b", 8)], outputs=[("d", 8), ("p", 16), ("s", 8)],
+        model=model)
+sys.exit(res)
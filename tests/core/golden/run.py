@@ -0,0 +1,23 @@
+import tester, sys
+
+# The accumulator is worked out by hand from the golden model, which gives the
+# outputs of each sample before its write, so acc starts at the initialiser and
+# lags the running total of a by one sample
+res = tester.run_test(input_file="golden.ecc", uut_name="golden",
+        inputs=[("a", 8), ("b", 8), ("s", 3)],
+        outputs=[("acc", 16)],
+        is_clocked=True,
+        input_vectors=  [[100, 1, 1], [100, 1, 1], [0x80, 1, 1], [27, 1, 1],
+                         [1, 1, 1]],
+        output_results= [[0], [100], [200], [72], [99]],
+        golden=True)
+
+# The other results are not given by hand, as the netlist is checked against
+# the golden model instead, both as it is and with an elastic interface
+if res == 0:
+    res = tester.run_golden_check(input_file="golden.ecc", uut_name="golden",
+            count=20000)
+if res == 0:
+    res = tester.run_golden_check(input_file="golden.ecc", uut_name="golden",
+            count=20000, args=["--elastic"])
+sys.exit(res)
@@ -0,0 +1,13 @@
+import tester, sys
+
+# The memory has a latency of one cycle, so with outputs sampled after each
+# clock edge the results appear in the same row as their inputs
+res = tester.run_test(input_file="histogram.ecc", uut_name="histogram",
+        inputs=[("x", 4)], outputs=[("count", 8), ("other", 8)],
+        is_clocked=True,
+        input_vectors=  [[3], [3], [2], [3], [5], [4], [4], [4], [2], [15],
+                         [14], [3], [3], [0], [1], [1]],
+        output_results= [[1, 0], [2, 0], [1, 2], [3, 1], [1, 0], [1, 1],
+                         [2, 1], [3, 1], [2, 3], [1, 0], [1, 1], [4, 2],
+                         [5, 2], [1, 0], [1, 1], [2, 1]])
+sys.exit(res)
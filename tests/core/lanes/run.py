@@ -0,0 +1,11 @@
+import tester, sys
+
+# Four lanes, so each port holds four values with lane 0 in the least
+# significant bits
+res = tester.run_test(input_file="lanes.ecc", uut_name="lanes",
+        inputs=[("a", 32), ("b", 32)], outputs=[("s", 40), ("m", 32)],
+        is_clocked=False,
+        input_vectors=[[67305985, 134678021], [3363832063, 1686241024]],
+        output_results= [[21491625992, 134678021], [752157458173, 3363962879]],
+        args=["--lanes", "4"])
+sys.exit(res)
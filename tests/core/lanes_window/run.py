@@ -0,0 +1,42 @@
+import tester, sys
+
+px = [3, 200, 17, 64, 255, 9, 120, 33, 77, 140, 1, 250,
+      96, 45, 180, 66, 7, 99, 210, 14, 38, 160, 5, 123]
+
+# The golden model gives the outputs of each sample before its own pixel is
+# pushed. Run on one pixel at a time, it reads back through a window where the
+# top row lags two lines of six pixels behind the bottom row
+single = [[0, 0, 0, 0, 0], [0, 0, 3, 0, 3], [0, 0, 200, 0, 203],
+          [0, 0, 17, 3, 220], [0, 0, 64, 200, 281], [0, 0, 255, 17, 336],
+          [0, 0, 9, 64, 328], [0, 0, 120, 255, 387], [0, 3, 33, 9, 365],
+          [0, 200, 77, 120, 450], [0, 17, 140, 33, 531], [0, 64, 1, 77, 554],
+          [0, 255, 250, 140, 719], [0, 9, 96, 1, 734], [0, 120, 45, 250, 756],
+          [3, 33, 180, 96, 771], [200, 77, 66, 45, 822], [17, 140, 7, 180, 807],
+          [64, 1, 99, 66, 891], [255, 250, 210, 7, 1047], [9, 96, 14, 99, 876],
+          [120, 45, 38, 210, 813], [33, 180, 160, 14, 753], [77, 66, 5, 38, 674]]
+res = tester.run_test(input_file="window.ecc", uut_name="lanes_window",
+        inputs=[("px", 8)],
+        outputs=[("tl", 8), ("mid", 8), ("br", 8), ("old", 8), ("sum", 12)],
+        is_clocked=True, input_vectors=[[p] for p in px],
+        output_results=single, golden=True)
+
+# With two lanes, each lane's outputs are those of its pixel alone
+if res == 0:
+    widths = [8, 8, 8, 8, 12]
+    res = tester.run_test(input_file="window.ecc", uut_name="lanes_window",
+            inputs=[("px", 16)],
+            outputs=[("tl", 16), ("mid", 16), ("br", 16), ("old", 16),
+                     ("sum", 24)],
+            is_clocked=True,
+            input_vectors=[[px[i] | (px[i + 1] << 8)]
+                           for i in range(0, len(px), 2)],
+            output_results=[[a | (b << w) for a, b, w in
+                             zip(single[i], single[i + 1], widths)]
+                            for i in range(0, len(px), 2)],
+            args=["--lanes", "2"], golden=True)
+
+# The netlist of the shared window is checked against the golden model
+if res == 0:
+    res = tester.run_golden_check(input_file="window.ecc",
+            uut_name="lanes_window", count=5000, args=["--lanes", "2"])
+sys.exit(res)
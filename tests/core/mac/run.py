@@ -0,0 +1,35 @@
+import tester, sys
+
+# Built for a device with DSP blocks, giving a latency of five cycles: four for
+# the pre-adder, multiply and post-adder of p, and one more for each DSP block
+# in the chain for q. Results appear four rows after their inputs
+res = tester.run_test(input_file="mac.ecc", uut_name="mac",
+        inputs=[("a", 8), ("b", 8), ("c", 8), ("d", 8), ("e", 16)],
+        outputs=[("p", 32), ("q", 32)],
+        is_clocked=True,
+        input_vectors=  [[3, 4, 5, 6, 7], [128, 127, 255, 100, 32768],
+                         [127, 128, 127, 127, 32767], [255, 255, 255, 255, 65535],
+                         [0, 0, 0, 0, 0], [0, 0, 0, 0, 0], [0, 0, 0, 0, 0],
+                         [0, 0, 0, 0, 0]],
+        output_results= [[None, None], [None, None], [None, None], [None, None],
+                         [43, 70], [4294930972, 4290789404],
+                         [255, 4290772993], [1, 3]],
+        args=["--device", "xc7-1"])
+
+# The stages inside each DSP block are timing endpoints of their own, so the
+# 2.5ns multiplier stage limits Fmax however the design is pipelined
+def check(report):
+    stages = [p for p in report["critical_paths"]
+              if p["endpoint"].startswith("dsp_")]
+    if not any(p["endpoint"].endswith(".m") and p["arrival_ns"] == 2.5
+               for p in stages):
+        return "no multiplier stage endpoint in {}".format(stages)
+    if report["clock_domains"][0]["fmax_mhz"] > 1000 / (2.5 + 0.06) + 0.01:
+        return "Fmax {} exceeds that of the multiplier stage".format(
+            report["clock_domains"][0]["fmax_mhz"])
+    return None
+
+if res == 0:
+    res = tester.run_timing_test(input_file="mac.ecc", uut_name="mac",
+            num_paths=100, check=check, args=["--device", "xc7-1"])
+sys.exit(res)
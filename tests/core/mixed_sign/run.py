@@ -0,0 +1,19 @@
+import tester, sys
+
+def s8(v):
+    return v & 0xff
+
+res = tester.run_test(input_file="mixed_sign.ecc", uut_name="mixed_sign",
+        inputs=[("x", 2), ("y", 2), ("z", 2)],
+        outputs=[("cs", 8), ("cd", 8), ("s", 8), ("d", 8), ("t", 8)],
+        is_clocked=False,
+        input_vectors=[[1, 3, 3], [2, 3, 3], [1, 0, 0], [2, 0, 1], [3, 2, 1]],
+        output_results= [[4, s8(-2), 4, s8(-2), s8(-5)],
+                         [4, s8(-2), 1, s8(-5), s8(-8)],
+                         [4, s8(-2), 1, 1, 1],
+                         [4, s8(-2), s8(-2), s8(-2), s8(-3)],
+                         [4, s8(-2), 1, s8(-3), s8(-4)]])
+if res == 0:
+    res = tester.run_golden_check(input_file="mixed_sign.ecc",
+            uut_name="mixed_sign", count=64)
+sys.exit(res)
@@ -0,0 +1,41 @@
+import tester, sys
+
+# A new iteration starts every three cycles, with the inputs only sampled when
+# it starts. Results appear two rows after the inputs, and are then held with
+# output_valid set until the next iteration starts
+res = tester.run_test(input_file="multicycle.ecc", uut_name="multicycle",
+        inputs=[("reset", 1), ("input_valid", 1), ("a", 8), ("b", 8), ("c", 8),
+                ("d", 8), ("e", 8)],
+        outputs=[("p", 32), ("q", 32), ("output_valid", 1), ("input_ready", 1)],
+        is_clocked=True,
+        input_vectors=  [[1, 0, 0, 0, 0, 0, 0], [0, 1, 3, 4, 5, 6, 7],
+                         [0, 1, 121, 66, 189, 242, 33], [0, 1, 6, 240, 132, 119, 98],
+                         [0, 1, 128, 127, 255, 100, 200], [0, 1, 240, 243, 203, 77, 118],
+                         [0, 1, 77, 199, 7, 32, 81], [0, 1, 255, 255, 255, 255, 255],
+                         [0, 1, 21, 154, 15, 137, 242], [0, 1, 198, 218, 202, 227, 68],
+                         [0, 0, 0, 0, 0, 0, 0]],
+        output_results= [[None, None, 0, 1], [None, None, 0, 0], [None, None, 0, 0],
+                         [102, 75, 1, 1], [None, None, 0, 0], [None, None, 0, 0],
+                         [4290842016, 4291670756, 1, 1], [None, None, 0, 0],
+                         [None, None, 0, 0], [0, 4294967295, 1, 1],
+                         [0, 4294967295, 1, 1]],
+        args=["--ii", "3"])
+if res == 0:
+    res = tester.run_golden_check(input_file="multicycle.ecc",
+            uut_name="multicycle", count=5000, args=["--ii", "3"])
+
+# Steps registered to meet timing still give the same results, and every
+# endpoint meets timing
+def check(report):
+    domain = report["clock_domains"][0]
+    if domain["failing_endpoints"] != 0:
+        return "{} endpoints failing".format(domain["failing_endpoints"])
+    return None
+
+if res == 0:
+    res = tester.run_golden_check(input_file="shared.ecc", uut_name="shared",
+            count=5000, args=["--ii", "3"])
+if res == 0:
+    res = tester.run_timing_test(input_file="shared.ecc", uut_name="shared",
+            num_paths=5, check=check, args=["--ii", "3"])
+sys.exit(res)
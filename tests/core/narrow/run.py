@@ -0,0 +1,10 @@
+import tester, sys
+
+res = tester.run_test(input_file="narrow.ecc", uut_name="narrow",
+        inputs=[("a", 8), ("b", 8)],
+        outputs=[("q", 16), ("m", 16), ("w", 8), ("c", 8)],
+        is_clocked=False,
+        input_vectors=[[3, 5], [200, 0x80], [101, 0xF9], [255, 0x7F], [0, 0xFF], [255, 0x80]],
+        output_results= [[4, 15, 15, 0], [375, 64512, 128, 1], [188, 65501, 235, 1],
+                         [476, 1905, 125, 1], [0, 0, 253, 1], [476, 63616, 128, 1]])
+sys.exit(res)
@@ -0,0 +1,12 @@
+import tester, sys
+
+# The testbench samples outputs after each clock edge, so results appear two
+# rows after their inputs for a three cycle latency
+res = tester.run_test(input_file="pipeline.ecc", uut_name="pipeline",
+        inputs=[("a", 8), ("b", 8), ("c", 8)], outputs=[("q", 16), ("r", 8)],
+        is_clocked=True,
+        input_vectors=  [[3, 4, 5], [200, 100, 7], [255, 255, 255], [0, 9, 1],
+                         [0, 0, 0], [0, 0, 0], [0, 0, 0]],
+        output_results= [[None, None], [None, None], [55, 4], [3804, 201],
+                         [511, 0], [9, 1], [0, 1]])
+sys.exit(res)
@@ -0,0 +1,10 @@
+import tester, sys
+
+res = tester.run_test(input_file="reduce.ecc", uut_name="reduce",
+        inputs=[("a", 48), ("b", 48)], outputs=[("q", 16), ("x", 8), ("o", 8)],
+        is_clocked=False,
+        input_vectors=[[0x060504030201, 0x0C0B0A090807],
+                       [0x808080808080, 0x808080808080],
+                       [0x64F90500FF7F, 0x01FE7F098003]],
+        output_results= [[217, 7, 15], [32768, 0, 128], [1258, 24, 255]])
+sys.exit(res)
@@ -0,0 +1,11 @@
+import tester, sys
+
+res = tester.run_test(input_file="simplify.ecc", uut_name="simplify",
+        inputs=[("a", 8), ("b", 8)],
+        outputs=[("m", 16), ("i", 8), ("d", 8), ("r", 8), ("s", 16), ("c", 8), ("k", 8)],
+        is_clocked=False,
+        input_vectors=[[3, 5], [200, 0x80], [101, 0xF9], [100, 0x7F], [255, 0xFF]],
+        output_results= [[12, 3, 0, 3, 40, 0, 5], [800, 200, 25, 0, 64512, 128, 5],
+                         [404, 101, 12, 5, 65480, 7, 5], [400, 100, 12, 4, 1016, 0, 5],
+                         [1020, 255, 31, 7, 65528, 1, 5]])
+sys.exit(res)
@@ -0,0 +1,40 @@
+import tester, sys
+
+def s8(v):
+    return v & 0xff
+
+# Outputs are sampled after each clock edge, so each row sees the static
+# variables after its own write. The counter wraps after counting up from 250,
+# the last positive x is held through the negative one, and the reset in the
+# seventh row returns the variables to their initialisers, or zero
+res = tester.run_test(input_file="static_init.ecc", uut_name="static_init",
+        inputs=[("reset", 1), ("x", 8)],
+        outputs=[("count", 8), ("total", 16), ("prev", 16), ("held", 8)],
+        is_clocked=True,
+        input_vectors=  [[0, 10], [0, s8(-20)], [0, 127], [0, 1], [0, 1],
+                         [0, 1], [1, 5], [0, 5]],
+        output_results= [[251, 1020, 1010, 10], [252, 970, 990, 10],
+                         [253, 1244, 1117, 127], [254, 1119, 1118, 1],
+                         [255, 1120, 1119, 1], [0, 1121, 1120, 1],
+                         [250, 1005, 1000, 0], [251, 1010, 1005, 5]])
+
+# The golden model gives the outputs of each sample before its writes, so the
+# first sample reads the initialisers themselves
+if res == 0:
+    res = tester.run_test(input_file="static_init.ecc", uut_name="static_init",
+            inputs=[("x", 8)],
+            outputs=[("count", 8), ("total", 16), ("prev", 16), ("held", 8)],
+            is_clocked=True,
+            input_vectors=  [[10], [s8(-20)], [127], [1], [1], [1]],
+            output_results= [[250, 1010, 1000, 0], [251, 990, 1010, 10],
+                             [252, 1117, 990, 10], [253, 1118, 1117, 127],
+                             [254, 1119, 1118, 1], [255, 1120, 1119, 1]],
+            golden=True)
+
+if res == 0:
+    res = tester.run_golden_check(input_file="static_init.ecc",
+            uut_name="static_init", count=2000)
+if res == 0:
+    res = tester.run_golden_check(input_file="static_init.ecc",
+            uut_name="static_init", count=2000, args=["--elastic"])
+sys.exit(res)
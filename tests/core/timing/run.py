@@ -0,0 +1,43 @@
+import tester, sys
+
+# At 200MHz the multiply and add to p is the only path taking more than one
+# adder delay, so it sets the worst slack, with a 0.1ns setup time
+def check(report):
+    domain = report["clock_domains"][0]
+    if domain["period_ns"] != 5 or domain["endpoints"] != 3:
+        return "unexpected clock domain {}".format(domain)
+    path = report["critical_paths"][0]
+    if path["endpoint"] != "p":
+        return "most critical path is to {}".format(path["endpoint"])
+    if abs(domain["worst_slack_ns"] - (5 - path["arrival_ns"] - 0.1)) > 1e-3:
+        return "worst slack {} does not match arrival {}".format(
+            domain["worst_slack_ns"], path["arrival_ns"])
+    return None
+
+res = tester.run_timing_test(input_file="timing.ecc", uut_name="timing",
+        num_paths=2, check=check)
+if res == 0:
+    res = tester.run_timing_test(input_file="timing.ecc", uut_name="timing",
+            num_paths=10, check=check)
+
+# With valid/ready handshaking every endpoint still meets timing, output_valid
+# is aligned with the data and ready is registered, so every latency is known
+def check_elastic(report):
+    domain = report["clock_domains"][0]
+    if domain["failing_endpoints"] != 0:
+        return "{} endpoints failing".format(domain["failing_endpoints"])
+    latencies = {(lat["input"], lat["output"]): lat["cycles"]
+                 for lat in report["latencies"]}
+    for pair, cycles in latencies.items():
+        if cycles is None:
+            return "latency {} -> {} is unknown".format(*pair)
+    if latencies[("input_valid", "output_valid")] != latencies[("a", "q")]:
+        return "output_valid is not aligned with q"
+    if latencies[("output_ready", "input_ready")] != 1:
+        return "input_ready does not come from a register"
+    return None
+
+if res == 0:
+    res = tester.run_timing_test(input_file="elastic.ecc", uut_name="elastic",
+            num_paths=5, check=check_elastic, args=["--elastic"])
+sys.exit(res)
@@ -0,0 +1,17 @@
+import tester, sys
+
+# Outputs are sampled after each clock edge, so each row sees the window after
+# its own pixel has been pushed. The top row of the window lags two lines of
+# five pixels behind the bottom row
+res = tester.run_test(input_file="window.ecc", uut_name="window",
+        inputs=[("px", 8)], outputs=[("tl", 8), ("mid", 8), ("br", 8), ("sum", 12)],
+        is_clocked=True,
+        input_vectors=  [[3], [200], [17], [64], [255], [9], [120], [33], [77],
+                         [140], [1], [250], [96], [45], [180], [66]],
+        output_results= [[0, 0, 3, 3], [0, 0, 200, 203], [0, 0, 17, 220],
+                         [0, 0, 64, 281], [0, 0, 255, 336], [0, 0, 9, 331],
+                         [0, 3, 120, 587], [0, 200, 33, 382], [0, 17, 77, 511],
+                         [0, 64, 140, 586], [0, 255, 1, 549], [0, 9, 250, 978],
+                         [3, 120, 96, 729], [200, 33, 45, 902], [17, 77, 180, 907],
+                         [64, 140, 66, 837]])
+sys.exit(res)
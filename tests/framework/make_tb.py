@@ -1,5 +1,6 @@
 """
-Load the testbench template and customise it for a given design
+Load the testbench template and customise it for a given design, or write a
+driver for a design's C++ model
 """
 import os, sys
 
@@ -58,3 +59,44 @@ def generate_vhdl(uut_name, inputs, outputs, is_clocked, outfile):
 
     with open(outfile, 'w') as outf:
        outf.write(testbench)
+
+def generate_cpp(uut_name, inputs, outputs, outfile):
+    """
+    Build a driver for the C++ model of a design in uut.hpp, which reads input
+    vectors from input.txt and writes the outputs after each to output.txt.
+    Inputs and outputs a list of (name, width) tuples
+    """
+    read_ip = ""
+    for i, sig in enumerate(inputs):
+        name, width = sig
+        read_ip += "    ecc::from_binary(uut.{}, words.at({}));\n".format(name, i)
+    write_out = ""
+    for i, sig in enumerate(outputs):
+        name, width = sig
+        separator = " << \" \"" if i != len(outputs) - 1 else ""
+        write_out += "    out << ecc::to_binary(uut.{}, {}){};\n".format(name, width, separator)
+
+    with open(outfile, 'w') as outf:
+        outf.write("""#include "uut.hpp"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+int main() {{
+  std::ifstream in("input.txt");
+  std::ofstream out("output.txt");
+  {} uut;
+  std::string line;
+  while (std::getline(in, line)) {{
+    std::istringstream split(line);
+    std::vector<std::string> words;
+    std::string word;
+    while (split >> word)
+      words.push_back(word);
+{}    uut.tick();
+{}    out << std::endl;
+  }}
+  return 0;
+}}
+""".format(uut_name, read_ip, write_out))
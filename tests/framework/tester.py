@@ -1,53 +1,37 @@
 """Main VHDL test framework entry point"""
-import os, sys, subprocess
+import os, sys, subprocess, json, shutil
 
-import make_tb
+import make_tb, verilog_lint
 
 dirname = os.path.dirname(__file__)
 eccexe = os.path.join(dirname, '../../bin/elasticc')
 
 
-def run_test(input_file, uut_name, inputs, outputs, is_clocked, input_vectors, output_results):
+def run_ghdl(tempdir, input_file, uut_name, inputs, outputs, is_clocked, args):
     """
-    Build input_file using ElasticC into VHDL
-    Build a testbench in VHDL and run it using ghdl.
-    Inputs and outputs are list of (name, width) tuples.
-    input_vectors and output_results are both an array of integers
-    An entry in output_results can also be None for a don't care
-    Return 0 on success or 1 on failure
+    Build the design into VHDL, then build a testbench in VHDL and run it using
+    ghdl, which writes output.txt. Return 0 on success or 1 on failure
     """
-    print(" -- Testing module {} --".format(uut_name))
-    input_dir = os.path.dirname(input_file)
-    input_bn = os.path.basename(input_file)
-    tempdir = os.path.join(input_dir, "temp_run")
-    try:
-        os.makedirs(tempdir)
-    except OSError:
-        pass
-    
-    uutpath = os.path.join(tempdir, "uut.vhd")
+    if shutil.which("ghdl") is None:
+        print("Test failure: ghdl is not installed")
+        return 1
     try:
         # Run ElasticC
-        subprocess.run([eccexe, "-o", "uut.vhd", os.path.join("..", input_file)],
+        subprocess.run([eccexe, "-o", "uut.vhd", os.path.join("..", input_file)] + args,
                        cwd=tempdir, check=True)
     except subprocess.CalledProcessError:
-        print("Test failure: GHDL analysis exited with non-zero return code")
+        print("Test failure: ElasticC exited with non-zero return code")
         return 1
 
     tbpath = os.path.join(tempdir, "testbench.vhd")
     make_tb.generate_vhdl(uut_name, inputs, outputs, is_clocked, tbpath)
 
-    ipvpath = os.path.join(tempdir, "input.txt")
-    with open(ipvpath, 'w') as f:
-        for vector in input_vectors:
-            text_vectors = " ".join([format(vector[i], "0" + str(inputs[i][1]) + "b") for i in range(len(vector))])
-            f.write(text_vectors + '\n')
     try:
         # Analyse UUT
         subprocess.run(["ghdl", "-a", "uut.vhd"],
                        cwd=tempdir, check=True)
     except subprocess.CalledProcessError:
-        print("Test failure: ElasticC exited with non-zero return code")
+        print("Test failure: GHDL analysis exited with non-zero return code")
         return 1
 
     try:
@@ -69,7 +53,140 @@ def run_test(input_file, uut_name, inputs, outputs, is_clocked, input_vectors, o
     except subprocess.CalledProcessError:
         print("Test failure: GHDL run exited with non-zero return code")
         return 1
-    
+    return 0
+
+
+def run_simulator(tempdir, input_file, uut_name, inputs, outputs, args):
+    """
+    Run the design's netlist on the test vectors using ElasticC's built in
+    simulator, which writes output.txt. The VHDL is written to uut.vhd as
+    well, so that it can still be checked. Return 0 on success or 1 on failure
+    """
+    try:
+        subprocess.run([eccexe, "-o", "uut.vhd", os.path.join("..", input_file),
+                        "--simulate", "input.txt", "--sim-output", "output.txt",
+                        "--sim-inputs", ",".join([i[0] for i in inputs]),
+                        "--sim-outputs", ",".join([o[0] for o in outputs])] + args,
+                       cwd=tempdir, check=True)
+    except subprocess.CalledProcessError:
+        print("Test failure: ElasticC simulation exited with non-zero return code")
+        return 1
+    return 0
+
+
+def run_golden_model(tempdir, input_file, uut_name, inputs, outputs, args):
+    """
+    Run the design's golden model on the test vectors, which writes output.txt.
+    Return 0 on success or 1 on failure
+    """
+    try:
+        subprocess.run([eccexe, os.path.join("..", input_file),
+                        "--golden", "input.txt", "--sim-output", "output.txt",
+                        "--sim-inputs", ",".join([i[0] for i in inputs]),
+                        "--sim-outputs", ",".join([o[0] for o in outputs])] + args,
+                       cwd=tempdir, check=True)
+    except subprocess.CalledProcessError:
+        print("Test failure: ElasticC golden model exited with non-zero return code")
+        return 1
+    return 0
+
+
+def run_cpp_model(tempdir, input_file, uut_name, inputs, outputs, args):
+    """
+    Build a C++ model of the design, then a driver for it, and compile and run
+    them, which writes output.txt. Return 0 on success or 1 on failure
+    """
+    try:
+        subprocess.run([eccexe, os.path.join("..", input_file),
+                        "--cpp-model", "uut.hpp"] + args,
+                       cwd=tempdir, check=True)
+    except subprocess.CalledProcessError:
+        print("Test failure: ElasticC exited with non-zero return code")
+        return 1
+
+    make_tb.generate_cpp(uut_name, inputs, outputs, os.path.join(tempdir, "driver.cpp"))
+
+    cxx = os.environ.get("CXX", "c++")
+    try:
+        subprocess.run([cxx, "-std=c++17", "-O1", "-o", "driver", "driver.cpp"],
+                       cwd=tempdir, check=True)
+    except subprocess.CalledProcessError:
+        print("Test failure: C++ model failed to compile")
+        return 1
+    try:
+        subprocess.run([os.path.join(".", "driver")], cwd=tempdir, check=True)
+    except subprocess.CalledProcessError:
+        print("Test failure: C++ model exited with non-zero return code")
+        return 1
+    return 0
+
+
+def check_verilog(tempdir, input_file, uut_name, inputs, outputs, args):
+    """
+    Build the design into Verilog as well, written to uut.v, and lint it, as
+    no Verilog simulator is run. Inputs and outputs are lists of (name, width)
+    tuples that the module must have, or None if they are not known. Return 0
+    on success or 1 on failure
+    """
+    try:
+        subprocess.run([eccexe, "-o", "uut.v", os.path.join("..", input_file)] + args,
+                       cwd=tempdir, check=True, stdout=subprocess.DEVNULL)
+    except subprocess.CalledProcessError:
+        print("Test failure: ElasticC exited with non-zero return code writing Verilog")
+        return 1
+    ports = None
+    if inputs is not None:
+        ports = [(n, w, True) for n, w in inputs] + [(n, w, False) for n, w in outputs]
+    with open(os.path.join(tempdir, "uut.v"), 'r') as f:
+        problems = verilog_lint.lint(f.read(), uut_name, ports)
+    for problem in problems:
+        print("Test failure: Verilog lint: " + problem)
+    return 1 if problems else 0
+
+
+def run_test(input_file, uut_name, inputs, outputs, is_clocked, input_vectors, output_results, args=[], golden=False):
+    """
+    Build input_file using ElasticC and run the input vectors through it, using
+    a VHDL testbench run using ghdl if it is installed or the ECC_USE_GHDL
+    environment variable is set, or a C++ model of the design if ECC_USE_CPP
+    is set. Otherwise, or if ECC_USE_SIM is set, ElasticC's built in simulator
+    is used. The design's Verilog is also written and linted.
+    Inputs and outputs are list of (name, width) tuples.
+    input_vectors and output_results are both an array of integers
+    An entry in output_results can also be None for a don't care
+    args is a list of extra command line arguments to pass to ElasticC
+    If golden is true the design's golden model is run instead, giving the
+    outputs of each vector before its writes to state take effect
+    Return 0 on success or 1 on failure
+    """
+    print(" -- Testing module {} --".format(uut_name))
+    input_dir = os.path.dirname(input_file)
+    tempdir = os.path.join(input_dir, "temp_run")
+    try:
+        os.makedirs(tempdir)
+    except OSError:
+        pass
+
+    ipvpath = os.path.join(tempdir, "input.txt")
+    with open(ipvpath, 'w') as f:
+        for vector in input_vectors:
+            text_vectors = " ".join([format(vector[i], "0" + str(inputs[i][1]) + "b") for i in range(len(vector))])
+            f.write(text_vectors + '\n')
+
+    if golden:
+        result = run_golden_model(tempdir, input_file, uut_name, inputs, outputs, args)
+    elif os.environ.get("ECC_USE_CPP"):
+        result = run_cpp_model(tempdir, input_file, uut_name, inputs, outputs, args)
+    elif os.environ.get("ECC_USE_GHDL") or (not os.environ.get("ECC_USE_SIM") and
+                                            shutil.which("ghdl") is not None):
+        result = run_ghdl(tempdir, input_file, uut_name, inputs, outputs, is_clocked, args)
+    else:
+        result = run_simulator(tempdir, input_file, uut_name, inputs, outputs, args)
+    if result != 0:
+        return result
+    if check_verilog(tempdir, input_file, uut_name, inputs, outputs, args) != 0:
+        return 1
+
     ovpath = os.path.join(tempdir, "output.txt")
     with open(ovpath, 'r') as f:
         current_idx = 0
@@ -91,3 +208,162 @@ def run_test(input_file, uut_name, inputs, outputs, is_clocked, input_vectors, o
             current_idx+=1
     print(" -- All tests for module {} passed --".format(uut_name))
     return 0
+
+
+def run_exhaustive_test(input_file, uut_name, inputs, outputs, model, args=[]):
+    """
+    Build input_file using ElasticC and simulate every combination of input
+    values as an independent test, using the batch simulator, checking the
+    results against model.
+    Inputs and outputs are list of (name, width) tuples.
+    model is called with the input values as integers, and returns a list of
+    the expected outputs, where an entry can be None for a don't care
+    args is a list of extra command line arguments to pass to ElasticC
+    Return 0 on success or 1 on failure
+    """
+    print(" -- Exhaustively testing module {} --".format(uut_name))
+    input_dir = os.path.dirname(input_file)
+    tempdir = os.path.join(input_dir, "temp_run")
+    try:
+        os.makedirs(tempdir)
+    except OSError:
+        pass
+
+    try:
+        subprocess.run([eccexe, os.path.join("..", input_file),
+                        "--sim-exhaustive", "--sim-output", "output.txt",
+                        "--sim-inputs", ",".join([i[0] for i in inputs]),
+                        "--sim-outputs", ",".join([o[0] for o in outputs])] + args,
+                       cwd=tempdir, check=True)
+    except subprocess.CalledProcessError:
+        print("Test failure: ElasticC simulation exited with non-zero return code")
+        return 1
+    if check_verilog(tempdir, input_file, uut_name, inputs, outputs, args) != 0:
+        return 1
+
+    ovpath = os.path.join(tempdir, "output.txt")
+    with open(ovpath, 'r') as f:
+        current_idx = 0
+        for line in f:
+            # Tests count up through the input values, with the last input in
+            # the least significant bits
+            vector = []
+            low = 0
+            for name, width in reversed(inputs):
+                vector.insert(0, (current_idx >> low) & ((1 << width) - 1))
+                low += width
+            expected = model(*vector)
+            splitLine = [x.strip() for x in line.split(" ")]
+            for i in range(len(expected)):
+                if expected[i] is None:
+                    continue
+                res = int(splitLine[i], 2)
+                expt = expected[i] & ((1 << outputs[i][1]) - 1)
+                if res != expt:
+                    print("Test failure for inputs {}. Expected {} for output {}, but got {}.".format(vector, expt, outputs[i], res))
+                    return 1
+            current_idx += 1
+    if current_idx != (1 << sum([i[1] for i in inputs])):
+        print("Test failure: got {} results".format(current_idx))
+        return 1
+    print(" -- All {} tests for module {} passed --".format(current_idx, uut_name))
+    return 0
+
+
+def run_golden_check(input_file, uut_name, count, args=[]):
+    """
+    Build input_file using ElasticC and check its netlist against a golden model
+    compiled from the design before optimisation, using count random test
+    vectors or every combination of input values if there are fewer.
+    args is a list of extra command line arguments to pass to ElasticC
+    Return 0 on success or 1 on failure
+    """
+    print(" -- Checking module {} against its golden model --".format(uut_name))
+    try:
+        subprocess.run([eccexe, input_file, "--sim-check", str(count)] + args,
+                       check=True)
+    except subprocess.CalledProcessError:
+        print("Test failure: netlist differs from golden model")
+        return 1
+    tempdir = os.path.join(os.path.dirname(input_file), "temp_run")
+    try:
+        os.makedirs(tempdir)
+    except OSError:
+        pass
+    if check_verilog(tempdir, input_file, uut_name, None, None, args) != 0:
+        return 1
+    print(" -- All tests for module {} passed --".format(uut_name))
+    return 0
+
+
+def run_timing_test(input_file, uut_name, num_paths, check, args=[]):
+    """
+    Build input_file using ElasticC, writing its timing report as JSON and
+    reporting num_paths critical paths, and check that the report is
+    consistent: every clock domain's worst slack is that of its most critical
+    path, paths are listed in order of slack and the number of paths printed
+    and written is num_paths, or the number of endpoints if there are fewer.
+    check is then called with the report, and returns None if it is as
+    expected or a message describing the failure otherwise
+    args is a list of extra command line arguments to pass to ElasticC
+    Return 0 on success or 1 on failure
+    """
+    print(" -- Checking timing report of module {} --".format(uut_name))
+    input_dir = os.path.dirname(input_file)
+    tempdir = os.path.join(input_dir, "temp_run")
+    try:
+        os.makedirs(tempdir)
+    except OSError:
+        pass
+
+    try:
+        proc = subprocess.run([eccexe, os.path.join("..", input_file),
+                               "-o", "uut.vhd", "--timing-report", "timing.json",
+                               "--critical-paths", str(num_paths)] + args,
+                              cwd=tempdir, check=True, stdout=subprocess.PIPE,
+                              stderr=subprocess.STDOUT, universal_newlines=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        print("Test failure: ElasticC exited with non-zero return code")
+        return 1
+    printed = proc.stdout.count("critical path ")
+
+    with open(os.path.join(tempdir, "timing.json"), 'r') as f:
+        report = json.load(f)
+    for key in ["design", "clock_domains", "critical_paths", "latencies"]:
+        if key not in report:
+            print("Test failure: timing report has no {}".format(key))
+            return 1
+    if report["design"] != uut_name:
+        print("Test failure: timing report is for {}".format(report["design"]))
+        return 1
+
+    paths = report["critical_paths"]
+    endpoints = sum([d["endpoints"] for d in report["clock_domains"]])
+    if len(paths) != min(num_paths, endpoints) or printed != len(paths):
+        print("Test failure: expected {} critical paths, but {} were written and {} printed".format(
+            min(num_paths, endpoints), len(paths), printed))
+        return 1
+    slacks = [p["slack_ns"] for p in paths if "slack_ns" in p]
+    if slacks != sorted(slacks):
+        print("Test failure: critical paths are not in order of slack")
+        return 1
+    for domain in report["clock_domains"]:
+        if domain["clock"] is None:
+            continue
+        for key in ["period_ns", "worst_slack_ns", "failing_endpoints",
+                    "endpoints", "max_delay_ns", "fmax_mhz"]:
+            if key not in domain:
+                print("Test failure: clock domain {} has no {}".format(domain["clock"], key))
+                return 1
+        if slacks and abs(domain["worst_slack_ns"] - slacks[0]) > 1e-3:
+            print("Test failure: worst slack of clock domain {} is {}, but the most critical path has {}".format(
+                domain["clock"], domain["worst_slack_ns"], slacks[0]))
+            return 1
+
+    error = check(report)
+    if error is not None:
+        print("Test failure: " + error)
+        return 1
+    print(" -- All tests for module {} passed --".format(uut_name))
+    return 0
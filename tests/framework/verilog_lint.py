@@ -0,0 +1,244 @@
+"""
+Structural lint of the Verilog written by ElasticC, for when no Verilog
+simulator is available. It checks the plain subset of Verilog-2005 that the
+backend emits: brackets and blocks balance, the module has the expected ports,
+every name is declared once before it is used, wires are only driven by a
+single continuous assignment, regs are only assigned in always and initial
+blocks, and everything that is read is driven by something.
+"""
+import re
+
+keywords = {"module", "endmodule", "input", "output", "inout", "wire", "reg",
+            "integer", "signed", "assign", "always", "initial", "begin", "end",
+            "if", "else", "case", "endcase", "default", "posedge", "negedge",
+            "or", "for"}
+
+token_re = re.compile(r"""
+    (?P<space>\s+) |
+    (?P<number>[0-9]*'s?[bdhoBDHO][0-9a-fA-FxzXZ_]+ | [0-9][0-9_]*) |
+    (?P<name>[A-Za-z_][A-Za-z0-9_$]*) |
+    (?P<system>\$[A-Za-z_][A-Za-z0-9_]*) |
+    (?P<op><<<|>>>|<=|>=|==|!=|&&|\|\||<<|>>|[-+*/%&|^~!<>=?:;,.@#()\[\]{}])
+    """, re.VERBOSE)
+
+
+def tokenise(text):
+    text = re.sub(r"//[^\n]*", "", text)
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.DOTALL)
+    tokens = []
+    pos = 0
+    while pos < len(text):
+        m = token_re.match(text, pos)
+        if m is None:
+            raise ValueError("unexpected character '{}'".format(text[pos]))
+        if m.lastgroup != "space":
+            tokens.append((m.lastgroup, m.group(0)))
+        pos = m.end()
+    return tokens
+
+
+def skip_range(tokens, i):
+    """Return the index after a [msb:lsb] range starting at i, if there is one"""
+    if i < len(tokens) and tokens[i][1] == "[":
+        depth = 0
+        while True:
+            if tokens[i][1] == "[":
+                depth += 1
+            elif tokens[i][1] == "]":
+                depth -= 1
+                if depth == 0:
+                    return i + 1
+            i += 1
+    return i
+
+
+def lint(text, module_name, ports=None):
+    """
+    Lint the Verilog text, which should hold a single module named module_name.
+    ports is a list of (name, width, is_input) tuples that the module must have,
+    or None to skip the check. Returns a list of problems, empty if none
+    """
+    try:
+        tokens = tokenise(text)
+    except ValueError as e:
+        return [str(e)]
+    problems = []
+
+    # Brackets and blocks balance
+    pairs = {")": "(", "]": "[", "}": "{", "end": "begin",
+             "endcase": "case", "endmodule": "module"}
+    stack = []
+    for kind, tok in tokens:
+        if tok in ("(", "[", "{", "begin", "case", "module"):
+            stack.append(tok)
+        elif tok in pairs:
+            if not stack or stack[-1] != pairs[tok]:
+                return problems + ["unbalanced '{}'".format(tok)]
+            stack.pop()
+    if stack:
+        return problems + ["'{}' is never closed".format(stack[-1])]
+
+    if [t for k, t in tokens].count("module") != 1:
+        return problems + ["expected exactly one module"]
+    if tokens[0][1] != "module" or tokens[1][1] != module_name:
+        return problems + ["expected module {}".format(module_name)]
+
+    # Port list
+    declared = {}
+    i = 3
+    found_ports = []
+    while tokens[i][1] != ")":
+        direction = tokens[i][1]
+        if direction not in ("input", "output"):
+            return problems + ["bad port declaration at '{}'".format(direction)]
+        i += 1
+        kind = "wire"
+        if tokens[i][1] in ("wire", "reg"):
+            kind = tokens[i][1]
+            i += 1
+        if tokens[i][1] == "signed":
+            i += 1
+        width = 1
+        if tokens[i][1] == "[":
+            width = int(tokens[i + 1][1]) - int(tokens[i + 3][1]) + 1
+        i = skip_range(tokens, i)
+        name = tokens[i][1]
+        declared[name] = (kind, direction)
+        found_ports.append((name, width, direction == "input"))
+        i += 1
+        if tokens[i][1] == ",":
+            i += 1
+    if ports is not None:
+        for port in ports:
+            if port not in found_ports:
+                problems.append("port {} missing or of the wrong width or direction".format(port[0]))
+    i += 2
+
+    # Body: declarations, continuous assignments and procedural blocks
+    body = tokens[i:-1]
+    drivers = {}
+    procedural = set()
+    used = set()
+    j = 0
+    while j < len(body):
+        tok = body[j][1]
+        if tok in ("wire", "reg", "integer"):
+            j += 1
+            if body[j][1] == "signed":
+                j += 1
+            j = skip_range(body, j)
+            while True:
+                name = body[j][1]
+                if name in declared:
+                    problems.append("{} is declared twice".format(name))
+                declared[name] = (tok, None)
+                j = skip_range(body, j + 1)
+                if body[j][1] == "=":
+                    # A net declaration assignment drives the wire, while a reg
+                    # takes an initial value
+                    if tok == "wire":
+                        drivers[name] = drivers.get(name, 0) + 1
+                    else:
+                        procedural.add(name)
+                    depth = 0
+                    while depth > 0 or body[j][1] not in (",", ";"):
+                        if body[j][1] in ("(", "[", "{"):
+                            depth += 1
+                        elif body[j][1] in (")", "]", "}"):
+                            depth -= 1
+                        elif body[j][0] == "name":
+                            used.add(body[j][1])
+                        j += 1
+                if body[j][1] == ";":
+                    break
+                j += 1
+            j += 1
+        elif tok == "assign":
+            name = body[j + 1][1]
+            if name not in declared:
+                problems.append("{} is assigned before it is declared".format(name))
+            elif declared[name][0] != "wire" or declared[name][1] == "input":
+                problems.append("{} is not a wire that can be assigned".format(name))
+            sliced = body[j + 2][1] == "["
+            drivers[name] = drivers.get(name, 0) + (0 if sliced else 1)
+            if sliced:
+                drivers.setdefault(name, 0)
+                drivers[name] = max(drivers[name], 1)
+            j = skip_range(body, j + 2)
+            while body[j][1] != ";":
+                if body[j][0] == "name":
+                    used.add(body[j][1])
+                j += 1
+            j += 1
+        elif tok in ("always", "initial"):
+            j = lint_block(body, j + 1, declared, procedural, used, problems)
+        else:
+            problems.append("unexpected '{}' in module body".format(tok))
+            break
+
+    for name, count in drivers.items():
+        if count > 1:
+            problems.append("{} has {} continuous assignments".format(name, count))
+    for name in used:
+        if name in keywords:
+            continue
+        if name not in declared:
+            problems.append("{} is used but never declared".format(name))
+            continue
+        kind, direction = declared[name]
+        if direction == "input" or kind == "integer":
+            continue
+        if kind == "wire" and name not in drivers:
+            problems.append("wire {} is read but never driven".format(name))
+        if kind == "reg" and name not in procedural:
+            problems.append("reg {} is read but never assigned".format(name))
+    for name, (kind, direction) in declared.items():
+        if direction == "output" and name not in drivers and name not in procedural:
+            problems.append("output {} is never driven".format(name))
+    return problems
+
+
+def next_is_else(body, j):
+    return (j + 1 < len(body)) and (body[j + 1][1] == "else")
+
+
+def lint_block(body, j, declared, procedural, used, problems):
+    """
+    Lint the statement of an always or initial block starting at j, returning
+    the index after it. Statements are recognised by the token before them
+    """
+    starts = (";", "begin", "else", ":", ")")
+    depth = 0
+    block = 0
+    while True:
+        tok = body[j][1]
+        kind = body[j][0]
+        if tok == "(":
+            depth += 1
+        elif tok == ")":
+            depth -= 1
+        elif tok in ("begin", "case"):
+            block += 1
+        elif tok in ("end", "endcase"):
+            block -= 1
+            if block == 0 and depth == 0 and not next_is_else(body, j):
+                return j + 1
+        elif kind == "name" and depth == 0 and tok not in keywords:
+            prev = body[j - 1][1]
+            at_start = prev in starts
+            after = skip_range(body, j + 1)
+            if at_start and body[after][1] in ("<=", "="):
+                if tok not in declared:
+                    problems.append("{} is assigned but never declared".format(tok))
+                elif declared[tok][0] not in ("reg", "integer"):
+                    problems.append("{} is assigned in a procedural block but is not a reg".format(tok))
+                procedural.add(tok)
+            else:
+                used.add(tok)
+        elif kind == "name" and tok not in keywords:
+            if tok in declared and declared[tok][0] == "integer" and body[j + 1][1] == "=":
+                procedural.add(tok)
+            used.add(tok)
+        if tok == ";" and depth == 0 and block == 0 and not next_is_else(body, j):
+            return j + 1
+        j += 1